@@ -0,0 +1,139 @@
+#include "AssetRegistry.h"
+#include "PathHelpers.h"
+#include "PackedVertex.h"
+
+#include <WICTextureLoader.h>
+
+AssetRegistry::AssetRegistry(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context),
+	stats()
+{
+}
+
+AssetRegistry::~AssetRegistry()
+{
+}
+
+// --------------------------------------------------------
+// The one place a cache lookup happens
+//
+// - The first request for a key stores a future for the
+//   asset before loading it, outside the lock, so other
+//   threads asking for the same key wait on that future
+//   rather than loading the file again
+// - A load that fails is removed again, after everyone
+//   already waiting on it has been given the failed result
+// --------------------------------------------------------
+template <typename T>
+T AssetRegistry::Acquire(std::unordered_map<std::wstring, std::shared_future<T>>& assets, AssetCounts& counts,
+	const std::wstring& key, const std::function<T()>& load, const std::function<bool(const T&)>& isValid)
+{
+	std::promise<T> promise;
+	std::shared_future<T> existing;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto found = assets.find(key);
+		if (found != assets.end())
+		{
+			counts.hits++;
+			existing = found->second;
+		}
+		else
+		{
+			counts.misses++;
+			assets[key] = promise.get_future().share();
+		}
+	}
+
+	if (existing.valid())
+		return existing.get();
+
+	T asset = load();
+	promise.set_value(asset);
+
+	if (!isValid(asset))
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		assets.erase(key);
+	}
+
+	return asset;
+}
+
+std::wstring AssetRegistry::MeshKey(const std::wstring& relativePath, MeshVertexFormat vertexFormat, bool buildClusters)
+{
+	std::wstring key = CanonicalPath(relativePath);
+	key += vertexFormat == MeshVertexFormat::Packed ? L"|packed" : L"|full";
+	if (buildClusters)
+		key += L"|clusters";
+
+	return key;
+}
+
+std::shared_ptr<Mesh> AssetRegistry::GetMesh(const std::wstring& relativePath, MeshVertexFormat vertexFormat, bool buildClusters)
+{
+	std::wstring fileName = FixPath(relativePath);
+	return Acquire<std::shared_ptr<Mesh>>(meshes, stats.meshes, MeshKey(relativePath, vertexFormat, buildClusters),
+		[&]() { return std::make_shared<Mesh>(fileName, device, vertexFormat, buildClusters); },
+		[](const std::shared_ptr<Mesh>& mesh) { return mesh->GetLoadState() == MeshLoadState::Ready; });
+}
+
+std::shared_ptr<Mesh> AssetRegistry::GetMeshAsync(MeshLoader& loader, const std::wstring& relativePath, MeshVertexFormat vertexFormat, bool buildClusters)
+{
+	// The mesh is only known to have failed once the loader is done with it,
+	// so async loads stay in the registry either way
+	std::wstring fileName = FixPath(relativePath);
+	return Acquire<std::shared_ptr<Mesh>>(meshes, stats.meshes, MeshKey(relativePath, vertexFormat, buildClusters),
+		[&]() { return loader.LoadAsync(fileName, vertexFormat, buildClusters); },
+		[](const std::shared_ptr<Mesh>& mesh) { return mesh->GetLoadState() != MeshLoadState::Failed; });
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> AssetRegistry::GetTexture(const std::wstring& relativePath)
+{
+	std::wstring fileName = FixPath(relativePath);
+	return Acquire<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>(textures, stats.textures, CanonicalPath(relativePath),
+		[&]()
+		{
+			// Passing the context is what makes the loader generate mips
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+			std::lock_guard<std::mutex> guard(contextLock);
+			DirectX::CreateWICTextureFromFile(device.Get(), context.Get(), fileName.c_str(), 0, srv.GetAddressOf());
+			return srv;
+		},
+		[](const Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv) { return srv != nullptr; });
+}
+
+std::shared_ptr<SimpleVertexShader> AssetRegistry::GetVertexShader(const std::wstring& relativePath, bool packedInputLayout)
+{
+	std::wstring key = CanonicalPath(relativePath);
+	if (packedInputLayout)
+		key += L"|packed";
+
+	std::wstring fileName = FixPath(relativePath);
+	return Acquire<std::shared_ptr<SimpleVertexShader>>(vertexShaders, stats.shaders, key,
+		[&]()
+		{
+			// Packed vertices can't be described by reflection, so these get an explicit input layout
+			if (packedInputLayout)
+				return std::make_shared<SimpleVertexShader>(device, context, fileName.c_str(),
+					CreatePackedVertexInputLayout(device, fileName.c_str()), false);
+
+			return std::make_shared<SimpleVertexShader>(device, context, fileName.c_str());
+		},
+		[](const std::shared_ptr<SimpleVertexShader>& shader) { return shader->IsShaderValid(); });
+}
+
+std::shared_ptr<SimplePixelShader> AssetRegistry::GetPixelShader(const std::wstring& relativePath)
+{
+	std::wstring fileName = FixPath(relativePath);
+	return Acquire<std::shared_ptr<SimplePixelShader>>(pixelShaders, stats.shaders, CanonicalPath(relativePath),
+		[&]() { return std::make_shared<SimplePixelShader>(device, context, fileName.c_str()); },
+		[](const std::shared_ptr<SimplePixelShader>& shader) { return shader->IsShaderValid(); });
+}
+
+AssetRegistryStats AssetRegistry::GetStats()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return stats;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <future>
+#include <mutex>
+#include <functional>
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "SimpleShader.h"
+
+// How often requests for one kind of asset found it already loaded
+struct AssetCounts
+{
+	unsigned int hits; //requests answered with an asset that was already loaded (or being loaded)
+	unsigned int misses; //requests that had to load the asset from disk
+};
+
+struct AssetRegistryStats
+{
+	AssetCounts meshes;
+	AssetCounts textures;
+	AssetCounts shaders;
+};
+
+// --------------------------------------------------------
+// Loads every mesh, texture and shader file once and hands
+// out shared references to it from then on
+//
+// - Assets are keyed by their canonical path (see
+//   CanonicalPath in PathHelpers), so differently spelled
+//   paths to the same file still share one copy
+// - Safe to call from several threads: a request for an
+//   asset another thread is already loading waits for that
+//   load instead of starting a second one
+// - Failed loads aren't kept, so they're tried again on the
+//   next request
+// --------------------------------------------------------
+class AssetRegistry
+{
+public:
+	AssetRegistry(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~AssetRegistry();
+
+	//the same file loaded with a different vertex format or clustering is a separate mesh
+	std::shared_ptr<Mesh> GetMesh(const std::wstring& relativePath, MeshVertexFormat vertexFormat = MeshVertexFormat::Full, bool buildClusters = false);
+
+	//returns straight away, starting the load on the loader's workers if it's the first request
+	//(GetMesh() shares the same meshes, so it can return one that's still Loading)
+	std::shared_ptr<Mesh> GetMeshAsync(MeshLoader& loader, const std::wstring& relativePath,
+		MeshVertexFormat vertexFormat = MeshVertexFormat::Full, bool buildClusters = false);
+
+	//loads with a full mip chain (null if the file couldn't be loaded)
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTexture(const std::wstring& relativePath);
+
+	//packedInputLayout gives the shader the layout for PackedVertex instead of one from reflection
+	std::shared_ptr<SimpleVertexShader> GetVertexShader(const std::wstring& relativePath, bool packedInputLayout = false);
+	std::shared_ptr<SimplePixelShader> GetPixelShader(const std::wstring& relativePath);
+
+	//returns the hit and miss counts of every request so far
+	AssetRegistryStats GetStats();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context; //only used to generate texture mips
+	std::mutex lock; //guards the maps and the counts
+	std::mutex contextLock; //the immediate context can only be used by one thread at a time
+	AssetRegistryStats stats;
+
+	std::unordered_map<std::wstring, std::shared_future<std::shared_ptr<Mesh>>> meshes;
+	std::unordered_map<std::wstring, std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>> textures;
+	std::unordered_map<std::wstring, std::shared_future<std::shared_ptr<SimpleVertexShader>>> vertexShaders;
+	std::unordered_map<std::wstring, std::shared_future<std::shared_ptr<SimplePixelShader>>> pixelShaders;
+
+	//the key a mesh is stored under
+	std::wstring MeshKey(const std::wstring& relativePath, MeshVertexFormat vertexFormat, bool buildClusters);
+
+	//returns the asset stored under key, loading it (on this thread) if nobody has yet
+	template <typename T>
+	T Acquire(std::unordered_map<std::wstring, std::shared_future<T>>& assets, AssetCounts& counts,
+		const std::wstring& key, const std::function<T()>& load, const std::function<bool(const T&)>& isValid);
+};
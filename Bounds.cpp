@@ -0,0 +1,180 @@
+#include "Bounds.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+// The point at the given index of a strided array
+static const XMFLOAT3& PointAt(const XMFLOAT3* points, size_t stride, int index)
+{
+	return *(const XMFLOAT3*)((const char*)points + stride * index);
+}
+
+static XMVECTOR LoadPoint(const XMFLOAT3* points, size_t stride, int index)
+{
+	return XMLoadFloat3(&PointAt(points, stride, index));
+}
+
+// The smallest and largest coordinates of a set of points
+static void ComputeBox(const XMFLOAT3* points, int numPoints, size_t stride, XMVECTOR& boxMin, XMVECTOR& boxMax)
+{
+	boxMin = LoadPoint(points, stride, 0);
+	boxMax = boxMin;
+	for (int i = 1; i < numPoints; i++)
+	{
+		XMVECTOR p = LoadPoint(points, stride, i);
+		boxMin = XMVectorMin(boxMin, p);
+		boxMax = XMVectorMax(boxMax, p);
+	}
+}
+
+void ComputeBoundingSphere(const XMFLOAT3* points, int numPoints, size_t stride, XMFLOAT3& center, float& radius)
+{
+	center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	radius = 0.0f;
+	if (numPoints <= 0)
+		return;
+
+	// The points with the smallest and largest x, y and z
+	int minPoint[3] = { 0, 0, 0 };
+	int maxPoint[3] = { 0, 0, 0 };
+	float minValue[3] = { points->x, points->y, points->z };
+	float maxValue[3] = { points->x, points->y, points->z };
+	for (int i = 1; i < numPoints; i++)
+	{
+		const XMFLOAT3& p = PointAt(points, stride, i);
+		const float value[3] = { p.x, p.y, p.z };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (value[axis] < minValue[axis])
+			{
+				minValue[axis] = value[axis];
+				minPoint[axis] = i;
+			}
+			if (value[axis] > maxValue[axis])
+			{
+				maxValue[axis] = value[axis];
+				maxPoint[axis] = i;
+			}
+		}
+	}
+
+	// Start with the sphere through the pair that's furthest apart
+	XMVECTOR a = LoadPoint(points, stride, minPoint[0]);
+	XMVECTOR b = LoadPoint(points, stride, maxPoint[0]);
+	float widest = XMVectorGetX(XMVector3LengthSq(b - a));
+	for (int axis = 1; axis < 3; axis++)
+	{
+		XMVECTOR low = LoadPoint(points, stride, minPoint[axis]);
+		XMVECTOR high = LoadPoint(points, stride, maxPoint[axis]);
+		float distance = XMVectorGetX(XMVector3LengthSq(high - low));
+		if (distance > widest)
+		{
+			widest = distance;
+			a = low;
+			b = high;
+		}
+	}
+
+	XMVECTOR c = (a + b) * 0.5f;
+	float r = sqrtf(widest) * 0.5f;
+
+	// Grow it to take in any point that's still outside, moving
+	// towards the point just enough to reach it
+	for (int i = 0; i < numPoints; i++)
+	{
+		XMVECTOR p = LoadPoint(points, stride, i);
+		float distance = XMVectorGetX(XMVector3Length(p - c));
+		if (distance > r)
+		{
+			float grownRadius = (r + distance) * 0.5f;
+			c += (p - c) * ((grownRadius - r) / distance);
+			r = grownRadius;
+		}
+	}
+
+	// Evenly spread or boxy point sets can be bounded better from
+	// their average or from the box's center, so try those as well
+	XMVECTOR boxMin, boxMax;
+	ComputeBox(points, numPoints, stride, boxMin, boxMax);
+	XMVECTOR average = XMVectorZero();
+	for (int i = 0; i < numPoints; i++)
+		average += LoadPoint(points, stride, i);
+
+	XMVECTOR candidates[2] = { (boxMin + boxMax) * 0.5f, average / (float)numPoints };
+	for (int i = 0; i < 2; i++)
+	{
+		float candidateRadiusSq = 0.0f;
+		for (int j = 0; j < numPoints; j++)
+			candidateRadiusSq = fmaxf(candidateRadiusSq, XMVectorGetX(XMVector3LengthSq(LoadPoint(points, stride, j) - candidates[i])));
+
+		float candidateRadius = sqrtf(candidateRadiusSq);
+		if (candidateRadius < r)
+		{
+			c = candidates[i];
+			r = candidateRadius;
+		}
+	}
+
+	XMStoreFloat3(&center, c);
+	radius = r;
+}
+
+Bounds ComputeBounds(const XMFLOAT3* points, int numPoints, size_t stride)
+{
+	Bounds bounds = {};
+	if (numPoints <= 0)
+		return bounds;
+
+	XMVECTOR boxMin, boxMax;
+	ComputeBox(points, numPoints, stride, boxMin, boxMax);
+	XMStoreFloat3(&bounds.boxMin, boxMin);
+	XMStoreFloat3(&bounds.boxMax, boxMax);
+
+	ComputeBoundingSphere(points, numPoints, stride, bounds.sphereCenter, bounds.sphereRadius);
+	return bounds;
+}
+
+Bounds TransformBounds(const Bounds& bounds, const XMFLOAT4X4& matrix)
+{
+	XMMATRIX m = XMLoadFloat4x4(&matrix);
+
+	// Each axis of the box contributes its extent along the
+	// matrix's version of that axis, in whichever direction
+	XMVECTOR boxMin = XMLoadFloat3(&bounds.boxMin);
+	XMVECTOR boxMax = XMLoadFloat3(&bounds.boxMax);
+	XMVECTOR extents = (boxMax - boxMin) * 0.5f;
+	XMVECTOR center = XMVector3TransformCoord((boxMin + boxMax) * 0.5f, m);
+	XMVECTOR newExtents =
+		XMVectorAbs(m.r[0]) * XMVectorSplatX(extents) +
+		XMVectorAbs(m.r[1]) * XMVectorSplatY(extents) +
+		XMVectorAbs(m.r[2]) * XMVectorSplatZ(extents);
+
+	Bounds result = {};
+	XMStoreFloat3(&result.boxMin, center - newExtents);
+	XMStoreFloat3(&result.boxMax, center + newExtents);
+
+	XMStoreFloat3(&result.sphereCenter, XMVector3TransformCoord(XMLoadFloat3(&bounds.sphereCenter), m));
+	result.sphereRadius = bounds.sphereRadius * ComputeMaxScale(matrix);
+
+	return result;
+}
+
+float ComputeMaxScale(const XMFLOAT4X4& matrix)
+{
+	XMMATRIX m = XMLoadFloat4x4(&matrix);
+
+	// The most a matrix stretches anything is the square root of the largest
+	// eigenvalue of M * M^T, whose entries are the rows' dot products.  No
+	// eigenvalue is more than any row of that sums to (Gershgorin), nor more
+	// than its diagonal does, so the smaller of the two is used
+	float xx = XMVectorGetX(XMVector3LengthSq(m.r[0]));
+	float yy = XMVectorGetX(XMVector3LengthSq(m.r[1]));
+	float zz = XMVectorGetX(XMVector3LengthSq(m.r[2]));
+	float xy = fabsf(XMVectorGetX(XMVector3Dot(m.r[0], m.r[1])));
+	float xz = fabsf(XMVectorGetX(XMVector3Dot(m.r[0], m.r[2])));
+	float yz = fabsf(XMVectorGetX(XMVector3Dot(m.r[1], m.r[2])));
+
+	float rowSum = fmaxf(xx + xy + xz, fmaxf(yy + xy + yz, zz + xz + yz));
+	return sqrtf(fminf(rowSum, xx + yy + zz));
+}
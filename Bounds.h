@@ -0,0 +1,53 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// An axis-aligned box and a sphere around the same set of
+// points - the box is usually tighter, the sphere is cheaper
+// to test and doesn't change when the points are rotated
+// --------------------------------------------------------
+struct Bounds
+{
+	DirectX::XMFLOAT3 boxMin;
+	DirectX::XMFLOAT3 boxMax;
+	DirectX::XMFLOAT3 sphereCenter;
+	float sphereRadius;
+};
+
+// --------------------------------------------------------
+// A close fitting sphere around a set of points: the best
+// of Ritter's (seeded with the most separated pair of points
+// along the axes) and the spheres centered on the points'
+// average and on their box
+//
+// - stride is the distance in bytes from one point to the
+//   next, so positions can be read straight out of vertices
+// --------------------------------------------------------
+void ComputeBoundingSphere(const DirectX::XMFLOAT3* points, int numPoints, size_t stride,
+	DirectX::XMFLOAT3& center, float& radius);
+
+// The box and sphere around a set of points (all zero if there are none)
+Bounds ComputeBounds(const DirectX::XMFLOAT3* points, int numPoints, size_t stride);
+
+// --------------------------------------------------------
+// Moves bounds into another space, such as world space
+//
+// - The box is the smallest one around the transformed box,
+//   so it grows when rotated (Arvo's method)
+// - The sphere's radius grows by ComputeMaxScale(), so it
+//   stays conservative under any scale, sheared included
+// --------------------------------------------------------
+Bounds TransformBounds(const Bounds& bounds, const DirectX::XMFLOAT4X4& matrix);
+
+// --------------------------------------------------------
+// At least as much as the matrix stretches any length
+//
+// - Exactly the longest of the first three rows when they
+//   are perpendicular (any rotation and scale)
+// - A rotated child of a non-uniformly scaled parent is
+//   sheared, and can stretch a diagonal further than any of
+//   its axes; the rows' overlap with each other is added on
+//   to cover that
+// --------------------------------------------------------
+float ComputeMaxScale(const DirectX::XMFLOAT4X4& matrix);
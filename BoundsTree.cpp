@@ -0,0 +1,715 @@
+#include "BoundsTree.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+using namespace DirectX;
+
+// Leaves are made once this few objects are left, if splitting them wouldn't be cheaper
+#define BOUNDS_TREE_MAX_LEAF_OBJECTS 4
+#define BOUNDS_TREE_BINS 12
+
+// What visiting a node costs compared to testing one object's box
+#define BOUNDS_TREE_TRAVERSAL_COST 3.0f
+
+// fminf() and fmaxf() are library calls that handle NaNs, which these are too hot for
+static float Min(float a, float b) { return a < b ? a : b; }
+static float Max(float a, float b) { return a > b ? a : b; }
+
+// Half the surface area of a box, which is all the heuristic needs to compare them
+static float HalfArea(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	float x = boxMax.x - boxMin.x;
+	float y = boxMax.y - boxMin.y;
+	float z = boxMax.z - boxMin.z;
+	return x * y + y * z + z * x;
+}
+
+static void Grow(XMFLOAT3& boxMin, XMFLOAT3& boxMax, const XMFLOAT3& otherMin, const XMFLOAT3& otherMax)
+{
+	boxMin = XMFLOAT3(Min(boxMin.x, otherMin.x), Min(boxMin.y, otherMin.y), Min(boxMin.z, otherMin.z));
+	boxMax = XMFLOAT3(Max(boxMax.x, otherMax.x), Max(boxMax.y, otherMax.y), Max(boxMax.z, otherMax.z));
+}
+
+static void EmptyBox(XMFLOAT3& boxMin, XMFLOAT3& boxMax)
+{
+	boxMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	boxMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+static float Component(const XMFLOAT3& v, int axis)
+{
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static bool BoxesOverlap(const XMFLOAT3& aMin, const XMFLOAT3& aMax, const XMFLOAT3& bMin, const XMFLOAT3& bMax)
+{
+	return aMin.x <= bMax.x && aMax.x >= bMin.x &&
+		aMin.y <= bMax.y && aMax.y >= bMin.y &&
+		aMin.z <= bMax.z && aMax.z >= bMin.z;
+}
+
+static bool BoxTouchesSphere(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, const XMFLOAT3& center, float radiusSquared)
+{
+	// The distance from the center to the closest point in the box
+	float x = center.x - Min(Max(center.x, boxMin.x), boxMax.x);
+	float y = center.y - Min(Max(center.y, boxMin.y), boxMax.y);
+	float z = center.z - Min(Max(center.z, boxMin.z), boxMax.z);
+	return x * x + y * y + z * z <= radiusSquared;
+}
+
+// The distance along the ray where it enters the box (0 if it starts inside), or -1 if it
+// misses it before maxDistance
+static float RayEntersBox(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, const XMFLOAT3& origin,
+	const XMFLOAT3& inverseDirection, float maxDistance)
+{
+	float x0 = (boxMin.x - origin.x) * inverseDirection.x, x1 = (boxMax.x - origin.x) * inverseDirection.x;
+	float y0 = (boxMin.y - origin.y) * inverseDirection.y, y1 = (boxMax.y - origin.y) * inverseDirection.y;
+	float z0 = (boxMin.z - origin.z) * inverseDirection.z, z1 = (boxMax.z - origin.z) * inverseDirection.z;
+	float enter = Max(Max(Min(x0, x1), Min(y0, y1)), Max(Min(z0, z1), 0.0f));
+	float exit = Min(Min(Max(x0, x1), Max(y0, y1)), Min(Max(z0, z1), maxDistance));
+	return enter <= exit ? enter : -1.0f;
+}
+
+// One frustum plane, with its normal's absolute values ready for measuring how far a box reaches
+struct BoxPlane
+{
+	XMFLOAT4 plane;
+	XMFLOAT3 absNormal;
+};
+
+// Returns -1 if the box is entirely behind the plane, 1 if entirely in front, or 0 if it crosses it
+static int ClassifyBox(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, const BoxPlane& plane)
+{
+	float distance =
+		plane.plane.x * (boxMin.x + boxMax.x) +
+		plane.plane.y * (boxMin.y + boxMax.y) +
+		plane.plane.z * (boxMin.z + boxMax.z) + plane.plane.w * 2.0f;
+	float reach =
+		plane.absNormal.x * (boxMax.x - boxMin.x) +
+		plane.absNormal.y * (boxMax.y - boxMin.y) +
+		plane.absNormal.z * (boxMax.z - boxMin.z);
+	return distance < -reach ? -1 : (distance > reach ? 1 : 0);
+}
+
+BoundsTree::BoundsTree() :
+	refitNeeded(false),
+	cost(0.0f),
+	builtCostRatio(0.0f),
+	rebuildRatio(1.5f)
+{
+}
+
+void BoundsTree::Build(const Bounds* bounds, unsigned int count)
+{
+	objectOrder.resize(count);
+	boxMins.resize(count);
+	boxMaxes.resize(count);
+	spheres.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		objectOrder[i] = i;
+		boxMins[i] = bounds[i].boxMin;
+		boxMaxes[i] = bounds[i].boxMax;
+		spheres[i] = XMFLOAT4(bounds[i].sphereCenter.x, bounds[i].sphereCenter.y, bounds[i].sphereCenter.z, bounds[i].sphereRadius);
+	}
+
+	Rebuild();
+}
+
+void BoundsTree::Rebuild()
+{
+	unsigned int count = (unsigned int)objectOrder.size();
+	nodes.clear();
+	objectPositions.resize(count);
+	objectLeaves.resize(count);
+	refitNeeded = false;
+	cost = 0.0f;
+	builtCostRatio = 0.0f;
+	if (count == 0)
+		return;
+
+	BuildTask root;
+	root.node = 0;
+	root.first = 0;
+	root.count = count;
+	EmptyBox(root.boxMin, root.boxMax);
+	EmptyBox(root.centerMin, root.centerMax);
+	buildObjects.resize(count);
+	buildSpheres.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// Building only moves boxes, so the spheres wait by object to be put in the new order
+		buildSpheres[objectOrder[i]] = spheres[i];
+
+		BuildObject& buildObject = buildObjects[i];
+		buildObject.boxMin = boxMins[i];
+		buildObject.boxMax = boxMaxes[i];
+		XMStoreFloat3(&buildObject.center, (XMLoadFloat3(&boxMins[i]) + XMLoadFloat3(&boxMaxes[i])) * 0.5f);
+		buildObject.object = objectOrder[i];
+		Grow(root.boxMin, root.boxMax, buildObject.boxMin, buildObject.boxMax);
+		Grow(root.centerMin, root.centerMax, buildObject.center, buildObject.center);
+	}
+
+	// Splitting each node pushes its children, so the nodes end up in depth-first order
+	nodes.reserve(count * 2);
+	nodes.push_back(Node());
+	nodes[0].parent = -1;
+	buildTasks.clear();
+	buildTasks.push_back(root);
+	while (!buildTasks.empty())
+	{
+		BuildTask task = buildTasks.back();
+		buildTasks.pop_back();
+		BuildNode(task);
+	}
+
+	// The objects are now grouped by leaf
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const BuildObject& buildObject = buildObjects[i];
+		objectOrder[i] = buildObject.object;
+		objectPositions[buildObject.object] = i;
+		boxMins[i] = buildObject.boxMin;
+		boxMaxes[i] = buildObject.boxMax;
+		spheres[i] = buildSpheres[buildObject.object];
+	}
+
+	for (const Node& node : nodes)
+		cost += NodeCost(node);
+
+	float rootArea = HalfArea(nodes[0].boxMin, nodes[0].boxMax);
+	builtCostRatio = rootArea > 0.0f ? cost / rootArea : 0.0f;
+}
+
+void BoundsTree::BuildNode(const BuildTask& task)
+{
+	BuildObject* objects = &buildObjects[task.first];
+	unsigned int count = task.count;
+	Node& node = nodes[task.node];
+	node.boxMin = task.boxMin;
+	node.boxMax = task.boxMax;
+	node.refit = 0;
+
+	// Bin the centers along the axis they're spread furthest over
+	XMFLOAT3 spread(task.centerMax.x - task.centerMin.x, task.centerMax.y - task.centerMin.y, task.centerMax.z - task.centerMin.z);
+	int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+	float axisMin = Component(task.centerMin, axis);
+	float axisSpread = Component(spread, axis);
+	float binScale = axisSpread > 0.0f ? BOUNDS_TREE_BINS / axisSpread : 0.0f;
+
+	// Both children's tasks, filled in once the split is chosen
+	BuildTask left, right;
+	EmptyBox(left.boxMin, left.boxMax);
+	EmptyBox(right.boxMin, right.boxMax);
+	EmptyBox(left.centerMin, left.centerMax);
+	EmptyBox(right.centerMin, right.centerMax);
+
+	unsigned int split = count / 2;
+	bool makeLeaf = count <= 1;
+	if (!makeLeaf && axisSpread > 0.0f)
+	{
+		// Each object's bin is kept alongside it, so partitioning doesn't work it out again
+		unsigned int binCounts[BOUNDS_TREE_BINS] = {};
+		XMFLOAT3 binMins[BOUNDS_TREE_BINS], binMaxes[BOUNDS_TREE_BINS];
+		for (int b = 0; b < BOUNDS_TREE_BINS; b++)
+			EmptyBox(binMins[b], binMaxes[b]);
+
+		buildBins.resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			int bin = std::min((int)((Component(objects[i].center, axis) - axisMin) * binScale), BOUNDS_TREE_BINS - 1);
+			buildBins[i] = (unsigned char)bin;
+			binCounts[bin]++;
+			Grow(binMins[bin], binMaxes[bin], objects[i].boxMin, objects[i].boxMax);
+		}
+
+		// Sweep from the right to get the box and cost of everything past each split, then from the left
+		XMFLOAT3 rightMins[BOUNDS_TREE_BINS], rightMaxes[BOUNDS_TREE_BINS];
+		float rightCosts[BOUNDS_TREE_BINS];
+		XMFLOAT3 sweepMin, sweepMax;
+		EmptyBox(sweepMin, sweepMax);
+		unsigned int sweepCount = 0;
+		for (int b = BOUNDS_TREE_BINS - 1; b > 0; b--)
+		{
+			Grow(sweepMin, sweepMax, binMins[b], binMaxes[b]);
+			sweepCount += binCounts[b];
+			rightMins[b] = sweepMin;
+			rightMaxes[b] = sweepMax;
+			rightCosts[b] = sweepCount ? HalfArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		int bestBin = 1;
+		EmptyBox(sweepMin, sweepMax);
+		sweepCount = 0;
+		for (int b = 1; b < BOUNDS_TREE_BINS; b++)
+		{
+			Grow(sweepMin, sweepMax, binMins[b - 1], binMaxes[b - 1]);
+			sweepCount += binCounts[b - 1];
+			float splitCost = (sweepCount ? HalfArea(sweepMin, sweepMax) * sweepCount : 0.0f) + rightCosts[b];
+			if (splitCost < bestCost)
+			{
+				bestCost = splitCost;
+				bestBin = b;
+				left.boxMin = sweepMin;
+				left.boxMax = sweepMax;
+			}
+		}
+
+		// Splitting costs a visit to the node on top of what's below it
+		float area = HalfArea(task.boxMin, task.boxMax);
+		makeLeaf = count <= BOUNDS_TREE_MAX_LEAF_OBJECTS && area * BOUNDS_TREE_TRAVERSAL_COST + bestCost >= area * count;
+		if (!makeLeaf)
+		{
+			right.boxMin = rightMins[bestBin];
+			right.boxMax = rightMaxes[bestBin];
+
+			// Partition by the bins already worked out, gathering each side's centers on the way
+			unsigned int low = 0, high = count;
+			while (low < high)
+			{
+				if (buildBins[low] < bestBin)
+				{
+					Grow(left.centerMin, left.centerMax, objects[low].center, objects[low].center);
+					low++;
+				}
+				else
+				{
+					high--;
+					std::swap(objects[low], objects[high]);
+					std::swap(buildBins[low], buildBins[high]);
+					Grow(right.centerMin, right.centerMax, objects[high].center, objects[high].center);
+				}
+			}
+			split = low;
+		}
+	}
+	else if (count <= BOUNDS_TREE_MAX_LEAF_OBJECTS)
+	{
+		// Every center is in the same place, so only a leaf or an arbitrary split is possible
+		makeLeaf = true;
+	}
+
+	if (makeLeaf)
+	{
+		node.children[0] = -1;
+		node.children[1] = -1;
+		node.first = task.first;
+		node.count = count;
+		for (unsigned int i = 0; i < count; i++)
+			objectLeaves[objects[i].object] = task.node;
+		return;
+	}
+
+	// Splitting in half by position (every center in one place, or rounding putting
+	// them all on one side) leaves the children's boxes still to be measured
+	if (split == 0 || split == count || axisSpread <= 0.0f)
+	{
+		split = count / 2;
+		EmptyBox(left.boxMin, left.boxMax);
+		EmptyBox(right.boxMin, right.boxMax);
+		EmptyBox(left.centerMin, left.centerMax);
+		EmptyBox(right.centerMin, right.centerMax);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			BuildTask& side = i < split ? left : right;
+			Grow(side.boxMin, side.boxMax, objects[i].boxMin, objects[i].boxMax);
+			Grow(side.centerMin, side.centerMax, objects[i].center, objects[i].center);
+		}
+	}
+
+	int firstChild = (int)nodes.size();
+	nodes.resize(nodes.size() + 2);
+	Node& parent = nodes[task.node];
+	parent.children[0] = firstChild;
+	parent.children[1] = firstChild + 1;
+	parent.first = 0;
+	parent.count = 0;
+	nodes[firstChild].parent = task.node;
+	nodes[firstChild + 1].parent = task.node;
+
+	left.node = firstChild;
+	left.first = task.first;
+	left.count = split;
+	right.node = firstChild + 1;
+	right.first = task.first + split;
+	right.count = count - split;
+
+	// The right child goes on first, so the left is split next and follows its parent
+	buildTasks.push_back(right);
+	buildTasks.push_back(left);
+}
+
+void BoundsTree::Update(unsigned int object, const Bounds& bounds)
+{
+	if (object >= objectPositions.size())
+		return;
+
+	// Only the boxes make up the tree, so a changed sphere needs nothing refit
+	const XMFLOAT3& center = bounds.sphereCenter;
+	spheres[objectPositions[object]] = XMFLOAT4(center.x, center.y, center.z, bounds.sphereRadius);
+
+	XMFLOAT3& boxMin = boxMins[objectPositions[object]];
+	XMFLOAT3& boxMax = boxMaxes[objectPositions[object]];
+	if (boxMin.x == bounds.boxMin.x && boxMin.y == bounds.boxMin.y && boxMin.z == bounds.boxMin.z &&
+		boxMax.x == bounds.boxMax.x && boxMax.y == bounds.boxMax.y && boxMax.z == bounds.boxMax.z)
+		return;
+
+	boxMin = bounds.boxMin;
+	boxMax = bounds.boxMax;
+
+	// Flag the way up to the root, stopping early where another object already did
+	for (int node = objectLeaves[object]; node >= 0 && !nodes[node].refit; node = nodes[node].parent)
+		nodes[node].refit = 1;
+	refitNeeded = true;
+}
+
+int BoundsTree::Refit()
+{
+	if (!refitNeeded)
+		return 0;
+
+	int refitCount = 0;
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		// Each node is seen twice: once on the way down to push its flagged
+		// children, and again (marked by a negative index) once they're refit
+		int entry = stack.back();
+		stack.pop_back();
+		int node = entry < 0 ? -entry - 1 : entry;
+		Node& n = nodes[node];
+
+		if (entry >= 0 && n.count == 0)
+		{
+			stack.push_back(-node - 1);
+			for (int child : n.children)
+				if (nodes[child].refit)
+					stack.push_back(child);
+			continue;
+		}
+
+		float oldCost = NodeCost(n);
+		if (n.count > 0)
+		{
+			EmptyBox(n.boxMin, n.boxMax);
+			for (unsigned int i = n.first; i < n.first + n.count; i++)
+				Grow(n.boxMin, n.boxMax, boxMins[i], boxMaxes[i]);
+		}
+		else
+		{
+			n.boxMin = nodes[n.children[0]].boxMin;
+			n.boxMax = nodes[n.children[0]].boxMax;
+			Grow(n.boxMin, n.boxMax, nodes[n.children[1]].boxMin, nodes[n.children[1]].boxMax);
+			TryRotations(node);
+		}
+
+		cost += NodeCost(n) - oldCost;
+		n.refit = 0;
+		refitCount++;
+	}
+	refitNeeded = false;
+
+	// Rotations only fix things up locally; past a point it's cheaper to start again
+	if (GetCostRatio() > rebuildRatio)
+		Rebuild();
+
+	return refitCount;
+}
+
+void BoundsTree::TryRotations(int node)
+{
+	// Try swapping each child with each of the other child's children, which leaves the
+	// node's own box alone but changes the other child's; keep the swap that shrinks it most
+	float bestArea = 0.0f;
+	int bestChild = -1;
+	int bestGrandchild = -1;
+	for (int c = 0; c < 2; c++)
+	{
+		const Node& child = nodes[nodes[node].children[c]];
+		const Node& other = nodes[nodes[node].children[1 - c]];
+		if (other.count > 0)
+			continue;
+
+		float otherArea = HalfArea(other.boxMin, other.boxMax);
+		for (int g = 0; g < 2; g++)
+		{
+			// The other child would hold this child and the grandchild not swapped
+			const Node& kept = nodes[other.children[1 - g]];
+			XMFLOAT3 boxMin = child.boxMin, boxMax = child.boxMax;
+			Grow(boxMin, boxMax, kept.boxMin, kept.boxMax);
+			float saved = otherArea - HalfArea(boxMin, boxMax);
+			if (saved > bestArea)
+			{
+				bestArea = saved;
+				bestChild = c;
+				bestGrandchild = g;
+			}
+		}
+	}
+
+	if (bestChild < 0)
+		return;
+
+	int child = nodes[node].children[bestChild];
+	int other = nodes[node].children[1 - bestChild];
+	int grandchild = nodes[other].children[bestGrandchild];
+	int kept = nodes[other].children[1 - bestGrandchild];
+
+	nodes[node].children[bestChild] = grandchild;
+	nodes[grandchild].parent = node;
+	nodes[other].children[bestGrandchild] = child;
+	nodes[child].parent = other;
+
+	Node& o = nodes[other];
+	float oldCost = NodeCost(o);
+	o.boxMin = nodes[child].boxMin;
+	o.boxMax = nodes[child].boxMax;
+	Grow(o.boxMin, o.boxMax, nodes[kept].boxMin, nodes[kept].boxMax);
+	cost += NodeCost(o) - oldCost;
+}
+
+float BoundsTree::NodeCost(const Node& node) const
+{
+	float area = HalfArea(node.boxMin, node.boxMax);
+	return node.count > 0 ? area * node.count : area * BOUNDS_TREE_TRAVERSAL_COST;
+}
+
+void BoundsTree::AddSubtree(int node, std::vector<unsigned int>& results) const
+{
+	// Shares the stack with whichever query called it, using only what's above the query's part
+	size_t base = stack.size();
+	stack.push_back(node);
+	while (stack.size() > base)
+	{
+		const Node& n = nodes[stack.back()];
+		stack.pop_back();
+		if (n.count > 0)
+			results.insert(results.end(), &objectOrder[n.first], &objectOrder[n.first] + n.count);
+		else
+		{
+			stack.push_back(n.children[1]);
+			stack.push_back(n.children[0]);
+		}
+	}
+}
+
+void BoundsTree::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	BoxPlane planes[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planes[p].plane = frustum.planes[p];
+		planes[p].absNormal = XMFLOAT3(fabsf(frustum.planes[p].x), fabsf(frustum.planes[p].y), fabsf(frustum.planes[p].z));
+	}
+
+	// Each entry is a node and the planes its parent wasn't already entirely in front of
+	leafBounds.Clear();
+	leafObjects.clear();
+	stack.clear();
+	stack.push_back(0);
+	stack.push_back(0x3F);
+	while (!stack.empty())
+	{
+		int planeMask = stack.back(); stack.pop_back();
+		const Node& n = nodes[stack.back()];
+		int node = stack.back(); stack.pop_back();
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			if (!(planeMask & (1 << p)))
+				continue;
+
+			int side = ClassifyBox(n.boxMin, n.boxMax, planes[p]);
+			outside = side < 0;
+			if (side > 0)
+				planeMask &= ~(1 << p);
+		}
+
+		if (outside)
+			continue;
+
+		// Nothing below a node inside every plane needs testing
+		if (planeMask == 0)
+		{
+			AddSubtree(node, results);
+			continue;
+		}
+
+		if (n.count == 0)
+		{
+			stack.push_back(n.children[1]);
+			stack.push_back(planeMask);
+			stack.push_back(n.children[0]);
+			stack.push_back(planeMask);
+			continue;
+		}
+
+		// Leaves crossing a plane are tested once the walk is done, all together
+		for (unsigned int i = n.first; i < n.first + n.count; i++)
+		{
+			Bounds bounds = { boxMins[i], boxMaxes[i], XMFLOAT3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w };
+			leafBounds.Add(bounds);
+			leafObjects.push_back(objectOrder[i]);
+		}
+	}
+
+	CullBoundsBatch(frustum, leafBounds, leafVisible);
+	for (unsigned int i : leafVisible)
+		results.push_back(leafObjects[i]);
+}
+
+void BoundsTree::QueryBox(XMFLOAT3 boxMin, XMFLOAT3 boxMax, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& n = nodes[stack.back()];
+		stack.pop_back();
+		if (!BoxesOverlap(n.boxMin, n.boxMax, boxMin, boxMax))
+			continue;
+
+		if (n.count == 0)
+		{
+			stack.push_back(n.children[1]);
+			stack.push_back(n.children[0]);
+			continue;
+		}
+
+		for (unsigned int i = n.first; i < n.first + n.count; i++)
+		{
+			if (BoxesOverlap(boxMins[i], boxMaxes[i], boxMin, boxMax))
+				results.push_back(objectOrder[i]);
+		}
+	}
+}
+
+void BoundsTree::QuerySphere(XMFLOAT3 center, float radius, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	float radiusSquared = radius * radius;
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& n = nodes[stack.back()];
+		stack.pop_back();
+		if (!BoxTouchesSphere(n.boxMin, n.boxMax, center, radiusSquared))
+			continue;
+
+		if (n.count == 0)
+		{
+			stack.push_back(n.children[1]);
+			stack.push_back(n.children[0]);
+			continue;
+		}
+
+		for (unsigned int i = n.first; i < n.first + n.count; i++)
+		{
+			if (BoxTouchesSphere(boxMins[i], boxMaxes[i], center, radiusSquared))
+				results.push_back(objectOrder[i]);
+		}
+	}
+}
+
+bool BoundsTree::Raycast(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, unsigned int& hitObject, float& hitDistance) const
+{
+	if (nodes.empty())
+		return false;
+
+	// Dividing by zero gives infinities, which the slab test handles
+	XMFLOAT3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float closest = maxDistance;
+	bool hit = false;
+
+	float rootDistance = RayEntersBox(nodes[0].boxMin, nodes[0].boxMax, origin, inverseDirection, closest);
+	if (rootDistance < 0.0f)
+		return false;
+
+	// Each node is pushed along with where the ray enters it
+	stack.clear();
+	distances.clear();
+	stack.push_back(0);
+	distances.push_back(rootDistance);
+	while (!stack.empty())
+	{
+		const Node& n = nodes[stack.back()];
+		float distance = distances.back();
+		stack.pop_back();
+		distances.pop_back();
+
+		// Anything hit since this node was pushed may now be closer than it
+		if (hit && distance >= closest)
+			continue;
+
+		if (n.count > 0)
+		{
+			for (unsigned int i = n.first; i < n.first + n.count; i++)
+			{
+				float objectDistance = RayEntersBox(boxMins[i], boxMaxes[i], origin, inverseDirection, closest);
+				if (objectDistance >= 0.0f && (!hit || objectDistance < closest))
+				{
+					closest = objectDistance;
+					hitObject = objectOrder[i];
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first, so the farther one is more likely to be skipped
+		int nearChild = n.children[0], farChild = n.children[1];
+		float nearDistance = RayEntersBox(nodes[nearChild].boxMin, nodes[nearChild].boxMax, origin, inverseDirection, closest);
+		float farDistance = RayEntersBox(nodes[farChild].boxMin, nodes[farChild].boxMax, origin, inverseDirection, closest);
+		if (farDistance >= 0.0f && (nearDistance < 0.0f || farDistance < nearDistance))
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearDistance, farDistance);
+		}
+		if (farDistance >= 0.0f)
+		{
+			stack.push_back(farChild);
+			distances.push_back(farDistance);
+		}
+		if (nearDistance >= 0.0f)
+		{
+			stack.push_back(nearChild);
+			distances.push_back(nearDistance);
+		}
+	}
+
+	if (hit)
+		hitDistance = closest;
+	return hit;
+}
+
+unsigned int BoundsTree::GetCount() const { return (unsigned int)objectOrder.size(); }
+
+unsigned int BoundsTree::GetNodeCount() const { return (unsigned int)nodes.size(); }
+
+float BoundsTree::GetCostRatio() const
+{
+	if (nodes.empty() || builtCostRatio <= 0.0f)
+		return 1.0f;
+
+	float rootArea = HalfArea(nodes[0].boxMin, nodes[0].boxMax);
+	return rootArea > 0.0f ? cost / rootArea / builtCostRatio : 1.0f;
+}
+
+void BoundsTree::SetRebuildRatio(float ratio) { rebuildRatio = ratio; }
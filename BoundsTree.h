@@ -0,0 +1,144 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Bounds.h"
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// A bounding volume hierarchy over many objects' world
+// boxes, so finding the ones in a frustum, box or sphere,
+// or the first one along a ray, skips everything far away
+//
+// - Objects are numbered from 0, in the order they were
+//   given to Build(); queries answer with those numbers
+// - Built top-down with the surface area heuristic, choosing
+//   each split from 12 bins along the widest axis of the
+//   objects' centers.  Leaves hold up to 4 objects
+// - Moving objects are handled by Update(), then one Refit()
+//   that grows or shrinks only the nodes above objects that
+//   changed.  While refitting, each node swaps a child with
+//   a grandchild whenever that shrinks the child (a tree
+//   rotation), which keeps moving objects grouped well
+// - Once the tree's surface area cost has grown far enough
+//   past what it was when built, Refit() rebuilds it
+// - Frustum queries gather the objects of leaves that cross
+//   a plane and test them all at the end with
+//   CullBoundsBatch(), four at a time, spheres and boxes
+// - Not thread safe, queries included (they share a stack)
+// --------------------------------------------------------
+class BoundsTree
+{
+public:
+	BoundsTree();
+
+	//builds the tree from scratch over count objects' bounds (the spheres are only used by
+	//QueryFrustum())
+	void Build(const Bounds* bounds, unsigned int count);
+
+	//gives one object new bounds, doing nothing more than storing its sphere if its box hasn't
+	//changed; the tree is only brought up to date by Refit()
+	void Update(unsigned int object, const Bounds& bounds);
+
+	//refits every node above an updated object, rebuilding the whole tree instead if it has
+	//got too much worse than when it was built, and returns how many nodes were refit
+	int Refit();
+
+	//the objects whose spheres and boxes are both at least partly inside the frustum, in no
+	//particular order
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const;
+
+	//the objects whose boxes overlap a box or a sphere
+	void QueryBox(DirectX::XMFLOAT3 boxMin, DirectX::XMFLOAT3 boxMax, std::vector<unsigned int>& results) const;
+	void QuerySphere(DirectX::XMFLOAT3 center, float radius, std::vector<unsigned int>& results) const;
+
+	//finds the first object box the ray enters (or starts in) within maxDistance, returning
+	//false if there's none; distances are in multiples of direction's length
+	bool Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance,
+		unsigned int& hitObject, float& hitDistance) const;
+
+	//returns how many objects the tree was built over
+	unsigned int GetCount() const;
+
+	//returns how many nodes the tree has
+	unsigned int GetNodeCount() const;
+
+	//returns the tree's surface area cost now, compared to just after it was built
+	float GetCostRatio() const;
+
+	//how much worse the cost can get before Refit() rebuilds the tree
+	void SetRebuildRatio(float ratio);
+
+private:
+	// One box in the tree, either splitting into two children
+	// or holding a range of objectOrder
+	struct Node
+	{
+		DirectX::XMFLOAT3 boxMin;
+		DirectX::XMFLOAT3 boxMax;
+		int parent; //-1 for the root
+		int children[2]; //-1 for leaves
+		unsigned int first; //a leaf's objects are objectOrder[first] to objectOrder[first + count - 1]
+		unsigned int count; //0 for nodes with children
+		int refit; //set on every node above an updated object, next to parent for walking up
+	};
+
+	// One object while building, kept together so splitting the objects reads them in order
+	struct BuildObject
+	{
+		DirectX::XMFLOAT3 boxMin;
+		DirectX::XMFLOAT3 boxMax;
+		DirectX::XMFLOAT3 center;
+		unsigned int object;
+	};
+
+	// A node waiting to be built, with the boxes around its objects and their centers
+	struct BuildTask
+	{
+		int node;
+		unsigned int first;
+		unsigned int count;
+		DirectX::XMFLOAT3 boxMin, boxMax;
+		DirectX::XMFLOAT3 centerMin, centerMax;
+	};
+
+	std::vector<Node> nodes; //the root is always first
+	std::vector<unsigned int> objectOrder; //every object, grouped by leaf
+	std::vector<DirectX::XMFLOAT3> boxMins, boxMaxes; //each object's box, in objectOrder's order so leaves read them together
+	std::vector<DirectX::XMFLOAT4> spheres; //each object's sphere (radius in w), in the same order
+	std::vector<unsigned int> objectPositions; //where each object is in objectOrder
+	std::vector<int> objectLeaves; //the leaf each object is in
+	bool refitNeeded;
+
+	//the surface area cost now and just after building, both without dividing by the root's area
+	float cost;
+	float builtCostRatio;
+	float rebuildRatio;
+
+	//reused while building and querying
+	std::vector<BuildObject> buildObjects;
+	std::vector<unsigned char> buildBins; //the bin each of one node's objects went in
+	std::vector<BuildTask> buildTasks;
+	std::vector<DirectX::XMFLOAT4> buildSpheres; //the spheres by object, while they're put in the new order
+	mutable std::vector<int> stack;
+	mutable std::vector<float> distances; //alongside the stack while raycasting
+	mutable BoundsBatch leafBounds; //the objects of the leaves a frustum query still has to test
+	mutable std::vector<unsigned int> leafObjects; //which object each of those is
+	mutable std::vector<unsigned int> leafVisible;
+
+	//makes the task's node a leaf holding its objects, or splits them between two new
+	//children, pushing those onto buildTasks to be built next
+	void BuildNode(const BuildTask& task);
+
+	//rebuilds the tree over the boxes it already has
+	void Rebuild();
+
+	//swaps one of a just refit node's children with a grandchild, if that shrinks the boxes
+	void TryRotations(int node);
+
+	//the cost one node adds: its area, times how many objects it holds if it's a leaf
+	float NodeCost(const Node& node) const;
+
+	//adds the leaves under node to results, without testing them
+	void AddSubtree(int node, std::vector<unsigned int>& results) const;
+};
@@ -3,11 +3,21 @@
 
 using namespace DirectX;
 
+//Handed out to every camera whenever its matrices change, so no two cameras share a version
+static unsigned int nextVersion = 1;
+
 Camera::Camera(float x, float y, float z, 
     float moveSpeed, 
     float mouseLookSpeed, 
     float fov, 
     float aspectRatio) : 
+    viewMatrix(),
+    projectionMatrix(),
+    inverseViewMatrix(),
+    inverseProjectionMatrix(),
+    position(),
+    version(0),
+    transformVersion(0),
     moveSpeed(moveSpeed),
     mouseLookSpeed(mouseLookSpeed)
 {
@@ -45,21 +55,26 @@ void Camera::Update(float dt)
         transform.Rotate(yDiff, xDiff, 0);
     }
 
-    UpdateViewMatrix();
+    //Nothing to rebuild on frames the camera didn't move
+    if (transform.GetVersion() != transformVersion)
+        UpdateViewMatrix();
 }
 
 void Camera::UpdateViewMatrix()
 {
     //Grab the transform data we'll need
-    XMFLOAT3 pos = transform.GetPosition();
+    transformVersion = transform.GetVersion();
+    position = transform.GetPosition();
     XMFLOAT3 fwd = transform.GetForward();
 
     //Build the view and store
     XMMATRIX view = XMMatrixLookToLH(
-        XMLoadFloat3(&pos),
+        XMLoadFloat3(&position),
         XMLoadFloat3(&fwd),
         XMVectorSet(0, 1, 0, 0));
     XMStoreFloat4x4(&viewMatrix, view);
+    XMStoreFloat4x4(&inverseViewMatrix, XMMatrixInverse(nullptr, view));
+    UpdateViewProjection();
 }
 
 void Camera::UpdateProjectionMatrix(float fov, float aspectRatio)
@@ -70,10 +85,37 @@ void Camera::UpdateProjectionMatrix(float fov, float aspectRatio)
         0.01f,      //Near clip distance
         1000.0f);   //Far clip distance
     XMStoreFloat4x4(&projectionMatrix, proj);
+    XMStoreFloat4x4(&inverseProjectionMatrix, XMMatrixInverse(nullptr, proj));
+    UpdateViewProjection();
+}
+
+void Camera::UpdateViewProjection()
+{
+    //The inverse of view * projection is the inverses the other way round, so no third inverse is needed
+    XMStoreFloat4x4(&viewProjectionMatrix, XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projectionMatrix)));
+    XMStoreFloat4x4(&inverseViewProjectionMatrix, XMMatrixMultiply(XMLoadFloat4x4(&inverseProjectionMatrix), XMLoadFloat4x4(&inverseViewMatrix)));
+
+    //Planes from view * projection are in world space, ready for world bounds
+    frustum = ExtractFrustum(viewProjectionMatrix);
+    version = nextVersion++;
 }
 
 Transform* Camera::GetTransform() { return &transform; }
 
-DirectX::XMFLOAT4X4 Camera::GetView() { return viewMatrix; }
+const DirectX::XMFLOAT4X4& Camera::GetView() const { return viewMatrix; }
+
+const DirectX::XMFLOAT4X4& Camera::GetProjection() const { return projectionMatrix; }
+
+const DirectX::XMFLOAT4X4& Camera::GetViewProjection() const { return viewProjectionMatrix; }
+
+const DirectX::XMFLOAT4X4& Camera::GetInverseView() const { return inverseViewMatrix; }
+
+const DirectX::XMFLOAT4X4& Camera::GetInverseProjection() const { return inverseProjectionMatrix; }
+
+const DirectX::XMFLOAT4X4& Camera::GetInverseViewProjection() const { return inverseViewProjectionMatrix; }
+
+const DirectX::XMFLOAT3& Camera::GetPosition() const { return position; }
+
+const Frustum& Camera::GetFrustum() const { return frustum; }
 
-DirectX::XMFLOAT4X4 Camera::GetProjection() { return projectionMatrix; }
+unsigned int Camera::GetVersion() const { return version; }
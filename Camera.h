@@ -1,7 +1,21 @@
 #pragma once
 #include "Transform.h"
+#include "Frustum.h"
 #include <DirectXMath.h>
 
+// --------------------------------------------------------
+// A first-person camera, moved by the keyboard and mouse
+//
+// - The view matrix is only rebuilt when the transform has
+//   actually changed since it was last built, and the
+//   projection only when it's set
+// - View, projection, view * projection, their inverses and
+//   the frustum are all worked out then and kept, so reading
+//   them is just a reference
+// - GetVersion() changes whenever any of them do, and never
+//   matches another camera's, so whatever was set up from one
+//   camera can tell if it needs doing again
+// --------------------------------------------------------
 class Camera
 {
 public:
@@ -20,16 +34,41 @@ public:
 
 	Transform* GetTransform();
 
-	DirectX::XMFLOAT4X4 GetView();
-	DirectX::XMFLOAT4X4 GetProjection();
+	const DirectX::XMFLOAT4X4& GetView() const;
+	const DirectX::XMFLOAT4X4& GetProjection() const;
+	const DirectX::XMFLOAT4X4& GetViewProjection() const;
+	const DirectX::XMFLOAT4X4& GetInverseView() const;
+	const DirectX::XMFLOAT4X4& GetInverseProjection() const;
+	const DirectX::XMFLOAT4X4& GetInverseViewProjection() const;
+
+	//The position the view matrix was last built from
+	const DirectX::XMFLOAT3& GetPosition() const;
+
+	//The planes around what the camera sees, in world space, kept up to date with the matrices
+	const Frustum& GetFrustum() const;
+
+	//Changes whenever the matrices do, unique across every camera
+	unsigned int GetVersion() const;
 
 private:
 	//Matrices
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projectionMatrix;
+	DirectX::XMFLOAT4X4 viewProjectionMatrix;
+	DirectX::XMFLOAT4X4 inverseViewMatrix;
+	DirectX::XMFLOAT4X4 inverseProjectionMatrix;
+	DirectX::XMFLOAT4X4 inverseViewProjectionMatrix;
+	DirectX::XMFLOAT3 position;
+	Frustum frustum;
+
+	unsigned int version;
+	unsigned int transformVersion; //the transform's version when the view matrix was last built
+
+	//rebuilds everything made from both the view and the projection
+	void UpdateViewProjection();
 
 	Transform transform;
 
 	float moveSpeed;
 	float mouseLookSpeed;
-};
\ No newline at end of file
+};
@@ -1,5 +1,6 @@
 #include "DXCore.h"
 #include "Input.h"
+#include "TransformStore.h"
 
 #include <dxgi1_5.h>
 #include <WindowsX.h>
@@ -51,6 +52,9 @@ DXCore::DXCore(
 	dxFeatureLevel(D3D_FEATURE_LEVEL_11_0),
 	fpsTimeElapsed(0),
 	fpsFrameCount(0),
+	fpsStepCount(0),
+	fixedSteps(60.0, 5),
+	simulationTime(0),
 	previousTime(0),
 	currentTime(0),
 	hasFocus(true),
@@ -437,6 +441,7 @@ HRESULT DXCore::Run()
 
 			// The game loop
 			Update(deltaTime, totalTime);
+			RunFixedSteps();
 			Draw(deltaTime, totalTime);
 
 			// Frame is over, notify the input manager
@@ -484,6 +489,51 @@ void DXCore::UpdateTimer()
 }
 
 
+// --------------------------------------------------------
+// Runs FixedUpdate() once for every whole step's worth of
+// time that's built up, then tells the transforms how far
+// into the next step this frame is so they can be drawn
+// between their last two states
+//  - If more steps are due than a frame may run (after a
+//    hitch, or a breakpoint), the rest are dropped rather
+//    than leaving every following frame to catch up (see
+//    FixedStepTimer)
+// --------------------------------------------------------
+void DXCore::RunFixedSteps()
+{
+	TransformStore& transforms = TransformStore::GetInstance();
+
+	int steps = fixedSteps.Advance(deltaTime);
+	double stepSeconds = fixedSteps.GetStepSeconds();
+	for (int step = 0; step < steps; step++)
+	{
+		transforms.BeginFixedStep();
+		FixedUpdate((float)stepSeconds, (float)simulationTime);
+		transforms.EndFixedStep();
+
+		simulationTime += stepSeconds;
+	}
+
+	fpsStepCount += steps;
+	transforms.SetInterpolation((float)fixedSteps.GetInterpolation());
+}
+
+
+// --------------------------------------------------------
+// Changes how often FixedUpdate() runs, keeping any time
+// that's already built up
+// --------------------------------------------------------
+void DXCore::SetSimulationRate(float stepsPerSecond, int maxStepsPerFrame)
+{
+	fixedSteps.SetRate(stepsPerSecond, maxStepsPerFrame);
+}
+
+float DXCore::GetSimulationRate()
+{
+	return (float)(1.0 / fixedSteps.GetStepSeconds());
+}
+
+
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
@@ -510,7 +560,8 @@ void DXCore::UpdateTitleBarStats()
 		"    Width: "		<< windowWidth <<
 		"    Height: "		<< windowHeight <<
 		"    FPS: "			<< fpsFrameCount <<
-		"    Frame Time: "	<< mspf << "ms";
+		"    Frame Time: "	<< mspf << "ms" <<
+		"    Sim Steps: "	<< fpsStepCount;
 	
 	// Append the version of Direct3D the app is using
 	switch (dxFeatureLevel)
@@ -528,6 +579,7 @@ void DXCore::UpdateTitleBarStats()
 	// Actually update the title bar and reset fps data
 	SetWindowText(hWnd, output.str().c_str());
 	fpsFrameCount = 0;
+	fpsStepCount = 0;
 	fpsTimeElapsed += 1.0f;
 }
 
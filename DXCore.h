@@ -4,6 +4,7 @@
 #include <d3d11.h>
 #include <string>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+#include "FixedStepTimer.h"
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
@@ -42,8 +43,13 @@ public:
 	virtual void OnResize();
 
 	// Pure virtual methods for setup and game functionality
+	//  - Update() and Draw() run once per frame
+	//  - FixedUpdate() runs zero or more times per frame, always with the same
+	//    stepTime, so the simulation doesn't depend on the framerate.  Transforms
+	//    it moves are drawn blended between their last two steps
 	virtual void Init() = 0;
 	virtual void Update(float deltaTime, float totalTime) = 0;
+	virtual void FixedUpdate(float stepTime, float simulationTime) = 0;
 	virtual void Draw(float deltaTime, float totalTime) = 0;
 
 protected:
@@ -78,6 +84,12 @@ protected:
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
+	// How many fixed steps to simulate per second (regardless of the framerate),
+	// and how many of them a single frame may run to catch up before the
+	// simulation is allowed to fall behind instead
+	void SetSimulationRate(float stepsPerSecond, int maxStepsPerFrame = 5);
+	float GetSimulationRate();
+
 private:
 	// Timing related data
 	double perfCounterSeconds;
@@ -87,11 +99,17 @@ private:
 	__int64 currentTime;
 	__int64 previousTime;
 
+	// Fixed step data
+	FixedStepTimer fixedSteps;	// How many FixedUpdate() steps each frame runs
+	double simulationTime;		// Time simulated so far
+
 	// FPS calculation
 	int fpsFrameCount;
+	int fpsStepCount;
 	float fpsTimeElapsed;
 
 	void UpdateTimer();			// Updates the timer for this frame
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
+	void RunFixedSteps();		// Runs however many fixed steps are due this frame
 };
 
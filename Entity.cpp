@@ -1,4 +1,5 @@
 #include "Entity.h"
+#include <cmath>
 
 //CONSTRUCTOR - Accepts a shared_ptr for a mesh and saves it, creates a new transform and saves that to a shared_ptr
 Entity::Entity(std::shared_ptr<Mesh> mesh, 
@@ -7,6 +8,10 @@ Entity::Entity(std::shared_ptr<Mesh> mesh,
 {
     meshPtr = mesh;
     transformPtr = std::make_shared<Transform>();
+    worldBounds = {};
+    worldBoundsValid = false;
+    worldBoundsVersion = 0;
+    worldBoundsMesh = nullptr;
 }
 
 //DESTRUCTOR
@@ -21,10 +26,83 @@ std::shared_ptr<Material> Entity::GetMaterial() { return material; }
 
 void Entity::SetMaterial(std::shared_ptr<Material> material) { this->material = material; }
 
+//Drawable Mesh - Only Ready meshes can be drawn, so a loading one is swapped for its placeholder
+std::shared_ptr<Mesh> Entity::GetDrawableMesh()
+{
+    std::shared_ptr<Mesh> mesh = meshPtr;
+    if (mesh->GetLoadState() == MeshLoadState::Loading)
+        mesh = mesh->GetPlaceholder();
+
+    if (!mesh || mesh->GetLoadState() != MeshLoadState::Ready)
+        return nullptr;
+
+    return mesh;
+}
+
+//World Bounds - Moves the mesh's bounds into world space, only redoing it after the transform
+//or the mesh being drawn changes (a loading mesh's bounds aren't known yet, so its placeholder's are used)
+const Bounds& Entity::GetWorldBounds()
+{
+    std::shared_ptr<Mesh> mesh = GetDrawableMesh();
+    unsigned int version = transformPtr->GetVersion();
+    if (!worldBoundsValid || version != worldBoundsVersion || mesh.get() != worldBoundsMesh)
+    {
+        worldBounds = mesh ? TransformBounds(mesh->GetBounds(), transformPtr->GetWorldMatrix()) : Bounds();
+        worldBoundsVersion = version;
+        worldBoundsMesh = mesh.get();
+        worldBoundsValid = true;
+    }
+
+    return worldBounds;
+}
+
 //Draw Method - Accepts the device context and a constant buffer resource
-void Entity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera, float deltaTime, DirectX::XMFLOAT2 screenRes)
+void Entity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Camera& camera, float deltaTime, DirectX::XMFLOAT2 screenRes)
 {
-    this->GetMaterial()->SetResources(transformPtr, camera);
+    std::shared_ptr<Mesh> mesh = GetDrawableMesh();
+    if (!mesh)
+        return;
+
+    //Packed meshes need their position range to decode vertices, and
+    //it must be set before SetResources() copies the cbuffer data
+    if (mesh->GetVertexFormat() == MeshVertexFormat::Packed)
+    {
+        std::shared_ptr<SimpleVertexShader> vs = this->GetMaterial()->GetVertexShader();
+        vs->SetFloat3("positionOffset", mesh->GetPositionOffset());
+        vs->SetFloat3("positionScale", mesh->GetPositionScale());
+    }
+
+    this->GetMaterial()->SetResources(*transformPtr, camera);
+
+    //Pick the coarsest LOD that still looks right from here, based on how
+    //many pixels one unit of the model covers (projection._22 is 1 / tan(fov / 2)).
+    //The world matrix is used rather than the transform's own position and scale,
+    //which are relative to its parent: its last row is the world position, and
+    //ComputeMaxScale() is the most it stretches anything, sheared by a parent or not
+    const DirectX::XMFLOAT3& cameraPosition = camera.GetPosition();
+    DirectX::XMFLOAT4X4 world = transformPtr->GetWorldMatrix();
+    DirectX::XMMATRIX worldMatrix = DirectX::XMLoadFloat4x4(&world);
+    float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(
+        DirectX::XMVectorSubtract(worldMatrix.r[3], DirectX::XMLoadFloat3(&cameraPosition))));
+    float maxScale = ComputeMaxScale(world);
+    float pixelsPerUnit = camera.GetProjection()._22 * screenRes.y * 0.5f * maxScale / fmaxf(distance, 0.0001f);
+
+    int lod = mesh->SelectLod(pixelsPerUnit);
+    if (lod != 0 || mesh->GetClusterCount() == 0)
+    {
+        mesh->SetBuffersAndDraw(context, lod);
+        return;
+    }
+
+    //Full detail meshes split into clusters only draw the ones that might be
+    //visible; the test runs in model space so the clusters' bounds can be used as-is
+    DirectX::XMFLOAT4X4 worldViewProjection;
+    DirectX::XMStoreFloat4x4(&worldViewProjection, DirectX::XMMatrixMultiply(worldMatrix,
+        DirectX::XMLoadFloat4x4(&camera.GetViewProjection())));
+    DirectX::XMFLOAT3 localCameraPosition;
+    DirectX::XMStoreFloat3(&localCameraPosition, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&cameraPosition),
+        DirectX::XMMatrixInverse(nullptr, worldMatrix)));
 
-    meshPtr->SetBuffersAndDraw(context);
+    mesh->CullClusters(worldViewProjection, localCameraPosition, visibleClusters);
+    mesh->SetBuffersAndDraw(context, visibleClusters);
 }
@@ -3,6 +3,7 @@
 #include "Mesh.h"
 
 #include <memory>
+#include <vector>
 
 #include "BufferStructs.h"
 #include "Camera.h"
@@ -24,13 +25,28 @@ public:
 	std::shared_ptr<Transform> GetTransform();
 	std::shared_ptr<Material> GetMaterial();
 
+	//The mesh to draw right now - its placeholder while it's loading, null if there's nothing to draw
+	std::shared_ptr<Mesh> GetDrawableMesh();
+
 	//Setters
 	void SetMaterial(std::shared_ptr<Material> material);
 
-	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera, float deltaTime, DirectX::XMFLOAT2 screenRes);
+	//Box and sphere around the entity in world space, cached until its transform changes
+	const Bounds& GetWorldBounds();
+
+	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Camera& camera, float deltaTime, DirectX::XMFLOAT2 screenRes);
 
 private:
 	std::shared_ptr<Mesh> meshPtr;
 	std::shared_ptr<Transform> transformPtr;
 	std::shared_ptr<Material> material;
+
+	//World bounds and the transform version and mesh they were built from
+	Bounds worldBounds;
+	bool worldBoundsValid;
+	unsigned int worldBoundsVersion;
+	const Mesh* worldBoundsMesh;
+
+	//Reused every frame so culling a clustered mesh doesn't allocate
+	std::vector<unsigned int> visibleClusters;
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "FixedStepTimer.h"
+
+#include <cmath>
+
+FixedStepTimer::FixedStepTimer(double stepsPerSecond, int maxStepsPerFrame) :
+	stepSeconds(1.0 / stepsPerSecond),
+	accumulator(0),
+	maxSteps(maxStepsPerFrame)
+{
+}
+
+int FixedStepTimer::Advance(double frameSeconds)
+{
+	if (frameSeconds > 0.0)
+		accumulator += frameSeconds;
+
+	int steps = 0;
+	while (accumulator >= stepSeconds && steps < maxSteps)
+	{
+		accumulator -= stepSeconds;
+		steps++;
+	}
+
+	// Past the cap, drop the steps that are still due
+	if (accumulator >= stepSeconds)
+		accumulator = fmod(accumulator, stepSeconds);
+
+	return steps;
+}
+
+void FixedStepTimer::SetRate(double stepsPerSecond, int maxStepsPerFrame)
+{
+	if (stepsPerSecond <= 0.0 || maxStepsPerFrame < 1)
+		return;
+
+	stepSeconds = 1.0 / stepsPerSecond;
+	maxSteps = maxStepsPerFrame;
+}
+
+double FixedStepTimer::GetStepSeconds() { return stepSeconds; }
+
+int FixedStepTimer::GetMaxStepsPerFrame() { return maxSteps; }
+
+double FixedStepTimer::GetInterpolation() { return accumulator / stepSeconds; }
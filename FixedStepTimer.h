@@ -0,0 +1,38 @@
+#pragma once
+
+// --------------------------------------------------------
+// Decides how many fixed simulation steps each frame runs,
+// however long the frames take
+//
+// - Frame time builds up in an accumulator, and every whole
+//   step's worth of it is one step due
+// - A frame runs at most maxStepsPerFrame steps.  If more
+//   are due (after a hitch, or a breakpoint) the rest are
+//   dropped, keeping only the part of a step left over, so
+//   later frames don't all run the cap trying to catch up
+// - What's left over afterwards is how far this frame is
+//   into the next step, which is what transforms blend by
+// --------------------------------------------------------
+class FixedStepTimer
+{
+public:
+	FixedStepTimer(double stepsPerSecond = 60.0, int maxStepsPerFrame = 5);
+
+	//adds a frame's time and returns how many steps to run for it
+	int Advance(double frameSeconds);
+
+	//changes the step length and cap, keeping any time that's already built up
+	//(ignored unless both are positive)
+	void SetRate(double stepsPerSecond, int maxStepsPerFrame);
+
+	double GetStepSeconds();
+	int GetMaxStepsPerFrame();
+
+	//how far into the next step the time that's built up reaches (below 1 after Advance())
+	double GetInterpolation();
+
+private:
+	double stepSeconds; //length of one step
+	double accumulator; //time that's passed but hasn't been stepped yet
+	int maxSteps; //most steps one frame may run
+};
@@ -0,0 +1,132 @@
+#include "Frustum.h"
+
+using namespace DirectX;
+
+Frustum ExtractFrustum(const XMFLOAT4X4& viewProjection)
+{
+	// Each plane is the last column plus or minus one of the others
+	const XMFLOAT4X4& m = viewProjection;
+	XMVECTOR column1 = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR column2 = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR column3 = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR column4 = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	Frustum frustum;
+	XMStoreFloat4(&frustum.planes[0], XMPlaneNormalize(column4 + column1));
+	XMStoreFloat4(&frustum.planes[1], XMPlaneNormalize(column4 - column1));
+	XMStoreFloat4(&frustum.planes[2], XMPlaneNormalize(column4 + column2));
+	XMStoreFloat4(&frustum.planes[3], XMPlaneNormalize(column4 - column2));
+	XMStoreFloat4(&frustum.planes[4], XMPlaneNormalize(column3));
+	XMStoreFloat4(&frustum.planes[5], XMPlaneNormalize(column4 - column3));
+	return frustum;
+}
+
+BoundsBatch::BoundsBatch() :
+	count(0)
+{
+}
+
+void BoundsBatch::Clear()
+{
+	count = 0;
+}
+
+unsigned int BoundsBatch::Add(const Bounds& bounds)
+{
+	// Grow by doubling, which keeps the arrays a whole number of batches of four long
+	if (count == sphereX.size())
+	{
+		size_t size = sphereX.empty() ? 4 : sphereX.size() * 2;
+		for (std::vector<float>* component : { &sphereX, &sphereY, &sphereZ, &sphereRadius,
+			&boxCenterX, &boxCenterY, &boxCenterZ, &boxExtentX, &boxExtentY, &boxExtentZ })
+			component->resize(size, 0.0f);
+	}
+
+	sphereX[count] = bounds.sphereCenter.x;
+	sphereY[count] = bounds.sphereCenter.y;
+	sphereZ[count] = bounds.sphereCenter.z;
+	sphereRadius[count] = bounds.sphereRadius;
+	boxCenterX[count] = (bounds.boxMin.x + bounds.boxMax.x) * 0.5f;
+	boxCenterY[count] = (bounds.boxMin.y + bounds.boxMax.y) * 0.5f;
+	boxCenterZ[count] = (bounds.boxMin.z + bounds.boxMax.z) * 0.5f;
+	boxExtentX[count] = (bounds.boxMax.x - bounds.boxMin.x) * 0.5f;
+	boxExtentY[count] = (bounds.boxMax.y - bounds.boxMin.y) * 0.5f;
+	boxExtentZ[count] = (bounds.boxMax.z - bounds.boxMin.z) * 0.5f;
+	return count++;
+}
+
+unsigned int BoundsBatch::GetCount() const { return count; }
+
+// Four consecutive floats out of one of the arrays
+static XMVECTOR LoadFour(const std::vector<float>& component, unsigned int first)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&component[first]));
+}
+
+void CullBoundsBatch(const Frustum& frustum, const BoundsBatch& bounds, std::vector<unsigned int>& visible)
+{
+	// Room for everything to be visible, cut down to what was at the end
+	visible.resize(bounds.count);
+	unsigned int visibleCount = 0;
+
+	// Every component of every plane splatted across the four lanes once, up front
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	XMVECTOR absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		XMVECTOR plane = XMLoadFloat4(&frustum.planes[p]);
+		planeX[p] = XMVectorSplatX(plane);
+		planeY[p] = XMVectorSplatY(plane);
+		planeZ[p] = XMVectorSplatZ(plane);
+		planeW[p] = XMVectorSplatW(plane);
+		absPlaneX[p] = XMVectorAbs(planeX[p]);
+		absPlaneY[p] = XMVectorAbs(planeY[p]);
+		absPlaneZ[p] = XMVectorAbs(planeZ[p]);
+	}
+
+	for (unsigned int first = 0; first < bounds.count; first += 4)
+	{
+		// A sphere is outside once its center is more than its radius behind any plane
+		XMVECTOR x = LoadFour(bounds.sphereX, first);
+		XMVECTOR y = LoadFour(bounds.sphereY, first);
+		XMVECTOR z = LoadFour(bounds.sphereZ, first);
+		XMVECTOR negativeRadius = XMVectorNegate(LoadFour(bounds.sphereRadius, first));
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = planeX[p] * x + planeY[p] * y + planeZ[p] * z + planeW[p];
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, negativeRadius));
+		}
+
+		int outsideLanes = _mm_movemask_ps(outside);
+		if (outsideLanes == 0xF)
+			continue;
+
+		// A box is outside once its center is behind a plane by more than the
+		// box reaches towards it, which is its extents along the plane's normal
+		x = LoadFour(bounds.boxCenterX, first);
+		y = LoadFour(bounds.boxCenterY, first);
+		z = LoadFour(bounds.boxCenterZ, first);
+		XMVECTOR extentX = LoadFour(bounds.boxExtentX, first);
+		XMVECTOR extentY = LoadFour(bounds.boxExtentY, first);
+		XMVECTOR extentZ = LoadFour(bounds.boxExtentZ, first);
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = planeX[p] * x + planeY[p] * y + planeZ[p] * z + planeW[p];
+			XMVECTOR reach = absPlaneX[p] * extentX + absPlaneY[p] * extentY + absPlaneZ[p] * extentZ;
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, XMVectorNegate(reach)));
+		}
+
+		// Every lane is written, but only the visible ones holding real bounds (the
+		// last batch may be padding) move the count on, so there's nothing to mispredict
+		outsideLanes = _mm_movemask_ps(outside);
+		unsigned int lanes = bounds.count - first < 4 ? bounds.count - first : 4;
+		for (unsigned int lane = 0; lane < lanes; lane++)
+		{
+			visible[visibleCount] = first + lane;
+			visibleCount += ((outsideLanes >> lane) & 1) ^ 1;
+		}
+	}
+
+	visible.resize(visibleCount);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Bounds.h"
+
+// --------------------------------------------------------
+// The six planes around everything a camera can see, each
+// normalized and facing inwards (left, right, bottom, top,
+// near, far), so a point is inside all of them when its
+// signed distance to every one is positive
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+};
+
+// --------------------------------------------------------
+// Pulls the planes out of a view * projection matrix
+// (Gribb and Hartmann), in whichever space the matrix
+// starts from - world space for view * projection, the
+// model's own space for world * view * projection
+// --------------------------------------------------------
+Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& viewProjection);
+
+// --------------------------------------------------------
+// The world-space bounds of many objects, one array per
+// component so they can be tested four at a time
+//
+// - The box is kept as a center and half-size, which is
+//   what the plane test needs
+// - The arrays are always a whole number of batches of four
+//   long, so no batch reads past their end (lanes past the
+//   last bounds added are tested but ignored)
+// --------------------------------------------------------
+class BoundsBatch
+{
+public:
+	BoundsBatch();
+
+	//forgets every bounds added, keeping the memory for the next frame
+	void Clear();
+
+	//adds one object's bounds, returning its index
+	unsigned int Add(const Bounds& bounds);
+
+	//returns how many bounds have been added
+	unsigned int GetCount() const;
+
+private:
+	friend void CullBoundsBatch(const Frustum& frustum, const BoundsBatch& bounds, std::vector<unsigned int>& visible);
+
+	unsigned int count;
+	std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	std::vector<float> boxCenterX, boxCenterY, boxCenterZ;
+	std::vector<float> boxExtentX, boxExtentY, boxExtentZ;
+};
+
+// --------------------------------------------------------
+// Lists the indices (in increasing order) of the bounds
+// that might be visible: the ones whose sphere and box are
+// both at least partly inside the frustum
+//
+// - Four bounds are tested at once against each plane,
+//   spheres first as they're cheaper; the boxes of a batch
+//   are only tested if some of its spheres passed
+// - Conservative, as culling against planes is - bounds
+//   near the frustum's corners can pass without being in it
+// --------------------------------------------------------
+void CullBoundsBatch(const Frustum& frustum, const BoundsBatch& bounds, std::vector<unsigned int>& visible);
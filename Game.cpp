@@ -17,6 +17,8 @@
 
 #include <WICTextureLoader.h>
 
+#include <algorithm>
+
 // For the DirectX Math library
 using namespace DirectX;
 
@@ -42,6 +44,9 @@ Game::Game(HINSTANCE hInstance)
 	lightProjectionSize(15.0f),
 	blurAmt(5)
 {
+	// Simulate at a steady 30 steps a second, drawing in between them at whatever the framerate is
+	SetSimulationRate(30.0f);
+
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
 	CreateConsoleWindow(500, 120, 32, 120);
@@ -71,6 +76,9 @@ void Game::Init()
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
+	assets = std::make_shared<AssetRegistry>(device, context);
+	geometryPool = std::make_shared<GeometryPool>(std::make_shared<D3D11GeometryBufferBackend>(device, context));
+	meshLoader = std::make_shared<MeshLoader>(device, context, 1, geometryPool, true);
 	LoadShaders();
 
 	CreateGeometry();
@@ -156,6 +164,13 @@ void Game::Init()
 
 	loadShadows();
 	ppSetup();
+
+#if defined(DEBUG) || defined(_DEBUG)
+	AssetRegistryStats assetStats = assets->GetStats();
+	printf("Assets: meshes %u hits / %u misses, textures %u / %u, shaders %u / %u\n",
+		assetStats.meshes.hits, assetStats.meshes.misses, assetStats.textures.hits, assetStats.textures.misses,
+		assetStats.shaders.hits, assetStats.shaders.misses);
+#endif
 }
 
 // --------------------------------------------------------
@@ -168,11 +183,14 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
-	vertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader.cso").c_str());
-	pixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"PixelShader.cso").c_str());
-	customPixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"CustomPS.cso").c_str());
-	ppVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"FullscreenVS.cso").c_str());
-	ppPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"BoxBlurPPPS.cso").c_str());
+	vertexShader = assets->GetVertexShader(L"VertexShader.cso");
+	shadowVS = assets->GetVertexShader(L"ShadowVS.cso");
+	packedVertexShader = assets->GetVertexShader(L"PackedVertexShader.cso", true);
+	packedShadowVS = assets->GetVertexShader(L"PackedShadowVS.cso", true);
+	pixelShader = assets->GetPixelShader(L"PixelShader.cso");
+	customPixelShader = assets->GetPixelShader(L"CustomPS.cso");
+	ppVS = assets->GetVertexShader(L"FullscreenVS.cso");
+	ppPS = assets->GetPixelShader(L"BoxBlurPPPS.cso");
 }
 
 
@@ -191,25 +209,31 @@ void Game::CreateGeometry()
 	XMFLOAT3 white = XMFLOAT3(1.0f, 1.0f, 1.0f);
 	XMFLOAT3 purple = XMFLOAT3(1.0f, 0.0f, 1.0f);
 
-	// Imports all of the different 3D meshes
-	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/sphere.obj").c_str(), device);
-	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cube.obj").c_str(), device);
-	std::shared_ptr<Mesh> helixMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/helix.obj").c_str(), device);
-	std::shared_ptr<Mesh> cylinderMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cylinder.obj").c_str(), device);
-	std::shared_ptr<Mesh> torusMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/torus.obj").c_str(), device);
-	std::shared_ptr<Mesh> quadMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/quad.obj").c_str(), device);
-	std::shared_ptr<Mesh> quadDSMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/quad_double_sided.obj").c_str(), device);
+	// Imports all of the different 3D meshes (in the background, so
+	// the window doesn't wait on them)
+	// - The entities' meshes use the compact vertex format (and so
+	//   their materials need the packed vertex shader)
+	// - The cube stays full since the sky's shader reads it directly
+	// - The sphere the entities draw is split into clusters so the
+	//   parts facing away or off screen can be skipped up close
+	std::shared_ptr<Mesh> sphereMesh = LoadMesh(L"../../Assets/Models/sphere.obj", MeshVertexFormat::Packed, true);
+	std::shared_ptr<Mesh> cubeMesh = LoadMesh(L"../../Assets/Models/cube.obj");
+	std::shared_ptr<Mesh> helixMesh = LoadMesh(L"../../Assets/Models/helix.obj");
+	std::shared_ptr<Mesh> cylinderMesh = LoadMesh(L"../../Assets/Models/cylinder.obj");
+	std::shared_ptr<Mesh> torusMesh = LoadMesh(L"../../Assets/Models/torus.obj");
+	std::shared_ptr<Mesh> quadMesh = LoadMesh(L"../../Assets/Models/quad.obj");
+	std::shared_ptr<Mesh> quadDSMesh = LoadMesh(L"../../Assets/Models/quad_double_sided.obj", MeshVertexFormat::Packed);
 
 	loadTextures(cubeMesh);
 
 	// Creates the different materials and adds them to a vector of materials 
-	materials.push_back(std::make_shared<Material>(white, vertexShader, pixelShader, 0.0f));
-	materials.push_back(std::make_shared<Material>(white, vertexShader, pixelShader, 0.17f));
-	materials.push_back(std::make_shared<Material>(white, vertexShader, pixelShader, 0.34f));
-	materials.push_back(std::make_shared<Material>(white, vertexShader, pixelShader, 0.51f));
-	materials.push_back(std::make_shared<Material>(white, vertexShader, pixelShader, 0.68f));
-	materials.push_back(std::make_shared<Material>(white, vertexShader, pixelShader, 0.85f));
-	materials.push_back(std::make_shared<Material>(white, vertexShader, pixelShader, 1.0f));
+	materials.push_back(std::make_shared<Material>(white, packedVertexShader, pixelShader, 0.0f));
+	materials.push_back(std::make_shared<Material>(white, packedVertexShader, pixelShader, 0.17f));
+	materials.push_back(std::make_shared<Material>(white, packedVertexShader, pixelShader, 0.34f));
+	materials.push_back(std::make_shared<Material>(white, packedVertexShader, pixelShader, 0.51f));
+	materials.push_back(std::make_shared<Material>(white, packedVertexShader, pixelShader, 0.68f));
+	materials.push_back(std::make_shared<Material>(white, packedVertexShader, pixelShader, 0.85f));
+	materials.push_back(std::make_shared<Material>(white, packedVertexShader, pixelShader, 1.0f));
 
 	//std::shared_ptr<Material> customPSMaterial = std::make_shared<Material>(white, vertexShader, customPixelShader, 1);
 
@@ -236,42 +260,121 @@ void Game::CreateGeometry()
 	entities[7]->GetTransform()->SetScale(10.0f, 10.0f, 10.0f);
 }
 
+#if defined(DEBUG) || defined(_DEBUG)
+// --------------------------------------------------------
+// Prints how a mesh's import went, so loader changes can be
+// compared
+// --------------------------------------------------------
+static void PrintMeshImportStats(const std::wstring& relativePath, MeshVertexFormat vertexFormat, std::shared_ptr<Mesh> mesh)
+{
+	const MeshImportStats& stats = mesh->GetImportStats();
+	double megabytesPerSecond = stats.loadMilliseconds > 0 ?
+		(stats.fileBytes / (1024.0 * 1024.0)) / (stats.loadMilliseconds / 1000.0) : 0.0;
+	printf("Loaded %ls from %s: %.1f KB in %.3f ms (%.1f MB/s), peak memory %.1f MB\n",
+		relativePath.c_str(), stats.loadedFromCache ? "cache" : stats.streamed ? "OBJ, streamed" : "OBJ",
+		stats.fileBytes / 1024.0, stats.loadMilliseconds, megabytesPerSecond, stats.peakMemoryBytes / (1024.0 * 1024.0));
+	if (!stats.loadedFromCache)
+		printf("  tangents took %.3f ms\n", stats.tangentMilliseconds);
+	printf("  %zu vertices welded to %zu (VB %.1f KB -> %.1f KB, %u bytes per %s vertex)\n",
+		stats.unweldedVertexCount, stats.vertexCount,
+		stats.unweldedVertexCount * sizeof(Vertex) / 1024.0, stats.vertexCount * mesh->GetVertexStride() / 1024.0,
+		mesh->GetVertexStride(), vertexFormat == MeshVertexFormat::Packed ? "packed" : "full");
+	printf("  %d indices as %s\n", mesh->GetIndexCount(),
+		mesh->GetIndexFormat() == DXGI_FORMAT_R16_UINT ? "R16_UINT" : "R32_UINT");
+	if (mesh->HasPositionStream())
+		printf("  position stream costs %.1f KB, shadow passes fetch %u of %u bytes per vertex (%.1fx less)\n",
+			stats.vertexCount * mesh->GetPositionStride() / 1024.0, mesh->GetPositionStride(), mesh->GetVertexStride(),
+			(float)mesh->GetVertexStride() / mesh->GetPositionStride());
+	printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		stats.cacheBefore.acmr, stats.cacheAfter.acmr, stats.cacheBefore.atvr, stats.cacheAfter.atvr);
+	for (int i = 1; i < mesh->GetLodCount(); i++)
+		printf("  LOD %d: %u triangles, error %.4f\n", i, mesh->GetLod(i).indexCount / 3, mesh->GetLod(i).error);
+	if (mesh->GetClusterCount() > 0)
+		printf("  %d clusters, %.0f%% vertex fill, %.0f%% triangle fill\n", mesh->GetClusterCount(),
+			stats.clusterFill.vertexFill * 100.0f, stats.clusterFill.triangleFill * 100.0f);
+}
+#endif
+
+// --------------------------------------------------------
+// Starts loading a single model in the background and
+// keeps track of it
+//
+// - Goes through the asset registry, so each file is only
+//   imported once however many times it's asked for
+// - The mesh comes back straight away, and is drawn as a
+//   placeholder cube until Update() has finished it
+// - In debug builds, the import throughput and vertex
+//   counts are printed to the console once it's loaded,
+//   so loader changes can be compared
+// --------------------------------------------------------
+std::shared_ptr<Mesh> Game::LoadMesh(const std::wstring& relativePath, MeshVertexFormat vertexFormat, bool buildClusters)
+{
+	std::shared_ptr<Mesh> mesh = assets->GetMeshAsync(*meshLoader, relativePath, vertexFormat, buildClusters);
+
+	// Asking for a mesh that's already loaded just shares it
+	if (std::find(meshes.begin(), meshes.end(), mesh) != meshes.end())
+		return mesh;
+
+	meshes.push_back(mesh);
+
+#if defined(DEBUG) || defined(_DEBUG)
+	meshLoader->WhenLoaded(mesh, [relativePath, vertexFormat, pool = geometryPool](std::shared_ptr<Mesh> mesh)
+	{
+		if (mesh->GetLoadState() == MeshLoadState::Failed)
+		{
+			printf("Couldn't load %ls\n", relativePath.c_str());
+			return;
+		}
+
+		PrintMeshImportStats(relativePath, vertexFormat, mesh);
+
+		GeometryPoolStats poolStats = pool->GetStats();
+		printf("  geometry pool: %u meshes in %u vertex and %u index buffers, %.1f of %.1f MB used, %u free spans\n",
+			poolStats.allocations, poolStats.vertexBuffers, poolStats.indexBuffers,
+			(poolStats.vertexBytesUsed + poolStats.indexBytesUsed) / (1024.0 * 1024.0),
+			(poolStats.vertexBytesReserved + poolStats.indexBytesReserved) / (1024.0 * 1024.0), poolStats.freeSpans);
+	});
+#endif
+
+	return mesh;
+}
+
 void Game::loadTextures(std::shared_ptr<Mesh> cubeMesh)
 {
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/bronze_albedo.png").c_str(), 0, srvBronzeAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/bronze_metal.png").c_str(), 0, srvBronzeMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/bronze_normals.png").c_str(), 0, srvBronzeNormal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/bronze_roughness.png").c_str(), 0, srvBronzeRough.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/cobblestone_albedo.png").c_str(), 0, srvCobbleAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/cobblestone_metal.png").c_str(), 0, srvCobbleMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/cobblestone_normals.png").c_str(), 0, srvCobbleNormal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/cobblestone_roughness.png").c_str(), 0, srvCobbleRough.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/floor_albedo.png").c_str(), 0, srvFloorAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/floor_metal.png").c_str(), 0, srvFloorMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/floor_normals.png").c_str(), 0, srvFloorNormal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/floor_roughness.png").c_str(), 0, srvFloorRough.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/paint_albedo.png").c_str(), 0, srvPaintAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/paint_metal.png").c_str(), 0, srvPaintMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/paint_normals.png").c_str(), 0, srvPaintNormal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/paint_roughness.png").c_str(), 0, srvPaintRough.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/rough_albedo.png").c_str(), 0, srvRoughAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/rough_metal.png").c_str(), 0, srvRoughMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/rough_normals.png").c_str(), 0, srvRoughNormal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/rough_roughness.png").c_str(), 0, srvRoughRough.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/scratched_albedo.png").c_str(), 0, srvScratchAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/scratched_metal.png").c_str(), 0, srvScratchMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/scratched_normals.png").c_str(), 0, srvScratchNormal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/scratched_roughness.png").c_str(), 0, srvScratchRough.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/wood_albedo.png").c_str(), 0, srvWoodAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/wood_metal.png").c_str(), 0, srvWoodMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/wood_normals.png").c_str(), 0, srvWoodNormal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/wood_roughness.png").c_str(), 0, srvWoodRough.GetAddressOf());
+	srvBronzeAlbedo = assets->GetTexture(L"../../Assets/Textures/bronze_albedo.png");
+	srvBronzeMetal = assets->GetTexture(L"../../Assets/Textures/bronze_metal.png");
+	srvBronzeNormal = assets->GetTexture(L"../../Assets/Textures/bronze_normals.png");
+	srvBronzeRough = assets->GetTexture(L"../../Assets/Textures/bronze_roughness.png");
+
+	srvCobbleAlbedo = assets->GetTexture(L"../../Assets/Textures/cobblestone_albedo.png");
+	srvCobbleMetal = assets->GetTexture(L"../../Assets/Textures/cobblestone_metal.png");
+	srvCobbleNormal = assets->GetTexture(L"../../Assets/Textures/cobblestone_normals.png");
+	srvCobbleRough = assets->GetTexture(L"../../Assets/Textures/cobblestone_roughness.png");
+
+	srvFloorAlbedo = assets->GetTexture(L"../../Assets/Textures/floor_albedo.png");
+	srvFloorMetal = assets->GetTexture(L"../../Assets/Textures/floor_metal.png");
+	srvFloorNormal = assets->GetTexture(L"../../Assets/Textures/floor_normals.png");
+	srvFloorRough = assets->GetTexture(L"../../Assets/Textures/floor_roughness.png");
+
+	srvPaintAlbedo = assets->GetTexture(L"../../Assets/Textures/paint_albedo.png");
+	srvPaintMetal = assets->GetTexture(L"../../Assets/Textures/paint_metal.png");
+	srvPaintNormal = assets->GetTexture(L"../../Assets/Textures/paint_normals.png");
+	srvPaintRough = assets->GetTexture(L"../../Assets/Textures/paint_roughness.png");
+
+	srvRoughAlbedo = assets->GetTexture(L"../../Assets/Textures/rough_albedo.png");
+	srvRoughMetal = assets->GetTexture(L"../../Assets/Textures/rough_metal.png");
+	srvRoughNormal = assets->GetTexture(L"../../Assets/Textures/rough_normals.png");
+	srvRoughRough = assets->GetTexture(L"../../Assets/Textures/rough_roughness.png");
+
+	srvScratchAlbedo = assets->GetTexture(L"../../Assets/Textures/scratched_albedo.png");
+	srvScratchMetal = assets->GetTexture(L"../../Assets/Textures/scratched_metal.png");
+	srvScratchNormal = assets->GetTexture(L"../../Assets/Textures/scratched_normals.png");
+	srvScratchRough = assets->GetTexture(L"../../Assets/Textures/scratched_roughness.png");
+
+	srvWoodAlbedo = assets->GetTexture(L"../../Assets/Textures/wood_albedo.png");
+	srvWoodMetal = assets->GetTexture(L"../../Assets/Textures/wood_metal.png");
+	srvWoodNormal = assets->GetTexture(L"../../Assets/Textures/wood_normals.png");
+	srvWoodRough = assets->GetTexture(L"../../Assets/Textures/wood_roughness.png");
 
 	D3D11_SAMPLER_DESC samplerDesc = {};
 	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -283,20 +386,12 @@ void Game::loadTextures(std::shared_ptr<Mesh> cubeMesh)
 
 	device->CreateSamplerState(&samplerDesc, samplerState.GetAddressOf());
 
-	std::vector<const wchar_t*> skySidePaths;
-	skySidePaths.push_back(FixPath(L"../../Assets/Textures/right.png").c_str());
-	skySidePaths.push_back(FixPath(L"../../Assets/Textures/left.png").c_str());
-	skySidePaths.push_back(FixPath(L"../../Assets/Textures/up.png").c_str());
-	skySidePaths.push_back(FixPath(L"../../Assets/Textures/down.png").c_str());
-	skySidePaths.push_back(FixPath(L"../../Assets/Textures/front.png").c_str());
-	skySidePaths.push_back(FixPath(L"../../Assets/Textures/back.png").c_str());
-
-	sky = std::make_shared<Sky>(*cubeMesh, samplerState, device, context,
+	sky = std::make_shared<Sky>(cubeMesh, samplerState, device, context,
 		FixPath(L"../../Assets/Textures/Skybox/right.png").c_str(), FixPath(L"../../Assets/Textures/Skybox/left.png").c_str(),
 		FixPath(L"../../Assets/Textures/Skybox/up.png").c_str(), FixPath(L"../../Assets/Textures/Skybox/down.png").c_str(),
 		FixPath(L"../../Assets/Textures/Skybox/front.png").c_str(), FixPath(L"../../Assets/Textures/Skybox/back.png").c_str(),
-		std::make_shared<SimpleVertexShader>(device, context, FixPath(L"SkyVertexShader.cso").c_str()),
-		std::make_shared<SimplePixelShader>(device, context, FixPath(L"SkyPixelShader.cso").c_str()));
+		assets->GetVertexShader(L"SkyVertexShader.cso"),
+		assets->GetPixelShader(L"SkyPixelShader.cso"));
 }
 
 void Game::loadMaterials()
@@ -439,6 +534,9 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	//Swap in any meshes that have finished loading
+	meshLoader->Update();
+
 	//Feed fresh input data to ImGui
 	ImGuiIO& io = ImGui::GetIO();
 	io.DeltaTime = deltaTime;
@@ -484,6 +582,15 @@ void Game::Update(float deltaTime, float totalTime)
 			//Tracker for the framerate
 			ImGui::Text("Framerate: %f", ImGui::GetIO().Framerate);
 
+			//Lets the simulation rate be changed independently of the framerate
+			int simulationRate = (int)(GetSimulationRate() + 0.5f);
+			if (ImGui::SliderInt("Simulation Rate (Hz)", &simulationRate, 10, 240))
+				SetSimulationRate((float)simulationRate);
+
+			//How many entities made it past frustum culling last frame
+			ImGui::Text("Entities Drawn: %i (%i culled)", (int)visibleEntities.size(), (int)(entities.size() - visibleEntities.size()));
+			ImGui::Text("Entity Tree: %u nodes, cost %.2fx as built", entityTree.GetNodeCount(), entityTree.GetCostRatio());
+
 			//Tracker for the Window Dimensions
 			ImGui::Text("Window Dimensions: %i x %i", this->windowWidth, this->windowHeight);
 
@@ -684,8 +791,15 @@ void Game::Update(float deltaTime, float totalTime)
 		Quit();
 
 	activeCamera->Update(deltaTime);
+}
 
-	entities[0]->GetTransform()->MoveAbsolute(0, 0, 0.001f);
+// --------------------------------------------------------
+// Advance the simulation by one fixed step
+// --------------------------------------------------------
+void Game::FixedUpdate(float stepTime, float simulationTime)
+{
+	//Drifts at the speed it used to move each frame at 60fps, now whatever the framerate
+	entities[0]->GetTransform()->MoveAbsolute(0, 0, 0.06f * stepTime);
 }
 
 // --------------------------------------------------------
@@ -706,6 +820,13 @@ void Game::Draw(float deltaTime, float totalTime)
 
 		const float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f }; //Clear color
 		context->ClearRenderTargetView(ppRTV.Get(), clearColor);
+
+		// ImGui and anything else may have bound their own buffers since last frame
+		Mesh::ForgetBoundBuffers();
+
+		// Rebuild the matrices of everything that moved this frame in one pass,
+		// rather than one entity at a time as each is drawn
+		TransformStore::GetInstance().UpdateWorldMatrices();
 	}
 
 	renderShadows();
@@ -716,9 +837,28 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	context->OMSetRenderTargets(1, ppRTV.GetAddressOf(), depthBufferDSV.Get());
 
-	//Draws each of the entities
-	for (auto& e : entities)
+	//Only the entities at least partly inside the camera's frustum get drawn
+	if (entityTree.GetCount() != entities.size())
+	{
+		std::vector<Bounds> bounds;
+		bounds.reserve(entities.size());
+		for (auto& e : entities)
+			bounds.push_back(e->GetWorldBounds());
+		entityTree.Build(bounds.data(), (unsigned int)bounds.size());
+	}
+	else
+	{
+		//Bounds that haven't changed are skipped, so only what moved gets refit
+		for (unsigned int i = 0; i < entities.size(); i++)
+			entityTree.Update(i, entities[i]->GetWorldBounds());
+		entityTree.Refit();
+	}
+	entityTree.QueryFrustum(activeCamera->GetFrustum(), visibleEntities);
+
+	//Draws each of the visible entities
+	for (unsigned int i : visibleEntities)
 	{
+		std::shared_ptr<Entity>& e = entities[i];
 		std::shared_ptr<SimpleVertexShader> entityVS = e->GetMaterial()->GetVertexShader();
 		entityVS->SetMatrix4x4("lightView", lightViewMatrix);
 		entityVS->SetMatrix4x4("lightProjection", lightProjectionMatrix);
@@ -729,7 +869,7 @@ void Game::Draw(float deltaTime, float totalTime)
 		entityPS->SetShaderResourceView("ShadowMap", shadowSRV);
 		entityPS->SetSamplerState("ShadowSampler", shadowSampler);
 
-		e->Draw(context, activeCamera, deltaTime, XMFLOAT2((float)this->windowWidth, (float)this->windowHeight));
+		e->Draw(context, *activeCamera, deltaTime, XMFLOAT2((float)this->windowWidth, (float)this->windowHeight));
 		//e->Draw(context, activeCamera, srvPtr1, samplerState);
 	}
 
@@ -801,20 +941,31 @@ void Game::renderShadows()
 	// shadow map vertex shader described above. 
 	// AVOID the entity's material entirely (as that might activate a different set of shaders
 	// and we need no material data at all)
-	std::shared_ptr<SimpleVertexShader> shadowVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"ShadowVS.cso").c_str());
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", lightViewMatrix);
-	shadowVS->SetMatrix4x4("projection", lightProjectionMatrix);
-
 	// Loop and draw all entities
 	for (auto& e : entities)
 	{
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
+		// Packed meshes need the shadow shader that can decode them
+		std::shared_ptr<Mesh> mesh = e->GetDrawableMesh();
+		if (!mesh)
+			continue;
+
+		std::shared_ptr<SimpleVertexShader> vs = shadowVS;
+		if (mesh->GetVertexFormat() == MeshVertexFormat::Packed)
+		{
+			vs = packedShadowVS;
+			vs->SetFloat3("positionOffset", mesh->GetPositionOffset());
+			vs->SetFloat3("positionScale", mesh->GetPositionScale());
+		}
+
+		vs->SetShader();
+		vs->SetMatrix4x4("view", lightViewMatrix);
+		vs->SetMatrix4x4("projection", lightProjectionMatrix);
+		vs->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
+		vs->CopyAllBufferData();
 
 		// Draw the mesh directly to avoid the entity's material
-		// Note: Your code may differ significantly here!
-		e->GetMesh()->SetBuffersAndDraw(context);
+		// Only positions are needed, so this reads the position stream
+		mesh->SetPositionsAndDraw(context);
 	}
 
 	// Reset the pipeline - Change pipeline settings back tot prepare to render to the screen once again
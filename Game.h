@@ -14,6 +14,7 @@
 
 #include "Entity.h"
 #include "Camera.h"
+#include "BoundsTree.h"
 
 #include "SimpleShader.h"
 
@@ -21,6 +22,9 @@
 
 #include "Sky.h"
 
+#include "AssetRegistry.h"
+#include "MeshLoader.h"
+
 class Game 
 	: public DXCore
 {
@@ -34,6 +38,7 @@ public:
 	void Init();
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
+	void FixedUpdate(float stepTime, float simulationTime);
 	void Draw(float deltaTime, float totalTime);
 
 private:
@@ -41,6 +46,7 @@ private:
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
 	void LoadShaders(); 
 	void CreateGeometry();
+	std::shared_ptr<Mesh> LoadMesh(const std::wstring& relativePath, MeshVertexFormat vertexFormat = MeshVertexFormat::Full, bool buildClusters = false);
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -51,7 +57,19 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 
+	//loads each mesh, texture and shader file once, however many times it's asked for
+	std::shared_ptr<AssetRegistry> assets;
+
+	//every mesh the loader finishes shares the buffers in here, so draws rarely rebind them
+	std::shared_ptr<GeometryPool> geometryPool;
+
+	//imports meshes on a worker thread, finishing them in Update()
+	std::shared_ptr<MeshLoader> meshLoader;
+
 	std::shared_ptr<SimpleVertexShader> vertexShader;
+	std::shared_ptr<SimpleVertexShader> packedVertexShader; //for meshes loaded with MeshVertexFormat::Packed
+	std::shared_ptr<SimpleVertexShader> shadowVS;
+	std::shared_ptr<SimpleVertexShader> packedShadowVS;
 	std::shared_ptr<SimplePixelShader> pixelShader;
 	std::shared_ptr<SimplePixelShader> customPixelShader;
 
@@ -64,6 +82,10 @@ private:
 
 	std::vector<std::shared_ptr<Entity>> entities;
 
+	//a tree over the entities' world bounds, refit each frame around whatever moved
+	BoundsTree entityTree;
+	std::vector<unsigned int> visibleEntities; //indices into entities that passed last frame's culling
+
 	std::shared_ptr<Camera> activeCamera;
 
 	std::vector<std::shared_ptr<Camera>> cameras;
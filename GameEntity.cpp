@@ -45,7 +45,7 @@ void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
     UINT offset = 0;
 
     context->IASetVertexBuffers(0, 1, meshObject->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-    context->IASetIndexBuffer(meshObject->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+    context->IASetIndexBuffer(meshObject->GetIndexBuffer().Get(), meshObject->GetIndexFormat(), 0);
 
     //Tell D3D to render the currently bound resources
     context->DrawIndexed(meshObject->GetIndexCount(), 0, 0);
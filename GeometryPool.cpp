@@ -0,0 +1,380 @@
+#include "GeometryPool.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+D3D11GeometryBufferBackend::D3D11GeometryBufferBackend(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context)
+{
+}
+
+int D3D11GeometryBufferBackend::CreateBuffer(bool indexBuffer, unsigned int byteWidth)
+{
+	// Default usage, since meshes are written into them one at a
+	// time and moved around by Defragment()
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = byteWidth;
+	desc.BindFlags = indexBuffer ? D3D11_BIND_INDEX_BUFFER : D3D11_BIND_VERTEX_BUFFER;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+	if (!buffer)
+		return -1;
+
+	buffers.push_back(buffer);
+	return (int)buffers.size() - 1;
+}
+
+void D3D11GeometryBufferBackend::ReleaseBuffer(int buffer)
+{
+	buffers[buffer].Reset();
+}
+
+void D3D11GeometryBufferBackend::WriteBuffer(int buffer, unsigned int byteOffset, const void* data, unsigned int byteCount)
+{
+	D3D11_BOX box = { byteOffset, 0, 0, byteOffset + byteCount, 1, 1 };
+	context->UpdateSubresource(buffers[buffer].Get(), 0, &box, data, 0, 0);
+}
+
+void D3D11GeometryBufferBackend::CopyBuffer(int destBuffer, unsigned int destOffset, int sourceBuffer, unsigned int sourceOffset, unsigned int byteCount)
+{
+	D3D11_BOX box = { sourceOffset, 0, 0, sourceOffset + byteCount, 1, 1 };
+	context->CopySubresourceRegion(buffers[destBuffer].Get(), 0, destOffset, 0, 0, buffers[sourceBuffer].Get(), 0, &box);
+}
+
+ID3D11Buffer* D3D11GeometryBufferBackend::GetD3DBuffer(int buffer)
+{
+	return buffers[buffer].Get();
+}
+
+int CpuGeometryBufferBackend::CreateBuffer(bool indexBuffer, unsigned int byteWidth)
+{
+	buffers.push_back(std::vector<unsigned char>(byteWidth));
+	live.push_back(true);
+	return (int)buffers.size() - 1;
+}
+
+void CpuGeometryBufferBackend::ReleaseBuffer(int buffer)
+{
+	std::vector<unsigned char>().swap(buffers[buffer]);
+	live[buffer] = false;
+}
+
+void CpuGeometryBufferBackend::WriteBuffer(int buffer, unsigned int byteOffset, const void* data, unsigned int byteCount)
+{
+	memcpy(&buffers[buffer][byteOffset], data, byteCount);
+}
+
+void CpuGeometryBufferBackend::CopyBuffer(int destBuffer, unsigned int destOffset, int sourceBuffer, unsigned int sourceOffset, unsigned int byteCount)
+{
+	memcpy(&buffers[destBuffer][destOffset], &buffers[sourceBuffer][sourceOffset], byteCount);
+}
+
+ID3D11Buffer* CpuGeometryBufferBackend::GetD3DBuffer(int buffer)
+{
+	return nullptr;
+}
+
+const unsigned char* CpuGeometryBufferBackend::GetData(int buffer)
+{
+	return live[buffer] ? buffers[buffer].data() : nullptr;
+}
+
+int CpuGeometryBufferBackend::GetLiveBufferCount()
+{
+	return (int)std::count(live.begin(), live.end(), true);
+}
+
+GeometryPool::GeometryPool(std::shared_ptr<IGeometryBufferBackend> backend, unsigned int blockBytes) :
+	backend(backend),
+	blockBytes(blockBytes)
+{
+}
+
+GeometryPool::~GeometryPool()
+{
+	for (Arena& arena : arenas)
+		for (Block& block : arena.blocks)
+			if (block.buffer >= 0)
+				backend->ReleaseBuffer(block.buffer);
+}
+
+int GeometryPool::FindArena(bool indices, unsigned int elementSize)
+{
+	for (size_t i = 0; i < arenas.size(); i++)
+		if (arenas[i].indices == indices && arenas[i].elementSize == elementSize)
+			return (int)i;
+
+	Arena arena = {};
+	arena.indices = indices;
+	arena.elementSize = elementSize;
+	arenas.push_back(arena);
+	return (int)arenas.size() - 1;
+}
+
+bool GeometryPool::AllocateSpan(Arena& arena, unsigned int count, int& block, unsigned int& start)
+{
+	// First fit, taking from the front of the span so what's left stays put
+	for (size_t b = 0; b < arena.blocks.size(); b++)
+	{
+		std::vector<FreeSpan>& spans = arena.blocks[b].freeSpans;
+		for (size_t s = 0; s < spans.size(); s++)
+		{
+			if (spans[s].count < count)
+				continue;
+
+			block = (int)b;
+			start = spans[s].start;
+			spans[s].start += count;
+			spans[s].count -= count;
+			if (spans[s].count == 0)
+				spans.erase(spans.begin() + s);
+
+			arena.blocks[b].used += count;
+			return true;
+		}
+	}
+
+	// Nothing has room, so add a block (big enough for this on its own, if need be)
+	unsigned int capacity = std::max(blockBytes / arena.elementSize, count);
+	if ((unsigned long long)capacity * arena.elementSize > UINT_MAX)
+		return false;
+
+	Block added = {};
+	added.buffer = backend->CreateBuffer(arena.indices, capacity * arena.elementSize);
+	if (added.buffer < 0)
+		return false;
+
+	added.capacity = capacity;
+	added.used = count;
+	if (count < capacity)
+		added.freeSpans.push_back({ count, capacity - count });
+
+	// Released blocks leave a gap in the list, since allocations refer to blocks by position
+	auto released = std::find_if(arena.blocks.begin(), arena.blocks.end(), [](const Block& b) { return b.buffer < 0; });
+	if (released != arena.blocks.end())
+	{
+		*released = added;
+		block = (int)(released - arena.blocks.begin());
+	}
+	else
+	{
+		arena.blocks.push_back(added);
+		block = (int)arena.blocks.size() - 1;
+	}
+
+	start = 0;
+	return true;
+}
+
+void GeometryPool::FreeSpanInBlock(Arena& arena, int block, unsigned int start, unsigned int count)
+{
+	Block& freed = arena.blocks[block];
+	freed.used -= count;
+
+	// Release blocks nothing is using any more, keeping one of each kind around for the next mesh
+	if (freed.used == 0)
+	{
+		int liveBlocks = (int)std::count_if(arena.blocks.begin(), arena.blocks.end(), [](const Block& b) { return b.buffer >= 0; });
+		if (liveBlocks > 1)
+		{
+			backend->ReleaseBuffer(freed.buffer);
+			freed = Block();
+			freed.buffer = -1;
+			return;
+		}
+	}
+
+	std::vector<FreeSpan>& spans = freed.freeSpans;
+	auto next = std::lower_bound(spans.begin(), spans.end(), start, [](const FreeSpan& span, unsigned int s) { return span.start < s; });
+	next = spans.insert(next, { start, count });
+
+	// Merge with the span after it, then the one before
+	if (next + 1 != spans.end() && next->start + next->count == (next + 1)->start)
+	{
+		next->count += (next + 1)->count;
+		spans.erase(next + 1);
+	}
+	if (next != spans.begin() && (next - 1)->start + (next - 1)->count == next->start)
+	{
+		(next - 1)->count += next->count;
+		spans.erase(next);
+	}
+}
+
+int GeometryPool::Allocate(const void* vertices, unsigned int vertexCount, unsigned int vertexStride,
+	const void* indices, unsigned int indexCount, unsigned int indexSize)
+{
+	if (vertexCount == 0)
+		return -1;
+
+	// Both arenas have to exist before either is referenced, since adding one can move the other
+	int vertexArena = FindArena(false, vertexStride);
+	int indexArena = indexCount > 0 ? FindArena(true, indexSize) : -1;
+
+	Allocation allocation = {};
+	allocation.vertexArena = vertexArena;
+	allocation.indexArena = indexArena;
+	allocation.indexBlock = -1;
+	allocation.range.indexBuffer = -1;
+	allocation.live = true;
+
+	if (!AllocateSpan(arenas[vertexArena], vertexCount, allocation.vertexBlock, allocation.range.baseVertex))
+		return -1;
+
+	if (indexArena >= 0 && !AllocateSpan(arenas[indexArena], indexCount, allocation.indexBlock, allocation.range.firstIndex))
+	{
+		FreeSpanInBlock(arenas[vertexArena], allocation.vertexBlock, allocation.range.baseVertex, vertexCount);
+		return -1;
+	}
+
+	allocation.range.vertexBuffer = arenas[vertexArena].blocks[allocation.vertexBlock].buffer;
+	allocation.range.vertexCount = vertexCount;
+	allocation.range.indexCount = indexCount;
+	backend->WriteBuffer(allocation.range.vertexBuffer, allocation.range.baseVertex * vertexStride, vertices, vertexCount * vertexStride);
+
+	if (indexArena >= 0)
+	{
+		allocation.range.indexBuffer = arenas[indexArena].blocks[allocation.indexBlock].buffer;
+		backend->WriteBuffer(allocation.range.indexBuffer, allocation.range.firstIndex * indexSize, indices, indexCount * indexSize);
+	}
+
+	if (!freeAllocationIds.empty())
+	{
+		int id = freeAllocationIds.back();
+		freeAllocationIds.pop_back();
+		allocations[id] = allocation;
+		return id;
+	}
+
+	allocations.push_back(allocation);
+	return (int)allocations.size() - 1;
+}
+
+void GeometryPool::Free(int allocation)
+{
+	Allocation& freed = allocations[allocation];
+	if (!freed.live)
+		return;
+
+	FreeSpanInBlock(arenas[freed.vertexArena], freed.vertexBlock, freed.range.baseVertex, freed.range.vertexCount);
+	if (freed.indexArena >= 0)
+		FreeSpanInBlock(arenas[freed.indexArena], freed.indexBlock, freed.range.firstIndex, freed.range.indexCount);
+
+	freed.live = false;
+	freeAllocationIds.push_back(allocation);
+}
+
+const GeometryRange& GeometryPool::GetRange(int allocation)
+{
+	return allocations[allocation].range;
+}
+
+ID3D11Buffer* GeometryPool::GetD3DBuffer(int buffer)
+{
+	return backend->GetD3DBuffer(buffer);
+}
+
+size_t GeometryPool::CompactBlock(int arenaIndex, int blockIndex)
+{
+	Arena& arena = arenas[arenaIndex];
+	Block& block = arena.blocks[blockIndex];
+
+	// Already packed when the only free space (if any) is at the end
+	if (block.freeSpans.empty() ||
+		(block.freeSpans.size() == 1 && block.freeSpans[0].start + block.freeSpans[0].count == block.capacity))
+		return 0;
+
+	// Everything stored in this block, in the order it's laid out
+	std::vector<int> moving;
+	for (size_t i = 0; i < allocations.size(); i++)
+	{
+		const Allocation& a = allocations[i];
+		if (!a.live)
+			continue;
+
+		if (arena.indices ? (a.indexArena == arenaIndex && a.indexBlock == blockIndex) : (a.vertexArena == arenaIndex && a.vertexBlock == blockIndex))
+			moving.push_back((int)i);
+	}
+
+	auto startOf = [&](int id) -> unsigned int& { return arena.indices ? allocations[id].range.firstIndex : allocations[id].range.baseVertex; };
+	std::sort(moving.begin(), moving.end(), [&](int a, int b) { return startOf(a) < startOf(b); });
+
+	// D3D11 can't copy a buffer onto itself, so everything goes into a new one
+	int packed = backend->CreateBuffer(arena.indices, block.capacity * arena.elementSize);
+	if (packed < 0)
+		return 0;
+
+	size_t bytesCopied = 0;
+	unsigned int next = 0;
+	for (int id : moving)
+	{
+		GeometryRange& range = allocations[id].range;
+		unsigned int count = arena.indices ? range.indexCount : range.vertexCount;
+		unsigned int& start = startOf(id);
+
+		backend->CopyBuffer(packed, next * arena.elementSize, block.buffer, start * arena.elementSize, count * arena.elementSize);
+		bytesCopied += (size_t)count * arena.elementSize;
+
+		start = next;
+		(arena.indices ? range.indexBuffer : range.vertexBuffer) = packed;
+		next += count;
+	}
+
+	backend->ReleaseBuffer(block.buffer);
+	block.buffer = packed;
+	block.freeSpans.clear();
+	if (block.used < block.capacity)
+		block.freeSpans.push_back({ block.used, block.capacity - block.used });
+
+	return bytesCopied;
+}
+
+size_t GeometryPool::Defragment()
+{
+	size_t bytesCopied = 0;
+	for (size_t a = 0; a < arenas.size(); a++)
+		for (size_t b = 0; b < arenas[a].blocks.size(); b++)
+			if (arenas[a].blocks[b].buffer >= 0)
+				bytesCopied += CompactBlock((int)a, (int)b);
+
+	return bytesCopied;
+}
+
+GeometryPoolStats GeometryPool::GetStats()
+{
+	GeometryPoolStats stats = {};
+	stats.allocations = (unsigned int)(allocations.size() - freeAllocationIds.size());
+
+	for (const Arena& arena : arenas)
+	{
+		for (const Block& block : arena.blocks)
+		{
+			if (block.buffer < 0)
+				continue;
+
+			size_t reserved = (size_t)block.capacity * arena.elementSize;
+			size_t used = (size_t)block.used * arena.elementSize;
+			if (arena.indices)
+			{
+				stats.indexBuffers++;
+				stats.indexBytesReserved += reserved;
+				stats.indexBytesUsed += used;
+			}
+			else
+			{
+				stats.vertexBuffers++;
+				stats.vertexBytesReserved += reserved;
+				stats.vertexBytesUsed += used;
+			}
+
+			stats.freeSpans += (unsigned int)block.freeSpans.size();
+			for (const FreeSpan& span : block.freeSpans)
+				stats.largestFreeBytes = std::max(stats.largestFreeBytes, (size_t)span.count * arena.elementSize);
+		}
+	}
+
+	return stats;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+
+// Each of a pool's buffers is this big, unless a single mesh needs more
+#define GEOMETRY_POOL_BLOCK_BYTES (16 * 1024 * 1024)
+
+// --------------------------------------------------------
+// Where a GeometryPool's buffers actually live - D3D
+// buffers to draw from, or plain memory so the allocator
+// can be exercised without a device
+// --------------------------------------------------------
+class IGeometryBufferBackend
+{
+public:
+	virtual ~IGeometryBufferBackend() {}
+
+	//returns the id of a new buffer, or -1 if it couldn't be created
+	virtual int CreateBuffer(bool indexBuffer, unsigned int byteWidth) = 0;
+	virtual void ReleaseBuffer(int buffer) = 0;
+
+	virtual void WriteBuffer(int buffer, unsigned int byteOffset, const void* data, unsigned int byteCount) = 0;
+
+	//copies between two different buffers (D3D11 can't copy within one)
+	virtual void CopyBuffer(int destBuffer, unsigned int destOffset, int sourceBuffer, unsigned int sourceOffset, unsigned int byteCount) = 0;
+
+	//returns the buffer to bind when drawing (null for backends without one)
+	virtual ID3D11Buffer* GetD3DBuffer(int buffer) = 0;
+};
+
+// Default usage buffers, written and copied through the immediate context
+class D3D11GeometryBufferBackend : public IGeometryBufferBackend
+{
+public:
+	D3D11GeometryBufferBackend(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	int CreateBuffer(bool indexBuffer, unsigned int byteWidth) override;
+	void ReleaseBuffer(int buffer) override;
+	void WriteBuffer(int buffer, unsigned int byteOffset, const void* data, unsigned int byteCount) override;
+	void CopyBuffer(int destBuffer, unsigned int destOffset, int sourceBuffer, unsigned int sourceOffset, unsigned int byteCount) override;
+	ID3D11Buffer* GetD3DBuffer(int buffer) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>> buffers; //indexed by id, null once released
+};
+
+// Buffers in system memory, whose contents can be read back to check what the pool did
+class CpuGeometryBufferBackend : public IGeometryBufferBackend
+{
+public:
+	int CreateBuffer(bool indexBuffer, unsigned int byteWidth) override;
+	void ReleaseBuffer(int buffer) override;
+	void WriteBuffer(int buffer, unsigned int byteOffset, const void* data, unsigned int byteCount) override;
+	void CopyBuffer(int destBuffer, unsigned int destOffset, int sourceBuffer, unsigned int sourceOffset, unsigned int byteCount) override;
+	ID3D11Buffer* GetD3DBuffer(int buffer) override;
+
+	//returns the contents of a buffer (null once it's been released)
+	const unsigned char* GetData(int buffer);
+
+	//returns how many buffers have been created and not released
+	int GetLiveBufferCount();
+
+private:
+	std::vector<std::vector<unsigned char>> buffers; //indexed by id
+	std::vector<bool> live;
+};
+
+// Where one mesh's vertices and indices are in a GeometryPool
+struct GeometryRange
+{
+	int vertexBuffer; //backend ids of the buffers holding them
+	int indexBuffer; //-1 for allocations without indices
+	unsigned int baseVertex; //added to every index when drawing (the BaseVertexLocation)
+	unsigned int vertexCount;
+	unsigned int firstIndex; //where the mesh's first index is (the StartIndexLocation)
+	unsigned int indexCount;
+};
+
+// How full a pool's buffers are, to judge the block size and when to defragment
+struct GeometryPoolStats
+{
+	unsigned int allocations; //meshes currently in the pool
+	unsigned int vertexBuffers; //buffers currently created
+	unsigned int indexBuffers;
+	size_t vertexBytesReserved; //the size of every vertex buffer added up
+	size_t vertexBytesUsed; //the part of that holding vertices
+	size_t indexBytesReserved;
+	size_t indexBytesUsed;
+	unsigned int freeSpans; //separate runs of free space - more than one per buffer means fragmentation
+	size_t largestFreeBytes; //the biggest of those runs
+};
+
+// --------------------------------------------------------
+// Sub-allocates the vertices and indices of many meshes out
+// of a few large buffers, so drawing one mesh after another
+// only changes offsets rather than the bound buffers
+//
+// - Vertices are grouped by stride and indices by size, as
+//   each buffer can only be bound one way.  Indices stay
+//   relative to their own mesh, since draws add baseVertex
+// - Free space is kept as a sorted list of spans per
+//   buffer, first-fit, merged with its neighbours as soon as
+//   it's freed.  Buffers that end up empty are released
+//   (apart from the last one of each kind)
+// - Defragment() moves everything in a buffer with holes
+//   into a fresh copy of it, back to back, which changes the
+//   ranges of what moved - look them up with GetRange()
+//   again rather than keeping them around
+// - Not thread safe; D3D backends may only be used from the
+//   thread that owns the immediate context
+// --------------------------------------------------------
+class GeometryPool
+{
+public:
+	//blockBytes is the size of each buffer the pool creates (meshes bigger than it get one to themselves)
+	GeometryPool(std::shared_ptr<IGeometryBufferBackend> backend, unsigned int blockBytes = GEOMETRY_POOL_BLOCK_BYTES);
+	~GeometryPool();
+
+	// Ranges point into the pool's own buffers, so it can't be copied
+	GeometryPool(GeometryPool const&) = delete;
+	void operator=(GeometryPool const&) = delete;
+
+	//copies a mesh's vertices and indices (indexSize is 2 or 4 bytes) into the pool,
+	//returning its allocation id, or -1 if a buffer couldn't be created
+	//(indexCount can be 0 for extra vertex streams that share another allocation's indices)
+	int Allocate(const void* vertices, unsigned int vertexCount, unsigned int vertexStride,
+		const void* indices, unsigned int indexCount, unsigned int indexSize);
+
+	//gives an allocation's space back to the pool
+	void Free(int allocation);
+
+	//returns where an allocation currently is
+	const GeometryRange& GetRange(int allocation);
+
+	//returns the D3D buffer behind one of the ids in a GeometryRange
+	ID3D11Buffer* GetD3DBuffer(int buffer);
+
+	//packs every fragmented buffer so its free space is one span at the end,
+	//returning how many bytes were copied to do it
+	size_t Defragment();
+
+	//returns the pool's current occupancy
+	GeometryPoolStats GetStats();
+
+private:
+	struct FreeSpan
+	{
+		unsigned int start; //in elements
+		unsigned int count;
+	};
+
+	struct Block
+	{
+		int buffer; //backend id, -1 once released
+		unsigned int capacity; //in elements
+		unsigned int used;
+		std::vector<FreeSpan> freeSpans; //sorted by start, never touching each other
+	};
+
+	// Every block holding one kind of element
+	struct Arena
+	{
+		bool indices;
+		unsigned int elementSize;
+		std::vector<Block> blocks;
+	};
+
+	struct Allocation
+	{
+		GeometryRange range;
+		int vertexArena, vertexBlock;
+		int indexArena, indexBlock; //-1 without indices
+		bool live;
+	};
+
+	std::shared_ptr<IGeometryBufferBackend> backend;
+	unsigned int blockBytes;
+	std::vector<Arena> arenas;
+	std::vector<Allocation> allocations; //indexed by allocation id
+	std::vector<int> freeAllocationIds; //ids that can be reused
+
+	//returns the arena for one kind of element, creating it if needed
+	int FindArena(bool indices, unsigned int elementSize);
+
+	//finds room for count elements, adding a block if none has it; returns false if that failed
+	bool AllocateSpan(Arena& arena, unsigned int count, int& block, unsigned int& start);
+
+	//returns a span to its block's free list, merging it with its neighbours
+	void FreeSpanInBlock(Arena& arena, int block, unsigned int start, unsigned int count);
+
+	//moves the allocations in one block into a new buffer back to back, returning the bytes copied
+	size_t CompactBlock(int arenaIndex, int blockIndex);
+};
@@ -2,6 +2,35 @@
 #include "Transform.h"
 #include "Camera.h"
 
+#include <iterator>
+#include <map>
+
+//The camera version each shader's cbuffer data was last given, shared by every material as
+//many use the same shaders (weak, so a new shader never inherits a freed one's entry)
+static std::map<std::weak_ptr<ISimpleShader>, unsigned int, std::owner_less<std::weak_ptr<ISimpleShader>>> shaderCameraVersions;
+
+//Returns true, remembering the version, if the shader hasn't been given this camera's data yet
+static bool NeedsCamera(const std::shared_ptr<ISimpleShader>& shader, unsigned int version)
+{
+    auto entry = shaderCameraVersions.find(shader);
+    if (entry == shaderCameraVersions.end())
+    {
+        //New shaders are rare, so this is when the entries of freed ones are dropped,
+        //keeping the map no bigger than the set of shaders in use
+        for (auto i = shaderCameraVersions.begin(); i != shaderCameraVersions.end();)
+            i = i->first.expired() ? shaderCameraVersions.erase(i) : std::next(i);
+
+        shaderCameraVersions.emplace(shader, version);
+        return true;
+    }
+
+    if (entry->second == version)
+        return false;
+
+    entry->second = version;
+    return true;
+}
+
 Material::Material(DirectX::XMFLOAT3 colorTint, 
     std::shared_ptr<SimpleVertexShader> vertexShader, 
     std::shared_ptr<SimplePixelShader> pixelShader,
@@ -35,20 +64,27 @@ void Material::AddTextureSRV(std::string shaderName, Microsoft::WRL::ComPtr<ID3D
 
 void Material::AddSampler(std::string shaderName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler) { samplers.insert({ shaderName, sampler }); }
 
-void Material::SetResources(std::shared_ptr<Transform> transform, std::shared_ptr<Camera> camera)
+void Material::SetResources(Transform& transform, const Camera& camera)
 {
     pixelShader->SetShader();
     vertexShader->SetShader();
 
-    vertexShader->SetMatrix4x4("world", transform->GetWorldMatrix());
-    vertexShader->SetMatrix4x4("view", camera->GetView());
-    vertexShader->SetMatrix4x4("proj", camera->GetProjection());
-    vertexShader->SetMatrix4x4("worldInvTranspose", transform->GetWorldInverseTransposeMatrix());
+    //The shaders keep their cbuffer data between draws, so the camera's part of it is
+    //still there from the last entity drawn with them unless the camera changed since
+    if (NeedsCamera(vertexShader, camera.GetVersion()))
+    {
+        vertexShader->SetMatrix4x4("view", &camera.GetView()._11);
+        vertexShader->SetMatrix4x4("proj", &camera.GetProjection()._11);
+    }
+    if (NeedsCamera(pixelShader, camera.GetVersion()))
+        pixelShader->SetFloat3("cameraPos", &camera.GetPosition().x);
+
+    vertexShader->SetMatrix4x4("world", transform.GetWorldMatrix());
+    vertexShader->SetMatrix4x4("worldInvTranspose", transform.GetWorldInverseTransposeMatrix());
     vertexShader->CopyAllBufferData();
 
     pixelShader->SetFloat3("colorTint", colorTint);
     pixelShader->SetFloat("roughness", roughness);
-    pixelShader->SetFloat3("cameraPos", camera->GetTransform()->GetPosition());
     pixelShader->CopyAllBufferData();
 
     for (auto& t : textureSRVs) { pixelShader->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
@@ -36,7 +36,9 @@ public:
 	void AddTextureSRV(std::string shaderName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	void AddSampler(std::string shaderName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
 
-	void SetResources(std::shared_ptr<Transform>transform, std::shared_ptr<Camera> camera);
+	//sets the shaders and everything they need to draw one transform from this camera; the
+	//camera's matrices and position are only set on each shader again once the camera changes
+	void SetResources(Transform& transform, const Camera& camera);
 
 private:
 
@@ -0,0 +1,85 @@
+#include "MemoryMappedFile.h"
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& fileName, bool mapEntireFile) :
+	file(INVALID_HANDLE_VALUE),
+	mapping(0),
+	view(0),
+	data(0),
+	size(0)
+{
+	file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize))
+		return;
+
+	//Empty files can't be mapped, but they are still "open" with a size of zero
+	size = (size_t)fileSize.QuadPart;
+	if (size == 0)
+		return;
+
+	mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+	{
+		size = 0;
+		return;
+	}
+
+	if (!mapEntireFile)
+		return;
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	data = (const char*)view;
+	if (!data)
+		size = 0;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	Close();
+}
+
+void MemoryMappedFile::Close()
+{
+	if (view) UnmapViewOfFile(view);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+
+	file = INVALID_HANDLE_VALUE;
+	mapping = 0;
+	view = 0;
+	data = 0;
+	size = 0;
+}
+
+bool MemoryMappedFile::IsOpen() { return file != INVALID_HANDLE_VALUE; }
+
+const char* MemoryMappedFile::GetData() { return data; }
+
+size_t MemoryMappedFile::GetSize() { return size; }
+
+const char* MemoryMappedFile::MapRange(size_t offset, size_t length)
+{
+	if (view)
+		UnmapViewOfFile(view);
+	view = 0;
+	data = 0;
+
+	if (!mapping || offset >= size)
+		return 0;
+
+	//Views have to start on an allocation granularity boundary
+	SYSTEM_INFO info = {};
+	GetSystemInfo(&info);
+	size_t start = offset - offset % info.dwAllocationGranularity;
+	size_t end = length < size - offset ? offset + length : size;
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)((unsigned long long)start >> 32), (DWORD)start, end - start);
+	if (view)
+		data = (const char*)view + (offset - start);
+
+	return data;
+}
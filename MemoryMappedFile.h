@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Windows.h>
+#include <string>
+
+// --------------------------------------------------------
+// A read-only view of an entire file on disk
+//
+// - The OS pages the file in on demand, so large assets can
+//   be parsed straight out of the mapping without copying
+//   them into a separate buffer first
+// - Files too big to keep resident can instead be walked
+//   through with MapRange(), one part at a time
+// - The view is released when this object is destroyed
+// --------------------------------------------------------
+class MemoryMappedFile
+{
+public:
+	//Only maps the entire file up front if mapEntireFile is true
+	MemoryMappedFile(const std::wstring& fileName, bool mapEntireFile = true);
+	~MemoryMappedFile();
+
+	// The mapping owns OS handles, so it can't be copied
+	MemoryMappedFile(MemoryMappedFile const&) = delete;
+	void operator=(MemoryMappedFile const&) = delete;
+
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+	//Releases the view and the file before this object is destroyed
+	void Close();
+
+	//Replaces the current view with one covering length bytes from offset
+	//(or up to the end of the file), returning that data or null on failure
+	const char* MapRange(size_t offset, size_t length);
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const void* view; //where the current view starts, which can be before data
+	const char* data;
+	size_t size;
+};
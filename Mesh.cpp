@@ -1,290 +1,1210 @@
 #include "Mesh.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "ParallelFor.h"
+#include "MemoryMappedFile.h"
+#include <psapi.h>
 #include <vector>
+#include <chrono>
+#include <unordered_map>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+
+#pragma comment(lib, "psapi.lib")
 
 using namespace DirectX;
 
-Mesh::Mesh(Vertex vertices[], int numVertices, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> devContext)
+Mesh::Mesh(Vertex vertices[], int numVertices, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> devContext,
+	MeshVertexFormat vertexFormat) :
+	geometryAllocation(-1),
+	positionAllocation(-1),
+	indexFormat(DXGI_FORMAT_R32_UINT),
+	vertexFormat(vertexFormat),
+	positionOffset(0.0f, 0.0f, 0.0f),
+	positionScale(1.0f, 1.0f, 1.0f),
+	bounds(),
+	importStats(),
+	loadState(MeshLoadState::Loading)
 {
 	this->context = devContext;
 	this->meshBufferIndices = numIndices;
+	this->bounds = ComputeBounds(&vertices[0].Position, numVertices, sizeof(Vertex));
 
 	this->ConstructBuffers(vertices, numVertices, indices, numIndices, device);
+	loadState = HasBuffers() ? MeshLoadState::Ready : MeshLoadState::Failed;
 }
 
-Mesh::Mesh(const std::wstring& fileName, Microsoft::WRL::ComPtr<ID3D11Device> device)
+// --------------------------------------------------------
+// Builds a single vertex from one corner of an OBJ face
+//
+// The model is most likely in a right-handed space,
+// especially if it came from Maya.  We want to convert
+// to a left-handed space for DirectX.  This means we 
+// need to:
+//  - Invert the Z position
+//  - Invert the normal's Z
+//  - Flip the winding order (done by the caller)
+// We also need to flip the UV coordinate since DirectX
+// defines (0,0) as the top left of the texture, and many
+// 3D modeling packages use the bottom left as (0,0)
+// --------------------------------------------------------
+static Vertex MakeObjVertex(const ObjData& obj, const ObjCorner& corner)
 {
-	meshBufferIndices = 0;
+	Vertex v = {};
+	v.Position = obj.positions[corner.position];
 
-	// File input object
-	std::ifstream obj(fileName);
+	// Corners without UVs or normals fall back to zero
+	if (corner.uv >= 0 && corner.uv < (int)obj.uvs.size())
+		v.uv = obj.uvs[corner.uv];
+	if (corner.normal >= 0 && corner.normal < (int)obj.normals.size())
+		v.normal = obj.normals[corner.normal];
 
-	// Check for successful open
-	if (!obj.is_open())
-		return;
+	// Flip the UV's since they're probably "upside down"
+	v.uv.y = 1.0f - v.uv.y;
+
+	// Flip Z (LH vs. RH)
+	v.Position.z *= -1.0f;
+
+	// Flip normal's Z
+	v.normal.z *= -1.0f;
+
+	return v;
+}
+
+// The most memory the process has had resident at once, so far
+static size_t GetPeakMemoryBytes()
+{
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.PeakWorkingSetSize;
+}
+
+// --------------------------------------------------------
+// Key used to find face corners that reference exactly the
+// same position, uv and normal from the file
+// --------------------------------------------------------
+struct ObjCornerKey
+{
+	int position;
+	int uv;
+	int normal;
+
+	bool operator==(const ObjCornerKey& other) const
+	{
+		return position == other.position && uv == other.uv && normal == other.normal;
+	}
+};
+
+struct ObjCornerKeyHash
+{
+	size_t operator()(const ObjCornerKey& key) const
+	{
+		// Pack the three indices and scramble them (Fibonacci hashing)
+		unsigned long long packed =
+			((unsigned long long)(unsigned int)key.position << 42) ^
+			((unsigned long long)(unsigned int)key.uv << 21) ^
+			(unsigned long long)(unsigned int)key.normal;
+		return (size_t)((packed * 0x9E3779B97F4A7C15ull) >> 16);
+	}
+};
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;	// Positions from the file
-	std::vector<XMFLOAT3> normals;		// Normals from the file
-	std::vector<XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
+// --------------------------------------------------------
+// Turns the parsed faces into an indexed triangle list
+//
+// - Every unique position/uv/normal triple becomes exactly
+//   one vertex, so corners shared between triangles are
+//   only stored (and transformed by the GPU) once
+// - Triangles that reference missing positions are dropped
+// - If keys is given, it gets the triple each vertex was
+//   made from, in the same order as verts
+// --------------------------------------------------------
+static void WeldObjVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<UINT>& indices, std::vector<ObjCornerKey>* keys = nullptr)
+{
+	std::unordered_map<ObjCornerKey, UINT, ObjCornerKeyHash> lookup;
+	lookup.reserve(obj.corners.size() / 2);
+	indices.reserve(obj.corners.size());
+
+	int positionCount = (int)obj.positions.size();
+	int uvCount = (int)obj.uvs.size();
+	int normalCount = (int)obj.normals.size();
+
+	for (size_t i = 0; i + 2 < obj.corners.size(); i += 3)
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		// Add the verts (flipping the winding order)
+		const ObjCorner* triangle[3] = { &obj.corners[i], &obj.corners[i + 2], &obj.corners[i + 1] };
+
+		// Skip any triangle that points at positions that don't exist
+		if (triangle[0]->position < 0 || triangle[0]->position >= positionCount ||
+			triangle[1]->position < 0 || triangle[1]->position >= positionCount ||
+			triangle[2]->position < 0 || triangle[2]->position >= positionCount)
+			continue;
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
+		for (int c = 0; c < 3; c++)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
+			// Out of range uvs/normals are treated as missing so they weld together
+			ObjCornerKey key;
+			key.position = triangle[c]->position;
+			key.uv = triangle[c]->uv < uvCount ? triangle[c]->uv : -1;
+			key.normal = triangle[c]->normal < normalCount ? triangle[c]->normal : -1;
+
+			auto found = lookup.find(key);
+			if (found != lookup.end())
+			{
+				indices.push_back(found->second);
+				continue;
+			}
+
+			UINT index = (UINT)verts.size();
+			lookup.emplace(key, index);
+			verts.push_back(MakeObjVertex(obj, *triangle[c]));
+			indices.push_back(index);
+			if (keys)
+				keys->push_back(key);
 		}
-		else if (chars[0] == 'v' && chars[1] == 't')
+	}
+}
+
+// --------------------------------------------------------
+// Every vertex written so far while cooking a file a window
+// at a time, so a window reuses the vertices it shares with
+// earlier ones instead of splitting them
+//
+// - Vertices are chained by position, since a position is
+//   rarely used by more than a few of them; that's far less
+//   memory than a hash map over the whole mesh
+// --------------------------------------------------------
+struct ObjWeldedVertices
+{
+	struct Entry
+	{
+		int uv;
+		int normal;
+		UINT next; //the previous vertex added with the same position, or UINT_MAX
+	};
+
+	std::vector<UINT> positionHeads; //the last vertex added with each position, or UINT_MAX
+	std::vector<Entry> entries;
+
+	// The vertex made from this triple, or UINT_MAX if there isn't one yet
+	UINT Find(const ObjCornerKey& key) const
+	{
+		if (key.position >= (int)positionHeads.size())
+			return UINT_MAX;
+
+		UINT v = positionHeads[key.position];
+		while (v != UINT_MAX && (entries[v].uv != key.uv || entries[v].normal != key.normal))
+			v = entries[v].next;
+		return v;
+	}
+
+	UINT Add(const ObjCornerKey& key)
+	{
+		if (key.position >= (int)positionHeads.size())
+			positionHeads.resize(key.position + 1, UINT_MAX);
+
+		UINT v = (UINT)entries.size();
+		entries.push_back({ key.uv, key.normal, positionHeads[key.position] });
+		positionHeads[key.position] = v;
+		return v;
+	}
+};
+
+// Triangle counts, relative to full detail, that each coarser LOD aims for
+static const float lodTriangleRatios[] = { 0.5f, 0.25f, 0.125f };
+
+// A LOD has to drop at least this fraction of the previous one's triangles to be worth keeping
+#define LOD_MIN_REDUCTION 0.2f
+
+// --------------------------------------------------------
+// Appends simplified versions of the mesh to its index
+// buffer, and lists every level (full detail included)
+//
+// - Each LOD is simplified from full detail, so its error
+//   is measured against the original surface
+// - The chain ends early once simplification stops paying
+//   off, e.g. for a cube, where every corner is a hard edge
+// --------------------------------------------------------
+static void BuildLodChain(const std::vector<Vertex>& verts, std::vector<UINT>& indices, std::vector<MeshLod>& lods)
+{
+	int fullIndexCount = (int)indices.size();
+
+	lods.clear();
+	lods.push_back({ 0, (unsigned int)fullIndexCount, 0.0f });
+
+	std::vector<unsigned int> simplified;
+	for (float ratio : lodTriangleRatios)
+	{
+		int targetIndexCount = (int)(fullIndexCount / 3 * ratio) * 3;
+		float error = SimplifyMesh(&indices[0], fullIndexCount, &verts[0], (int)verts.size(), targetIndexCount, simplified);
+
+		const MeshLod& previous = lods.back();
+		if (simplified.size() > previous.indexCount * (1.0f - LOD_MIN_REDUCTION))
+			break;
+
+		OptimizeVertexCache(&simplified[0], (int)simplified.size(), (int)verts.size());
+
+		// Coarser levels never claim to be more accurate than finer ones
+		MeshLod lod = { (unsigned int)indices.size(), (unsigned int)simplified.size(), std::max(error, previous.error) };
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		lods.push_back(lod);
+	}
+}
+
+Mesh::Mesh(const std::wstring& fileName, Microsoft::WRL::ComPtr<ID3D11Device> device, MeshVertexFormat vertexFormat, bool buildClusters) :
+	Mesh(vertexFormat, nullptr)
+{
+	if (Import(fileName, buildClusters))
+		CreateBuffers(device);
+	else
+		loadState = MeshLoadState::Failed;
+}
+
+Mesh::Mesh(MeshVertexFormat vertexFormat, std::shared_ptr<Mesh> placeholder) :
+	geometryAllocation(-1),
+	positionAllocation(-1),
+	meshBufferIndices(0),
+	indexFormat(DXGI_FORMAT_R32_UINT),
+	vertexFormat(vertexFormat),
+	positionOffset(0.0f, 0.0f, 0.0f),
+	positionScale(1.0f, 1.0f, 1.0f),
+	bounds(),
+	importStats(),
+	loadState(MeshLoadState::Loading),
+	placeholder(placeholder)
+{
+}
+
+bool Mesh::Import(const std::wstring& fileName, bool buildClusters)
+{
+	auto loadStart = std::chrono::high_resolution_clock::now();
+
+	// Use the cooked version of this model if it's still up to date (and
+	// has clusters, if they're wanted), keeping it mapped so its arrays
+	// can go straight to D3D without any copies
+	std::wstring cacheFileName = GetMeshCachePath(fileName);
+	auto loadCache = [&]()
+	{
+		std::shared_ptr<MeshCacheFile> cache = std::make_shared<MeshCacheFile>(cacheFileName, fileName);
+		if (!cache->IsValid() || (buildClusters && cache->GetHeader()->clusterCount == 0))
+			return false;
+
+		const MeshCacheHeader* header = cache->GetHeader();
+
+		auto loadEnd = std::chrono::high_resolution_clock::now();
+		importStats.fileBytes = cache->GetFileSize();
+		importStats.loadMilliseconds = std::chrono::duration<double, std::milli>(loadEnd - loadStart).count();
+		importStats.unweldedVertexCount = cache->GetLods()[0].indexCount;
+		importStats.vertexCount = header->vertexCount;
+		importStats.loadedFromCache = true;
+
+		lods.assign(cache->GetLods(), cache->GetLods() + header->lodCount);
+		bounds = header->bounds;
+		if (buildClusters)
 		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
+			clusters.assign(cache->GetClusters(), cache->GetClusters() + header->clusterCount);
+			importStats.clusterFill = MeasureClusterFill(&clusters[0], (int)clusters.size());
 		}
-		else if (chars[0] == 'v')
+
+		// Huge meshes are copied to the GPU a window at a time, so the
+		// arrays in the cache never all become resident at once
+		pendingCache = cache;
+		if (cache->GetFileSize() >= MESH_STREAMING_IMPORT_BYTES)
+			pendingWindowedCache = cacheFileName;
+		return true;
+	};
+
+	if (loadCache())
+		return true;
+
+	// Files too big to import in one go are cooked a window at a time
+	// instead, then loaded like any other cache
+	size_t sourceBytes = MemoryMappedFile(fileName, false).GetSize();
+	if (sourceBytes >= MESH_STREAMING_IMPORT_BYTES)
+	{
+		if (!CookObjInWindows(fileName, cacheFileName, buildClusters) || !loadCache())
+			return false;
+
+		importStats.fileBytes = sourceBytes;
+		importStats.loadedFromCache = false;
+		importStats.streamed = true;
+		return true;
+	}
+
+	// Memory-map and parse the whole file in one go
+	ObjData obj = {};
+	if (!LoadObj(fileName, obj))
+		return false;
+
+	// Verts we're assembling and the indices of these verts
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	WeldObjVertices(obj, verts, indices);
+
+	if (verts.empty())
+		return false;
+
+	// Reorder for the post-transform cache and for overdraw, group into
+	// clusters if asked to, add the simplified LODs, then lay the vertices
+	// out in the order the GPU will fetch them (full detail first, since
+	// the LODs reuse them)
+	int fullIndexCount = (int)indices.size();
+	importStats.cacheBefore = MeasureVertexCache(&indices[0], fullIndexCount, (int)verts.size());
+	OptimizeVertexCache(&indices[0], fullIndexCount, (int)verts.size());
+	OptimizeOverdraw(&indices[0], fullIndexCount, &verts[0], (int)verts.size());
+	if (buildClusters)
+	{
+		BuildMeshClusters(&indices[0], fullIndexCount, &verts[0], (int)verts.size(), clusters);
+		importStats.clusterFill = MeasureClusterFill(&clusters[0], (int)clusters.size());
+	}
+	BuildLodChain(verts, indices, lods);
+	verts.resize(OptimizeVertexFetch(&verts[0], (int)verts.size(), &indices[0], (int)indices.size()));
+	importStats.cacheAfter = MeasureVertexCache(&indices[0], fullIndexCount, (int)verts.size());
+	bounds = ComputeBounds(&verts[0].Position, (int)verts.size(), sizeof(Vertex));
+
+	// Every LOD shares the full-detail tangents
+	auto tangentStart = std::chrono::high_resolution_clock::now();
+	this->CalculateTangents(&verts[0], (int)verts.size(), &indices[0], fullIndexCount);
+	auto tangentEnd = std::chrono::high_resolution_clock::now();
+	importStats.tangentMilliseconds = std::chrono::duration<double, std::milli>(tangentEnd - tangentStart).count();
+
+	auto loadEnd = std::chrono::high_resolution_clock::now();
+	importStats.fileBytes = obj.sourceBytes;
+	importStats.loadMilliseconds = std::chrono::duration<double, std::milli>(loadEnd - loadStart).count();
+	importStats.unweldedVertexCount = fullIndexCount;
+	importStats.vertexCount = verts.size();
+
+	// Cook the results so the next run can skip all of the above
+	WriteMeshCache(cacheFileName, fileName, &verts[0], (int)verts.size(), &indices[0], (int)indices.size(),
+		&lods[0], (int)lods.size(), clusters.data(), (int)clusters.size(), bounds);
+
+	pendingVertices.swap(verts);
+	pendingIndices.swap(indices);
+	return true;
+}
+
+bool Mesh::CreateBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, std::shared_ptr<GeometryPool> pool, bool positionStream)
+{
+	// Huge meshes keep their own buffers - they'd fill a pool block on
+	// their own anyway, and are filled in a window at a time
+	bool filled = true;
+	if (pendingCache)
+	{
+		const MeshCacheHeader* header = pendingCache->GetHeader();
+		if (!pendingWindowedCache.empty())
+			filled = this->ConstructBuffersInWindows(pendingWindowedCache, (int)header->vertexCount, (int)header->indexCount, device, positionStream);
+		else
+			this->ConstructBuffers(pendingCache->GetVertices(), (int)header->vertexCount, pendingCache->GetIndices(), (int)header->indexCount, device, pool, positionStream);
+	}
+	else if (!pendingVertices.empty())
+		this->ConstructBuffers(&pendingVertices[0], (int)pendingVertices.size(), &pendingIndices[0], (int)pendingIndices.size(), device, pool, positionStream);
+
+	// D3D has its own copy now
+	pendingCache.reset();
+	pendingWindowedCache.clear();
+	std::vector<Vertex>().swap(pendingVertices);
+	std::vector<unsigned int>().swap(pendingIndices);
+
+	loadState = filled && HasBuffers() ? MeshLoadState::Ready : MeshLoadState::Failed;
+	importStats.peakMemoryBytes = GetPeakMemoryBytes();
+	return loadState == MeshLoadState::Ready;
+}
+
+// Defined with CalculateTangents(), which a window at a time can't use as is
+static inline bool TriangleTangent(const Vertex* verts, const unsigned int* triangle, XMVECTOR& tangent);
+static void OrthonormalizeTangents(Vertex* verts, const XMFLOAT4A* sums, int begin, int end);
+
+bool Mesh::CookObjInWindows(const std::wstring& fileName, const std::wstring& cacheFileName, bool buildClusters, size_t windowBytes)
+{
+	MeshCacheWriter writer(cacheFileName, fileName);
+
+	// Reused by every window, so they only grow as big as the largest one
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	std::vector<ObjCornerKey> keys;
+	std::vector<UINT> cacheIndices;
+	std::vector<Vertex> newVerts;
+	std::vector<MeshCluster> windowClusters;
+	std::vector<MeshCluster> cookedClusters;
+
+	// Every vertex written so far, and the tangents of every triangle
+	// that uses it, since windows share the vertices along their edges
+	ObjWeldedVertices welded;
+	std::vector<XMFLOAT4A> tangentSums;
+
+	unsigned long long indexTotal = 0;
+	double acmrBefore = 0.0, acmrAfter = 0.0, atvrBefore = 0.0, atvrAfter = 0.0;
+	bool written = true;
+
+	ObjData obj = {};
+	bool parsed = StreamObj(fileName, windowBytes, obj, [&](ObjData& window)
+	{
+		verts.clear();
+		indices.clear();
+		keys.clear();
+		WeldObjVertices(window, verts, indices, &keys);
+		if (verts.empty() || !written)
+			return;
+
+		// The same passes as a regular import, apart from the LODs
+		int numIndices = (int)indices.size();
+		VertexCacheStats before = MeasureVertexCache(&indices[0], numIndices, (int)verts.size());
+		OptimizeVertexCache(&indices[0], numIndices, (int)verts.size());
+		OptimizeOverdraw(&indices[0], numIndices, &verts[0], (int)verts.size());
+		if (buildClusters)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			BuildMeshClusters(&indices[0], numIndices, &verts[0], (int)verts.size(), windowClusters);
+			for (size_t i = 0; i < windowClusters.size(); i++)
+			{
+				windowClusters[i].indexStart += (unsigned int)indexTotal;
+				cookedClusters.push_back(windowClusters[i]);
+			}
 		}
-		else if (chars[0] == 'f')
+		VertexCacheStats after = MeasureVertexCache(&indices[0], numIndices, (int)verts.size());
+
+		// Vertices an earlier window already wrote are used from there, and the
+		// rest are written in the order the indices first use them (as
+		// OptimizeVertexFetch() would)
+		cacheIndices.assign(verts.size(), UINT_MAX);
+		newVerts.clear();
+		for (int i = 0; i < numIndices; i++)
 		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
+			UINT v = indices[i];
+			if (cacheIndices[v] != UINT_MAX)
+				continue;
+
+			cacheIndices[v] = welded.Find(keys[v]);
+			if (cacheIndices[v] == UINT_MAX)
 			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(XMFLOAT2(0, 0));
+				cacheIndices[v] = welded.Add(keys[v]);
+				newVerts.push_back(verts[v]);
 			}
+		}
+
+		// Only sum up the tangents for now, since vertices on the edge of
+		// this window may still be used by the next
+		auto tangentStart = std::chrono::high_resolution_clock::now();
+		tangentSums.resize(welded.entries.size(), XMFLOAT4A(0, 0, 0, 0));
+		for (int t = 0; t < numIndices / 3; t++)
+		{
+			XMVECTOR tangent;
+			if (!TriangleTangent(&verts[0], &indices[t * 3], tangent))
+				continue;
 
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.uv = uvs[i[1] - 1];
-			v1.normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.uv = uvs[i[4] - 1];
-			v2.normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.uv = uvs[i[7] - 1];
-			v3.normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.uv.y = 1.0f - v1.uv.y;
-			v2.uv.y = 1.0f - v2.uv.y;
-			v3.uv.y = 1.0f - v3.uv.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.normal.z *= -1.0f;
-			v2.normal.z *= -1.0f;
-			v3.normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
+			for (int c = 0; c < 3; c++)
 			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.uv = uvs[i[10] - 1];
-				v4.normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.uv.y = 1.0f - v4.uv.y;
-				v4.Position.z *= -1.0f;
-				v4.normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
+				XMFLOAT4A* sum = &tangentSums[cacheIndices[indices[t * 3 + c]]];
+				XMStoreFloat4A(sum, XMVectorAdd(XMLoadFloat4A(sum), tangent));
 			}
 		}
-	}
+		auto tangentEnd = std::chrono::high_resolution_clock::now();
+		importStats.tangentMilliseconds += std::chrono::duration<double, std::milli>(tangentEnd - tangentStart).count();
+
+		for (int i = 0; i < numIndices; i++)
+			indices[i] = cacheIndices[indices[i]];
 
-	// Close the file and create the actual buffers
-	obj.close();
+		written = writer.AddVertices(newVerts.data(), (int)newVerts.size()) && writer.AddIndices(&indices[0], numIndices);
 
-	//this->meshBufferIndices = indexCounter;
+		// Weighted so the totals match measuring the whole mesh at once
+		acmrBefore += before.acmr * (numIndices / 3);
+		acmrAfter += after.acmr * (numIndices / 3);
+		atvrBefore += before.atvr * verts.size();
+		atvrAfter += after.atvr * verts.size();
+		indexTotal += numIndices;
+	});
 
-	this->CalculateTangents(&verts[0], vertCounter, &indices[0], indexCounter);
+	if (!parsed || !written || indexTotal == 0)
+		return false;
 
-	this->ConstructBuffers(&verts[0], vertCounter, &indices[0], indexCounter, device);
+	// Every triangle has been seen, so the tangents can be finished in
+	// place in the cache
+	auto tangentStart = std::chrono::high_resolution_clock::now();
+	if (!writer.UpdateVertices([&](Vertex* vertices, unsigned int firstVertex, int numVertices)
+	{
+		OrthonormalizeTangents(vertices, &tangentSums[firstVertex], 0, numVertices);
+	}))
+		return false;
+	auto tangentEnd = std::chrono::high_resolution_clock::now();
+	importStats.tangentMilliseconds += std::chrono::duration<double, std::milli>(tangentEnd - tangentStart).count();
+
+	unsigned long long triangleTotal = indexTotal / 3;
+	unsigned long long vertexTotal = writer.GetVertexCount();
+	importStats.cacheBefore.acmr = (float)(acmrBefore / triangleTotal);
+	importStats.cacheAfter.acmr = (float)(acmrAfter / triangleTotal);
+	importStats.cacheBefore.atvr = (float)(atvrBefore / vertexTotal);
+	importStats.cacheAfter.atvr = (float)(atvrAfter / vertexTotal);
+
+	// The bounds come from every position in the file (flipped into
+	// left-handed space), so they're a little loose if some are unused
+	Bounds fileBounds = ComputeBounds(&obj.positions[0], (int)obj.positions.size(), sizeof(XMFLOAT3));
+	bounds = fileBounds;
+	bounds.boxMin.z = -fileBounds.boxMax.z;
+	bounds.boxMax.z = -fileBounds.boxMin.z;
+	bounds.sphereCenter.z = -fileBounds.sphereCenter.z;
+
+	// The parsed file and the weld are by far the biggest things in
+	// memory, and aren't needed to finish the cache
+	obj = ObjData();
+	welded = ObjWeldedVertices();
+	tangentSums = std::vector<XMFLOAT4A>();
+
+	MeshLod lod = { 0, (unsigned int)indexTotal, 0.0f };
+	return writer.Finish(&lod, 1, cookedClusters.data(), (int)cookedClusters.size(), bounds);
 }
 
 Mesh::~Mesh()
 {
+	if (geometryAllocation >= 0)
+		geometryPool->Free(geometryAllocation);
+	if (positionAllocation >= 0)
+		geometryPool->Free(positionAllocation);
+}
 
+bool Mesh::HasBuffers()
+{
+	return geometryAllocation >= 0 || (vertexBuffer && indexBuffer);
 }
 
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
 {
+	if (geometryAllocation >= 0)
+		return geometryPool->GetD3DBuffer(geometryPool->GetRange(geometryAllocation).vertexBuffer);
+
     return vertexBuffer;
 }
 
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
 {
+	if (geometryAllocation >= 0)
+		return geometryPool->GetD3DBuffer(geometryPool->GetRange(geometryAllocation).indexBuffer);
+
     return indexBuffer;
 }
 
+UINT Mesh::GetBaseVertex()
+{
+	return geometryAllocation >= 0 ? geometryPool->GetRange(geometryAllocation).baseVertex : 0;
+}
+
+UINT Mesh::GetFirstIndex()
+{
+	return geometryAllocation >= 0 ? geometryPool->GetRange(geometryAllocation).firstIndex : 0;
+}
+
+bool Mesh::HasPositionStream()
+{
+	return positionAllocation >= 0 || positionBuffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetPositionBuffer()
+{
+	if (positionAllocation >= 0)
+		return geometryPool->GetD3DBuffer(geometryPool->GetRange(positionAllocation).vertexBuffer);
+
+	return positionBuffer;
+}
+
+UINT Mesh::GetPositionBaseVertex()
+{
+	return positionAllocation >= 0 ? geometryPool->GetRange(positionAllocation).baseVertex : 0;
+}
+
+UINT Mesh::GetPositionStride()
+{
+	return vertexFormat == MeshVertexFormat::Packed ? sizeof(PackedVertex::position) : sizeof(XMFLOAT3);
+}
+
 int Mesh::GetIndexCount()
 {
     return meshBufferIndices;
 }
 
-void Mesh::Draw()
+int Mesh::GetLodCount()
 {
-    UINT stride = sizeof(Vertex);
-    UINT offset = 0;
+	return (int)lods.size();
+}
 
-    context->IASetVertexBuffers(0, 1, this->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-    context->IASetIndexBuffer(this->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+const MeshLod& Mesh::GetLod(int lod)
+{
+	return lods[lod];
+}
+
+int Mesh::SelectLod(float pixelsPerUnit)
+{
+	// Errors only grow from one level to the next, so stop at the first that's visible
+	int lod = 0;
+	while (lod + 1 < (int)lods.size() && lods[lod + 1].error * pixelsPerUnit <= MESH_LOD_MAX_PIXEL_ERROR)
+		lod++;
 
-    context->DrawIndexed(this->GetIndexCount(), 0, 0);
+	return lod;
 }
 
-void Mesh::ConstructBuffers(Vertex vertices[], int numVertices, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
+DXGI_FORMAT Mesh::GetIndexFormat()
 {
-	this->meshBufferIndices = numIndices;
+	return indexFormat;
+}
+
+MeshVertexFormat Mesh::GetVertexFormat()
+{
+	return vertexFormat;
+}
+
+UINT Mesh::GetVertexStride()
+{
+	return vertexFormat == MeshVertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+XMFLOAT3 Mesh::GetPositionOffset()
+{
+	return positionOffset;
+}
+
+XMFLOAT3 Mesh::GetPositionScale()
+{
+	return positionScale;
+}
+
+const Bounds& Mesh::GetBounds()
+{
+	return bounds;
+}
+
+const MeshImportStats& Mesh::GetImportStats()
+{
+	return importStats;
+}
+
+MeshLoadState Mesh::GetLoadState()
+{
+	return loadState;
+}
+
+std::shared_ptr<Mesh> Mesh::GetPlaceholder()
+{
+	return placeholder;
+}
+
+int Mesh::GetClusterCount()
+{
+	return (int)clusters.size();
+}
+
+const MeshCluster& Mesh::GetCluster(int cluster)
+{
+	return clusters[cluster];
+}
+
+void Mesh::CullClusters(const XMFLOAT4X4& worldViewProjection, XMFLOAT3 cameraPosition, std::vector<unsigned int>& visibleClusters)
+{
+	CullMeshClusters(clusters.data(), (int)clusters.size(), worldViewProjection, cameraPosition, visibleClusters);
+}
+
+void Mesh::Draw()
+{
+    BindBuffers(context, GetVertexBuffer().Get(), GetVertexStride());
+
+    context->DrawIndexed(this->GetIndexCount(), GetFirstIndex(), (INT)GetBaseVertex());
+}
+
+void Mesh::ConstructBuffers(const Vertex vertices[], int numVertices, const unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device,
+	std::shared_ptr<GeometryPool> pool, bool positionStream)
+{
+	// Meshes that weren't given any LODs are just their full-detail version
+	if (lods.empty())
+		lods.push_back({ 0, (unsigned int)numIndices, 0.0f });
+
+	this->meshBufferIndices = (int)lods[0].indexCount;
+
+	// Packed meshes are quantized here, relative to their own bounds,
+	// so the cooked cache doesn't depend on which format was chosen
+	std::vector<PackedVertex> packedVertices;
+	const void* vertexData = vertices;
+
+	if (vertexFormat == MeshVertexFormat::Packed)
+	{
+		GetPackedPositionRange(vertices, numVertices, positionOffset, positionScale);
+
+		// Quantized positions can land up to half a step away from the
+		// originals, which the box already covers but the sphere doesn't
+		XMVECTOR halfStep = XMLoadFloat3(&positionScale) * (0.5f / 65535.0f);
+		bounds.sphereRadius += XMVectorGetX(XMVector3Length(halfStep));
+
+		packedVertices.resize(numVertices);
+		for (int i = 0; i < numVertices; i++)
+			packedVertices[i] = PackVertex(vertices[i], positionOffset, positionScale);
+
+		vertexData = packedVertices.data();
+	}
+
+	// Meshes with few enough vertices get 16-bit indices, which halves
+	// the index buffer's memory and the bandwidth spent reading it
+	// (pooled ones too, since indices are relative to the base vertex)
+	std::vector<unsigned short> shortIndices;
+	UINT indexSize = sizeof(unsigned int);
+	const void* indexData = indices;
+	indexFormat = DXGI_FORMAT_R32_UINT;
+
+	if (numVertices <= 65536)
+	{
+		shortIndices.resize(numIndices);
+		for (int i = 0; i < numIndices; i++)
+			shortIndices[i] = (unsigned short)indices[i];
+
+		indexSize = sizeof(unsigned short);
+		indexData = shortIndices.data();
+		indexFormat = DXGI_FORMAT_R16_UINT;
+	}
+
+	if (positionStream)
+		this->ConstructPositionStream(vertexData, numVertices, device, pool);
+
+	if (pool)
+	{
+		geometryAllocation = pool->Allocate(vertexData, (unsigned int)numVertices, GetVertexStride(), indexData, (unsigned int)numIndices, indexSize);
+		if (geometryAllocation >= 0)
+		{
+			geometryPool = pool;
+			return;
+		}
+	}
 
 	D3D11_BUFFER_DESC vbd = {};
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * (UINT)numVertices;
+	vbd.ByteWidth = GetVertexStride() * (UINT)numVertices;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
 	vbd.StructureByteStride = 0;
 
 	D3D11_SUBRESOURCE_DATA initialVertexData = {};
-	initialVertexData.pSysMem = vertices;
+	initialVertexData.pSysMem = vertexData;
 
 	device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
 
 	D3D11_BUFFER_DESC ibd = {};
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * (UINT)meshBufferIndices;
+	ibd.ByteWidth = indexSize * (UINT)numIndices;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
 	ibd.StructureByteStride = 0;
 
 	D3D11_SUBRESOURCE_DATA initialIndexData = {};
-	initialIndexData.pSysMem = indices;
+	initialIndexData.pSysMem = indexData;
 
 	device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
 }
 
-void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+// --------------------------------------------------------
+// Depth-only passes don't need normals, UVs or tangents,
+// so they can read a stream of positions alone instead
+//
+// - Both vertex formats store the position first, so the
+//   stream is just the first GetPositionStride() bytes of
+//   each vertex, encoded the same way
+// - Shaders reading only POSITION can draw from either the
+//   stream or the full vertices with the same input layout
+// --------------------------------------------------------
+static void ExtractPositions(const void* vertexData, int numVertices, UINT vertexStride, UINT positionStride, std::vector<unsigned char>& positions)
+{
+	positions.resize((size_t)positionStride * numVertices);
+	for (int i = 0; i < numVertices; i++)
+		memcpy(&positions[(size_t)positionStride * i], (const unsigned char*)vertexData + (size_t)vertexStride * i, positionStride);
+}
+
+void Mesh::ConstructPositionStream(const void* vertexData, int numVertices, Microsoft::WRL::ComPtr<ID3D11Device> device, std::shared_ptr<GeometryPool> pool)
+{
+	std::vector<unsigned char> positions;
+	ExtractPositions(vertexData, numVertices, GetVertexStride(), GetPositionStride(), positions);
+
+	// The positions share the mesh's indices, so they're pooled without any
+	if (pool)
+	{
+		positionAllocation = pool->Allocate(positions.data(), (unsigned int)numVertices, GetPositionStride(), nullptr, 0, 0);
+		if (positionAllocation >= 0)
+		{
+			geometryPool = pool;
+			return;
+		}
+	}
+
+	D3D11_BUFFER_DESC pbd = {};
+	pbd.Usage = D3D11_USAGE_IMMUTABLE;
+	pbd.ByteWidth = GetPositionStride() * (UINT)numVertices;
+	pbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA initialPositionData = {};
+	initialPositionData.pSysMem = positions.data();
+
+	device->CreateBuffer(&pbd, &initialPositionData, positionBuffer.GetAddressOf());
+}
+
+bool Mesh::ConstructBuffersInWindows(const std::wstring& cacheFileName, int numVertices, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device,
+	bool positionStream)
 {
-	UINT stride = sizeof(Vertex);
+	this->meshBufferIndices = (int)lods[0].indexCount;
+
+	// Packed positions can't be quantized to the range of vertices that
+	// haven't been read yet, so they use the bounds instead
+	if (vertexFormat == MeshVertexFormat::Packed)
+	{
+		positionOffset = bounds.boxMin;
+		XMStoreFloat3(&positionScale, XMLoadFloat3(&bounds.boxMax) - XMLoadFloat3(&bounds.boxMin));
+		bounds.sphereRadius += XMVectorGetX(XMVector3Length(XMLoadFloat3(&positionScale) * (0.5f / 65535.0f)));
+	}
+
+	UINT vertexStride = GetVertexStride();
+	UINT indexSize = numVertices <= 65536 ? sizeof(unsigned short) : sizeof(unsigned int);
+	indexFormat = numVertices <= 65536 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+	// Immutable buffers need all of their data up front, so these are
+	// filled in piece by piece after being created
+	D3D11_BUFFER_DESC vbd = {};
+	vbd.Usage = D3D11_USAGE_DEFAULT;
+	vbd.ByteWidth = vertexStride * (UINT)numVertices;
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	device->CreateBuffer(&vbd, 0, vertexBuffer.GetAddressOf());
+
+	D3D11_BUFFER_DESC ibd = {};
+	ibd.Usage = D3D11_USAGE_DEFAULT;
+	ibd.ByteWidth = indexSize * (UINT)numIndices;
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	device->CreateBuffer(&ibd, 0, indexBuffer.GetAddressOf());
+
+	UINT positionStride = GetPositionStride();
+	if (positionStream)
+	{
+		D3D11_BUFFER_DESC pbd = {};
+		pbd.Usage = D3D11_USAGE_DEFAULT;
+		pbd.ByteWidth = positionStride * (UINT)numVertices;
+		pbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		device->CreateBuffer(&pbd, 0, positionBuffer.GetAddressOf());
+	}
+
+	if (!vertexBuffer || !indexBuffer)
+		return false;
+
+	// Buffers left partly filled by a window that couldn't be read
+	// would draw garbage, so they're released instead
+	auto fail = [&]()
+	{
+		vertexBuffer.Reset();
+		indexBuffer.Reset();
+		positionBuffer.Reset();
+		return false;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext;
+	device->GetImmediateContext(immediateContext.GetAddressOf());
+
+	MemoryMappedFile file(cacheFileName, false);
+	size_t vertexStart = sizeof(MeshCacheHeader);
+	size_t indexStart = vertexStart + sizeof(Vertex) * (size_t)numVertices;
+
+	std::vector<PackedVertex> packedVertices;
+	std::vector<unsigned char> positions;
+	int verticesPerWindow = MESH_STREAMING_WINDOW_BYTES / sizeof(Vertex);
+	for (int first = 0; first < numVertices; first += verticesPerWindow)
+	{
+		int count = std::min(verticesPerWindow, numVertices - first);
+		const Vertex* window = (const Vertex*)file.MapRange(vertexStart + sizeof(Vertex) * (size_t)first, sizeof(Vertex) * (size_t)count);
+		if (!window)
+			return fail();
+
+		const void* data = window;
+		if (vertexFormat == MeshVertexFormat::Packed)
+		{
+			packedVertices.resize(count);
+			for (int i = 0; i < count; i++)
+				packedVertices[i] = PackVertex(window[i], positionOffset, positionScale);
+			data = packedVertices.data();
+		}
+
+		D3D11_BOX box = { vertexStride * (UINT)first, 0, 0, vertexStride * (UINT)(first + count), 1, 1 };
+		immediateContext->UpdateSubresource(vertexBuffer.Get(), 0, &box, data, 0, 0);
+
+		if (positionBuffer)
+		{
+			ExtractPositions(data, count, vertexStride, positionStride, positions);
+			D3D11_BOX positionBox = { positionStride * (UINT)first, 0, 0, positionStride * (UINT)(first + count), 1, 1 };
+			immediateContext->UpdateSubresource(positionBuffer.Get(), 0, &positionBox, positions.data(), 0, 0);
+		}
+	}
+
+	std::vector<unsigned short> shortIndices;
+	int indicesPerWindow = MESH_STREAMING_WINDOW_BYTES / sizeof(unsigned int);
+	for (int first = 0; first < numIndices; first += indicesPerWindow)
+	{
+		int count = std::min(indicesPerWindow, numIndices - first);
+		const unsigned int* window = (const unsigned int*)file.MapRange(indexStart + sizeof(unsigned int) * (size_t)first, sizeof(unsigned int) * (size_t)count);
+		if (!window)
+			return fail();
+
+		const void* data = window;
+		if (indexFormat == DXGI_FORMAT_R16_UINT)
+		{
+			shortIndices.resize(count);
+			for (int i = 0; i < count; i++)
+				shortIndices[i] = (unsigned short)window[i];
+			data = shortIndices.data();
+		}
+
+		D3D11_BOX box = { indexSize * (UINT)first, 0, 0, indexSize * (UINT)(first + count), 1, 1 };
+		immediateContext->UpdateSubresource(indexBuffer.Get(), 0, &box, data, 0, 0);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// What BindBuffers() last bound, so consecutive meshes in
+// the same GeometryPool buffers only change their offsets
+//
+// - Raw pointers are safe to compare: a bound buffer is
+//   kept alive by the input assembler, so its address
+//   can't be reused while it's still what's recorded here
+// --------------------------------------------------------
+static struct
+{
+	ID3D11DeviceContext* context;
+	ID3D11Buffer* vertexBuffer;
+	UINT stride;
+	ID3D11Buffer* indexBuffer;
+	DXGI_FORMAT indexFormat;
+} boundBuffers = {};
+
+void Mesh::ForgetBoundBuffers()
+{
+	boundBuffers = {};
+}
+
+void Mesh::BindBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, ID3D11Buffer* vertexBuffer, UINT stride)
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> ib = GetIndexBuffer();
 	UINT offset = 0;
 
-	context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	if (boundBuffers.context == context.Get() && boundBuffers.vertexBuffer == vertexBuffer && boundBuffers.stride == stride &&
+		boundBuffers.indexBuffer == ib.Get() && boundBuffers.indexFormat == indexFormat)
+		return;
+
+	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	context->IASetIndexBuffer(ib.Get(), indexFormat, 0);
+
+	boundBuffers.context = context.Get();
+	boundBuffers.vertexBuffer = vertexBuffer;
+	boundBuffers.stride = stride;
+	boundBuffers.indexBuffer = ib.Get();
+	boundBuffers.indexFormat = indexFormat;
+}
+
+void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, int lod)
+{
+	// A mesh that's still loading, or failed to, has nothing to draw
+	if (loadState != MeshLoadState::Ready)
+		return;
+
+	BindBuffers(context, GetVertexBuffer().Get(), GetVertexStride());
+
+	context->DrawIndexed(lods[lod].indexCount, GetFirstIndex() + lods[lod].indexStart, (INT)GetBaseVertex());
+}
+
+void Mesh::SetPositionsAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, int lod)
+{
+	if (loadState != MeshLoadState::Ready)
+		return;
+
+	if (!HasPositionStream())
+	{
+		SetBuffersAndDraw(context, lod);
+		return;
+	}
+
+	BindBuffers(context, GetPositionBuffer().Get(), GetPositionStride());
+
+	context->DrawIndexed(lods[lod].indexCount, GetFirstIndex() + lods[lod].indexStart, (INT)GetPositionBaseVertex());
+}
+
+void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const std::vector<unsigned int>& visibleClusters)
+{
+	if (loadState != MeshLoadState::Ready || visibleClusters.empty())
+		return;
+
+	BindBuffers(context, GetVertexBuffer().Get(), GetVertexStride());
+	UINT firstIndex = GetFirstIndex();
+	INT baseVertex = (INT)GetBaseVertex();
+
+	// Clusters are stored back to back, so runs of visible ones
+	// can go out as a single draw
+	size_t i = 0;
+	while (i < visibleClusters.size())
+	{
+		const MeshCluster& first = clusters[visibleClusters[i]];
+		UINT indexCount = first.indexCount;
+
+		for (i++; i < visibleClusters.size() && visibleClusters[i] == visibleClusters[i - 1] + 1; i++)
+			indexCount += clusters[visibleClusters[i]].indexCount;
+
+		context->DrawIndexed(indexCount, firstIndex + first.indexStart, baseVertex);
+	}
+}
+
+// Triangles whose UVs cover less area than this can't define a tangent
+#define TANGENT_MIN_UV_AREA 1e-12f
 
-	context->DrawIndexed(this->GetIndexCount(), 0, 0);
+// Meshes are only split across threads in chunks of at least this many triangles
+#define TANGENT_MIN_CHUNK_TRIANGLES (32 * 1024)
+
+// --------------------------------------------------------
+// Any unit vector perpendicular to the normal, for vertices
+// that only touch degenerate triangles (or have no normal)
+// --------------------------------------------------------
+static XMFLOAT3 FallbackTangent(XMFLOAT3 normal)
+{
+	XMVECTOR n = XMLoadFloat3(&normal);
+	XMVECTOR axis = fabsf(normal.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+
+	XMFLOAT3 tangent;
+	XMStoreFloat3(&tangent, XMVector3Normalize(axis - n * XMVector3Dot(n, axis)));
+	return tangent;
+}
+
+// --------------------------------------------------------
+// Calculates the (unnormalized) tangent of one triangle
+//
+// - Returns false for triangles with no UV area, which used
+//   to divide by zero - they contribute nothing instead
+// - With SSE the tangent is built in one register; only its
+//   x, y and z are meaningful
+// --------------------------------------------------------
+static inline bool TriangleTangent(const Vertex* verts, const unsigned int* triangle, XMVECTOR& tangent)
+{
+	const Vertex* v1 = &verts[triangle[0]];
+	const Vertex* v2 = &verts[triangle[1]];
+	const Vertex* v3 = &verts[triangle[2]];
+
+	// Calculate vectors relative to triangle uv's
+	float s1 = v2->uv.x - v1->uv.x;
+	float t1 = v2->uv.y - v1->uv.y;
+
+	float s2 = v3->uv.x - v1->uv.x;
+	float t2 = v3->uv.y - v1->uv.y;
+
+	float determinant = s1 * t2 - s2 * t1;
+	if (fabsf(determinant) < TANGENT_MIN_UV_AREA)
+		return false;
+
+	float r = 1.0f / determinant;
+
+#if defined(_XM_SSE_INTRINSICS_)
+	// Position is followed by the normal in Vertex, so loading
+	// four floats never reads past the end of the vertex
+	__m128 p1 = _mm_loadu_ps(&v1->Position.x);
+	__m128 edge1 = _mm_sub_ps(_mm_loadu_ps(&v2->Position.x), p1);
+	__m128 edge2 = _mm_sub_ps(_mm_loadu_ps(&v3->Position.x), p1);
+
+	tangent = _mm_mul_ps(
+		_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(t2), edge1), _mm_mul_ps(_mm_set1_ps(t1), edge2)),
+		_mm_set1_ps(r));
+#else
+	// Calculate vectors relative to triangle positions
+	float x1 = v2->Position.x - v1->Position.x;
+	float y1 = v2->Position.y - v1->Position.y;
+	float z1 = v2->Position.z - v1->Position.z;
+
+	float x2 = v3->Position.x - v1->Position.x;
+	float y2 = v3->Position.y - v1->Position.y;
+	float z2 = v3->Position.z - v1->Position.z;
+
+	tangent = XMVectorSet(
+		(t2 * x1 - t1 * x2) * r,
+		(t2 * y1 - t1 * y2) * r,
+		(t2 * z1 - t1 * z2) * r,
+		0.0f);
+#endif
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Gram-Schmidt orthonormalizes the summed tangents of the
+// vertices in [begin, end) against their normals
+//
+// - With SSE, four vertices are handled at a time, transposed
+//   so each register holds one axis.  Groups start at begin,
+//   so callers splitting the work keep begin a multiple of 4
+// --------------------------------------------------------
+static void OrthonormalizeTangents(Vertex* verts, const XMFLOAT4A* sums, int begin, int end)
+{
+	int i = begin;
+
+#if defined(_XM_SSE_INTRINSICS_)
+	for (; i + 4 <= end; i += 4)
+	{
+		Vertex* v = &verts[i];
+
+		// The normal is followed by the uv, so these loads stay inside each vertex
+		__m128 nx = _mm_loadu_ps(&v[0].normal.x);
+		__m128 ny = _mm_loadu_ps(&v[1].normal.x);
+		__m128 nz = _mm_loadu_ps(&v[2].normal.x);
+		__m128 nw = _mm_loadu_ps(&v[3].normal.x);
+		_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+
+		__m128 tx = _mm_load_ps(&sums[i].x);
+		__m128 ty = _mm_load_ps(&sums[i + 1].x);
+		__m128 tz = _mm_load_ps(&sums[i + 2].x);
+		__m128 tw = _mm_load_ps(&sums[i + 3].x);
+		_MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+
+		// Use Gram-Schmidt orthonormalize to ensure
+		// the normal and tangent are exactly 90 degrees apart
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, tx), _mm_mul_ps(ny, ty)), _mm_mul_ps(nz, tz));
+		tx = _mm_sub_ps(tx, _mm_mul_ps(nx, dot));
+		ty = _mm_sub_ps(ty, _mm_mul_ps(ny, dot));
+		tz = _mm_sub_ps(tz, _mm_mul_ps(nz, dot));
+
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz)));
+		int validLanes = _mm_movemask_ps(_mm_cmpgt_ps(length, _mm_setzero_ps()));
+
+		tx = _mm_div_ps(tx, length);
+		ty = _mm_div_ps(ty, length);
+		tz = _mm_div_ps(tz, length);
+		tw = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+
+		// Store the tangents (exactly 3 floats each)
+		__m128 tangents[4] = { tx, ty, tz, tw };
+		for (int k = 0; k < 4; k++)
+		{
+			if (validLanes & (1 << k))
+			{
+				_mm_storel_pi((__m64*)&v[k].tangent.x, tangents[k]);
+				_mm_store_ss(&v[k].tangent.z, _mm_movehl_ps(tangents[k], tangents[k]));
+			}
+			else
+				v[k].tangent = FallbackTangent(v[k].normal);
+		}
+	}
+#endif
+
+	for (; i < end; i++)
+	{
+		// Grab the two vectors
+		XMVECTOR normal = XMLoadFloat3(&verts[i].normal);
+		XMVECTOR tangent = XMLoadFloat4A(&sums[i]);
+
+		// Use Gram-Schmidt orthonormalize to ensure
+		// the normal and tangent are exactly 90 degrees apart
+		tangent = tangent - normal * XMVector3Dot(normal, tangent);
+
+		// Store the tangent
+		if (XMVectorGetX(XMVector3LengthSq(tangent)) > 0.0f)
+			XMStoreFloat3(&verts[i].tangent, XMVector3Normalize(tangent));
+		else
+			verts[i].tangent = FallbackTangent(verts[i].normal);
+	}
 }
 
 // --------------------------------------------------------
@@ -303,76 +1223,89 @@ void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context
 //         contain an XMFLOAT3 called Tangent
 //
 // - Be sure to call this BEFORE creating your D3D vertex/index buffers
+//
+// - Large meshes are split across threads by vertex, not by
+//   triangle: each thread walks every triangle but only adds
+//   into the vertices it owns, so nothing is shared and each
+//   vertex sees the same additions in the same order as the
+//   single-threaded loop - the results are identical no
+//   matter how many threads are used
 // --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices, int threadCount)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].tangent = XMFLOAT3(0, 0, 0);
-	}
+	int numTriangles = numIndices / 3;
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->uv.x - v1->uv.x;
-		float t1 = v2->uv.y - v1->uv.y;
-
-		float s2 = v3->uv.x - v1->uv.x;
-		float t2 = v3->uv.y - v1->uv.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->tangent.x += tx;
-		v1->tangent.y += ty;
-		v1->tangent.z += tz;
-
-		v2->tangent.x += tx;
-		v2->tangent.y += ty;
-		v2->tangent.z += tz;
-
-		v3->tangent.x += tx;
-		v3->tangent.y += ty;
-		v3->tangent.z += tz;
-	}
+	// Tangents are summed in aligned 4-float slots (starting at zero),
+	// so a triangle can update each of its vertices with one add
+	std::vector<XMFLOAT4A> sums(numVerts, XMFLOAT4A(0, 0, 0, 0));
 
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
+	// Small meshes aren't worth splitting up, and every extra thread
+	// has to walk the whole index list
+	if (threadCount <= 0)
+		threadCount = GetDefaultThreadCount();
+	int chunkCount = std::max(1, std::min(numTriangles / TANGENT_MIN_CHUNK_TRIANGLES, threadCount));
+
+	if (chunkCount == 1)
 	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].tangent);
+		// Calculate tangents one whole triangle at a time
+		for (int t = 0; t < numTriangles; t++)
+		{
+			XMVECTOR tangent;
+			if (!TriangleTangent(verts, &indices[t * 3], tangent))
+				continue;
 
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
+			// Adjust tangents of each vert of the triangle
+			for (int c = 0; c < 3; c++)
+			{
+				XMFLOAT4A* sum = &sums[indices[t * 3 + c]];
+				XMStoreFloat4A(sum, XMVectorAdd(XMLoadFloat4A(sum), tangent));
+			}
+		}
 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].tangent, tangent);
+		OrthonormalizeTangents(verts, sums.data(), 0, numVerts);
+		return;
 	}
-}
\ No newline at end of file
+
+	// Ranges are a multiple of 4 vertices so the SIMD groups in
+	// OrthonormalizeTangents() don't change with the thread count
+	int verticesPerChunk = ((numVerts + chunkCount - 1) / chunkCount + 3) & ~3;
+
+	ParallelFor(chunkCount, [&](int chunk)
+	{
+		int begin = chunk * verticesPerChunk;
+		int end = std::min(begin + verticesPerChunk, numVerts);
+		if (begin >= end)
+			return;
+
+		// Same as above, skipping triangles that don't touch this range
+		unsigned int count = (unsigned int)(end - begin);
+		for (int t = 0; t < numTriangles; t++)
+		{
+			const unsigned int* triangle = &indices[t * 3];
+			bool owned[3] =
+			{
+				triangle[0] - begin < count,
+				triangle[1] - begin < count,
+				triangle[2] - begin < count
+			};
+			if (!owned[0] && !owned[1] && !owned[2])
+				continue;
+
+			XMVECTOR tangent;
+			if (!TriangleTangent(verts, triangle, tangent))
+				continue;
+
+			// Adjust tangents of each (owned) vert of the triangle
+			for (int c = 0; c < 3; c++)
+			{
+				if (owned[c])
+				{
+					XMFLOAT4A* sum = &sums[triangle[c]];
+					XMStoreFloat4A(sum, XMVectorAdd(XMLoadFloat4A(sum), tangent));
+				}
+			}
+		}
+
+		OrthonormalizeTangents(verts, sums.data(), begin, end);
+	}, threadCount);
+}
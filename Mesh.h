@@ -3,44 +3,220 @@
 #include <d3d11.h> //Used for Direct3D "stuff"
 #include <wrl/client.h> //Used for ComPtr
 #include "Vertex.h" //Used for custom Vertex struct
-#include <fstream>
+#include "MeshOptimizer.h" //Used for VertexCacheStats
+#include "PackedVertex.h" //Used for the compact vertex format
+#include "MeshSimplifier.h" //Used for MeshLod
+#include "MeshClusters.h" //Used for MeshCluster
+#include "Bounds.h" //Used for the mesh's bounding box and sphere
+#include "GeometryPool.h" //Used for sharing buffers between meshes
+#include <string>
+#include <vector>
+#include <memory>
+
+class MeshCacheFile;
+
+// A LOD is only used while its simplification error covers less than this many pixels
+#define MESH_LOD_MAX_PIXEL_ERROR 1.0f
+
+// OBJ files at least this big are cooked a window of the file at a time, which
+// keeps memory use down (only a few bytes per vertex are kept, to weld windows
+// together) but skips LODs (those need the whole mesh at once)
+#define MESH_STREAMING_IMPORT_BYTES (512ull * 1024 * 1024)
+#define MESH_STREAMING_WINDOW_BYTES (32 * 1024 * 1024)
+
+// Numbers recorded while importing a mesh from disk, shown in the
+// debug console so loader changes can be measured
+struct MeshImportStats
+{
+	size_t fileBytes; //size of the file that was read (the OBJ or its cooked cache)
+	double loadMilliseconds; //time spent producing the final vertices and indices
+	double tangentMilliseconds; //part of loadMilliseconds spent in CalculateTangents (0 when cached)
+	size_t unweldedVertexCount; //vertices needed if every triangle corner was stored separately
+	size_t vertexCount; //unique vertices after welding identical corners
+	bool loadedFromCache; //true if a cooked .meshbin was used instead of the OBJ
+	bool streamed; //true if the OBJ was too big to import in one go and was cooked a window at a time
+	size_t peakMemoryBytes; //peak working set of the whole process once the import had finished
+	VertexCacheStats cacheBefore; //vertex cache efficiency of the index buffer as it came out of the file
+	VertexCacheStats cacheAfter; //vertex cache efficiency after the optimization passes
+	MeshClusterFill clusterFill; //how full the clusters are, if the mesh was split into them
+};
+
+// Where a mesh has got to in loading - only Ready meshes can be drawn
+enum class MeshLoadState
+{
+	Loading, //still being imported on another thread (see MeshLoader)
+	Ready, //has its buffers
+	Failed //the file couldn't be read or the buffers couldn't be created
+};
 
 class Mesh
 {
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer; //vertex buffer of this mesh
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer; //index buffer of this mesh
+	std::shared_ptr<GeometryPool> geometryPool; //holds the vertices and indices instead, when set
+	int geometryAllocation; //this mesh's allocation in geometryPool (-1 when it has its own buffers)
+	Microsoft::WRL::ComPtr<ID3D11Buffer> positionBuffer; //just the positions, for depth-only passes (null unless asked for)
+	int positionAllocation; //the positions' allocation in geometryPool (-1 when they're in positionBuffer, or missing)
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context; //used for issuing draw commands
-	int meshBufferIndices; //specifies how many indices are in the mesh's index buffer, used when drawing
+	int meshBufferIndices; //specifies how many indices the full-detail mesh uses, used when drawing
+	std::vector<MeshLod> lods; //the index ranges of every level of detail, from full detail down
+	std::vector<MeshCluster> clusters; //the full-detail mesh split into cullable pieces (empty if it wasn't)
+	DXGI_FORMAT indexFormat; //R16_UINT when every vertex fits in 16 bits, R32_UINT otherwise
+	MeshVertexFormat vertexFormat; //whether the vertex buffer holds Vertex or PackedVertex
+	DirectX::XMFLOAT3 positionOffset; //packed positions are positionOffset + position * positionScale
+	DirectX::XMFLOAT3 positionScale;
+	Bounds bounds; //box and sphere around every vertex, in the mesh's own space
+	MeshImportStats importStats; //filled in by the file-loading constructor
+	MeshLoadState loadState; //only ever changed on the main thread
+	std::shared_ptr<Mesh> placeholder; //drawn instead of this mesh while it's loading (may be null)
+
+	//what Import() read, waiting for CreateBuffers() to hand it to D3D (released once it has)
+	std::vector<Vertex> pendingVertices;
+	std::vector<unsigned int> pendingIndices;
+	std::shared_ptr<MeshCacheFile> pendingCache; //a cooked cache, whose mapped arrays go to D3D without copies
+	std::wstring pendingWindowedCache; //set when pendingCache is too big for that and is copied a window at a time
+
+	//true once the vertices and indices are on the GPU, in either the pool or the mesh's own buffers
+	bool HasBuffers();
+
+	//binds a vertex buffer and the index buffer, unless they're what was bound last
+	void BindBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, ID3D11Buffer* vertexBuffer, UINT stride);
+
+	//copies the positions out of the vertex buffer's data into a stream of their own
+	void ConstructPositionStream(const void* vertexData, int numVertices, Microsoft::WRL::ComPtr<ID3D11Device> device, std::shared_ptr<GeometryPool> pool);
 
 public:
 	//A constructor that creates the two buffers from the appropriate arrays.
 	//You should copy, paste, and adjust the code from the CreateBasicGeometry()
 	//method as necessary
-	Mesh(Vertex vertices[], int numVertices, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> devContext);
+	Mesh(Vertex vertices[], int numVertices, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> devContext,
+		MeshVertexFormat vertexFormat = MeshVertexFormat::Full);
 	
-	Mesh(const std::wstring& fileName, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	//buildClusters splits the full-detail mesh into clusters that can be culled individually
+	Mesh(const std::wstring& fileName, Microsoft::WRL::ComPtr<ID3D11Device> device, MeshVertexFormat vertexFormat = MeshVertexFormat::Full, bool buildClusters = false);
+
+	//An empty mesh that's still Loading, for Import() and CreateBuffers() to fill in later
+	Mesh(MeshVertexFormat vertexFormat, std::shared_ptr<Mesh> placeholder);
 
 	//Since we're using smart pointers, your destructor won't have much to do (it'll be empty)
 	//Properly cleaning up Direct3D objects is your responsibility
 	//Smart pointers will do this for you if you're using them correctly
 	~Mesh();
 
+	//reads and processes a model file (or its cache) without touching D3D, so it can run on
+	//any thread; returns false if there's nothing to create buffers from
+	bool Import(const std::wstring& fileName, bool buildClusters);
+
+	//writes an OBJ's cache without ever holding all of it in memory, returning false on failure
+	//(Import() does this for big files; windowBytes is only smaller in tests)
+	bool CookObjInWindows(const std::wstring& fileName, const std::wstring& cacheFileName, bool buildClusters,
+		size_t windowBytes = MESH_STREAMING_WINDOW_BYTES);
+
+	//creates the buffers from what Import() read and moves the mesh to Ready (or Failed),
+	//which only the main thread may do; returns true if the mesh is now Ready
+	//(with a pool, the mesh is sub-allocated out of its buffers instead, unless it's too
+	//big to import in one go; positionStream also keeps the positions on their own for
+	//SetPositionsAndDraw())
+	bool CreateBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, std::shared_ptr<GeometryPool> pool = nullptr, bool positionStream = false);
+
+	//returns how far the mesh has got in loading
+	MeshLoadState GetLoadState();
+
+	//returns the mesh to draw in place of this one while it's loading (may be null)
+	std::shared_ptr<Mesh> GetPlaceholder();
+
 	//method to return the pointer to the vertex buffer object
+	//(a pool's shared buffer for pooled meshes, so draws need GetBaseVertex() too)
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 
 	//method to return the pointer for the index buffer object
+	//(a pool's shared buffer for pooled meshes, so draws need GetFirstIndex() too)
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 
+	//returns where the mesh's vertices and indices start in its buffers (0 unless it's pooled)
+	UINT GetBaseVertex();
+	UINT GetFirstIndex();
+
+	//returns true if the positions were also kept in a stream of their own
+	bool HasPositionStream();
+
+	//returns the buffer holding the position stream (null without one) and where it starts in it
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetPositionBuffer();
+	UINT GetPositionBaseVertex();
+
+	//returns the size of one position in the stream - a float3 for full meshes, or
+	//the same four 16-bit values PackedVertex starts with for packed ones
+	UINT GetPositionStride();
+
 	//returns the number of indices the mesh contains
 	int GetIndexCount(); 
 
+	//returns how many levels of detail the mesh has (always at least one, the full-detail mesh)
+	int GetLodCount();
+
+	//returns the index range and error of one level of detail
+	const MeshLod& GetLod(int lod);
+
+	//returns the coarsest level of detail that still looks right when one unit
+	//of the model covers pixelsPerUnit pixels on screen
+	int SelectLod(float pixelsPerUnit);
+
+	//returns how many clusters the full-detail mesh was split into (0 if it wasn't)
+	int GetClusterCount();
+
+	//returns the index range and bounds of one cluster
+	const MeshCluster& GetCluster(int cluster);
+
+	//lists the clusters that might be visible, given world * view * projection
+	//and the camera's position in the mesh's own space
+	void CullClusters(const DirectX::XMFLOAT4X4& worldViewProjection, DirectX::XMFLOAT3 cameraPosition, std::vector<unsigned int>& visibleClusters);
+
+	//returns the format the index buffer was created with, needed when binding it
+	DXGI_FORMAT GetIndexFormat();
+
+	//returns the layout of the vertex buffer, which decides the vertex shader that can draw it
+	MeshVertexFormat GetVertexFormat();
+
+	//returns the size of one vertex in the vertex buffer
+	UINT GetVertexStride();
+
+	//returns what packed vertex shaders need to decode positions (identity for full vertices)
+	DirectX::XMFLOAT3 GetPositionOffset();
+	DirectX::XMFLOAT3 GetPositionScale();
+
+	//returns the box and sphere around the mesh, in its own space
+	const Bounds& GetBounds();
+
+	//returns the timings and sizes recorded while importing the mesh
+	const MeshImportStats& GetImportStats();
+
 	//sets the buffers and tells DirectX to draw the correct number of indices
 	void Draw(); 
 
-	void ConstructBuffers(Vertex vertices[], int numVertices, unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	//sub-allocates out of pool when one is given, falling back to the mesh's own buffers if that fails
+	void ConstructBuffers(const Vertex vertices[], int numVertices, const unsigned int indices[], int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device,
+		std::shared_ptr<GeometryPool> pool = nullptr, bool positionStream = false);
+
+	//creates the buffers straight from a cache file, reading it a window at a time, and
+	//returns false (leaving no buffers) if they couldn't be created or completely filled
+	bool ConstructBuffersInWindows(const std::wstring& cacheFileName, int numVertices, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device,
+		bool positionStream = false);
+
+	//draws one level of detail (nothing unless the mesh is Ready)
+	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, int lod = 0);
+
+	//draws only the given clusters (in increasing order) of the full-detail mesh
+	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const std::vector<unsigned int>& visibleClusters);
+
+	//draws one level of detail from the position stream, for depth-only passes whose vertex
+	//shaders read nothing but POSITION (falls back to the full vertices without a stream)
+	void SetPositionsAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, int lod = 0);
 
-	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	//forgets which buffers SetBuffersAndDraw() bound last, so the next draw binds its own -
+	//call whenever something else may have changed the input assembler's buffers
+	static void ForgetBoundBuffers();
 
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	//a threadCount of 0 uses every core for large meshes - the output is the same either way
+	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices, int threadCount = 0);
 };
\ No newline at end of file
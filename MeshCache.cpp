@@ -0,0 +1,410 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <cstddef>
+#include <climits>
+#include <vector>
+
+// Size and last write time of a file, used as a cheap staleness check
+struct SourceFileInfo
+{
+	unsigned long long size;
+	unsigned long long writeTime;
+};
+
+static bool GetSourceFileInfo(const std::wstring& fileName, SourceFileInfo& info)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+	if (!GetFileAttributesExW(fileName.c_str(), GetFileExInfoStandard, &attributes))
+		return false;
+
+	info.size = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	info.writeTime =
+		((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+		attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+// --------------------------------------------------------
+// 64-bit FNV-1a hash of a file's contents
+//
+// - Only needed when the write time of a source file has
+//   changed, e.g. after a fresh checkout, so that identical
+//   content can still use the existing cache
+// - The file is mapped a window at a time, so hashing a huge
+//   source doesn't pull all of it into memory
+// --------------------------------------------------------
+static unsigned long long HashFileContents(const std::wstring& fileName)
+{
+	unsigned long long hash = 14695981039346656037ull;
+
+	MemoryMappedFile file(fileName, false);
+	for (size_t offset = 0; offset < file.GetSize(); offset += MESH_CACHE_WINDOW_BYTES)
+	{
+		const unsigned char* data = (const unsigned char*)file.MapRange(offset, MESH_CACHE_WINDOW_BYTES);
+		if (!data)
+			break;
+
+		size_t length = file.GetSize() - offset < MESH_CACHE_WINDOW_BYTES ? file.GetSize() - offset : MESH_CACHE_WINDOW_BYTES;
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	return hash;
+}
+
+MeshCacheFile::MeshCacheFile(const std::wstring& cacheFileName, const std::wstring& sourceFileName) :
+	file(cacheFileName),
+	header(0),
+	cacheFileName(cacheFileName),
+	refreshedWriteTime(0)
+{
+	// Is there enough data for the header?
+	if (file.GetSize() < sizeof(MeshCacheHeader))
+		return;
+
+	const MeshCacheHeader* candidate = (const MeshCacheHeader*)file.GetData();
+	if (memcmp(candidate->magic, "MBIN", 4) != 0 ||
+		candidate->version != MESH_CACHE_VERSION ||
+		candidate->vertexStride != sizeof(Vertex) ||
+		candidate->lodCount == 0)
+		return;
+
+	// A partially written file is never valid
+	unsigned long long expectedSize = sizeof(MeshCacheHeader) +
+		(unsigned long long)candidate->vertexCount * sizeof(Vertex) +
+		(unsigned long long)candidate->indexCount * sizeof(unsigned int) +
+		(unsigned long long)candidate->lodCount * sizeof(MeshLod) +
+		(unsigned long long)candidate->clusterCount * sizeof(MeshCluster);
+	if (file.GetSize() != expectedSize)
+		return;
+
+	// Make sure the source hasn't changed since this was cooked
+	SourceFileInfo source = {};
+	if (!GetSourceFileInfo(sourceFileName, source) || source.size != candidate->sourceSize)
+		return;
+	if (source.writeTime != candidate->sourceWriteTime)
+	{
+		if (HashFileContents(sourceFileName) != candidate->sourceHash)
+			return;
+
+		refreshedWriteTime = source.writeTime;
+	}
+
+	header = candidate;
+}
+
+MeshCacheFile::~MeshCacheFile()
+{
+	if (!refreshedWriteTime)
+		return;
+
+	// The header can only be written once the cache isn't mapped.  If it's open
+	// anywhere else this fails, and whichever load is last to finish tries again
+	file.Close();
+	HANDLE cache = CreateFileW(cacheFileName.c_str(), GENERIC_WRITE, 0, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (cache == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER offset = {};
+	offset.QuadPart = offsetof(MeshCacheHeader, sourceWriteTime);
+	DWORD written = 0;
+	if (SetFilePointerEx(cache, offset, 0, FILE_BEGIN))
+		WriteFile(cache, &refreshedWriteTime, sizeof(refreshedWriteTime), &written, 0);
+	CloseHandle(cache);
+}
+
+bool MeshCacheFile::IsValid() { return header != 0; }
+
+size_t MeshCacheFile::GetFileSize() { return file.GetSize(); }
+
+const MeshCacheHeader* MeshCacheFile::GetHeader() { return header; }
+
+const Vertex* MeshCacheFile::GetVertices()
+{
+	return header ? (const Vertex*)(file.GetData() + sizeof(MeshCacheHeader)) : 0;
+}
+
+const unsigned int* MeshCacheFile::GetIndices()
+{
+	return header ? (const unsigned int*)(GetVertices() + header->vertexCount) : 0;
+}
+
+const MeshLod* MeshCacheFile::GetLods()
+{
+	return header ? (const MeshLod*)(GetIndices() + header->indexCount) : 0;
+}
+
+const MeshCluster* MeshCacheFile::GetClusters()
+{
+	return header ? (const MeshCluster*)(GetLods() + header->lodCount) : 0;
+}
+
+std::wstring GetMeshCachePath(const std::wstring& sourceFileName)
+{
+	// Swap the extension (if there is one) for .meshbin
+	size_t dot = sourceFileName.find_last_of(L'.');
+	size_t slash = sourceFileName.find_last_of(L"\\/");
+	if (dot == std::wstring::npos || (slash != std::wstring::npos && dot < slash))
+		return sourceFileName + L".meshbin";
+
+	return sourceFileName.substr(0, dot) + L".meshbin";
+}
+
+// --------------------------------------------------------
+// Fills in everything but the magic, which is only written
+// once the rest of the file is known to be complete
+// --------------------------------------------------------
+static bool FillCacheHeader(MeshCacheHeader& header, const std::wstring& sourceFileName, unsigned int vertexCount,
+	unsigned int indexCount, unsigned int lodCount, unsigned int clusterCount, const Bounds& bounds)
+{
+	SourceFileInfo source = {};
+	if (!GetSourceFileInfo(sourceFileName, source))
+		return false;
+
+	header = {};
+	header.version = MESH_CACHE_VERSION;
+	header.sourceSize = source.size;
+	header.sourceWriteTime = source.writeTime;
+	header.sourceHash = HashFileContents(sourceFileName);
+	header.vertexStride = sizeof(Vertex);
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.lodCount = lodCount;
+	header.clusterCount = clusterCount;
+	header.bounds = bounds;
+	return true;
+}
+
+// Writes a block of any size, in pieces small enough for WriteFile
+static bool WriteBlock(HANDLE file, const void* data, size_t bytes)
+{
+	const char* p = (const char*)data;
+	while (bytes > 0)
+	{
+		DWORD piece = (DWORD)(bytes < MESH_CACHE_WINDOW_BYTES ? bytes : MESH_CACHE_WINDOW_BYTES);
+		DWORD written = 0;
+		if (!WriteFile(file, p, piece, &written, 0) || written != piece)
+			return false;
+
+		p += piece;
+		bytes -= piece;
+	}
+
+	return true;
+}
+
+// Reads a block of any size, in pieces small enough for ReadFile
+static bool ReadBlock(HANDLE file, void* data, size_t bytes)
+{
+	char* p = (char*)data;
+	while (bytes > 0)
+	{
+		DWORD piece = (DWORD)(bytes < MESH_CACHE_WINDOW_BYTES ? bytes : MESH_CACHE_WINDOW_BYTES);
+		DWORD read = 0;
+		if (!ReadFile(file, p, piece, &read, 0) || read != piece)
+			return false;
+
+		p += piece;
+		bytes -= piece;
+	}
+
+	return true;
+}
+
+// Where a cache is written before being moved into place
+static std::wstring GetTemporaryCachePath(const std::wstring& cacheFileName)
+{
+	return cacheFileName + L".tmp";
+}
+
+// --------------------------------------------------------
+// Moves a completely written temporary file over the cache
+// (replacing any old one), or deletes it if writing failed
+//
+// - The cache itself is never open for writing, so a crash
+//   or a reader part way through a write only ever sees the
+//   old cache or the new one, never half of one (the only
+//   exception is MeshCacheFile refreshing the source's write
+//   time, where a bad write only means hashing it again)
+// --------------------------------------------------------
+static bool ReplaceCacheFile(const std::wstring& temporaryFileName, const std::wstring& cacheFileName, bool written)
+{
+	if (written && MoveFileExW(temporaryFileName.c_str(), cacheFileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+		return true;
+
+	DeleteFileW(temporaryFileName.c_str());
+	return false;
+}
+
+bool WriteMeshCache(const std::wstring& cacheFileName, const std::wstring& sourceFileName,
+	const Vertex* vertices, int numVertices, const unsigned int* indices, int numIndices,
+	const MeshLod* lods, int numLods, const MeshCluster* clusters, int numClusters, const Bounds& bounds)
+{
+	MeshCacheHeader header;
+	if (!FillCacheHeader(header, sourceFileName, (unsigned int)numVertices, (unsigned int)numIndices,
+		(unsigned int)numLods, (unsigned int)numClusters, bounds))
+		return false;
+	memcpy(header.magic, "MBIN", 4);
+
+	std::wstring temporaryFileName = GetTemporaryCachePath(cacheFileName);
+	HANDLE file = CreateFileW(temporaryFileName.c_str(), GENERIC_WRITE, 0, 0,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Header, vertices, indices, LODs, then clusters - exactly what the reader expects
+	const void* blocks[5] = { &header, vertices, indices, lods, clusters };
+	size_t blockSizes[5] =
+	{
+		sizeof(header),
+		sizeof(Vertex) * (size_t)numVertices,
+		sizeof(unsigned int) * (size_t)numIndices,
+		sizeof(MeshLod) * (size_t)numLods,
+		sizeof(MeshCluster) * (size_t)numClusters
+	};
+
+	bool success = true;
+	for (int i = 0; i < 5 && success; i++)
+		success = WriteBlock(file, blocks[i], blockSizes[i]);
+
+	CloseHandle(file);
+	return ReplaceCacheFile(temporaryFileName, cacheFileName, success);
+}
+
+MeshCacheWriter::MeshCacheWriter(const std::wstring& cacheFileName, const std::wstring& sourceFileName) :
+	cacheFileName(cacheFileName),
+	sourceFileName(sourceFileName),
+	temporaryFileName(GetTemporaryCachePath(cacheFileName)),
+	indexFileName(cacheFileName + L".indices"),
+	cacheFile(INVALID_HANDLE_VALUE),
+	indexFile(INVALID_HANDLE_VALUE),
+	vertexCount(0),
+	indexCount(0),
+	failed(false),
+	finished(false)
+{
+	cacheFile = CreateFileW(temporaryFileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	indexFile = CreateFileW(indexFileName.c_str(), GENERIC_WRITE, 0, 0,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+
+	// Leave room for the header, which is zeroed (and so invalid) until Finish()
+	MeshCacheHeader header = {};
+	failed = cacheFile == INVALID_HANDLE_VALUE || indexFile == INVALID_HANDLE_VALUE ||
+		!WriteBlock(cacheFile, &header, sizeof(header));
+}
+
+MeshCacheWriter::~MeshCacheWriter()
+{
+	if (indexFile != INVALID_HANDLE_VALUE)
+		CloseHandle(indexFile);
+	if (cacheFile != INVALID_HANDLE_VALUE)
+		CloseHandle(cacheFile);
+
+	// Whatever happened, the indices aren't needed anymore, and
+	// an unfinished cache is never left behind
+	DeleteFileW(indexFileName.c_str());
+	if (!finished)
+		DeleteFileW(temporaryFileName.c_str());
+}
+
+unsigned int MeshCacheWriter::GetVertexCount() { return (unsigned int)vertexCount; }
+
+bool MeshCacheWriter::AddVertices(const Vertex* vertices, int numVertices)
+{
+	// The header can only count this many of either
+	if (vertexCount + numVertices > UINT_MAX)
+		failed = true;
+
+	failed = failed || !WriteBlock(cacheFile, vertices, sizeof(Vertex) * (size_t)numVertices);
+	vertexCount += numVertices;
+	return !failed;
+}
+
+bool MeshCacheWriter::AddIndices(const unsigned int* indices, int numIndices)
+{
+	if (indexCount + numIndices > UINT_MAX)
+		failed = true;
+
+	failed = failed || !WriteBlock(indexFile, indices, sizeof(unsigned int) * (size_t)numIndices);
+	indexCount += numIndices;
+	return !failed;
+}
+
+bool MeshCacheWriter::UpdateVertices(const std::function<void(Vertex* vertices, unsigned int firstVertex, int numVertices)>& update)
+{
+	// Each window goes back exactly where it was read from
+	std::vector<Vertex> window;
+	unsigned long long verticesPerWindow = MESH_CACHE_WINDOW_BYTES / sizeof(Vertex);
+	for (unsigned long long first = 0; first < vertexCount && !failed; first += verticesPerWindow)
+	{
+		int count = (int)(vertexCount - first < verticesPerWindow ? vertexCount - first : verticesPerWindow);
+		window.resize(count);
+
+		LARGE_INTEGER offset = {};
+		offset.QuadPart = sizeof(MeshCacheHeader) + first * sizeof(Vertex);
+		failed = !SetFilePointerEx(cacheFile, offset, 0, FILE_BEGIN) ||
+			!ReadBlock(cacheFile, window.data(), sizeof(Vertex) * (size_t)count);
+		if (failed)
+			break;
+
+		update(window.data(), (unsigned int)first, count);
+		failed = !SetFilePointerEx(cacheFile, offset, 0, FILE_BEGIN) ||
+			!WriteBlock(cacheFile, window.data(), sizeof(Vertex) * (size_t)count);
+	}
+
+	// Anything added afterwards still goes on the end
+	LARGE_INTEGER end = {};
+	failed = failed || !SetFilePointerEx(cacheFile, end, 0, FILE_END);
+	return !failed;
+}
+
+bool MeshCacheWriter::Finish(const MeshLod* lods, int numLods, const MeshCluster* clusters, int numClusters, const Bounds& bounds)
+{
+	if (failed)
+		return false;
+
+	// The indices can only be read back once nothing is writing to them
+	CloseHandle(indexFile);
+	indexFile = INVALID_HANDLE_VALUE;
+
+	MemoryMappedFile indexData(indexFileName, false);
+	size_t indexBytes = sizeof(unsigned int) * (size_t)indexCount;
+	failed = indexData.GetSize() != indexBytes;
+	for (size_t offset = 0; offset < indexBytes && !failed; offset += MESH_CACHE_WINDOW_BYTES)
+	{
+		size_t length = indexBytes - offset < MESH_CACHE_WINDOW_BYTES ? indexBytes - offset : MESH_CACHE_WINDOW_BYTES;
+		const char* data = indexData.MapRange(offset, length);
+		failed = !data || !WriteBlock(cacheFile, data, length);
+	}
+
+	failed = failed ||
+		!WriteBlock(cacheFile, lods, sizeof(MeshLod) * (size_t)numLods) ||
+		!WriteBlock(cacheFile, clusters, sizeof(MeshCluster) * (size_t)numClusters);
+
+	// Everything's in place, so the real header makes the file valid...
+	MeshCacheHeader header;
+	LARGE_INTEGER start = {};
+	failed = failed ||
+		!FillCacheHeader(header, sourceFileName, (unsigned int)vertexCount, (unsigned int)indexCount,
+			(unsigned int)numLods, (unsigned int)numClusters, bounds) ||
+		!SetFilePointerEx(cacheFile, start, 0, FILE_BEGIN);
+	if (!failed)
+	{
+		memcpy(header.magic, "MBIN", 4);
+		failed = !WriteBlock(cacheFile, &header, sizeof(header));
+	}
+
+	// ...and it can only be moved into place once it's closed
+	CloseHandle(cacheFile);
+	cacheFile = INVALID_HANDLE_VALUE;
+
+	finished = ReplaceCacheFile(temporaryFileName, cacheFileName, !failed);
+	failed = !finished;
+	return finished;
+}
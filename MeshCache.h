@@ -0,0 +1,137 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <functional>
+#include "Vertex.h"
+#include "MeshSimplifier.h"
+#include "MeshClusters.h"
+#include "Bounds.h"
+#include "MemoryMappedFile.h"
+
+// Bump this whenever the layout of a cache file (or of Vertex) changes,
+// or the import pipeline starts producing different vertices/indices
+#define MESH_CACHE_VERSION 6
+
+// Large files are read and copied in pieces of this size
+#define MESH_CACHE_WINDOW_BYTES (64 * 1024 * 1024)
+
+// --------------------------------------------------------
+// The header at the start of every .meshbin file
+//
+// - The vertex array immediately follows the header, then
+//   the index array, so both can be handed to D3D directly
+//   from a memory mapping of the file
+// - The index array holds every LOD one after the other,
+//   followed by the table of LODs and then the table of
+//   clusters (which is empty unless they were built)
+// - The source file's size, write time and content hash are
+//   recorded so stale caches can be detected
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char magic[4];				// Always "MBIN"
+	unsigned int version;		// MESH_CACHE_VERSION when written
+	unsigned long long sourceSize;
+	unsigned long long sourceWriteTime;
+	unsigned long long sourceHash;
+	unsigned int vertexStride;	// sizeof(Vertex) when written
+	unsigned int vertexCount;
+	unsigned int indexCount;	// Across all LODs
+	unsigned int lodCount;
+	unsigned int clusterCount;
+	unsigned int padding;
+	Bounds bounds;				// Around every vertex
+};
+
+// --------------------------------------------------------
+// A read-only, memory-mapped view of a cooked mesh
+//
+// - IsValid() is only true if the cache exists, is complete
+//   and was built from the current version of the source
+// - The returned pointers point into the mapping itself and
+//   are only usable while this object is alive
+// - A source whose write time changed but whose contents
+//   didn't (a fresh checkout, say) has its new write time
+//   written into the header once the mapping is released,
+//   so later loads don't hash it again
+// --------------------------------------------------------
+class MeshCacheFile
+{
+public:
+	MeshCacheFile(const std::wstring& cacheFileName, const std::wstring& sourceFileName);
+	~MeshCacheFile();
+
+	bool IsValid();
+	size_t GetFileSize();
+
+	const MeshCacheHeader* GetHeader();
+	const Vertex* GetVertices();
+	const unsigned int* GetIndices();
+	const MeshLod* GetLods();
+	const MeshCluster* GetClusters();
+
+private:
+	MemoryMappedFile file;
+	const MeshCacheHeader* header;
+	std::wstring cacheFileName;
+	unsigned long long refreshedWriteTime; //the source's write time to put in the header, or 0 if it's current
+};
+
+// Where the cooked version of a source model lives (next to it, as .meshbin)
+std::wstring GetMeshCachePath(const std::wstring& sourceFileName);
+
+// Writes a cooked mesh for the given source file, returning false on failure (the file
+// is written beside the cache and then moved over it, so it's never seen half written)
+bool WriteMeshCache(const std::wstring& cacheFileName, const std::wstring& sourceFileName,
+	const Vertex* vertices, int numVertices, const unsigned int* indices, int numIndices,
+	const MeshLod* lods, int numLods, const MeshCluster* clusters, int numClusters, const Bounds& bounds);
+
+// --------------------------------------------------------
+// Writes a cooked mesh a piece at a time, for meshes too big
+// to hold in memory all at once
+//
+// - Vertices go into a temporary copy of the cache file and
+//   indices into another file beside it (the cache stores all
+//   of the vertices first); Finish() joins them, writes the
+//   real header and only then moves the copy over the cache
+// - Indices are stored as given, so they must already account
+//   for the vertices written before them
+// - Vertices can be changed after they're written, through
+//   UpdateVertices(), for anything that needs the whole mesh
+// - An unfinished or failed copy is deleted on destruction,
+//   leaving any previous cache as it was
+// --------------------------------------------------------
+class MeshCacheWriter
+{
+public:
+	MeshCacheWriter(const std::wstring& cacheFileName, const std::wstring& sourceFileName);
+	~MeshCacheWriter();
+
+	// The writer owns open files, so it can't be copied
+	MeshCacheWriter(MeshCacheWriter const&) = delete;
+	void operator=(MeshCacheWriter const&) = delete;
+
+	// How many vertices have been written so far
+	unsigned int GetVertexCount();
+
+	bool AddVertices(const Vertex* vertices, int numVertices);
+	bool AddIndices(const unsigned int* indices, int numIndices);
+
+	//reads back every vertex written so far, a window at a time, for update to change before
+	//they're written again (update gets the window and the index of its first vertex)
+	bool UpdateVertices(const std::function<void(Vertex* vertices, unsigned int firstVertex, int numVertices)>& update);
+	bool Finish(const MeshLod* lods, int numLods, const MeshCluster* clusters, int numClusters, const Bounds& bounds);
+
+private:
+	std::wstring cacheFileName;
+	std::wstring sourceFileName;
+	std::wstring temporaryFileName;
+	std::wstring indexFileName;
+	HANDLE cacheFile;
+	HANDLE indexFile;
+	unsigned long long vertexCount;
+	unsigned long long indexCount;
+	bool failed;
+	bool finished;
+};
@@ -0,0 +1,269 @@
+#include "MeshClusters.h"
+#include "MeshOptimizer.h"
+#include "Bounds.h"
+#include "Frustum.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// Clusters whose triangles spread further than this from the average
+// direction (dot product below it) can't be rejected as backfacing
+#define CLUSTER_MIN_CONE_DOT 0.1f
+
+// --------------------------------------------------------
+// The cone around the normals of a cluster's triangles:
+// their average direction and the sine of the widest angle
+// any of them makes with it
+// --------------------------------------------------------
+static void ClusterNormalCone(const std::vector<XMFLOAT3>& normals, XMFLOAT3& axis, float& cutoff)
+{
+	XMVECTOR sum = XMVectorZero();
+	for (size_t i = 0; i < normals.size(); i++)
+		sum += XMLoadFloat3(&normals[i]);
+
+	axis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	cutoff = 1.0f;
+
+	float length = XMVectorGetX(XMVector3Length(sum));
+	if (length <= 0.0f)
+		return;
+
+	XMVECTOR a = sum / length;
+	float minDot = 1.0f;
+	for (size_t i = 0; i < normals.size(); i++)
+		minDot = fminf(minDot, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normals[i]), a)));
+
+	XMStoreFloat3(&axis, a);
+	if (minDot > CLUSTER_MIN_CONE_DOT)
+		cutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+void BuildMeshClusters(unsigned int* indices, int numIndices, const Vertex* vertices, int numVertices, std::vector<MeshCluster>& clusters)
+{
+	clusters.clear();
+
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+		return;
+
+	// Unit normal and center of every triangle (the normal is zero for degenerate ones)
+	std::vector<XMFLOAT3> triangleNormals(numTriangles);
+	std::vector<XMFLOAT3> triangleCenters(numTriangles);
+	for (int t = 0; t < numTriangles; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+		XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+
+		float length = XMVectorGetX(XMVector3Length(normal));
+		XMStoreFloat3(&triangleNormals[t], length > 0.0f ? normal / length : XMVectorZero());
+		XMStoreFloat3(&triangleCenters[t], (p0 + p1 + p2) / 3.0f);
+	}
+
+	// Triangles around each position, so clusters can grow across seams
+	std::vector<unsigned int> positionRemap;
+	std::vector<unsigned int> twins;
+	BuildPositionRemap(vertices, numVertices, positionRemap, twins);
+
+	std::vector<unsigned int> adjacencyOffsets(numVertices + 1, 0);
+	for (int i = 0; i < numIndices; i++)
+		adjacencyOffsets[positionRemap[indices[i]] + 1]++;
+	for (int v = 0; v < numVertices; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<unsigned int> adjacency(numIndices);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (int i = 0; i < numIndices; i++)
+		adjacency[fill[positionRemap[indices[i]]]++] = i / 3;
+
+	std::vector<unsigned int> clustered;
+	clustered.reserve(numIndices);
+
+	std::vector<bool> used(numTriangles, false);
+	std::vector<int> vertexCluster(numVertices, -1);
+	std::vector<unsigned int> localIndex(numVertices);
+	std::vector<unsigned int> clusterVertices;
+	std::vector<unsigned int> localIndices;
+	std::vector<unsigned int> candidates;
+	std::vector<XMFLOAT3> clusterPoints;
+	std::vector<XMFLOAT3> clusterNormals;
+	int nextSeed = 0;
+
+	while (nextSeed < numTriangles)
+	{
+		int clusterIndex = (int)clusters.size();
+		MeshCluster cluster = {};
+		cluster.indexStart = (unsigned int)clustered.size();
+
+		clusterVertices.clear();
+		localIndices.clear();
+		candidates.clear();
+		clusterNormals.clear();
+		XMVECTOR normalSum = XMVectorZero();
+		XMVECTOR centerSum = XMVectorZero();
+
+		int triangle = nextSeed;
+		while (triangle >= 0)
+		{
+			// Add the triangle, and everything touching its new vertices as a candidate
+			used[triangle] = true;
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[triangle * 3 + c];
+				if (vertexCluster[v] != clusterIndex)
+				{
+					vertexCluster[v] = clusterIndex;
+					localIndex[v] = (unsigned int)clusterVertices.size();
+					clusterVertices.push_back(v);
+
+					unsigned int position = positionRemap[v];
+					for (unsigned int a = adjacencyOffsets[position]; a < adjacencyOffsets[position + 1]; a++)
+					{
+						if (!used[adjacency[a]])
+							candidates.push_back(adjacency[a]);
+					}
+				}
+
+				localIndices.push_back(localIndex[v]);
+			}
+
+			clusterNormals.push_back(triangleNormals[triangle]);
+			normalSum += XMLoadFloat3(&triangleNormals[triangle]);
+			centerSum += XMLoadFloat3(&triangleCenters[triangle]);
+
+			if (localIndices.size() / 3 >= MESH_CLUSTER_MAX_TRIANGLES)
+				break;
+
+			// Pick the neighbor that adds the fewest vertices, then the one that
+			// keeps the cluster the most compact and facing the same way
+			XMVECTOR averageNormal = XMVector3Normalize(normalSum);
+			XMVECTOR center = centerSum / (float)(localIndices.size() / 3);
+			int best = -1;
+			int bestNewVertices = 4;
+			float bestScore = FLT_MAX;
+
+			size_t kept = 0;
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				unsigned int candidate = candidates[i];
+				if (used[candidate])
+					continue;
+				candidates[kept++] = candidate;
+
+				int newVertices = 0;
+				for (int c = 0; c < 3; c++)
+					newVertices += vertexCluster[indices[candidate * 3 + c]] == clusterIndex ? 0 : 1;
+
+				if (clusterVertices.size() + newVertices > MESH_CLUSTER_MAX_VERTICES || newVertices > bestNewVertices)
+					continue;
+
+				float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&triangleCenters[candidate]) - center));
+				float facing = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&triangleNormals[candidate]), averageNormal));
+				float score = distance * (2.0f - facing);
+				if (newVertices < bestNewVertices || score < bestScore)
+				{
+					best = (int)candidate;
+					bestNewVertices = newVertices;
+					bestScore = score;
+				}
+			}
+			candidates.resize(kept);
+
+			// With no neighbors left, carry on in index buffer order, which
+			// the vertex cache optimization has already made fairly local
+			if (best < 0)
+			{
+				while (nextSeed < numTriangles && used[nextSeed])
+					nextSeed++;
+
+				if (nextSeed < numTriangles)
+				{
+					int newVertices = 0;
+					for (int c = 0; c < 3; c++)
+						newVertices += vertexCluster[indices[nextSeed * 3 + c]] == clusterIndex ? 0 : 1;
+
+					if (clusterVertices.size() + newVertices <= MESH_CLUSTER_MAX_VERTICES)
+						best = nextSeed;
+				}
+			}
+
+			triangle = best;
+		}
+
+		while (nextSeed < numTriangles && used[nextSeed])
+			nextSeed++;
+
+		// Growing the cluster scrambled the triangle order, so reorder it for
+		// the vertex cache again (cheaply, since it only has a few vertices)
+		OptimizeVertexCache(&localIndices[0], (int)localIndices.size(), (int)clusterVertices.size());
+		for (size_t i = 0; i < localIndices.size(); i++)
+			clustered.push_back(clusterVertices[localIndices[i]]);
+
+		clusterPoints.resize(clusterVertices.size());
+		for (size_t i = 0; i < clusterVertices.size(); i++)
+			clusterPoints[i] = vertices[clusterVertices[i]].Position;
+
+		cluster.indexCount = (unsigned int)localIndices.size();
+		cluster.vertexCount = (unsigned int)clusterVertices.size();
+		ComputeBoundingSphere(&clusterPoints[0], (int)clusterPoints.size(), sizeof(XMFLOAT3), cluster.center, cluster.radius);
+		ClusterNormalCone(clusterNormals, cluster.coneAxis, cluster.coneCutoff);
+		clusters.push_back(cluster);
+	}
+
+	memcpy(indices, clustered.data(), sizeof(unsigned int) * clustered.size());
+}
+
+MeshClusterFill MeasureClusterFill(const MeshCluster* clusters, int numClusters)
+{
+	MeshClusterFill fill = {};
+	if (numClusters <= 0)
+		return fill;
+
+	for (int i = 0; i < numClusters; i++)
+	{
+		fill.vertexFill += (float)clusters[i].vertexCount / MESH_CLUSTER_MAX_VERTICES;
+		fill.triangleFill += (float)(clusters[i].indexCount / 3) / MESH_CLUSTER_MAX_TRIANGLES;
+	}
+
+	fill.vertexFill /= numClusters;
+	fill.triangleFill /= numClusters;
+	return fill;
+}
+
+void CullMeshClusters(const MeshCluster* clusters, int numClusters, const XMFLOAT4X4& worldViewProjection,
+	XMFLOAT3 cameraPosition, std::vector<unsigned int>& visibleClusters)
+{
+	visibleClusters.clear();
+
+	// The frustum planes in model space, pointing inwards
+	Frustum frustum = ExtractFrustum(worldViewProjection);
+	XMVECTOR planes[6];
+	for (int p = 0; p < 6; p++)
+		planes[p] = XMLoadFloat4(&frustum.planes[p]);
+
+	XMVECTOR eye = XMLoadFloat3(&cameraPosition);
+
+	for (int i = 0; i < numClusters; i++)
+	{
+		const MeshCluster& cluster = clusters[i];
+		XMVECTOR center = XMLoadFloat3(&cluster.center);
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+			outside = XMVectorGetX(XMPlaneDotCoord(planes[p], center)) < -cluster.radius;
+		if (outside)
+			continue;
+
+		// Every triangle faces away if the whole sphere is behind the cone
+		XMVECTOR toCenter = center - eye;
+		float facing = XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&cluster.coneAxis)));
+		if (facing >= cluster.coneCutoff * XMVectorGetX(XMVector3Length(toCenter)) + cluster.radius)
+			continue;
+
+		visibleClusters.push_back((unsigned int)i);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Vertex.h"
+#include <vector>
+
+// Limits on the size of a single cluster, small enough that the
+// triangles in one tend to face the same way
+#define MESH_CLUSTER_MAX_VERTICES 64
+#define MESH_CLUSTER_MAX_TRIANGLES 124
+
+// --------------------------------------------------------
+// A small group of neighboring triangles, stored as a range
+// of the mesh's index buffer, that can be culled as a unit
+//
+// - center/radius bound the cluster's vertices
+// - coneAxis/coneCutoff bound the directions its triangles
+//   face; a cutoff of 1 means they face too many ways for
+//   the cluster to ever be rejected as backfacing
+// --------------------------------------------------------
+struct MeshCluster
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+	unsigned int vertexCount;
+	DirectX::XMFLOAT3 center;
+	float radius;
+	DirectX::XMFLOAT3 coneAxis;
+	float coneCutoff;
+};
+
+// --------------------------------------------------------
+// How full the clusters are on average, compared to the
+// limits above (1.0 means every cluster is at the limit)
+// --------------------------------------------------------
+struct MeshClusterFill
+{
+	float vertexFill;
+	float triangleFill;
+};
+
+// --------------------------------------------------------
+// Splits a triangle list into clusters, reordering the
+// indices so each cluster's triangles are contiguous
+//
+// - Clusters are grown one triangle at a time from the
+//   first unused triangle, preferring neighbors that add no
+//   new vertices, then ones facing the same way
+// - The result only depends on the input, so the same mesh
+//   always produces the same clusters
+// --------------------------------------------------------
+void BuildMeshClusters(unsigned int* indices, int numIndices, const Vertex* vertices, int numVertices, std::vector<MeshCluster>& clusters);
+
+MeshClusterFill MeasureClusterFill(const MeshCluster* clusters, int numClusters);
+
+// --------------------------------------------------------
+// Lists the clusters that might be visible: the ones that
+// are at least partly inside the view frustum and not
+// facing entirely away from the camera
+//
+// - Everything is in the mesh's own space: the matrix is
+//   world * view * projection, and cameraPosition must be
+//   transformed into model space as well
+// --------------------------------------------------------
+void CullMeshClusters(const MeshCluster* clusters, int numClusters, const DirectX::XMFLOAT4X4& worldViewProjection,
+	DirectX::XMFLOAT3 cameraPosition, std::vector<unsigned int>& visibleClusters);
@@ -0,0 +1,181 @@
+#include "MeshLoader.h"
+#include "ParallelFor.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// A unit cube around the origin with proper normals, UVs
+// and tangents, small enough to build on the spot and
+// cheap enough to draw for anything that's still loading
+// --------------------------------------------------------
+static std::shared_ptr<Mesh> CreatePlaceholderCube(Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, MeshVertexFormat vertexFormat)
+{
+	Vertex vertices[24] = {};
+	unsigned int indices[36] = {};
+
+	for (int face = 0; face < 6; face++)
+	{
+		// The face's normal, plus the directions its U and V run in, with
+		// U x V pointing inwards so the corners below wind clockwise
+		float sign = face % 2 == 0 ? 1.0f : -1.0f;
+		XMVECTOR normal = XMVectorSetByIndex(XMVectorZero(), sign, face / 2);
+		XMVECTOR u = XMVectorSetByIndex(XMVectorZero(), 1.0f, (face / 2 + 1) % 3);
+		XMVECTOR v = XMVector3Cross(u, normal);
+
+		const float cornerU[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+		const float cornerV[4] = { -1.0f, 1.0f, 1.0f, -1.0f };
+		for (int c = 0; c < 4; c++)
+		{
+			Vertex& vertex = vertices[face * 4 + c];
+			XMStoreFloat3(&vertex.Position, (normal + u * cornerU[c] + v * cornerV[c]) * 0.5f);
+			XMStoreFloat3(&vertex.normal, normal);
+			XMStoreFloat3(&vertex.tangent, u);
+			vertex.uv = XMFLOAT2(cornerU[c] * 0.5f + 0.5f, 0.5f - cornerV[c] * 0.5f);
+		}
+
+		const unsigned int corners[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i = 0; i < 6; i++)
+			indices[face * 6 + i] = face * 4 + corners[i];
+	}
+
+	return std::make_shared<Mesh>(vertices, 24, indices, 36, device, context, vertexFormat);
+}
+
+MeshLoader::MeshLoader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, int threadCount,
+	std::shared_ptr<GeometryPool> geometryPool, bool positionStreams) :
+	device(device),
+	geometryPool(geometryPool),
+	positionStreams(positionStreams),
+	pendingCount(0),
+	stopping(false)
+{
+	placeholders[0] = CreatePlaceholderCube(device, context, MeshVertexFormat::Full);
+	placeholders[1] = CreatePlaceholderCube(device, context, MeshVertexFormat::Packed);
+
+	if (threadCount <= 0)
+		threadCount = GetDefaultThreadCount();
+
+	for (int i = 0; i < threadCount; i++)
+		workers.emplace_back(&MeshLoader::WorkerLoop, this);
+}
+
+MeshLoader::~MeshLoader()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+
+	jobQueued.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+std::shared_ptr<Mesh> MeshLoader::LoadAsync(const std::wstring& fileName, MeshVertexFormat vertexFormat, bool buildClusters, MeshLoadCallback onLoaded)
+{
+	std::shared_ptr<Mesh> placeholder = placeholders[vertexFormat == MeshVertexFormat::Packed ? 1 : 0];
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(vertexFormat, placeholder);
+	if (onLoaded)
+		callbacks[mesh.get()].push_back(onLoaded);
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		queued.push_back({ mesh, fileName, buildClusters });
+		pendingCount++;
+	}
+
+	jobQueued.notify_one();
+	return mesh;
+}
+
+void MeshLoader::WhenLoaded(std::shared_ptr<Mesh> mesh, MeshLoadCallback onLoaded)
+{
+	if (mesh->GetLoadState() == MeshLoadState::Loading)
+		callbacks[mesh.get()].push_back(onLoaded);
+	else
+		onLoaded(mesh);
+}
+
+int MeshLoader::Update()
+{
+	std::vector<Job> finished;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		finished.swap(imported);
+		pendingCount -= (int)finished.size();
+	}
+
+	// A mesh that failed to import has nothing to create buffers from,
+	// so this is also what moves it to Failed
+	for (Job& job : finished)
+		job.mesh->CreateBuffers(device, geometryPool, positionStreams);
+
+	// Callbacks only run once all of the meshes are done, so any of them
+	// can rely on the others that finished at the same time
+	for (Job& job : finished)
+	{
+		auto found = callbacks.find(job.mesh.get());
+		if (found == callbacks.end())
+			continue;
+
+		std::vector<MeshLoadCallback> meshCallbacks;
+		meshCallbacks.swap(found->second);
+		callbacks.erase(found);
+
+		for (auto& callback : meshCallbacks)
+			callback(job.mesh);
+	}
+
+	return (int)finished.size();
+}
+
+void MeshLoader::Wait(const std::vector<std::shared_ptr<Mesh>>& meshes)
+{
+	for (;;)
+	{
+		Update();
+
+		bool loading = false;
+		for (auto& mesh : meshes)
+			loading = loading || mesh->GetLoadState() == MeshLoadState::Loading;
+		if (!loading)
+			return;
+
+		std::unique_lock<std::mutex> guard(lock);
+		jobImported.wait(guard, [&]() { return !imported.empty(); });
+	}
+}
+
+int MeshLoader::GetPendingCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return pendingCount;
+}
+
+void MeshLoader::WorkerLoop()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			jobQueued.wait(guard, [&]() { return stopping || !queued.empty(); });
+			if (stopping)
+				return;
+
+			job = queued.front();
+			queued.pop_front();
+		}
+
+		// The mesh is Loading, so nothing else touches it until Update() picks it up
+		job.mesh->Import(job.fileName, job.buildClusters);
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			imported.push_back(job);
+		}
+
+		jobImported.notify_all();
+	}
+}
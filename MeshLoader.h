@@ -0,0 +1,94 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Mesh.h"
+#include "GeometryPool.h"
+
+// Called on the main thread once a mesh has finished loading, whether it's Ready or Failed
+typedef std::function<void(std::shared_ptr<Mesh>)> MeshLoadCallback;
+
+// --------------------------------------------------------
+// Imports model files on worker threads so the caller never
+// waits on parsing or processing them
+//
+// - LoadAsync() returns the mesh straight away, still in the
+//   Loading state, drawing as a small placeholder cube (in
+//   the same vertex format) until it's Ready
+// - A worker thread runs Mesh::Import(), then Update(), on
+//   the main thread, creates the buffers and makes the mesh
+//   Ready, so D3D is only ever used from one thread
+// - Given a GeometryPool, every mesh it finishes is sub-
+//   allocated out of the pool's shared buffers
+// - positionStreams gives every mesh a position stream too,
+//   for drawing depth-only passes with less bandwidth
+// - Everything here except the workers themselves is meant
+//   to be called from the main thread
+// --------------------------------------------------------
+class MeshLoader
+{
+public:
+	//threadCount of 0 uses GetDefaultThreadCount()
+	MeshLoader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, int threadCount = 1,
+		std::shared_ptr<GeometryPool> geometryPool = nullptr, bool positionStreams = false);
+
+	//waits for the workers to finish what they're importing - queued files are never loaded
+	~MeshLoader();
+
+	// The workers hold a pointer to the loader, so it can't be copied
+	MeshLoader(MeshLoader const&) = delete;
+	void operator=(MeshLoader const&) = delete;
+
+	//starts loading a file and returns its (still Loading) mesh
+	std::shared_ptr<Mesh> LoadAsync(const std::wstring& fileName, MeshVertexFormat vertexFormat = MeshVertexFormat::Full,
+		bool buildClusters = false, MeshLoadCallback onLoaded = nullptr);
+
+	//runs onLoaded when the mesh finishes loading, or right away if it already has
+	void WhenLoaded(std::shared_ptr<Mesh> mesh, MeshLoadCallback onLoaded);
+
+	//finishes every mesh the workers are done with and runs their callbacks,
+	//returning how many were finished - call once a frame
+	int Update();
+
+	//blocks until every one of the meshes (which must come from this loader) is Ready or Failed
+	void Wait(const std::vector<std::shared_ptr<Mesh>>& meshes);
+
+	//returns how many meshes are still Loading
+	int GetPendingCount();
+
+private:
+	struct Job
+	{
+		std::shared_ptr<Mesh> mesh;
+		std::wstring fileName;
+		bool buildClusters;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	std::shared_ptr<GeometryPool> geometryPool; //may be null
+	bool positionStreams;
+	std::shared_ptr<Mesh> placeholders[2]; //a cube in each MeshVertexFormat
+
+	std::vector<std::thread> workers;
+	std::mutex lock; //guards everything below it
+	std::condition_variable jobQueued;
+	std::condition_variable jobImported;
+	std::deque<Job> queued; //waiting for a worker
+	std::vector<Job> imported; //waiting for Update()
+	int pendingCount; //queued, being imported or waiting for Update()
+	bool stopping;
+
+	//only touched on the main thread, so they aren't guarded
+	std::unordered_map<const Mesh*, std::vector<MeshLoadCallback>> callbacks;
+
+	void WorkerLoop();
+};
@@ -0,0 +1,405 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+using namespace DirectX;
+
+VertexCacheStats MeasureVertexCache(const unsigned int* indices, int numIndices, int numVertices, int cacheSize)
+{
+	VertexCacheStats stats = {};
+	if (numIndices < 3 || numVertices <= 0)
+		return stats;
+
+	// Each vertex remembers when it entered the cache, so checking
+	// whether it's still there is a single subtraction
+	std::vector<int> cacheTimestamps(numVertices, -cacheSize - 1);
+	int transforms = 0;
+
+	for (int i = 0; i < numIndices; i++)
+	{
+		unsigned int v = indices[i];
+		if (transforms - cacheTimestamps[v] > cacheSize)
+		{
+			cacheTimestamps[v] = transforms;
+			transforms++;
+		}
+	}
+
+	stats.acmr = (float)transforms / (numIndices / 3);
+	stats.atvr = (float)transforms / numVertices;
+	return stats;
+}
+
+// --------------------------------------------------------
+// Scoring for Forsyth's "Linear-Speed Vertex Cache
+// Optimisation" - the values below are the ones from the
+// original write-up
+// --------------------------------------------------------
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+
+static float forsythCacheScores[FORSYTH_CACHE_SIZE];
+static float forsythValenceScores[FORSYTH_MAX_VALENCE + 1];
+
+static void BuildForsythScoreTables()
+{
+	static bool built = false;
+	if (built)
+		return;
+
+	for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+	{
+		// The last triangle's vertices get a fixed score so the
+		// algorithm doesn't favor re-using them over and over
+		if (i < 3)
+			forsythCacheScores[i] = 0.75f;
+		else
+			forsythCacheScores[i] = powf(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+
+	// Vertices with few triangles left get a boost, so they're finished off
+	forsythValenceScores[0] = 0.0f;
+	for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+		forsythValenceScores[i] = 2.0f * powf((float)i, -0.5f);
+
+	built = true;
+}
+
+static inline float ForsythVertexScore(int cachePosition, int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = cachePosition >= 0 ? forsythCacheScores[cachePosition] : 0.0f;
+	return score + forsythValenceScores[std::min(remainingTriangles, FORSYTH_MAX_VALENCE)];
+}
+
+void OptimizeVertexCache(unsigned int* indices, int numIndices, int numVertices)
+{
+	int numTriangles = numIndices / 3;
+	if (numTriangles < 2 || numVertices <= 0)
+		return;
+
+	BuildForsythScoreTables();
+
+	// Build vertex -> triangle adjacency as a flat array (counting sort)
+	std::vector<int> remaining(numVertices, 0);
+	for (int i = 0; i < numTriangles * 3; i++)
+		remaining[indices[i]]++;
+
+	std::vector<int> adjacencyOffsets(numVertices + 1, 0);
+	for (int v = 0; v < numVertices; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+
+	std::vector<int> adjacency(adjacencyOffsets[numVertices]);
+	std::vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (int t = 0; t < numTriangles; t++)
+	{
+		for (int c = 0; c < 3; c++)
+			adjacency[fill[indices[t * 3 + c]]++] = t;
+	}
+
+	// Initial scores, with nothing in the cache yet
+	std::vector<int> cachePositions(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	for (int v = 0; v < numVertices; v++)
+		vertexScores[v] = ForsythVertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScores(numTriangles);
+	std::vector<bool> emitted(numTriangles, false);
+	for (int t = 0; t < numTriangles; t++)
+	{
+		triangleScores[t] =
+			vertexScores[indices[t * 3]] +
+			vertexScores[indices[t * 3 + 1]] +
+			vertexScores[indices[t * 3 + 2]];
+	}
+
+	// The cache has room for one extra triangle's worth while it's updated
+	int cache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	std::vector<unsigned int> output;
+	output.reserve(numTriangles * 3);
+
+	// Every emitted vertex, most recent last, for restarting near the last triangle at dead ends
+	std::vector<int> deadEndStack;
+	deadEndStack.reserve(numTriangles * 3);
+
+	int bestTriangle = -1;
+	int scanCursor = 0;
+
+	while ((int)output.size() < numTriangles * 3)
+	{
+		// Nothing left touching the cache.  Searching every remaining triangle would make this
+		// quadratic, so instead take the best triangle of the most recently emitted vertex that
+		// has any left, or failing that the first one not yet emitted.  The stack only shrinks
+		// and the cursor only moves forward, so all of this is linear over the whole mesh
+		if (bestTriangle < 0)
+		{
+			while (bestTriangle < 0 && !deadEndStack.empty())
+			{
+				int v = deadEndStack.back();
+				deadEndStack.pop_back();
+
+				float bestScore = -1.0f;
+				for (int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remaining[v]; a++)
+				{
+					if (triangleScores[adjacency[a]] > bestScore)
+					{
+						bestScore = triangleScores[adjacency[a]];
+						bestTriangle = adjacency[a];
+					}
+				}
+			}
+
+			if (bestTriangle < 0)
+			{
+				for (; emitted[scanCursor]; scanCursor++);
+				bestTriangle = scanCursor;
+			}
+		}
+
+		// Emit the triangle and take it out of the adjacency counts
+		emitted[bestTriangle] = true;
+		int newCache[FORSYTH_CACHE_SIZE + 3];
+		int newCacheCount = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[bestTriangle * 3 + c];
+			output.push_back(v);
+			newCache[newCacheCount++] = (int)v;
+			deadEndStack.push_back((int)v);
+
+			// Swap-remove the triangle from this vertex's live list
+			int begin = adjacencyOffsets[v];
+			int end = begin + remaining[v];
+			for (int a = begin; a < end; a++)
+			{
+				if (adjacency[a] == bestTriangle)
+				{
+					std::swap(adjacency[a], adjacency[end - 1]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// The triangle's vertices move to the front, everything else shifts back
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+				newCache[newCacheCount++] = v;
+		}
+
+		// Re-score everything that was (or still is) in the cache
+		for (int i = 0; i < newCacheCount; i++)
+		{
+			int v = newCache[i];
+			cachePositions[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+			float newScore = ForsythVertexScore(cachePositions[v], remaining[v]);
+			float difference = newScore - vertexScores[v];
+			vertexScores[v] = newScore;
+
+			for (int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remaining[v]; a++)
+				triangleScores[adjacency[a]] += difference;
+		}
+
+		cacheCount = std::min(newCacheCount, FORSYTH_CACHE_SIZE);
+		for (int i = 0; i < cacheCount; i++)
+			cache[i] = newCache[i];
+
+		// The next triangle is the best one touching the cache
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			for (int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remaining[v]; a++)
+			{
+				int t = adjacency[a];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(unsigned int* indices, int numIndices, const Vertex* vertices, int numVertices)
+{
+	int numTriangles = numIndices / 3;
+	if (numTriangles < 2 || numVertices <= 0)
+		return;
+
+	// Split into clusters wherever the FIFO cache misses all three
+	// vertices of a triangle, since reordering at those points can't
+	// make the cache any worse
+	std::vector<int> clusterStarts;
+	std::vector<int> cacheTimestamps(numVertices, -VERTEX_CACHE_MEASURE_SIZE - 1);
+	int transforms = 0;
+	for (int t = 0; t < numTriangles; t++)
+	{
+		int misses = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			if (transforms - cacheTimestamps[v] > VERTEX_CACHE_MEASURE_SIZE)
+			{
+				cacheTimestamps[v] = transforms;
+				transforms++;
+				misses++;
+			}
+		}
+
+		if (t == 0 || misses == 3)
+			clusterStarts.push_back(t);
+	}
+
+	int numClusters = (int)clusterStarts.size();
+	if (numClusters < 2)
+		return;
+	clusterStarts.push_back(numTriangles);
+
+	// Area-weighted centroid of the whole mesh
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+	for (int t = 0; t < numTriangles; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+		float area = XMVectorGetX(XMVector3Length(XMVector3Cross(p1 - p0, p2 - p0)));
+		meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+		meshCentroid = meshCentroid / meshArea;
+
+	// Clusters that face away from the middle of the mesh are
+	// likely to occlude the rest, so they get drawn first
+	std::vector<float> sortKeys(numClusters);
+	for (int c = 0; c < numClusters; c++)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (int t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+			XMVECTOR cross = XMVector3Cross(p1 - p0, p2 - p0);
+			float triangleArea = XMVectorGetX(XMVector3Length(cross));
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+
+		if (area > 0.0f)
+			centroid = centroid / area;
+		normal = XMVector3Normalize(normal);
+
+		// Imported triangles wind clockwise seen from outside (left-handed,
+		// like D3D's default front faces), so the cross product points outward
+		sortKeys[c] = XMVectorGetX(XMVector3Dot(centroid - meshCentroid, normal));
+	}
+
+	std::vector<int> order(numClusters);
+	for (int c = 0; c < numClusters; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(numTriangles * 3);
+	for (int c : order)
+		output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+int OptimizeVertexFetch(Vertex* vertices, int numVertices, unsigned int* indices, int numIndices)
+{
+	const unsigned int unused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(numVertices, unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(numVertices);
+
+	for (int i = 0; i < numIndices; i++)
+	{
+		unsigned int& newIndex = remap[indices[i]];
+		if (newIndex == unused)
+		{
+			newIndex = (unsigned int)reordered.size();
+			reordered.push_back(vertices[indices[i]]);
+		}
+		indices[i] = newIndex;
+	}
+
+	std::copy(reordered.begin(), reordered.end(), vertices);
+	return (int)reordered.size();
+}
+
+// --------------------------------------------------------
+// Key used to find vertices with bit-for-bit identical
+// positions
+// --------------------------------------------------------
+struct PositionKey
+{
+	unsigned int bits[3];
+
+	bool operator==(const PositionKey& other) const
+	{
+		return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+	}
+};
+
+struct PositionKeyHash
+{
+	size_t operator()(const PositionKey& key) const
+	{
+		unsigned long long packed =
+			((unsigned long long)key.bits[0] << 32 | key.bits[1]) ^ ((unsigned long long)key.bits[2] << 16);
+		return (size_t)((packed * 0x9E3779B97F4A7C15ull) >> 16);
+	}
+};
+
+void BuildPositionRemap(const Vertex* vertices, int numVertices,
+	std::vector<unsigned int>& positionRemap, std::vector<unsigned int>& twins)
+{
+	std::unordered_map<PositionKey, unsigned int, PositionKeyHash> lookup;
+	lookup.reserve(numVertices);
+
+	positionRemap.resize(numVertices);
+	twins.resize(numVertices);
+
+	for (int i = 0; i < numVertices; i++)
+	{
+		PositionKey key;
+		memcpy(key.bits, &vertices[i].Position, sizeof(key.bits));
+
+		auto found = lookup.find(key);
+		if (found == lookup.end())
+		{
+			lookup.emplace(key, (unsigned int)i);
+			positionRemap[i] = i;
+			twins[i] = i;
+			continue;
+		}
+
+		// Splice this vertex into the list after the first one
+		unsigned int first = found->second;
+		positionRemap[i] = first;
+		twins[i] = twins[first];
+		twins[first] = i;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Vertex.h"
+#include <vector>
+
+// Size of the FIFO cache simulated when measuring index buffers
+#define VERTEX_CACHE_MEASURE_SIZE 16
+
+// --------------------------------------------------------
+// How well an index buffer uses the post-transform cache
+//
+// - ACMR: average cache miss ratio, vertices transformed per
+//   triangle (0.5 is ideal for big grids, 3.0 is the worst)
+// - ATVR: average transform to vertex ratio, vertices
+//   transformed per unique vertex (1.0 is ideal)
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float acmr;
+	float atvr;
+};
+
+// Simulates a FIFO vertex cache over the index buffer
+VertexCacheStats MeasureVertexCache(const unsigned int* indices, int numIndices, int numVertices, int cacheSize = VERTEX_CACHE_MEASURE_SIZE);
+
+// --------------------------------------------------------
+// Reorders triangles so vertices are reused while they're
+// still in the post-transform cache (Forsyth's algorithm)
+// --------------------------------------------------------
+void OptimizeVertexCache(unsigned int* indices, int numIndices, int numVertices);
+
+// --------------------------------------------------------
+// Reorders the clusters produced by OptimizeVertexCache so
+// outward-facing parts of the mesh tend to be drawn first,
+// which lets early depth testing reject more of the rest
+//
+// - Clusters are only split where the cache would miss on
+//   every vertex anyway, so ACMR is essentially unchanged
+// --------------------------------------------------------
+void OptimizeOverdraw(unsigned int* indices, int numIndices, const Vertex* vertices, int numVertices);
+
+// --------------------------------------------------------
+// Reorders the vertices into the order the index buffer
+// first uses them, so vertex fetches walk through memory
+//
+// - Indices are remapped to match
+// - Unreferenced vertices are dropped, and the new vertex
+//   count is returned
+// --------------------------------------------------------
+int OptimizeVertexFetch(Vertex* vertices, int numVertices, unsigned int* indices, int numIndices);
+
+// --------------------------------------------------------
+// Links together the vertices that share a position, i.e.
+// the copies a UV or normal seam splits a corner into
+//
+// - positionRemap gives the first vertex with each position
+// - twins is a circular list through all vertices with the
+//   same position (a vertex with a unique one points to itself)
+// --------------------------------------------------------
+void BuildPositionRemap(const Vertex* vertices, int numVertices,
+	std::vector<unsigned int>& positionRemap, std::vector<unsigned int>& twins);
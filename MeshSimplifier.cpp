@@ -0,0 +1,608 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Border and seam edges are held in place by quadrics this many
+// times stronger than those of the faces next to them
+#define SIMPLIFY_BORDER_WEIGHT 10.0f
+
+// --------------------------------------------------------
+// Which collapses a vertex can take part in as the vertex
+// that goes away
+//
+// - Manifold: surrounded by triangles, may collapse into
+//   any neighbor
+// - Border: on a single open edge loop, may only collapse
+//   along it into another border vertex
+// - Seam: one of several vertices sharing a position, each
+//   on a single seam; may only collapse along the seam, and
+//   only together with its twins so every side stays stitched
+// - Locked: corners, seams meeting borders, and so on
+// --------------------------------------------------------
+enum class SimplifyVertexKind { Manifold, Border, Seam, Locked };
+
+// --------------------------------------------------------
+// The area-weighted sum of squared distances to a set of
+// planes, as a symmetric 3x3 matrix, a vector and a scalar
+// --------------------------------------------------------
+struct Quadric
+{
+	float a00, a11, a22;
+	float a10, a20, a21;
+	float b0, b1, b2;
+	float c;
+	float weight;
+};
+
+static Quadric PlaneQuadric(XMFLOAT3 n, float d, float weight)
+{
+	Quadric q;
+	q.a00 = weight * n.x * n.x;
+	q.a11 = weight * n.y * n.y;
+	q.a22 = weight * n.z * n.z;
+	q.a10 = weight * n.y * n.x;
+	q.a20 = weight * n.z * n.x;
+	q.a21 = weight * n.z * n.y;
+	q.b0 = weight * n.x * d;
+	q.b1 = weight * n.y * d;
+	q.b2 = weight * n.z * d;
+	q.c = weight * d * d;
+	q.weight = weight;
+	return q;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+	q.a00 += other.a00;
+	q.a11 += other.a11;
+	q.a22 += other.a22;
+	q.a10 += other.a10;
+	q.a20 += other.a20;
+	q.a21 += other.a21;
+	q.b0 += other.b0;
+	q.b1 += other.b1;
+	q.b2 += other.b2;
+	q.c += other.c;
+	q.weight += other.weight;
+}
+
+// Mean squared distance from p to the quadric's planes
+static float QuadricError(const Quadric& q, XMFLOAT3 p)
+{
+	float rx = q.a00 * p.x + q.a10 * p.y + q.a20 * p.z + 2.0f * q.b0;
+	float ry = q.a10 * p.x + q.a11 * p.y + q.a21 * p.z + 2.0f * q.b1;
+	float rz = q.a20 * p.x + q.a21 * p.y + q.a22 * p.z + 2.0f * q.b2;
+	float error = rx * p.x + ry * p.y + rz * p.z + q.c;
+
+	return q.weight > 0.0f ? fabsf(error) / q.weight : 0.0f;
+}
+
+// --------------------------------------------------------
+// Lists the triangles around each vertex, in one array
+//
+// - With a remap, triangles are listed around each remapped
+//   vertex instead (e.g. around each position)
+// --------------------------------------------------------
+static void BuildAdjacency(const std::vector<unsigned int>& indices, const unsigned int* remap, int numVertices,
+	std::vector<unsigned int>& offsets, std::vector<unsigned int>& adjacency)
+{
+	offsets.assign(numVertices + 1, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		offsets[(remap ? remap[indices[i]] : indices[i]) + 1]++;
+	for (int i = 0; i < numVertices; i++)
+		offsets[i + 1] += offsets[i];
+
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	adjacency.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency[fill[remap ? remap[indices[i]] : indices[i]]++] = (unsigned int)(i / 3);
+}
+
+// Whether any triangle around a has the edge from a to b (compared through the remap, if there is one)
+static bool HasEdge(const std::vector<unsigned int>& indices, const unsigned int* remap,
+	const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& adjacency, unsigned int a, unsigned int b)
+{
+	for (unsigned int i = offsets[a]; i < offsets[a + 1]; i++)
+	{
+		const unsigned int* triangle = &indices[adjacency[i] * 3];
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int from = remap ? remap[triangle[c]] : triangle[c];
+			unsigned int to = remap ? remap[triangle[(c + 1) % 3]] : triangle[(c + 1) % 3];
+			if (from == a && to == b)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// Connectivity of the current index buffer
+//
+// - An edge is open when no triangle uses it the other way
+//   around; it's a border if that's true of its positions
+//   too, and a seam if only its attributes differ
+// - loopOut/loopIn give the vertex at the other end of a
+//   vertex's outgoing/incoming open edge (-1 for none, -2
+//   if there are several)
+// --------------------------------------------------------
+struct SimplifyTopology
+{
+	std::vector<unsigned int> triangleOffsets;
+	std::vector<unsigned int> triangles;
+	std::vector<unsigned int> positionTriangleOffsets;
+	std::vector<unsigned int> positionTriangles;
+	std::vector<SimplifyVertexKind> kinds;
+	std::vector<int> loopOut;
+	std::vector<int> loopIn;
+	std::vector<bool> referenced;
+};
+
+static bool IsOpenEdge(const SimplifyTopology& topology, const std::vector<unsigned int>& indices, unsigned int a, unsigned int b)
+{
+	return !HasEdge(indices, 0, topology.triangleOffsets, topology.triangles, b, a);
+}
+
+static void BuildTopology(const std::vector<unsigned int>& indices, const std::vector<unsigned int>& positionRemap,
+	const std::vector<unsigned int>& twins, SimplifyTopology& topology)
+{
+	int numVertices = (int)positionRemap.size();
+
+	BuildAdjacency(indices, 0, numVertices, topology.triangleOffsets, topology.triangles);
+	BuildAdjacency(indices, &positionRemap[0], numVertices, topology.positionTriangleOffsets, topology.positionTriangles);
+
+	topology.referenced.assign(numVertices, false);
+	for (size_t i = 0; i < indices.size(); i++)
+		topology.referenced[indices[i]] = true;
+
+	// Follow the open edges, remembering which positions are on a border
+	std::vector<bool> onBorder(numVertices, false);
+	topology.loopOut.assign(numVertices, -1);
+	topology.loopIn.assign(numVertices, -1);
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int a = indices[i + c];
+			unsigned int b = indices[i + (c + 1) % 3];
+			if (!IsOpenEdge(topology, indices, a, b))
+				continue;
+
+			if (!HasEdge(indices, &positionRemap[0], topology.positionTriangleOffsets, topology.positionTriangles,
+				positionRemap[b], positionRemap[a]))
+			{
+				onBorder[positionRemap[a]] = true;
+				onBorder[positionRemap[b]] = true;
+			}
+
+			topology.loopOut[a] = topology.loopOut[a] == -1 ? (int)b : -2;
+			topology.loopIn[b] = topology.loopIn[b] == -1 ? (int)a : -2;
+		}
+	}
+
+	topology.kinds.assign(numVertices, SimplifyVertexKind::Locked);
+
+	for (unsigned int v = 0; v < (unsigned int)numVertices; v++)
+	{
+		if (!topology.referenced[v])
+			continue;
+
+		int positionUsers = 1;
+		for (unsigned int t = twins[v]; t != v; t = twins[t])
+			positionUsers += topology.referenced[t] ? 1 : 0;
+
+		bool open = topology.loopOut[v] != -1 || topology.loopIn[v] != -1;
+		bool simpleLoop = topology.loopOut[v] >= 0 && topology.loopIn[v] >= 0;
+
+		if (positionUsers == 1 && !open)
+			topology.kinds[v] = SimplifyVertexKind::Manifold;
+		else if (positionUsers == 1 && simpleLoop && onBorder[positionRemap[v]])
+			topology.kinds[v] = SimplifyVertexKind::Border;
+		else if (positionUsers > 1 && simpleLoop && !onBorder[positionRemap[v]])
+		{
+			// Every side of the seam has to be simple for it to move
+			bool simpleTwins = true;
+			for (unsigned int t = twins[v]; t != v; t = twins[t])
+			{
+				if (topology.referenced[t] && (topology.loopOut[t] < 0 || topology.loopIn[t] < 0))
+					simpleTwins = false;
+			}
+
+			if (simpleTwins)
+				topology.kinds[v] = SimplifyVertexKind::Seam;
+		}
+	}
+}
+
+static bool CanCollapse(const SimplifyTopology& topology, unsigned int v, unsigned int target)
+{
+	switch (topology.kinds[v])
+	{
+	case SimplifyVertexKind::Manifold:
+		return true;
+
+	case SimplifyVertexKind::Border:
+	case SimplifyVertexKind::Seam:
+		return topology.kinds[target] == topology.kinds[v] &&
+			(topology.loopOut[v] == (int)target || topology.loopIn[v] == (int)target);
+
+	default:
+		return false;
+	}
+}
+
+// A vertex merging into one of its neighbors
+struct VertexMove
+{
+	unsigned int v;
+	unsigned int target;
+};
+
+// --------------------------------------------------------
+// Lists the vertices that go away when v collapses into
+// target: v itself and, for a seam, each of its twins,
+// which move into whichever twin of target is next to them
+// along their own side of the seam
+//
+// - Returns false if the sides of the seam don't line up
+// --------------------------------------------------------
+static bool FindCollapseMoves(const SimplifyTopology& topology, const std::vector<unsigned int>& positionRemap,
+	const std::vector<unsigned int>& twins, unsigned int v, unsigned int target, std::vector<VertexMove>& moves)
+{
+	moves.clear();
+	moves.push_back({ v, target });
+
+	if (topology.kinds[v] != SimplifyVertexKind::Seam)
+		return true;
+
+	for (unsigned int twin = twins[v]; twin != v; twin = twins[twin])
+	{
+		if (!topology.referenced[twin])
+			continue;
+
+		int out = topology.loopOut[twin];
+		int in = topology.loopIn[twin];
+		if (positionRemap[out] == positionRemap[target] && topology.kinds[out] == SimplifyVertexKind::Seam)
+			moves.push_back({ twin, (unsigned int)out });
+		else if (positionRemap[in] == positionRemap[target] && topology.kinds[in] == SimplifyVertexKind::Seam)
+			moves.push_back({ twin, (unsigned int)in });
+		else
+			return false;
+	}
+
+	return true;
+}
+
+static XMVECTOR TriangleNormal(XMFLOAT3 p0, XMFLOAT3 p1, XMFLOAT3 p2)
+{
+	XMVECTOR a = XMLoadFloat3(&p0);
+	return XMVector3Cross(XMLoadFloat3(&p1) - a, XMLoadFloat3(&p2) - a);
+}
+
+// --------------------------------------------------------
+// Checks whether moving v onto target would turn any of the
+// triangles around v over (or flatten them)
+//
+// - Corners are looked up through collapseRemap, so the
+//   collapses already made this pass are taken into account
+// - Triangles that contain target simply disappear
+// --------------------------------------------------------
+static bool CollapseFlipsTriangle(const std::vector<unsigned int>& indices,
+	const std::vector<unsigned int>& adjacencyOffsets, const std::vector<unsigned int>& adjacency,
+	const std::vector<unsigned int>& collapseRemap, const std::vector<XMFLOAT3>& positions,
+	unsigned int v, unsigned int target)
+{
+	for (unsigned int i = adjacencyOffsets[v]; i < adjacencyOffsets[v + 1]; i++)
+	{
+		const unsigned int* triangle = &indices[adjacency[i] * 3];
+		unsigned int corners[3] = { collapseRemap[triangle[0]], collapseRemap[triangle[1]], collapseRemap[triangle[2]] };
+
+		if (corners[0] == target || corners[1] == target || corners[2] == target)
+			continue;
+
+		XMFLOAT3 before[3] = { positions[corners[0]], positions[corners[1]], positions[corners[2]] };
+		XMFLOAT3 after[3] = { before[0], before[1], before[2] };
+		for (int c = 0; c < 3; c++)
+		{
+			if (corners[c] == v)
+				after[c] = positions[target];
+		}
+
+		XMVECTOR normalBefore = TriangleNormal(before[0], before[1], before[2]);
+		XMVECTOR normalAfter = TriangleNormal(after[0], after[1], after[2]);
+		if (XMVectorGetX(XMVector3Dot(normalBefore, normalAfter)) <= 0.0f)
+			return true;
+	}
+
+	return false;
+}
+
+// A possible collapse of v into target
+struct EdgeCollapse
+{
+	unsigned int v;
+	unsigned int target;
+	float error;
+};
+
+// --------------------------------------------------------
+// Distance from p to the closest point of triangle abc
+// (from Ericson's "Real-Time Collision Detection")
+// --------------------------------------------------------
+static float PointTriangleDistance(XMVECTOR p, XMVECTOR a, XMVECTOR b, XMVECTOR c)
+{
+	XMVECTOR ab = b - a;
+	XMVECTOR ac = c - a;
+	XMVECTOR ap = p - a;
+	float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+	float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+	if (d1 <= 0.0f && d2 <= 0.0f)
+		return XMVectorGetX(XMVector3Length(ap));
+
+	XMVECTOR bp = p - b;
+	float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+	float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+	if (d3 >= 0.0f && d4 <= d3)
+		return XMVectorGetX(XMVector3Length(bp));
+
+	XMVECTOR cp = p - c;
+	float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+	float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+	if (d6 >= 0.0f && d5 <= d6)
+		return XMVectorGetX(XMVector3Length(cp));
+
+	// Closest to one of the edges?
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		return XMVectorGetX(XMVector3Length(p - (a + ab * (d1 / (d1 - d3)))));
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		return XMVectorGetX(XMVector3Length(p - (a + ac * (d2 / (d2 - d6)))));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+		return XMVectorGetX(XMVector3Length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))))));
+
+	// Inside the face
+	float denominator = 1.0f / (va + vb + vc);
+	return XMVectorGetX(XMVector3Length(p - (a + ab * (vb * denominator) + ac * (vc * denominator))));
+}
+
+// --------------------------------------------------------
+// Measures how far the simplified surface ended up from the
+// original vertices: each one is checked against the
+// triangles around the position it was finally merged into,
+// which cover the area it used to be in
+// --------------------------------------------------------
+static float MeasureSimplifiedError(const unsigned int* indices, int numIndices, const std::vector<unsigned int>& result,
+	const std::vector<XMFLOAT3>& positions, const std::vector<unsigned int>& positionRemap,
+	const std::vector<unsigned int>& finalVertex)
+{
+	int numVertices = (int)positions.size();
+
+	// Triangles around each position, rather than each vertex
+	std::vector<unsigned int> offsets;
+	std::vector<unsigned int> adjacency;
+	BuildAdjacency(result, &positionRemap[0], numVertices, offsets, adjacency);
+
+	std::vector<bool> measured(numVertices, false);
+	float error = 0.0f;
+
+	for (int i = 0; i < numIndices; i++)
+	{
+		unsigned int v = indices[i];
+		if (measured[v])
+			continue;
+		measured[v] = true;
+
+		XMVECTOR p = XMLoadFloat3(&positions[v]);
+		unsigned int position = positionRemap[finalVertex[v]];
+
+		float distance = FLT_MAX;
+		for (unsigned int t = offsets[position]; t < offsets[position + 1]; t++)
+		{
+			const unsigned int* triangle = &result[adjacency[t] * 3];
+			distance = std::min(distance, PointTriangleDistance(p,
+				XMLoadFloat3(&positions[triangle[0]]), XMLoadFloat3(&positions[triangle[1]]), XMLoadFloat3(&positions[triangle[2]])));
+		}
+
+		error = std::max(error, distance < FLT_MAX ? distance : 0.0f);
+	}
+
+	return error;
+}
+
+float SimplifyMesh(const unsigned int* indices, int numIndices, const Vertex* vertices, int numVertices,
+	int targetIndexCount, std::vector<unsigned int>& result)
+{
+	result.assign(indices, indices + numIndices);
+	if (numIndices < 3 || numVertices <= 0 || numIndices <= targetIndexCount)
+		return 0.0f;
+
+	// Work in a unit-sized box so the quadrics keep their precision,
+	// scaling the error back up at the end
+	XMVECTOR boundsMin = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR boundsMax = boundsMin;
+	for (int i = 1; i < numVertices; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[i].Position);
+		boundsMin = XMVectorMin(boundsMin, p);
+		boundsMax = XMVectorMax(boundsMax, p);
+	}
+
+	XMFLOAT3 size;
+	XMStoreFloat3(&size, boundsMax - boundsMin);
+	float extent = std::max(size.x, std::max(size.y, size.z));
+	if (extent <= 0.0f)
+		return 0.0f;
+
+	std::vector<XMFLOAT3> positions(numVertices);
+	for (int i = 0; i < numVertices; i++)
+		XMStoreFloat3(&positions[i], (XMLoadFloat3(&vertices[i].Position) - boundsMin) / extent);
+
+	std::vector<unsigned int> positionRemap;
+	std::vector<unsigned int> twins;
+	BuildPositionRemap(vertices, numVertices, positionRemap, twins);
+
+	SimplifyTopology topology;
+	BuildTopology(result, positionRemap, twins, topology);
+
+	// Every position starts with the planes of the triangles around it,
+	// and open edges add a perpendicular plane to keep them in place
+	std::vector<Quadric> quadrics(numVertices, Quadric());
+	for (int i = 0; i + 2 < numIndices; i += 3)
+	{
+		const unsigned int* triangle = &indices[i];
+		XMVECTOR normal = TriangleNormal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+		float area = XMVectorGetX(XMVector3Length(normal)) * 0.5f;
+		if (area <= 0.0f)
+			continue;
+
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, XMVector3Normalize(normal));
+		float d = -XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&positions[triangle[0]]))) / (area * 2.0f);
+
+		Quadric faceQuadric = PlaneQuadric(n, d, area);
+		for (int c = 0; c < 3; c++)
+			AddQuadric(quadrics[positionRemap[triangle[c]]], faceQuadric);
+
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int a = triangle[c];
+			unsigned int b = triangle[(c + 1) % 3];
+			if (!IsOpenEdge(topology, result, a, b))
+				continue;
+
+			XMVECTOR edge = XMLoadFloat3(&positions[b]) - XMLoadFloat3(&positions[a]);
+			float edgeLengthSq = XMVectorGetX(XMVector3LengthSq(edge));
+
+			XMFLOAT3 edgeNormal;
+			XMStoreFloat3(&edgeNormal, XMVector3Normalize(XMVector3Cross(edge, XMLoadFloat3(&n))));
+			float edgeD = -(edgeNormal.x * positions[a].x + edgeNormal.y * positions[a].y + edgeNormal.z * positions[a].z);
+
+			Quadric edgeQuadric = PlaneQuadric(edgeNormal, edgeD, edgeLengthSq * SIMPLIFY_BORDER_WEIGHT);
+			AddQuadric(quadrics[positionRemap[a]], edgeQuadric);
+			AddQuadric(quadrics[positionRemap[b]], edgeQuadric);
+		}
+	}
+
+	std::vector<unsigned int> collapseRemap(numVertices);
+	std::vector<unsigned int> finalVertex(numVertices);
+	std::vector<bool> collapseLocked(numVertices);
+	std::vector<EdgeCollapse> collapses;
+	std::vector<VertexMove> moves;
+
+	for (int i = 0; i < numVertices; i++)
+		finalVertex[i] = i;
+
+	// Each pass collapses as many of the cheapest edges as it can
+	// without two collapses touching the same position
+	while ((int)result.size() > targetIndexCount)
+	{
+		int triangleCount = (int)result.size() / 3;
+
+		// The cheapest allowed direction of every edge
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int a = result[i + c];
+				unsigned int b = result[i + (c + 1) % 3];
+				unsigned int positionA = positionRemap[a];
+				unsigned int positionB = positionRemap[b];
+				if (positionA == positionB)
+					continue;
+
+				Quadric merged = quadrics[positionA];
+				AddQuadric(merged, quadrics[positionB]);
+
+				float errorAB = CanCollapse(topology, a, b) ? QuadricError(merged, positions[b]) : FLT_MAX;
+				float errorBA = CanCollapse(topology, b, a) ? QuadricError(merged, positions[a]) : FLT_MAX;
+
+				if (errorAB <= errorBA && errorAB < FLT_MAX)
+					collapses.push_back({ a, b, errorAB });
+				else if (errorBA < errorAB)
+					collapses.push_back({ b, a, errorBA });
+			}
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const EdgeCollapse& x, const EdgeCollapse& y) { return x.error < y.error; });
+
+		// Most collapses remove two triangles, so don't go much further than needed
+		int collapseLimit = std::max(1, (triangleCount - targetIndexCount / 3) / 2);
+		int collapseCount = 0;
+
+		for (int i = 0; i < numVertices; i++)
+			collapseRemap[i] = i;
+		collapseLocked.assign(numVertices, false);
+
+		for (size_t i = 0; i < collapses.size() && collapseCount < collapseLimit; i++)
+		{
+			const EdgeCollapse& collapse = collapses[i];
+			unsigned int positionV = positionRemap[collapse.v];
+			unsigned int positionTarget = positionRemap[collapse.target];
+			if (collapseLocked[positionV] || collapseLocked[positionTarget])
+				continue;
+
+			if (!FindCollapseMoves(topology, positionRemap, twins, collapse.v, collapse.target, moves))
+				continue;
+
+			bool flips = false;
+			for (size_t m = 0; m < moves.size() && !flips; m++)
+				flips = CollapseFlipsTriangle(result, topology.triangleOffsets, topology.triangles, collapseRemap, positions, moves[m].v, moves[m].target);
+			if (flips)
+				continue;
+
+			for (size_t m = 0; m < moves.size(); m++)
+				collapseRemap[moves[m].v] = moves[m].target;
+
+			AddQuadric(quadrics[positionTarget], quadrics[positionV]);
+			collapseLocked[positionV] = true;
+			collapseLocked[positionTarget] = true;
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Apply the collapses, dropping the triangles that closed up
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			unsigned int a = collapseRemap[result[i]];
+			unsigned int b = collapseRemap[result[i + 1]];
+			unsigned int c = collapseRemap[result[i + 2]];
+			if (positionRemap[a] == positionRemap[b] || positionRemap[b] == positionRemap[c] || positionRemap[c] == positionRemap[a])
+				continue;
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+
+		// Never simplify a mesh away entirely (nothing was overwritten yet)
+		if (write == 0)
+			break;
+		result.resize(write);
+
+		for (int i = 0; i < numVertices; i++)
+			finalVertex[i] = collapseRemap[finalVertex[i]];
+
+		BuildTopology(result, positionRemap, twins, topology);
+	}
+
+	return MeasureSimplifiedError(indices, numIndices, result, positions, positionRemap, finalVertex) * extent;
+}
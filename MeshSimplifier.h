@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Vertex.h"
+#include <vector>
+
+// --------------------------------------------------------
+// One level of detail of a mesh, stored as a range of the
+// mesh's index buffer - every level shares the same vertices
+//
+// - error is how far (in model units) the level's surface
+//   has moved away from the full-detail one, so it can be
+//   projected onto the screen to choose between levels
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+	float error;
+};
+
+// --------------------------------------------------------
+// Reduces a triangle list by collapsing the edges with the
+// lowest quadric error (Garland and Heckbert)
+//
+// - A collapse merges a vertex into one of its neighbors,
+//   so no vertices are moved or created and the result
+//   indexes the same vertex buffer as the input
+// - Open borders and UV/normal seams (vertices that share a
+//   position but not their other attributes) can only slide
+//   along themselves, so they keep their shape and the mesh
+//   never tears open; more complex vertices are locked
+// - Stops once targetIndexCount is reached, or nothing else
+//   can be collapsed, and returns how far the original
+//   vertices were measured to be from the result
+// --------------------------------------------------------
+float SimplifyMesh(const unsigned int* indices, int numIndices, const Vertex* vertices, int numVertices,
+	int targetIndexCount, std::vector<unsigned int>& result);
@@ -0,0 +1,526 @@
+#include "ObjParser.h"
+#include "MemoryMappedFile.h"
+#include "ParallelFor.h"
+
+#include <cstdint>
+#include <cstring>
+
+using namespace DirectX;
+
+// Powers of ten that are exactly representable as doubles, so scaling
+// a mantissa by one of them only rounds once
+static const double powersOfTen[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+	1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+static inline bool IsDigit(char c) { return (unsigned char)(c - '0') < 10; }
+static inline bool IsNumberStart(char c) { return IsDigit(c) || c == '-' || c == '+' || c == '.'; }
+
+static inline const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && IsSpace(*p)) p++;
+	return p;
+}
+
+// Moves to the first character of the next line
+static inline const char* SkipLine(const char* p, const char* end)
+{
+	while (p < end && *p != '\n') p++;
+	return p < end ? p + 1 : end;
+}
+
+// --------------------------------------------------------
+// Reads a decimal float such as "-1.25", "3" or "6.1e-05"
+//
+// - Up to 19 significant digits are gathered into an integer
+//   and scaled by a power of ten once at the end, which gives
+//   the same value sscanf would for any sensible OBJ data
+// - Anything that isn't a number reads as zero
+// --------------------------------------------------------
+static const char* ParseFloat(const char* p, const char* end, float& out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+
+	// Whole part
+	for (; p < end && IsDigit(*p); p++)
+	{
+		if (significantDigits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa) significantDigits++;
+		}
+		else
+			exponent++;
+	}
+
+	// Fractional part
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && IsDigit(*p); p++)
+		{
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) significantDigits++;
+				exponent--;
+			}
+		}
+	}
+
+	// Scientific notation
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+		{
+			negativeExponent = *e == '-';
+			e++;
+		}
+
+		if (e < end && IsDigit(*e))
+		{
+			int value = 0;
+			for (; e < end && IsDigit(*e); e++)
+			{
+				if (value < 10000) value = value * 10 + (*e - '0');
+			}
+			exponent += negativeExponent ? -value : value;
+			p = e;
+		}
+	}
+
+	double result = (double)mantissa;
+	if (mantissa != 0)
+	{
+		while (exponent > 22) { result *= powersOfTen[22]; exponent -= 22; }
+		while (exponent < -22) { result /= powersOfTen[22]; exponent += 22; }
+		if (exponent > 0) result *= powersOfTen[exponent];
+		else if (exponent < 0) result /= powersOfTen[-exponent];
+	}
+
+	out = (float)(negative ? -result : result);
+	return p;
+}
+
+// Reads an optionally signed decimal integer
+static const char* ParseInt(const char* p, const char* end, long long& out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	long long value = 0;
+	for (; p < end && IsDigit(*p); p++)
+	{
+		if (value < INT32_MAX) value = value * 10 + (*p - '0');
+	}
+
+	out = negative ? -value : value;
+	return p;
+}
+
+// Converts an OBJ index (1-based, or negative to count back from the
+// most recent element) into a zero-based index, or -1 if it's invalid
+// (including anything too big for an int, rather than wrapping it)
+static inline int ResolveIndex(long long index, size_t count)
+{
+	long long resolved = -1;
+	if (index > 0) resolved = index - 1;
+	else if (index < 0 && -index <= (long long)count) resolved = (long long)count + index;
+	return resolved <= INT32_MAX ? (int)resolved : -1;
+}
+
+// How many of each element a range of the file contains (or precedes it)
+struct ObjCounts
+{
+	size_t positions;
+	size_t normals;
+	size_t uvs;
+};
+
+// The kinds of lines the parser cares about
+enum ObjLineType
+{
+	OBJ_LINE_OTHER,
+	OBJ_LINE_POSITION,	// "v x y z"
+	OBJ_LINE_NORMAL,	// "vn x y z"
+	OBJ_LINE_UV,		// "vt u v"
+	OBJ_LINE_FACE		// "f ..."
+};
+
+// Works out what a line holds from its first few characters, returning
+// the line type and setting "body" to the start of the line's data
+static inline ObjLineType ClassifyLine(const char* p, const char* end, const char*& body)
+{
+	if (p[0] == 'v' && p + 1 < end)
+	{
+		if (IsSpace(p[1])) { body = p + 2; return OBJ_LINE_POSITION; }
+		if (p + 2 < end && IsSpace(p[2]))
+		{
+			body = p + 3;
+			if (p[1] == 'n') return OBJ_LINE_NORMAL;
+			if (p[1] == 't') return OBJ_LINE_UV;
+		}
+	}
+	else if (p[0] == 'f' && p + 1 < end && IsSpace(p[1]))
+	{
+		body = p + 2;
+		return OBJ_LINE_FACE;
+	}
+
+	body = p;
+	return OBJ_LINE_OTHER;
+}
+
+// --------------------------------------------------------
+// Reads the corners of a single "f" line, splitting polygons
+// with more than three corners into a fan of triangles
+//
+// - Handles "p", "p/t", "p//n" and "p/t/n" corners
+// - Arbitrarily long polygons are fine, since only the first
+//   and previous corners are needed to emit each triangle
+// --------------------------------------------------------
+static const char* ParseFace(const char* p, const char* end, ObjData& out, const ObjCounts& base)
+{
+	ObjCorner first = {};
+	ObjCorner previous = {};
+	int cornerCount = 0;
+
+	while (true)
+	{
+		p = SkipSpaces(p, end);
+		if (p >= end || !IsNumberStart(*p))
+			break;
+
+		long long index = 0;
+		ObjCorner corner = { -1, -1, -1 };
+
+		p = ParseInt(p, end, index);
+		corner.position = ResolveIndex(index, base.positions + out.positions.size());
+
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (p < end && *p != '/' && IsNumberStart(*p))
+			{
+				p = ParseInt(p, end, index);
+				corner.uv = ResolveIndex(index, base.uvs + out.uvs.size());
+			}
+
+			if (p < end && *p == '/')
+			{
+				p++;
+				if (p < end && IsNumberStart(*p))
+				{
+					p = ParseInt(p, end, index);
+					corner.normal = ResolveIndex(index, base.normals + out.normals.size());
+				}
+			}
+		}
+
+		// Skip anything else glued onto this corner
+		while (p < end && !IsSpace(*p) && *p != '\r' && *p != '\n') p++;
+
+		if (cornerCount == 0)
+			first = corner;
+		else if (cornerCount >= 2)
+		{
+			out.corners.push_back(first);
+			out.corners.push_back(previous);
+			out.corners.push_back(corner);
+		}
+
+		previous = corner;
+		cornerCount++;
+	}
+
+	return p;
+}
+
+// --------------------------------------------------------
+// Counts the positions, normals and uvs in a range without
+// parsing any numbers, so later ranges know where their
+// elements will end up
+// --------------------------------------------------------
+static ObjCounts CountObjElements(const char* p, const char* end)
+{
+	ObjCounts counts = {};
+
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p >= end)
+			break;
+
+		const char* body;
+		switch (ClassifyLine(p, end, body))
+		{
+		case OBJ_LINE_POSITION: counts.positions++; break;
+		case OBJ_LINE_NORMAL: counts.normals++; break;
+		case OBJ_LINE_UV: counts.uvs++; break;
+		default: break;
+		}
+
+		p = SkipLine(body, end);
+	}
+
+	return counts;
+}
+
+// --------------------------------------------------------
+// Parses one range of lines into its own ObjData
+//
+// - "base" is how many of each element come before this
+//   range without already being in "out", which is needed to
+//   resolve relative indices when chunks are parsed apart
+// --------------------------------------------------------
+static void ParseObjRange(const char* p, const char* end, ObjData& out, const ObjCounts& base)
+{
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p >= end)
+			break;
+
+		const char* body;
+		switch (ClassifyLine(p, end, body))
+		{
+		case OBJ_LINE_POSITION:
+		{
+			XMFLOAT3 pos;
+			p = SkipSpaces(body, end);
+			p = ParseFloat(p, end, pos.x); p = SkipSpaces(p, end);
+			p = ParseFloat(p, end, pos.y); p = SkipSpaces(p, end);
+			p = ParseFloat(p, end, pos.z);
+			out.positions.push_back(pos);
+			break;
+		}
+
+		case OBJ_LINE_NORMAL:
+		{
+			XMFLOAT3 norm;
+			p = SkipSpaces(body, end);
+			p = ParseFloat(p, end, norm.x); p = SkipSpaces(p, end);
+			p = ParseFloat(p, end, norm.y); p = SkipSpaces(p, end);
+			p = ParseFloat(p, end, norm.z);
+			out.normals.push_back(norm);
+			break;
+		}
+
+		case OBJ_LINE_UV:
+		{
+			XMFLOAT2 uv;
+			p = SkipSpaces(body, end);
+			p = ParseFloat(p, end, uv.x); p = SkipSpaces(p, end);
+			p = ParseFloat(p, end, uv.y);
+			out.uvs.push_back(uv);
+			break;
+		}
+
+		case OBJ_LINE_FACE:
+			p = ParseFace(body, end, out, base);
+			break;
+
+		default:
+			// Comments, groups, materials and anything else are ignored
+			break;
+		}
+
+		p = SkipLine(p, end);
+	}
+}
+
+// Copies one chunk's array into its slot of the merged array
+template<typename T>
+static void CopyChunk(const std::vector<T>& source, std::vector<T>& destination, size_t offset)
+{
+	if (!source.empty())
+		memcpy(&destination[offset], &source[0], source.size() * sizeof(T));
+}
+
+void ParseObj(const char* begin, const char* end, ObjData& out, int threadCount)
+{
+	size_t size = end - begin;
+	out.sourceBytes += size;
+
+	// Anything already in the output comes before this text
+	ObjCounts start = { out.positions.size(), out.normals.size(), out.uvs.size() };
+
+	// Small files aren't worth splitting up
+	if (threadCount <= 0)
+		threadCount = GetDefaultThreadCount();
+	size_t chunkCount = size / OBJ_MIN_CHUNK_BYTES;
+	if (chunkCount > (size_t)threadCount) chunkCount = (size_t)threadCount;
+	if (chunkCount <= 1)
+	{
+		// Parsing straight into the output, whose earlier elements
+		// ParseFace() already counts, so nothing else comes before
+		ObjCounts none = {};
+		ParseObjRange(begin, end, out, none);
+		return;
+	}
+
+	// Split the text into roughly equal chunks that each end on a line break
+	std::vector<const char*> splits(chunkCount + 1);
+	splits[0] = begin;
+	splits[chunkCount] = end;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		const char* p = begin + size / chunkCount * i;
+		splits[i] = p < splits[i - 1] ? splits[i - 1] : SkipLine(p, end);
+	}
+
+	// First pass: count what each chunk contains, then prefix sum the
+	// counts so each chunk knows how many elements precede it
+	std::vector<ObjCounts> counts(chunkCount);
+	ParallelFor((int)chunkCount, [&](int i)
+	{
+		counts[i] = CountObjElements(splits[i], splits[i + 1]);
+	}, threadCount);
+
+	std::vector<ObjCounts> bases(chunkCount);
+	bases[0] = start;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		bases[i].positions = bases[i - 1].positions + counts[i - 1].positions;
+		bases[i].normals = bases[i - 1].normals + counts[i - 1].normals;
+		bases[i].uvs = bases[i - 1].uvs + counts[i - 1].uvs;
+	}
+
+	// Second pass: parse every chunk independently
+	std::vector<ObjData> chunks(chunkCount);
+	ParallelFor((int)chunkCount, [&](int i)
+	{
+		chunks[i].positions.reserve(counts[i].positions);
+		chunks[i].normals.reserve(counts[i].normals);
+		chunks[i].uvs.reserve(counts[i].uvs);
+		ParseObjRange(splits[i], splits[i + 1], chunks[i], bases[i]);
+	}, threadCount);
+
+	// Corners can only be counted after parsing, so prefix sum those now
+	std::vector<size_t> cornerBases(chunkCount);
+	size_t cornerTotal = out.corners.size();
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		cornerBases[i] = cornerTotal;
+		cornerTotal += chunks[i].corners.size();
+	}
+
+	const ObjCounts& last = bases[chunkCount - 1];
+	out.positions.resize(last.positions + counts[chunkCount - 1].positions);
+	out.normals.resize(last.normals + counts[chunkCount - 1].normals);
+	out.uvs.resize(last.uvs + counts[chunkCount - 1].uvs);
+	out.corners.resize(cornerTotal);
+
+	// Finally, stitch the chunks together
+	ParallelFor((int)chunkCount, [&](int i)
+	{
+		CopyChunk(chunks[i].positions, out.positions, bases[i].positions);
+		CopyChunk(chunks[i].normals, out.normals, bases[i].normals);
+		CopyChunk(chunks[i].uvs, out.uvs, bases[i].uvs);
+		CopyChunk(chunks[i].corners, out.corners, cornerBases[i]);
+
+		// Free each chunk as soon as it's merged to keep peak memory down
+		chunks[i] = ObjData();
+	}, threadCount);
+}
+
+bool LoadObj(const std::wstring& fileName, ObjData& out, int threadCount)
+{
+	MemoryMappedFile file(fileName);
+	if (!file.IsOpen())
+		return false;
+
+	ParseObj(file.GetData(), file.GetData() + file.GetSize(), out, threadCount);
+	return true;
+}
+
+// --------------------------------------------------------
+// Hands each line-aligned window of a file to onText in turn,
+// mapping only that window while it's being used
+// --------------------------------------------------------
+static bool ForEachObjWindow(MemoryMappedFile& file, size_t windowBytes,
+	const std::function<void(const char*, const char*)>& onText)
+{
+	size_t offset = 0;
+	size_t length = windowBytes;
+	while (offset < file.GetSize())
+	{
+		const char* begin = file.MapRange(offset, length);
+		if (!begin)
+			return false;
+
+		// Leave any partial line at the end for the next window
+		bool lastWindow = file.GetSize() - offset <= length;
+		const char* end = begin + (lastWindow ? file.GetSize() - offset : length);
+		if (!lastWindow)
+		{
+			while (end > begin && end[-1] != '\n')
+				end--;
+
+			// A line longer than the whole window needs a bigger one
+			if (end == begin)
+			{
+				length *= 2;
+				continue;
+			}
+		}
+
+		onText(begin, end);
+
+		offset += end - begin;
+		length = windowBytes;
+	}
+
+	return true;
+}
+
+bool StreamObj(const std::wstring& fileName, size_t windowBytes, ObjData& out,
+	const std::function<void(ObjData&)>& onWindow, int threadCount)
+{
+	MemoryMappedFile file(fileName, false);
+	if (!file.IsOpen())
+		return false;
+
+	// Counting everything first (which is much quicker than parsing) lets
+	// the arrays be allocated once at their final size, instead of growing
+	// to as much as twice that
+	ObjCounts counts = {};
+	bool counted = ForEachObjWindow(file, windowBytes, [&](const char* begin, const char* end)
+	{
+		ObjCounts windowCounts = CountObjElements(begin, end);
+		counts.positions += windowCounts.positions;
+		counts.normals += windowCounts.normals;
+		counts.uvs += windowCounts.uvs;
+	});
+	if (!counted)
+		return false;
+
+	out.positions.reserve(out.positions.size() + counts.positions);
+	out.normals.reserve(out.normals.size() + counts.normals);
+	out.uvs.reserve(out.uvs.size() + counts.uvs);
+
+	return ForEachObjWindow(file, windowBytes, [&](const char* begin, const char* end)
+	{
+		ParseObj(begin, end, out, threadCount);
+		onWindow(out);
+		out.corners.clear();
+	});
+}
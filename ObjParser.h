@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+// --------------------------------------------------------
+// One corner of an OBJ face, stored as zero-based indices
+// into the arrays of an ObjData
+//
+// - uv and normal are -1 when the face didn't specify them
+// - Relative (negative) indices are already resolved
+// --------------------------------------------------------
+struct ObjCorner
+{
+	int position;
+	int uv;
+	int normal;
+};
+
+// --------------------------------------------------------
+// The raw contents of an OBJ file, exactly as written
+//
+// - Faces are triangulated as fans, so every three corners
+//   make up one triangle in the file's own winding order
+// - No handedness conversion has been applied yet
+// --------------------------------------------------------
+struct ObjData
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	std::vector<ObjCorner> corners;
+
+	size_t sourceBytes; // Size of the text that was parsed
+};
+
+// Files are only split across threads in chunks of at least this size
+#define OBJ_MIN_CHUNK_BYTES (1024 * 1024)
+
+// Memory-maps the file and parses it, returning false if it can't be opened
+bool LoadObj(const std::wstring& fileName, ObjData& out, int threadCount = 0);
+
+// --------------------------------------------------------
+// Parses OBJ text in the range [begin, end), appending to
+// the output
+//
+// - Large inputs are split into line-aligned chunks that are
+//   parsed in parallel and merged in file order, so results
+//   are identical for any thread count
+// - A threadCount of 0 uses every available core
+// --------------------------------------------------------
+void ParseObj(const char* begin, const char* end, ObjData& out, int threadCount = 0);
+
+// --------------------------------------------------------
+// Parses a file one window of text at a time, so only that
+// window (rather than the whole file) is ever mapped
+//
+// - Positions, normals and uvs build up in "out", since any
+//   face may refer back to them, but out.corners only holds
+//   the current window's faces: onWindow is called after
+//   each window is parsed, and the corners are cleared after
+// - Windows end on line breaks, so a window can be a little
+//   shorter than windowBytes (or longer, for a huge line)
+// - The elements are counted in a quick first pass over the
+//   file, so their arrays never need to grow
+// --------------------------------------------------------
+bool StreamObj(const std::wstring& fileName, size_t windowBytes, ObjData& out,
+	const std::function<void(ObjData&)>& onWindow, int threadCount = 0);
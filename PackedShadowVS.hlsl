@@ -0,0 +1,20 @@
+#include "ShaderInclude.hlsli"
+
+// Constant Buffer for external (C++) data
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix view;
+	matrix projection;
+	float3 positionOffset;
+	float3 positionScale;
+};
+
+// Shadow map vertex shader for meshes stored as PackedVertex
+float4 main(PackedPositionOnlyShaderInput input) : SV_POSITION
+{
+	float3 localPosition = positionOffset + input.localPosition.xyz * positionScale;
+
+	matrix wvp = mul(projection, mul(view, world));
+	return mul(wvp, float4(localPosition, 1.0f));
+}
@@ -0,0 +1,170 @@
+#include "PackedVertex.h"
+
+#include <d3dcompiler.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Same conversions the input assembler does for SNORM/UNORM formats
+static short FloatToSnorm16(float value) { return (short)lroundf(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f); }
+static signed char FloatToSnorm8(float value) { return (signed char)lroundf(std::max(-1.0f, std::min(1.0f, value)) * 127.0f); }
+static unsigned short FloatToUnorm16(float value) { return (unsigned short)lroundf(std::max(0.0f, std::min(1.0f, value)) * 65535.0f); }
+static float Snorm16ToFloat(short value) { return std::max(value / 32767.0f, -1.0f); }
+static float Snorm8ToFloat(signed char value) { return std::max(value / 127.0f, -1.0f); }
+static float Unorm16ToFloat(unsigned short value) { return value / 65535.0f; }
+
+XMFLOAT2 EncodeOctahedral(XMFLOAT3 direction)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1
+	float length = fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z);
+	if (length <= 0.0f)
+		return XMFLOAT2(0.0f, 0.0f);
+
+	float x = direction.x / length;
+	float y = direction.y / length;
+
+	// Fold the lower half over the diagonals
+	if (direction.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	return XMFLOAT2(x, y);
+}
+
+XMFLOAT3 DecodeOctahedral(XMFLOAT2 encoded)
+{
+	// Matches DecodeOctahedral() in ShaderInclude.hlsli
+	XMFLOAT3 direction(encoded.x, encoded.y, 1.0f - fabsf(encoded.x) - fabsf(encoded.y));
+	float t = std::max(-direction.z, 0.0f);
+	direction.x += direction.x >= 0.0f ? -t : t;
+	direction.y += direction.y >= 0.0f ? -t : t;
+
+	XMStoreFloat3(&direction, XMVector3Normalize(XMLoadFloat3(&direction)));
+	return direction;
+}
+
+void GetPackedPositionRange(const Vertex* vertices, int numVertices, XMFLOAT3& positionOffset, XMFLOAT3& positionScale)
+{
+	if (numVertices <= 0)
+	{
+		positionOffset = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		positionScale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		return;
+	}
+
+	XMVECTOR minimum = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR maximum = minimum;
+	for (int i = 1; i < numVertices; i++)
+	{
+		XMVECTOR position = XMLoadFloat3(&vertices[i].Position);
+		minimum = XMVectorMin(minimum, position);
+		maximum = XMVectorMax(maximum, position);
+	}
+
+	XMStoreFloat3(&positionOffset, minimum);
+	XMStoreFloat3(&positionScale, XMVectorSubtract(maximum, minimum));
+}
+
+PackedVertex PackVertex(const Vertex& vertex, XMFLOAT3 positionOffset, XMFLOAT3 positionScale, float tangentSign)
+{
+	PackedVertex packed = {};
+
+	// Flat axes (like a quad's) have no scale, so everything maps to 0
+	packed.position[0] = FloatToUnorm16(positionScale.x > 0.0f ? (vertex.Position.x - positionOffset.x) / positionScale.x : 0.0f);
+	packed.position[1] = FloatToUnorm16(positionScale.y > 0.0f ? (vertex.Position.y - positionOffset.y) / positionScale.y : 0.0f);
+	packed.position[2] = FloatToUnorm16(positionScale.z > 0.0f ? (vertex.Position.z - positionOffset.z) / positionScale.z : 0.0f);
+
+	XMFLOAT2 normal = EncodeOctahedral(vertex.normal);
+	packed.normal[0] = FloatToSnorm16(normal.x);
+	packed.normal[1] = FloatToSnorm16(normal.y);
+
+	XMFLOAT2 tangent = EncodeOctahedral(vertex.tangent);
+	packed.tangent[0] = FloatToSnorm8(tangent.x);
+	packed.tangent[1] = FloatToSnorm8(tangent.y);
+	packed.tangent[2] = tangentSign < 0.0f ? -127 : 127;
+
+	packed.uv[0] = XMConvertFloatToHalf(vertex.uv.x);
+	packed.uv[1] = XMConvertFloatToHalf(vertex.uv.y);
+
+	return packed;
+}
+
+Vertex UnpackVertex(const PackedVertex& packed, XMFLOAT3 positionOffset, XMFLOAT3 positionScale, float* tangentSign)
+{
+	Vertex vertex = {};
+	vertex.Position.x = positionOffset.x + Unorm16ToFloat(packed.position[0]) * positionScale.x;
+	vertex.Position.y = positionOffset.y + Unorm16ToFloat(packed.position[1]) * positionScale.y;
+	vertex.Position.z = positionOffset.z + Unorm16ToFloat(packed.position[2]) * positionScale.z;
+
+	vertex.normal = DecodeOctahedral(XMFLOAT2(Snorm16ToFloat(packed.normal[0]), Snorm16ToFloat(packed.normal[1])));
+	vertex.tangent = DecodeOctahedral(XMFLOAT2(Snorm8ToFloat(packed.tangent[0]), Snorm8ToFloat(packed.tangent[1])));
+
+	vertex.uv.x = XMConvertHalfToFloat(packed.uv[0]);
+	vertex.uv.y = XMConvertHalfToFloat(packed.uv[1]);
+
+	if (tangentSign)
+		*tangentSign = packed.tangent[2] < 0 ? -1.0f : 1.0f;
+
+	return vertex;
+}
+
+Microsoft::WRL::ComPtr<ID3D11InputLayout> CreatePackedVertexInputLayout(Microsoft::WRL::ComPtr<ID3D11Device> device, LPCWSTR shaderFile)
+{
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	if (FAILED(D3DReadFileToBlob(shaderFile, shaderBlob.GetAddressOf())))
+		return inputLayout;
+
+	D3D11_INPUT_ELEMENT_DESC elements[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(PackedVertex, position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(PackedVertex, normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, offsetof(PackedVertex, tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(PackedVertex, uv), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	// Leave out whatever the shader doesn't read, so a position-only
+	// shader's layout also fits a mesh's (narrower) position stream
+	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
+	D3DReflect(
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		IID_ID3D11ShaderReflection,
+		(void**)refl.GetAddressOf());
+
+	D3D11_SHADER_DESC shaderDesc;
+	refl->GetDesc(&shaderDesc);
+
+	std::vector<D3D11_INPUT_ELEMENT_DESC> usedElements;
+	for (const D3D11_INPUT_ELEMENT_DESC& element : elements)
+	{
+		for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+		{
+			D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+			refl->GetInputParameterDesc(i, &paramDesc);
+			if (_stricmp(paramDesc.SemanticName, element.SemanticName) == 0)
+			{
+				usedElements.push_back(element);
+				break;
+			}
+		}
+	}
+
+	device->CreateInputLayout(
+		usedElements.data(),
+		(UINT)usedElements.size(),
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		inputLayout.GetAddressOf());
+
+	return inputLayout;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include "Vertex.h"
+
+// Which layout a mesh's vertex buffer is stored in
+enum class MeshVertexFormat
+{
+	Full,	// Vertex - 44 bytes of plain floats
+	Packed	// PackedVertex - 20 bytes, decoded in the vertex shader
+};
+
+// --------------------------------------------------------
+// A compact vertex definition (20 bytes vs. 44 for Vertex)
+//
+// - Positions are 16-bit UNORM within the mesh's bounds, so
+//   the shader needs the mesh's offset and scale to decode
+// - Normals and tangents are octahedral-encoded unit vectors
+// - Must match PackedVertexShaderInput in ShaderInclude.hlsli
+// --------------------------------------------------------
+struct PackedVertex
+{
+	unsigned short position[4];				// R16G16B16A16_UNORM (w unused)
+	short normal[2];						// R16G16_SNORM octahedral normal
+	signed char tangent[4];					// R8G8B8A8_SNORM octahedral tangent, handedness in z
+	DirectX::PackedVector::HALF uv[2];		// R16G16_FLOAT
+};
+
+// Octahedral mapping between unit vectors and [-1, 1] squares
+DirectX::XMFLOAT2 EncodeOctahedral(DirectX::XMFLOAT3 direction);
+DirectX::XMFLOAT3 DecodeOctahedral(DirectX::XMFLOAT2 encoded);
+
+// Finds the offset and scale that map the vertices' positions into [0, 1]
+void GetPackedPositionRange(const Vertex* vertices, int numVertices, DirectX::XMFLOAT3& positionOffset, DirectX::XMFLOAT3& positionScale);
+
+// Converts between the full and packed formats - the range must come from GetPackedPositionRange()
+PackedVertex PackVertex(const Vertex& vertex, DirectX::XMFLOAT3 positionOffset, DirectX::XMFLOAT3 positionScale, float tangentSign = 1.0f);
+Vertex UnpackVertex(const PackedVertex& packed, DirectX::XMFLOAT3 positionOffset, DirectX::XMFLOAT3 positionScale, float* tangentSign = 0);
+
+// --------------------------------------------------------
+// Creates an input layout describing PackedVertex, checked
+// against the given compiled vertex shader (.cso)
+//
+// - Pass the result to the SimpleVertexShader constructor
+//   that takes an input layout, since reflection would
+//   assume every input is made of 32-bit floats
+// - Only the elements the shader reads are included, so a
+//   shader reading just POSITION can also draw from a
+//   packed mesh's position stream
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11InputLayout> CreatePackedVertexInputLayout(Microsoft::WRL::ComPtr<ID3D11Device> device, LPCWSTR shaderFile);
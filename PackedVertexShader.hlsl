@@ -0,0 +1,41 @@
+#include "ShaderInclude.hlsli"
+
+// Same data as VertexShader.hlsl, plus what's needed to decode positions
+cbuffer ExternalData : register(b0)
+{
+	matrix world;
+	matrix view;
+	matrix proj;
+	matrix worldInvTranspose;
+	matrix lightView;
+	matrix lightProjection;
+	float3 positionOffset;
+	float3 positionScale;
+}
+
+// --------------------------------------------------------
+// Vertex shader for meshes stored as PackedVertex
+//
+// - Unpacks the vertex, then does exactly what the regular
+//   vertex shader does
+// --------------------------------------------------------
+VertexToPixel main( PackedVertexShaderInput packedInput )
+{
+	VertexShaderInput input = DecodePackedVertex(packedInput, positionOffset, positionScale);
+
+	VertexToPixel output;
+	matrix wvp = mul(mul(proj, view), world);
+	output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+
+	output.uv = input.uv;
+
+	output.normal = mul((float3x3)worldInvTranspose, input.normal);
+	output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
+
+	output.tangent = mul((float3x3)world, input.tangent);
+
+	matrix shadowWVP = mul(lightProjection, mul(lightView, world));
+	output.shadowMapPos = mul(shadowWVP, float4(input.localPosition, 1.0f));
+
+	return output;
+}
@@ -0,0 +1,45 @@
+#include "ParallelFor.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+int GetDefaultThreadCount()
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 0 ? (int)cores : 1;
+}
+
+void ParallelFor(int taskCount, const std::function<void(int)>& task, int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = GetDefaultThreadCount();
+	if (threadCount > taskCount)
+		threadCount = taskCount;
+
+	// Not worth spinning up any threads
+	if (threadCount <= 1)
+	{
+		for (int i = 0; i < taskCount; i++)
+			task(i);
+		return;
+	}
+
+	// Each thread keeps grabbing the next unclaimed task until none are left
+	std::atomic<int> nextTask(0);
+	auto worker = [&]()
+	{
+		for (int i = nextTask++; i < taskCount; i = nextTask++)
+			task(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (int i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& t : threads)
+		t.join();
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <functional>
+
+// Number of worker threads to use when the caller doesn't specify one
+int GetDefaultThreadCount();
+
+// --------------------------------------------------------
+// Runs task(0) ... task(taskCount - 1), spread across up to
+// threadCount threads, and returns once all have finished
+//
+// - The calling thread does a share of the work itself
+// - Tasks are handed out in order, but may finish in any
+//   order, so each task must only write its own outputs
+// - A threadCount of 0 uses GetDefaultThreadCount()
+// --------------------------------------------------------
+void ParallelFor(int taskCount, const std::function<void(int)>& task, int threadCount = 0);
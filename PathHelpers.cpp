@@ -2,6 +2,8 @@
 #include <Windows.h>
 #include <codecvt>
 #include <locale>
+#include <algorithm>
+#include <cwctype>
 
 #include "PathHelpers.h"
 
@@ -78,6 +80,33 @@ std::wstring FixPath(const std::wstring& relativeFilePath)
 }
 
 
+// ----------------------------------------------------
+//  Fixes a relative path (see FixPath) and then spells
+//  it the one way any path to the same file would be
+//  spelled, so it can be used as a key for that file:
+//  "." and ".." are resolved, every slash is a backslash
+//  and, as Windows file names ignore case, it's all in
+//  lower case.
+// ----------------------------------------------------
+std::wstring CanonicalPath(const std::wstring& relativeFilePath)
+{
+	std::wstring path = FixPath(relativeFilePath);
+	std::replace(path.begin(), path.end(), L'/', L'\\');
+
+	DWORD length = GetFullPathNameW(path.c_str(), 0, 0, 0);
+	if (length > 0)
+	{
+		std::wstring fullPath(length, L'\0');
+		length = GetFullPathNameW(path.c_str(), length, &fullPath[0], 0);
+		fullPath.resize(length);
+		path = fullPath;
+	}
+
+	std::transform(path.begin(), path.end(), path.begin(), towlower);
+	return path;
+}
+
+
 // ----------------------------------------------------
 //  Helper function for converting a wide character 
 //  string to a standard ("narrow") character string
@@ -7,5 +7,6 @@
 std::string GetExePath();
 std::string FixPath(const std::string& relativeFilePath);
 std::wstring FixPath(const std::wstring& relativeFilePath);
+std::wstring CanonicalPath(const std::wstring& relativeFilePath);
 std::string WideToNarrow(const std::wstring& str);
 std::wstring NarrowToWide(const std::string& str);
\ No newline at end of file
@@ -21,6 +21,49 @@ struct VertexShaderInput
 	float3 tangent			: TANGENT;
 };
 
+// Compact version of VertexShaderInput, matching PackedVertex in PackedVertex.h
+// - Turn it back into a VertexShaderInput with DecodePackedVertex()
+struct PackedVertexShaderInput
+{
+	float4 localPosition	: POSITION;     // XYZ within the mesh's bounds (0-1)
+	float2 normal			: NORMAL;       // Octahedral-encoded
+	float2 uv				: TEXCOORD;
+	float4 tangent			: TANGENT;      // Octahedral-encoded XY, handedness in Z
+};
+
+// Just the positions, for depth-only passes
+// - Position comes first in both vertex formats, so these can read a mesh's
+//   full vertices or its position stream (see Mesh::SetPositionsAndDraw)
+struct PositionOnlyShaderInput
+{
+	float3 localPosition	: POSITION;
+};
+
+struct PackedPositionOnlyShaderInput
+{
+	float4 localPosition	: POSITION;     // XYZ within the mesh's bounds (0-1)
+};
+
+// Turns an octahedral-encoded [-1, 1] pair back into a unit vector
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 direction = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float t = saturate(-direction.z);
+	direction.xy += (direction.xy >= 0.0f) ? -t : t;
+	return normalize(direction);
+}
+
+// Expands a packed vertex using the mesh's position offset and scale
+VertexShaderInput DecodePackedVertex(PackedVertexShaderInput input, float3 positionOffset, float3 positionScale)
+{
+	VertexShaderInput output;
+	output.localPosition = positionOffset + input.localPosition.xyz * positionScale;
+	output.normal = DecodeOctahedral(input.normal);
+	output.uv = input.uv;
+	output.tangent = DecodeOctahedral(input.tangent.xy);
+	return output;
+}
+
 // Struct representing the data we're sending down the pipeline
 // - Should match our pixel shader's input (hence the name: Vertex to Pixel)
 // - At a minimum, we need a piece of data defined tagged as SV_POSITION
@@ -9,7 +9,7 @@ cbuffer externalData : register(b0)
 };
 
 // A simplified vertex shader for rendering to a shadow map
-float4 main(VertexShaderInput input) : SV_POSITION
+float4 main(PositionOnlyShaderInput input) : SV_POSITION
 {
 	matrix wvp = mul(projection, mul(view, world));
 	return mul(wvp, float4(input.localPosition, 1.0f));
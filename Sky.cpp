@@ -1,11 +1,11 @@
 #include "Sky.h"
 #include "WICTextureLoader.h"
 
-Sky::Sky(Mesh skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState, 
+Sky::Sky(std::shared_ptr<Mesh> skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState, 
 	Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const wchar_t* right, const wchar_t* left,
 	const wchar_t* up, const wchar_t* down, const wchar_t* front, const wchar_t* back, 
 	std::shared_ptr<SimpleVertexShader> vertexShader, std::shared_ptr<SimplePixelShader> pixelShader) : 
-	skyMesh(std::make_shared<Mesh>(skyMesh)),
+	skyMesh(skyMesh),
 	samplerState(samplerState),
 	device(device),
 	context(context),
@@ -29,7 +29,7 @@ Sky::~Sky()
 {
 }
 
-void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera camera)
+void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Camera& camera)
 {
 	//Change the necessary render states
 	this->context->RSSetState(rastOptions.Get());
@@ -40,8 +40,8 @@ void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera camer
 	skyVertexShader->SetShader();
 
 	//Set the view and projection matrices for the vertex shader
-	skyVertexShader->SetMatrix4x4("view", camera.GetView());
-	skyVertexShader->SetMatrix4x4("proj", camera.GetProjection());
+	skyVertexShader->SetMatrix4x4("view", &camera.GetView()._11);
+	skyVertexShader->SetMatrix4x4("proj", &camera.GetProjection()._11);
 	skyVertexShader->CopyAllBufferData();
 
 	//Set the appropriate SamplerState and SRV for the pixel shader
@@ -12,14 +12,14 @@ class Sky
 {
 public:
 
-	Sky(Mesh skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState,
+	Sky(std::shared_ptr<Mesh> skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState,
 		Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const wchar_t* right, const wchar_t* left,
 		const wchar_t* up, const wchar_t* down, const wchar_t* front, const wchar_t* back,
 		std::shared_ptr<SimpleVertexShader> vertexShader, std::shared_ptr<SimplePixelShader> pixelShader);
 
 	~Sky();
 
-	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera camera);
+	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Camera& camera);
 
 	// Helper for creating a cubemap from 6 individual textures
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
@@ -0,0 +1,103 @@
+#include "TestFramework.h"
+#include "../Bounds.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// A rotation, scale and translation, each picked at random
+static XMMATRIX RandomTRS(std::mt19937& random, float minScale, float maxScale)
+{
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scale(minScale, maxScale);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	return XMMatrixScaling(scale(random), scale(random), scale(random)) *
+		XMMatrixRotationRollPitchYaw(angle(random), angle(random), angle(random)) *
+		XMMatrixTranslation(position(random), position(random), position(random));
+}
+
+// The longest of the first three rows, which is what the sphere used to be scaled by
+static float LongestRow(FXMMATRIX m)
+{
+	return sqrtf(std::max(XMVectorGetX(XMVector3LengthSq(m.r[0])),
+		std::max(XMVectorGetX(XMVector3LengthSq(m.r[1])), XMVectorGetX(XMVector3LengthSq(m.r[2])))));
+}
+
+TEST(MaxScaleBoundsEveryDirection)
+{
+	std::mt19937 random(51);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	float worstUnsheared = 0.0f;
+	int pastLongestRow = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		// A rotated child under a non-uniformly scaled parent, which shears it
+		XMMATRIX child = RandomTRS(random, 0.2f, 5.0f);
+		XMMATRIX parent = RandomTRS(random, 0.2f, 5.0f);
+		XMMATRIX world = child * parent;
+		XMFLOAT4X4 matrix;
+		XMStoreFloat4x4(&matrix, world);
+		float maxScale = ComputeMaxScale(matrix);
+
+		// Nothing is stretched further than that
+		float stretch = 0.0f;
+		for (int d = 0; d < 200; d++)
+		{
+			XMVECTOR direction = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0));
+			stretch = std::max(stretch, XMVectorGetX(XMVector3Length(XMVector3TransformNormal(direction, world))));
+		}
+		CHECK(stretch <= maxScale * 1.0001f);
+		pastLongestRow += stretch > LongestRow(world) * 1.0001f;
+
+		// Without shear it's just the longest row
+		XMStoreFloat4x4(&matrix, child);
+		worstUnsheared = std::max(worstUnsheared, fabsf(ComputeMaxScale(matrix) / LongestRow(child) - 1.0f));
+	}
+
+	printf("  %d of 2000 sheared matrices stretch past their longest row, worst unsheared error %g\n", pastLongestRow, worstUnsheared);
+	CHECK(pastLongestRow > 100);
+	CHECK(worstUnsheared < 1e-5f);
+}
+
+TEST(TransformedBoundsHoldTransformedPoints)
+{
+	std::mt19937 random(52);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<XMFLOAT3> points(100);
+
+	int outsideSphere = 0;
+	int outsideBox = 0;
+	for (int i = 0; i < 500; i++)
+	{
+		// Long thin point clouds, which a shear stretches most along their diagonal
+		XMFLOAT3 size(1.0f + fabsf(unit(random)) * 10.0f, 0.1f, 0.1f);
+		XMMATRIX shape = XMMatrixRotationRollPitchYaw(unit(random) * XM_PI, unit(random) * XM_PI, unit(random) * XM_PI);
+		for (XMFLOAT3& point : points)
+			XMStoreFloat3(&point, XMVector3TransformNormal(XMVectorSet(unit(random) * size.x, unit(random) * size.y, unit(random) * size.z, 0), shape));
+		Bounds bounds = ComputeBounds(points.data(), (int)points.size(), sizeof(XMFLOAT3));
+
+		XMMATRIX world = RandomTRS(random, 0.5f, 2.0f) * RandomTRS(random, 0.2f, 5.0f);
+		XMFLOAT4X4 matrix;
+		XMStoreFloat4x4(&matrix, world);
+		Bounds transformed = TransformBounds(bounds, matrix);
+
+		for (const XMFLOAT3& point : points)
+		{
+			XMFLOAT3 p;
+			XMStoreFloat3(&p, XMVector3TransformCoord(XMLoadFloat3(&point), world));
+			XMVECTOR offset = XMLoadFloat3(&p) - XMLoadFloat3(&transformed.sphereCenter);
+			float tolerance = transformed.sphereRadius * 1e-5f;
+			outsideSphere += XMVectorGetX(XMVector3Length(offset)) > transformed.sphereRadius + tolerance;
+			outsideBox += p.x < transformed.boxMin.x - tolerance || p.x > transformed.boxMax.x + tolerance ||
+				p.y < transformed.boxMin.y - tolerance || p.y > transformed.boxMax.y + tolerance ||
+				p.z < transformed.boxMin.z - tolerance || p.z > transformed.boxMax.z + tolerance;
+		}
+	}
+
+	CHECK(outsideSphere == 0);
+	CHECK(outsideBox == 0);
+}
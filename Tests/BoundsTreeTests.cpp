@@ -0,0 +1,395 @@
+#include "TestFramework.h"
+#include "../BoundsTree.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// Objects the size of props, scattered through a 1000 unit cube: either around a
+// ball (a box just around the sphere) or a block (a sphere just around the box)
+static Bounds RandomBounds(std::mt19937& random, float spread = 500.0f)
+{
+	std::uniform_real_distribution<float> position(-spread, spread);
+	std::uniform_real_distribution<float> size(0.5f, 10.0f);
+
+	XMFLOAT3 center(position(random), position(random), position(random));
+	XMFLOAT3 extent(size(random), size(random), size(random));
+	float radius;
+	if (random() % 2)
+	{
+		radius = extent.x;
+		extent = XMFLOAT3(extent.x, extent.x, extent.x);
+	}
+	else
+		radius = sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+
+	Bounds bounds;
+	bounds.boxMin = XMFLOAT3(center.x - extent.x, center.y - extent.y, center.z - extent.z);
+	bounds.boxMax = XMFLOAT3(center.x + extent.x, center.y + extent.y, center.z + extent.z);
+	bounds.sphereCenter = center;
+	bounds.sphereRadius = radius;
+	return bounds;
+}
+
+// The same bounds, moved
+static Bounds Moved(const Bounds& bounds, XMFLOAT3 offset)
+{
+	Bounds moved = bounds;
+	moved.boxMin = XMFLOAT3(bounds.boxMin.x + offset.x, bounds.boxMin.y + offset.y, bounds.boxMin.z + offset.z);
+	moved.boxMax = XMFLOAT3(bounds.boxMax.x + offset.x, bounds.boxMax.y + offset.y, bounds.boxMax.z + offset.z);
+	moved.sphereCenter = XMFLOAT3(bounds.sphereCenter.x + offset.x, bounds.sphereCenter.y + offset.y, bounds.sphereCenter.z + offset.z);
+	return moved;
+}
+
+static Frustum RandomFrustum(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 1);
+	XMVECTOR direction = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0));
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection,
+		XMMatrixLookToLH(eye, direction, XMVectorSet(0, 1, 0, 0)) *
+		XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 300.0f));
+	return ExtractFrustum(viewProjection);
+}
+
+// --------------------------------------------------------
+// What each query should find, testing every object
+// --------------------------------------------------------
+static bool InFrustum(const Frustum& frustum, const Bounds& bounds)
+{
+	XMFLOAT3 center((bounds.boxMin.x + bounds.boxMax.x) * 0.5f, (bounds.boxMin.y + bounds.boxMax.y) * 0.5f, (bounds.boxMin.z + bounds.boxMax.z) * 0.5f);
+	XMFLOAT3 extent((bounds.boxMax.x - bounds.boxMin.x) * 0.5f, (bounds.boxMax.y - bounds.boxMin.y) * 0.5f, (bounds.boxMax.z - bounds.boxMin.z) * 0.5f);
+	for (const XMFLOAT4& plane : frustum.planes)
+	{
+		const XMFLOAT3& sphere = bounds.sphereCenter;
+		if (plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w < -bounds.sphereRadius)
+			return false;
+
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float reach = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+		if (distance < -reach)
+			return false;
+	}
+
+	return true;
+}
+
+static bool InBox(const Bounds& bounds, XMFLOAT3 boxMin, XMFLOAT3 boxMax)
+{
+	return bounds.boxMin.x <= boxMax.x && bounds.boxMax.x >= boxMin.x &&
+		bounds.boxMin.y <= boxMax.y && bounds.boxMax.y >= boxMin.y &&
+		bounds.boxMin.z <= boxMax.z && bounds.boxMax.z >= boxMin.z;
+}
+
+static bool InSphere(const Bounds& bounds, XMFLOAT3 center, float radius)
+{
+	float x = center.x - std::min(std::max(center.x, bounds.boxMin.x), bounds.boxMax.x);
+	float y = center.y - std::min(std::max(center.y, bounds.boxMin.y), bounds.boxMax.y);
+	float z = center.z - std::min(std::max(center.z, bounds.boxMin.z), bounds.boxMax.z);
+	return x * x + y * y + z * z <= radius * radius;
+}
+
+// Where the ray enters the box (0 if it starts inside), or -1 if it doesn't before maxDistance
+static float RayDistance(const Bounds& bounds, XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance)
+{
+	float enter = 0.0f;
+	float exit = maxDistance;
+	const float* boxMin = &bounds.boxMin.x;
+	const float* boxMax = &bounds.boxMax.x;
+	const float* o = &origin.x;
+	const float* d = &direction.x;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float t0 = (boxMin[axis] - o[axis]) / d[axis];
+		float t1 = (boxMax[axis] - o[axis]) / d[axis];
+		enter = std::max(enter, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+	}
+
+	return enter <= exit ? enter : -1.0f;
+}
+
+// Runs every kind of query against the tree and against every object, returning how many disagreed
+static int CompareQueries(const BoundsTree& tree, const std::vector<Bounds>& bounds, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> position(-520.0f, 520.0f);
+	std::uniform_real_distribution<float> size(1.0f, 80.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<unsigned int> results, expected;
+	int mismatches = 0;
+
+	// Results are sets, in whatever order the tree found them
+	auto compare = [&]()
+	{
+		std::sort(results.begin(), results.end());
+		mismatches += results != expected;
+	};
+
+	for (int query = 0; query < 20; query++)
+	{
+		Frustum frustum = RandomFrustum(random);
+		tree.QueryFrustum(frustum, results);
+		expected.clear();
+		for (unsigned int i = 0; i < bounds.size(); i++)
+			if (InFrustum(frustum, bounds[i]))
+				expected.push_back(i);
+		compare();
+
+		XMFLOAT3 center(position(random), position(random), position(random));
+		XMFLOAT3 extent(size(random), size(random), size(random));
+		XMFLOAT3 boxMin(center.x - extent.x, center.y - extent.y, center.z - extent.z);
+		XMFLOAT3 boxMax(center.x + extent.x, center.y + extent.y, center.z + extent.z);
+		tree.QueryBox(boxMin, boxMax, results);
+		expected.clear();
+		for (unsigned int i = 0; i < bounds.size(); i++)
+			if (InBox(bounds[i], boxMin, boxMax))
+				expected.push_back(i);
+		compare();
+
+		float radius = size(random);
+		tree.QuerySphere(center, radius, results);
+		expected.clear();
+		for (unsigned int i = 0; i < bounds.size(); i++)
+			if (InSphere(bounds[i], center, radius))
+				expected.push_back(i);
+		compare();
+
+		// Rays from anywhere, some reaching right across the cube and some stopping short
+		XMFLOAT3 origin(position(random), position(random), position(random));
+		XMFLOAT3 direction(unit(random), unit(random), unit(random));
+		float maxDistance = query % 2 ? FLT_MAX : 200.0f;
+		unsigned int hitObject = 0;
+		float hitDistance = 0.0f;
+		bool hit = tree.Raycast(origin, direction, maxDistance, hitObject, hitDistance);
+
+		float closest = -1.0f;
+		for (unsigned int i = 0; i < bounds.size(); i++)
+		{
+			float distance = RayDistance(bounds[i], origin, direction, maxDistance);
+			if (distance >= 0.0f && (closest < 0.0f || distance < closest))
+				closest = distance;
+		}
+
+		// Two objects can be entered at the same distance, so the one hit only has to be as close
+		// (the tree multiplies by the direction's reciprocal, so only the last bits can differ)
+		float tolerance = closest * 1e-5f;
+		if (hit != (closest >= 0.0f))
+			mismatches++;
+		else if (hit)
+			mismatches += fabsf(hitDistance - closest) > tolerance ||
+				fabsf(RayDistance(bounds[hitObject], origin, direction, maxDistance) - closest) > tolerance;
+	}
+
+	return mismatches;
+}
+
+TEST(BoundsTreeQueriesMatchBruteForce)
+{
+	std::mt19937 random(41);
+	BoundsTree tree;
+	std::vector<unsigned int> results;
+
+	// An empty tree finds nothing
+	tree.Build(nullptr, 0);
+	tree.QueryFrustum(RandomFrustum(random), results);
+	CHECK(results.empty());
+	unsigned int hitObject;
+	float hitDistance;
+	CHECK(!tree.Raycast(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 0, 0), FLT_MAX, hitObject, hitDistance));
+
+	// From a single leaf up to deep trees
+	for (unsigned int count : { 1u, 3u, 4u, 5u, 100u, 5000u })
+	{
+		std::vector<Bounds> bounds;
+		for (unsigned int i = 0; i < count; i++)
+			bounds.push_back(RandomBounds(random));
+
+		tree.Build(bounds.data(), count);
+		CHECK(tree.GetCount() == count);
+		CHECK(tree.GetNodeCount() <= count * 2);
+		CHECK(CompareQueries(tree, bounds, random) == 0);
+	}
+
+	// Many objects in one place, which can't be split by position
+	std::vector<Bounds> stacked(50, RandomBounds(random));
+	tree.Build(stacked.data(), (unsigned int)stacked.size());
+	CHECK(CompareQueries(tree, stacked, random) == 0);
+}
+
+TEST(BoundsTreeQueriesMatchBruteForceAfterRefit)
+{
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> nudge(-5.0f, 5.0f);
+	std::vector<Bounds> bounds;
+	for (int i = 0; i < 5000; i++)
+		bounds.push_back(RandomBounds(random));
+
+	// High enough that small moves are only ever refit, with rotations
+	BoundsTree tree;
+	tree.SetRebuildRatio(100.0f);
+	tree.Build(bounds.data(), (unsigned int)bounds.size());
+
+	int mismatches = 0;
+	bool rotated = false;
+	for (int frame = 0; frame < 20; frame++)
+	{
+		// A tenth of the objects wander a little each frame
+		for (int i = 0; i < 500; i++)
+		{
+			unsigned int object = random() % bounds.size();
+			bounds[object] = Moved(bounds[object], XMFLOAT3(nudge(random), nudge(random), nudge(random)));
+			tree.Update(object, bounds[object]);
+		}
+
+		int refit = tree.Refit();
+		CHECK(refit > 0 && refit < (int)tree.GetNodeCount());
+		rotated |= tree.GetCostRatio() != 1.0f;
+		mismatches += CompareQueries(tree, bounds, random);
+	}
+	CHECK(rotated);
+	CHECK(mismatches == 0);
+
+	// Nothing updated, or updated to where it already was, leaves nothing to refit
+	tree.Update(7, bounds[7]);
+	CHECK(tree.Refit() == 0);
+
+	// A sphere that changes inside the same box needs no refit, but frustum queries use it
+	for (Bounds& b : bounds)
+	{
+		b.sphereRadius *= 0.5f;
+		tree.Update((unsigned int)(&b - &bounds[0]), b);
+	}
+	CHECK(tree.Refit() == 0);
+	CHECK(CompareQueries(tree, bounds, random) == 0);
+}
+
+TEST(BoundsTreeQueriesMatchBruteForceAfterRebuild)
+{
+	std::mt19937 random(43);
+	std::vector<Bounds> bounds;
+	for (int i = 0; i < 5000; i++)
+		bounds.push_back(RandomBounds(random));
+
+	BoundsTree tree;
+	tree.SetRebuildRatio(1.2f);
+	tree.Build(bounds.data(), (unsigned int)bounds.size());
+
+	// Everything jumping somewhere else makes the tree far worse than when built, so it starts again
+	int mismatches = 0;
+	for (int frame = 0; frame < 5; frame++)
+	{
+		for (unsigned int i = 0; i < bounds.size(); i++)
+		{
+			bounds[i] = RandomBounds(random);
+			tree.Update(i, bounds[i]);
+		}
+
+		tree.Refit();
+		CHECK(tree.GetCostRatio() <= 1.2f);
+		mismatches += CompareQueries(tree, bounds, random);
+	}
+	CHECK(mismatches == 0);
+
+	// Building again over fewer objects forgets the rest
+	bounds.resize(1000);
+	tree.Build(bounds.data(), (unsigned int)bounds.size());
+	CHECK(tree.GetCount() == 1000);
+	CHECK(CompareQueries(tree, bounds, random) == 0);
+}
+
+// --------------------------------------------------------
+// Times the tree at 10k, 100k and 1M objects:
+//
+// - Building it
+// - Refitting after a tenth of the objects moved
+// - Frustum and ray queries, against testing every object
+// - Box and sphere queries of about a room's size
+// --------------------------------------------------------
+BENCHMARK(BoundsTreeThroughput)
+{
+	for (int count : { 10000, 100000, 1000000 })
+	{
+		auto measure = [&](const char* name, const std::function<void()>& prepare, const std::function<void()>& run)
+		{
+			// Best of a few runs, only timing run()
+			double best = 0;
+			for (int attempt = 0; attempt < 5; attempt++)
+			{
+				prepare();
+				auto start = std::chrono::high_resolution_clock::now();
+				run();
+				auto end = std::chrono::high_resolution_clock::now();
+
+				double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+				if (attempt == 0 || milliseconds < best) best = milliseconds;
+			}
+
+			printf("  %7d %-24s %8.3f ms\n", count, name, best);
+		};
+
+		// The same density of objects at every size
+		float spread = 500.0f * cbrtf(count / 100000.0f);
+		std::mt19937 random(44);
+		std::vector<Bounds> bounds;
+		for (int i = 0; i < count; i++)
+			bounds.push_back(RandomBounds(random, spread));
+
+		BoundsTree tree;
+		measure("build", []() {}, [&]() { tree.Build(bounds.data(), count); });
+
+		std::uniform_real_distribution<float> nudge(-1.0f, 1.0f);
+		measure("refit, 10% moved", [&]()
+		{
+			for (int i = 0; i < count / 10; i++)
+			{
+				unsigned int object = random() % count;
+				bounds[object] = Moved(bounds[object], XMFLOAT3(nudge(random), nudge(random), nudge(random)));
+				tree.Update(object, bounds[object]);
+			}
+		}, [&]() { tree.Refit(); });
+
+		// A camera in the middle, seeing 300 units
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection,
+			XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0.3f, 0.2f, 1, 0), XMVectorSet(0, 1, 0, 0)) *
+			XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 300.0f));
+		Frustum frustum = ExtractFrustum(viewProjection);
+		std::vector<unsigned int> results;
+		measure("frustum query", []() {}, [&]() { tree.QueryFrustum(frustum, results); });
+		measure("frustum, every object", []() {}, [&]()
+		{
+			results.clear();
+			for (int i = 0; i < count; i++)
+				if (InFrustum(frustum, bounds[i]))
+					results.push_back(i);
+		});
+
+		XMFLOAT3 origin(-spread, 1.0f, 2.0f), direction(1.0f, 0.01f, 0.02f);
+		unsigned int hitObject = 0;
+		float hitDistance = 0.0f;
+		measure("ray query", []() {}, [&]() { tree.Raycast(origin, direction, FLT_MAX, hitObject, hitDistance); });
+		measure("ray, every object", []() {}, [&]()
+		{
+			float closest = FLT_MAX;
+			for (int i = 0; i < count; i++)
+			{
+				float distance = RayDistance(bounds[i], origin, direction, closest);
+				if (distance >= 0.0f)
+					closest = distance;
+			}
+			hitDistance = closest;
+		});
+
+		measure("box query", []() {}, [&]() { tree.QueryBox(XMFLOAT3(-20, -5, -20), XMFLOAT3(20, 5, 20), results); });
+		measure("sphere query", []() {}, [&]() { tree.QuerySphere(XMFLOAT3(10, 0, 10), 20.0f, results); });
+	}
+}
@@ -0,0 +1,67 @@
+#include "TestFramework.h"
+#include "../FixedStepTimer.h"
+
+// Step and frame lengths here are powers of two, so the accumulator never rounds
+
+TEST(FixedStepsFollowFrameTime)
+{
+	// Four frames to a step, as when rendering at four times the simulation rate
+	FixedStepTimer timer(32.0, 5);
+	int steps = 0;
+	for (int frame = 1; frame <= 64; frame++)
+	{
+		int due = timer.Advance(1.0 / 128.0);
+		CHECK(due == (frame % 4 == 0 ? 1 : 0));
+		CHECK(timer.GetInterpolation() == (frame % 4) * 0.25);
+		steps += due;
+	}
+	CHECK(steps == 16);
+
+	// Frames longer than a step run several, keeping what's left over
+	CHECK(timer.Advance(3.5 / 32.0) == 3);
+	CHECK(timer.GetInterpolation() == 0.5);
+	CHECK(timer.Advance(0.75 / 32.0) == 1);
+	CHECK(timer.GetInterpolation() == 0.25);
+
+	// Time can't run backwards
+	CHECK(timer.Advance(-1.0) == 0);
+	CHECK(timer.GetInterpolation() == 0.25);
+}
+
+TEST(FixedStepsAreCappedPerFrame)
+{
+	FixedStepTimer timer(32.0, 5);
+
+	// Exactly at the cap nothing is dropped...
+	CHECK(timer.Advance(5.5 / 32.0) == 5);
+	CHECK(timer.GetInterpolation() == 0.5);
+
+	// ...but past it the overdue steps are, leaving only the part of a step over
+	CHECK(timer.Advance(11.75 / 32.0) == 5);
+	CHECK(timer.GetInterpolation() == 0.25);
+	CHECK(timer.Advance(0.0) == 0);
+
+	// A hitch of a whole second doesn't leave later frames catching up
+	CHECK(timer.Advance(1.0) == 5);
+	CHECK(timer.Advance(1.0 / 128.0) == 0);
+}
+
+TEST(FixedStepRateCanChange)
+{
+	FixedStepTimer timer(32.0, 5);
+	CHECK(timer.Advance(0.75 / 32.0) == 0);
+
+	// Time already built up carries over into the new step length
+	timer.SetRate(64.0, 2);
+	CHECK(timer.GetStepSeconds() == 1.0 / 64.0);
+	CHECK(timer.GetMaxStepsPerFrame() == 2);
+	CHECK(timer.Advance(0.0) == 1);
+	CHECK(timer.GetInterpolation() == 0.5);
+	CHECK(timer.Advance(10.0 / 64.0) == 2);
+
+	// Rates that make no sense are ignored
+	timer.SetRate(0.0, 5);
+	timer.SetRate(60.0, 0);
+	CHECK(timer.GetStepSeconds() == 1.0 / 64.0);
+	CHECK(timer.GetMaxStepsPerFrame() == 2);
+}
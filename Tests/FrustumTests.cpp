@@ -0,0 +1,272 @@
+#include "TestFramework.h"
+#include "../Frustum.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// A camera at the origin looking down +z, seeing 100 units
+static XMFLOAT4X4 TestViewProjection(float aspect)
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection,
+		XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)) *
+		XMMatrixPerspectiveFovLH(XM_PIDIV4, aspect, 0.1f, 100.0f));
+	return viewProjection;
+}
+
+// Bounds scattered in and around the test camera's frustum, either around a ball
+// (a box just around the sphere) or a block (a sphere just around the box)
+static Bounds RandomBounds(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> across(-80.0f, 80.0f);
+	std::uniform_real_distribution<float> along(-20.0f, 120.0f);
+	std::uniform_real_distribution<float> size(0.1f, 5.0f);
+
+	Bounds bounds;
+	bounds.sphereCenter = XMFLOAT3(across(random), across(random), along(random));
+	XMFLOAT3 extent(size(random), size(random), size(random));
+	if (random() % 2)
+	{
+		bounds.sphereRadius = extent.x;
+		extent = XMFLOAT3(extent.x, extent.x, extent.x);
+	}
+	else
+		bounds.sphereRadius = sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+
+	XMFLOAT3& center = bounds.sphereCenter;
+	bounds.boxMin = XMFLOAT3(center.x - extent.x, center.y - extent.y, center.z - extent.z);
+	bounds.boxMax = XMFLOAT3(center.x + extent.x, center.y + extent.y, center.z + extent.z);
+	return bounds;
+}
+
+// The same sphere and box tests as CullBoundsBatch(), one plane at a time
+static bool ScalarVisible(const Frustum& frustum, const Bounds& bounds)
+{
+	XMFLOAT3 center((bounds.boxMin.x + bounds.boxMax.x) * 0.5f, (bounds.boxMin.y + bounds.boxMax.y) * 0.5f, (bounds.boxMin.z + bounds.boxMax.z) * 0.5f);
+	XMFLOAT3 extent((bounds.boxMax.x - bounds.boxMin.x) * 0.5f, (bounds.boxMax.y - bounds.boxMin.y) * 0.5f, (bounds.boxMax.z - bounds.boxMin.z) * 0.5f);
+	for (const XMFLOAT4& plane : frustum.planes)
+	{
+		const XMFLOAT3& sphere = bounds.sphereCenter;
+		if (plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w < -bounds.sphereRadius)
+			return false;
+
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float reach = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+		if (distance < -reach)
+			return false;
+	}
+
+	return true;
+}
+
+TEST(ExtractFrustumMatchesClipSpace)
+{
+	std::mt19937 random(31);
+	std::uniform_real_distribution<float> coordinate(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> aspect(0.5f, 2.5f);
+
+	int tested = 0;
+	int inside = 0;
+	for (int camera = 0; camera < 50; camera++)
+	{
+		// A camera somewhere, looking somewhere, and a model placed anywhere in the world
+		XMVECTOR eye = XMVectorSet(coordinate(random), coordinate(random), coordinate(random), 1);
+		XMVECTOR direction = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0));
+		XMMATRIX viewProjection =
+			XMMatrixLookToLH(eye, direction, XMVectorSet(0, 1, 0, 0)) *
+			XMMatrixPerspectiveFovLH(XM_PIDIV4, aspect(random), 0.5f, 300.0f);
+		XMMATRIX world =
+			XMMatrixScaling(1.0f + unit(random) * 0.5f, 1.0f + unit(random) * 0.5f, 1.0f + unit(random) * 0.5f) *
+			XMMatrixRotationRollPitchYaw(unit(random) * XM_PI, unit(random) * XM_PI, unit(random) * XM_PI) *
+			XMMatrixTranslation(coordinate(random), coordinate(random), coordinate(random));
+
+		XMFLOAT4X4 matrix, modelMatrix;
+		XMStoreFloat4x4(&matrix, viewProjection);
+		XMStoreFloat4x4(&modelMatrix, world * viewProjection);
+		Frustum frustum = ExtractFrustum(matrix);
+		Frustum modelFrustum = ExtractFrustum(modelMatrix);
+
+		for (int p = 0; p < 6; p++)
+		{
+			XMFLOAT4& plane = frustum.planes[p];
+			CHECK_NEAR(sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z), 1.0f, 1e-5f);
+		}
+
+		for (int i = 0; i < 2000; i++)
+		{
+			// Points spread around what the camera sees, most of them close to it
+			float distance = fabsf(unit(random)) * 400.0f;
+			XMVECTOR point = eye + XMVector3Normalize(direction + XMVectorSet(unit(random), unit(random), unit(random), 0)) * distance;
+			point = XMVectorSetW(point, 1.0f);
+
+			// In clip space each plane is a comparison against w, in the same order
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(point, viewProjection));
+			float expected[6] = { clip.w + clip.x, clip.w - clip.x, clip.w + clip.y, clip.w - clip.y, clip.z, clip.w - clip.z };
+
+			// The same point in the model's space against the planes taken from world * view * projection
+			XMMATRIX toModel = XMMatrixInverse(nullptr, world);
+			XMVECTOR modelPoint = XMVector3TransformCoord(point, toModel);
+
+			bool pointInside = true;
+			for (int p = 0; p < 6; p++)
+			{
+				// Too close to the plane to be sure of the side after rounding
+				if (fabsf(expected[p]) < 1e-3f * fabsf(clip.w) + 1e-4f)
+					continue;
+
+				tested++;
+				XMVECTOR plane = XMLoadFloat4(&frustum.planes[p]);
+				XMVECTOR modelPlane = XMLoadFloat4(&modelFrustum.planes[p]);
+				CHECK((XMVectorGetX(XMPlaneDotCoord(plane, point)) > 0.0f) == (expected[p] > 0.0f));
+				CHECK((XMVectorGetX(XMPlaneDotCoord(modelPlane, modelPoint)) > 0.0f) == (expected[p] > 0.0f));
+				pointInside &= expected[p] > 0.0f;
+			}
+			inside += pointInside;
+		}
+	}
+
+	// Enough of the points were on both sides of the planes to mean something
+	printf("  %d plane tests, %d points inside\n", tested, inside);
+	CHECK(inside > 10000);
+	CHECK(tested > 500000);
+}
+
+TEST(CullBoundsBatchMatchesScalarTest)
+{
+	Frustum frustum = ExtractFrustum(TestViewProjection(16.0f / 9.0f));
+	std::mt19937 random(32);
+	BoundsBatch batch;
+	std::vector<unsigned int> visible;
+
+	// Whole batches, partly filled last batches, and none at all
+	for (unsigned int count : { 0u, 1u, 2u, 3u, 4u, 5u, 7u, 8u, 9u, 1000u })
+	{
+		for (int pass = 0; pass < 50; pass++)
+		{
+			std::vector<Bounds> bounds;
+			batch.Clear();
+			for (unsigned int i = 0; i < count; i++)
+			{
+				bounds.push_back(RandomBounds(random));
+				CHECK(batch.Add(bounds.back()) == i);
+			}
+			CHECK(batch.GetCount() == count);
+
+			std::vector<unsigned int> expected;
+			for (unsigned int i = 0; i < count; i++)
+				if (ScalarVisible(frustum, bounds[i]))
+					expected.push_back(i);
+
+			// Leftovers from the last pass are replaced, not added to
+			CullBoundsBatch(frustum, batch, visible);
+			CHECK(visible == expected);
+		}
+	}
+}
+
+TEST(CullBoundsBatchIgnoresPaddingLanes)
+{
+	Frustum frustum = ExtractFrustum(TestViewProjection(1.0f));
+	BoundsBatch batch;
+	std::vector<unsigned int> visible(3, 7);
+
+	// Nothing added, nothing visible
+	CullBoundsBatch(frustum, batch, visible);
+	CHECK(visible.empty());
+
+	Bounds inFront = { XMFLOAT3(-1, -1, 9), XMFLOAT3(1, 1, 11), XMFLOAT3(0, 0, 10), 1.8f };
+	Bounds behind = { XMFLOAT3(-1, -1, -11), XMFLOAT3(1, 1, -9), XMFLOAT3(0, 0, -10), 1.8f };
+
+	// Fill two whole batches with visible bounds, so the arrays hold them after Clear()...
+	for (int i = 0; i < 8; i++)
+		batch.Add(inFront);
+	CullBoundsBatch(frustum, batch, visible);
+	CHECK(visible.size() == 8);
+
+	// ...then a last batch of one, three and five bounds that can't be seen mustn't report those lanes
+	for (unsigned int count : { 1u, 3u, 5u })
+	{
+		batch.Clear();
+		for (unsigned int i = 0; i < count; i++)
+			batch.Add(behind);
+		CullBoundsBatch(frustum, batch, visible);
+		CHECK(visible.empty());
+	}
+
+	// A batch entirely outside skips to the next one, which is still tested
+	batch.Clear();
+	for (int i = 0; i < 4; i++)
+		batch.Add(behind);
+	batch.Add(inFront);
+	batch.Add(behind);
+	CullBoundsBatch(frustum, batch, visible);
+	CHECK(visible.size() == 1 && visible[0] == 4);
+
+	// A sphere that's in front only counts if its box is too
+	Bounds sphereOnly = { XMFLOAT3(-1, -1, -11), XMFLOAT3(1, 1, -9), XMFLOAT3(0, 0, 10), 1.8f };
+	batch.Clear();
+	batch.Add(sphereOnly);
+	CullBoundsBatch(frustum, batch, visible);
+	CHECK(visible.empty());
+}
+
+// --------------------------------------------------------
+// Times culling 100k bounds, one at a time and in batches
+// of four (including filling the batch, as a frame would)
+// --------------------------------------------------------
+BENCHMARK(FrustumCullThroughput)
+{
+	const int count = 100000;
+	Frustum frustum = ExtractFrustum(TestViewProjection(16.0f / 9.0f));
+	std::mt19937 random(33);
+	std::vector<Bounds> bounds;
+	for (int i = 0; i < count; i++)
+		bounds.push_back(RandomBounds(random));
+
+	BoundsBatch batch;
+	std::vector<unsigned int> visible;
+	visible.reserve(count);
+
+	auto measure = [&](const char* name, const std::function<void()>& frame)
+	{
+		// Best of a few frames
+		double best = 0;
+		for (int run = 0; run < 5; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			frame();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+			if (run == 0 || milliseconds < best) best = milliseconds;
+		}
+
+		printf("  %-28s %8.2f ms (%d visible)\n", name, best, (int)visible.size());
+	};
+
+	measure("one at a time", [&]()
+	{
+		visible.clear();
+		for (int i = 0; i < count; i++)
+			if (ScalarVisible(frustum, bounds[i]))
+				visible.push_back(i);
+	});
+	measure("fill batch and cull", [&]()
+	{
+		batch.Clear();
+		for (const Bounds& b : bounds)
+			batch.Add(b);
+		CullBoundsBatch(frustum, batch, visible);
+	});
+	measure("cull filled batch", [&]()
+	{
+		CullBoundsBatch(frustum, batch, visible);
+	});
+}
@@ -0,0 +1,259 @@
+#include "TestFramework.h"
+#include "../GeometryPool.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// A 16-byte vertex, so a 1 KB block holds 64 of them
+struct TestVertex
+{
+	unsigned int mesh;
+	unsigned int index;
+	float padding[2];
+};
+
+// One mesh's worth of data, every vertex and index marked with the mesh it belongs to
+struct TestMesh
+{
+	std::vector<TestVertex> vertices;
+	std::vector<unsigned short> indices;
+	int allocation;
+};
+
+static TestMesh AddMesh(GeometryPool& pool, unsigned int mesh, unsigned int vertexCount, unsigned int indexCount)
+{
+	TestMesh added;
+	for (unsigned int i = 0; i < vertexCount; i++)
+		added.vertices.push_back({ mesh, i, { 0, 0 } });
+	for (unsigned int i = 0; i < indexCount; i++)
+		added.indices.push_back((unsigned short)(mesh * 100 + i));
+
+	added.allocation = pool.Allocate(&added.vertices[0], vertexCount, sizeof(TestVertex),
+		indexCount ? &added.indices[0] : nullptr, indexCount, sizeof(unsigned short));
+	return added;
+}
+
+// Whether the pool's buffers hold exactly a mesh's data where its range says they do
+static bool HoldsMesh(GeometryPool& pool, CpuGeometryBufferBackend& backend, const TestMesh& mesh)
+{
+	const GeometryRange& range = pool.GetRange(mesh.allocation);
+	if (range.vertexCount != mesh.vertices.size() || range.indexCount != mesh.indices.size())
+		return false;
+
+	const unsigned char* vertices = backend.GetData(range.vertexBuffer);
+	if (!vertices || memcmp(vertices + range.baseVertex * sizeof(TestVertex), &mesh.vertices[0], mesh.vertices.size() * sizeof(TestVertex)) != 0)
+		return false;
+
+	if (mesh.indices.empty())
+		return range.indexBuffer == -1;
+
+	const unsigned char* indices = backend.GetData(range.indexBuffer);
+	return indices && memcmp(indices + range.firstIndex * sizeof(unsigned short), &mesh.indices[0], mesh.indices.size() * sizeof(unsigned short)) == 0;
+}
+
+TEST(GeometryPoolReusesFreedSpaceFirstFit)
+{
+	std::shared_ptr<CpuGeometryBufferBackend> backend = std::make_shared<CpuGeometryBufferBackend>();
+	GeometryPool pool(backend, 1024);
+
+	TestMesh a = AddMesh(pool, 1, 10, 30);
+	TestMesh b = AddMesh(pool, 2, 10, 30);
+	TestMesh c = AddMesh(pool, 3, 10, 30);
+	CHECK(pool.GetRange(a.allocation).baseVertex == 0);
+	CHECK(pool.GetRange(b.allocation).baseVertex == 10);
+	CHECK(pool.GetRange(c.allocation).baseVertex == 20);
+	CHECK(pool.GetRange(c.allocation).firstIndex == 60);
+
+	// A smaller mesh takes the front of the first hole big enough...
+	pool.Free(b.allocation);
+	TestMesh d = AddMesh(pool, 4, 5, 12);
+	CHECK(d.allocation == b.allocation);
+	CHECK(pool.GetRange(d.allocation).baseVertex == 10);
+	CHECK(pool.GetRange(d.allocation).firstIndex == 30);
+
+	// ...one that doesn't fit what's left of it goes past it...
+	TestMesh e = AddMesh(pool, 5, 8, 30);
+	CHECK(pool.GetRange(e.allocation).baseVertex == 30);
+	CHECK(pool.GetRange(e.allocation).firstIndex == 90);
+
+	// ...and one that does fills it
+	TestMesh f = AddMesh(pool, 6, 5, 18);
+	CHECK(pool.GetRange(f.allocation).baseVertex == 15);
+	CHECK(pool.GetRange(f.allocation).firstIndex == 42);
+
+	for (const TestMesh* mesh : { &a, &c, &d, &e, &f })
+		CHECK(HoldsMesh(pool, *backend, *mesh));
+
+	// All of it in the one vertex and one index buffer
+	CHECK(backend->GetLiveBufferCount() == 2);
+}
+
+TEST(GeometryPoolMergesFreedSpans)
+{
+	std::shared_ptr<CpuGeometryBufferBackend> backend = std::make_shared<CpuGeometryBufferBackend>();
+	GeometryPool pool(backend, 1024);
+
+	TestMesh meshes[4];
+	for (unsigned int i = 0; i < 4; i++)
+		meshes[i] = AddMesh(pool, i, 10, 0);
+
+	// Holes on either side of b, and the rest of the block after d
+	pool.Free(meshes[0].allocation);
+	pool.Free(meshes[2].allocation);
+	CHECK(pool.GetStats().freeSpans == 3);
+
+	// Freeing b joins both neighbours into one span
+	pool.Free(meshes[1].allocation);
+	GeometryPoolStats stats = pool.GetStats();
+	CHECK(stats.freeSpans == 2);
+	CHECK(stats.largestFreeBytes == 30 * sizeof(TestVertex));
+
+	// So a mesh needing all of it fits at the start
+	TestMesh merged = AddMesh(pool, 5, 30, 0);
+	CHECK(pool.GetRange(merged.allocation).baseVertex == 0);
+	CHECK(HoldsMesh(pool, *backend, merged));
+	CHECK(HoldsMesh(pool, *backend, meshes[3]));
+
+	// Emptying the block merges everything back into one span (the last block is kept)
+	pool.Free(merged.allocation);
+	pool.Free(meshes[3].allocation);
+	stats = pool.GetStats();
+	CHECK(stats.freeSpans == 1);
+	CHECK(stats.largestFreeBytes == 1024);
+	CHECK(stats.vertexBuffers == 1);
+}
+
+TEST(GeometryPoolReleasesEmptyBlocks)
+{
+	std::shared_ptr<CpuGeometryBufferBackend> backend = std::make_shared<CpuGeometryBufferBackend>();
+	GeometryPool pool(backend, 1024);
+
+	// One full block, a second for what doesn't fit, and a third on its own for a mesh bigger than a block
+	TestMesh full = AddMesh(pool, 1, 64, 0);
+	TestMesh overflow = AddMesh(pool, 2, 10, 0);
+	TestMesh big = AddMesh(pool, 3, 100, 0);
+	CHECK(pool.GetRange(overflow.allocation).vertexBuffer != pool.GetRange(full.allocation).vertexBuffer);
+	CHECK(pool.GetRange(big.allocation).vertexBuffer != pool.GetRange(overflow.allocation).vertexBuffer);
+	CHECK(backend->GetLiveBufferCount() == 3);
+	CHECK(pool.GetStats().vertexBytesReserved == (64 + 64 + 100) * sizeof(TestVertex));
+
+	// Emptied blocks are released straight away...
+	int overflowBuffer = pool.GetRange(overflow.allocation).vertexBuffer;
+	pool.Free(overflow.allocation);
+	pool.Free(big.allocation);
+	CHECK(backend->GetLiveBufferCount() == 1);
+	CHECK(backend->GetData(overflowBuffer) == nullptr);
+	CHECK(pool.GetStats().vertexBuffers == 1);
+	CHECK(HoldsMesh(pool, *backend, full));
+
+	// ...apart from the last one, which is kept for the next mesh
+	pool.Free(full.allocation);
+	CHECK(backend->GetLiveBufferCount() == 1);
+	TestMesh next = AddMesh(pool, 4, 20, 0);
+	CHECK(backend->GetLiveBufferCount() == 1);
+	CHECK(pool.GetRange(next.allocation).baseVertex == 0);
+	CHECK(HoldsMesh(pool, *backend, next));
+
+	// A block added after one was released takes its place
+	TestMesh again = AddMesh(pool, 5, 64, 0);
+	CHECK(backend->GetLiveBufferCount() == 2);
+	CHECK(HoldsMesh(pool, *backend, again));
+	CHECK(pool.GetStats().vertexBuffers == 2);
+}
+
+TEST(GeometryPoolDefragmentPacksContents)
+{
+	std::shared_ptr<CpuGeometryBufferBackend> backend = std::make_shared<CpuGeometryBufferBackend>();
+	GeometryPool pool(backend, 1024);
+
+	// Enough meshes to need several blocks of each kind, then every third one freed
+	std::vector<TestMesh> meshes;
+	for (unsigned int i = 0; i < 24; i++)
+		meshes.push_back(AddMesh(pool, i, 5 + i % 7, 9 + (i % 4) * 6));
+
+	std::vector<TestMesh> kept;
+	size_t keptBytes = 0;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		if (i % 3 == 1)
+		{
+			pool.Free(meshes[i].allocation);
+			continue;
+		}
+
+		kept.push_back(meshes[i]);
+		keptBytes += meshes[i].vertices.size() * sizeof(TestVertex) + meshes[i].indices.size() * sizeof(unsigned short);
+	}
+
+	GeometryPoolStats before = pool.GetStats();
+	CHECK(before.freeSpans > before.vertexBuffers + before.indexBuffers);
+	std::vector<GeometryRange> oldRanges;
+	for (const TestMesh& mesh : kept)
+		oldRanges.push_back(pool.GetRange(mesh.allocation));
+
+	// The first mesh of every block stays at the start, but everything is copied into a new buffer
+	size_t copied = pool.Defragment();
+	CHECK(copied == keptBytes);
+
+	GeometryPoolStats after = pool.GetStats();
+	CHECK(after.allocations == kept.size());
+	CHECK(after.vertexBuffers == before.vertexBuffers);
+	CHECK(after.indexBuffers == before.indexBuffers);
+	CHECK(after.vertexBytesUsed == before.vertexBytesUsed);
+	CHECK(after.indexBytesUsed == before.indexBytesUsed);
+	CHECK(after.freeSpans <= after.vertexBuffers + after.indexBuffers);
+	CHECK(backend->GetLiveBufferCount() == (int)(after.vertexBuffers + after.indexBuffers));
+
+	// Every range was updated to where its mesh went, which holds the same data
+	bool moved = false;
+	for (size_t i = 0; i < kept.size(); i++)
+	{
+		const GeometryRange& range = pool.GetRange(kept[i].allocation);
+		CHECK(range.vertexBuffer != oldRanges[i].vertexBuffer);
+		CHECK(range.indexBuffer != oldRanges[i].indexBuffer);
+		CHECK(backend->GetData(oldRanges[i].vertexBuffer) == nullptr);
+		moved |= range.baseVertex != oldRanges[i].baseVertex || range.firstIndex != oldRanges[i].firstIndex;
+		CHECK(HoldsMesh(pool, *backend, kept[i]));
+	}
+	CHECK(moved);
+
+	// Already packed, so a second pass has nothing to do
+	CHECK(pool.Defragment() == 0);
+}
+
+TEST(GeometryPoolStatsTrackOccupancy)
+{
+	std::shared_ptr<CpuGeometryBufferBackend> backend = std::make_shared<CpuGeometryBufferBackend>();
+	GeometryPool pool(backend, 1024);
+
+	GeometryPoolStats stats = pool.GetStats();
+	CHECK(stats.allocations == 0 && stats.vertexBuffers == 0 && stats.indexBuffers == 0);
+
+	TestMesh a = AddMesh(pool, 1, 10, 36);
+	TestMesh b = AddMesh(pool, 2, 20, 0);
+
+	// A position-only stream with its own stride goes in a buffer of its own kind
+	float positions[12 * 3] = {};
+	int stream = pool.Allocate(positions, 12, 12, nullptr, 0, 2);
+
+	stats = pool.GetStats();
+	CHECK(stats.allocations == 3);
+	CHECK(stats.vertexBuffers == 2);
+	CHECK(stats.indexBuffers == 1);
+	CHECK(stats.vertexBytesReserved == 1024 + (1024 / 12) * 12);
+	CHECK(stats.vertexBytesUsed == 30 * sizeof(TestVertex) + 12 * 12);
+	CHECK(stats.indexBytesReserved == 1024);
+	CHECK(stats.indexBytesUsed == 36 * sizeof(unsigned short));
+	CHECK(stats.freeSpans == 3);
+	CHECK(stats.largestFreeBytes == 1024 - 36 * sizeof(unsigned short));
+
+	pool.Free(a.allocation);
+	pool.Free(stream);
+	stats = pool.GetStats();
+	CHECK(stats.allocations == 1);
+	CHECK(stats.vertexBytesUsed == 20 * sizeof(TestVertex));
+	CHECK(stats.indexBytesUsed == 0);
+	CHECK(stats.freeSpans == 4);
+	CHECK(HoldsMesh(pool, *backend, b));
+}
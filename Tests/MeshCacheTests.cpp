@@ -0,0 +1,118 @@
+#include "TestFramework.h"
+#include "../MeshCache.h"
+
+#include <Windows.h>
+
+static const wchar_t* sourceFileName = L"MeshCacheTests.obj";
+static const wchar_t* cacheFileName = L"MeshCacheTests.meshbin";
+
+static bool FileExists(const std::wstring& fileName)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+	return GetFileAttributesExW(fileName.c_str(), GetFileExInfoStandard, &attributes) != 0;
+}
+
+// How many vertices the cache holds, or -1 if it isn't valid
+static int GetCachedVertexCount()
+{
+	MeshCacheFile cache(cacheFileName, sourceFileName);
+	return cache.IsValid() ? (int)cache.GetHeader()->vertexCount : -1;
+}
+
+TEST(MeshCacheIsOnlyReplacedWhenComplete)
+{
+	// Only the source's size, time and contents matter
+	CHECK(WriteTestFile(sourceFileName, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"));
+
+	Vertex vertices[6] = {};
+	unsigned int indices[6] = { 0, 1, 2, 3, 4, 5 };
+	MeshLod lod = { 0, 3, 0.0f };
+	Bounds bounds = {};
+
+	CHECK(WriteMeshCache(cacheFileName, sourceFileName, vertices, 3, indices, 3, &lod, 1, 0, 0, bounds));
+	CHECK(GetCachedVertexCount() == 3);
+	CHECK(!FileExists(std::wstring(cacheFileName) + L".tmp"));
+
+	// A write that's never finished leaves the old cache alone
+	{
+		MeshCacheWriter writer(cacheFileName, sourceFileName);
+		CHECK(writer.AddVertices(vertices, 6));
+		CHECK(writer.AddIndices(indices, 6));
+		CHECK(GetCachedVertexCount() == 3);
+	}
+	CHECK(GetCachedVertexCount() == 3);
+	CHECK(!FileExists(std::wstring(cacheFileName) + L".tmp"));
+
+	// ...while a finished one replaces it
+	{
+		MeshCacheWriter writer(cacheFileName, sourceFileName);
+		CHECK(writer.AddVertices(vertices, 6));
+		CHECK(writer.AddIndices(indices, 6));
+		lod.indexCount = 6;
+		CHECK(writer.Finish(&lod, 1, 0, 0, bounds));
+	}
+	CHECK(GetCachedVertexCount() == 6);
+	CHECK(!FileExists(std::wstring(cacheFileName) + L".tmp"));
+
+	DeleteFileW(cacheFileName);
+	DeleteFileW(sourceFileName);
+}
+
+// Gives a file a new last write time, in 100ns units since 1601, as Windows keeps it
+static bool SetWriteTime(const std::wstring& fileName, unsigned long long writeTime)
+{
+	HANDLE file = CreateFileW(fileName.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	FILETIME time = { (DWORD)writeTime, (DWORD)(writeTime >> 32) };
+	bool set = SetFileTime(file, 0, 0, &time) != 0;
+	CloseHandle(file);
+	return set;
+}
+
+// The source write time in the cache's header, or 0 if it isn't valid
+static unsigned long long GetCachedWriteTime()
+{
+	MeshCacheFile cache(cacheFileName, sourceFileName);
+	return cache.IsValid() ? cache.GetHeader()->sourceWriteTime : 0;
+}
+
+TEST(MeshCacheRefreshesTheSourceWriteTime)
+{
+	const char* source = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+	CHECK(WriteTestFile(sourceFileName, source));
+	CHECK(SetWriteTime(sourceFileName, 130000000000000000ull));
+
+	Vertex vertices[3] = {};
+	unsigned int indices[3] = { 0, 1, 2 };
+	MeshLod lod = { 0, 3, 0.0f };
+	Bounds bounds = {};
+	CHECK(WriteMeshCache(cacheFileName, sourceFileName, vertices, 3, indices, 3, &lod, 1, 0, 0, bounds));
+	CHECK(GetCachedWriteTime() == 130000000000000000ull);
+
+	// The same contents written again (or checked out again) still match...
+	CHECK(WriteTestFile(sourceFileName, source));
+	CHECK(SetWriteTime(sourceFileName, 130000000010000000ull));
+	{
+		MeshCacheFile cache(cacheFileName, sourceFileName);
+		CHECK(cache.IsValid());
+		CHECK(cache.GetHeader()->sourceWriteTime == 130000000000000000ull);
+	}
+
+	// ...and once that's been seen the header has the new time, so the next load doesn't hash the source
+	CHECK(GetCachedWriteTime() == 130000000010000000ull);
+	CHECK(GetCachedVertexCount() == 3);
+
+	// Different contents of the same size don't match, and leave the header alone
+	CHECK(WriteTestFile(sourceFileName, "v 0 0 0\nv 2 0 0\nv 0 1 0\nf 1 2 3\n"));
+	CHECK(SetWriteTime(sourceFileName, 130000000020000000ull));
+	CHECK(GetCachedWriteTime() == 0);
+	CHECK(WriteTestFile(sourceFileName, source));
+	CHECK(SetWriteTime(sourceFileName, 130000000010000000ull));
+	CHECK(GetCachedWriteTime() == 130000000010000000ull);
+
+	DeleteFileW(cacheFileName);
+	DeleteFileW(sourceFileName);
+}
@@ -0,0 +1,201 @@
+#include "TestFramework.h"
+#include "../MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Makes a box, with every triangle on its own vertices so
+// each one becomes a cluster of its own in OptimizeOverdraw
+//
+// - Triangles wind clockwise seen from outside, the same as
+//   meshes once they've been imported
+// --------------------------------------------------------
+static void MakeBox(XMFLOAT3 halfSize, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	// Each face's outward axis, then two axes across it whose cross product is the outward one
+	const float faces[6][3][3] =
+	{
+		{ { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+		{ { -1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+		{ { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } },
+		{ { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+		{ { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, -1 }, { 0, 1, 0 }, { 1, 0, 0 } }
+	};
+	const float corners[6][2] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+
+	const float size[3] = { halfSize.x, halfSize.y, halfSize.z };
+	for (const auto& face : faces)
+	{
+		for (const auto& corner : corners)
+		{
+			float position[3];
+			for (int axis = 0; axis < 3; axis++)
+				position[axis] = (face[0][axis] + face[1][axis] * corner[0] + face[2][axis] * corner[1]) * size[axis];
+
+			Vertex vertex = {};
+			vertex.Position = XMFLOAT3(position[0], position[1], position[2]);
+			vertex.normal = XMFLOAT3(face[0][0], face[0][1], face[0][2]);
+			indices.push_back((unsigned int)vertices.size());
+			vertices.push_back(vertex);
+		}
+	}
+}
+
+static XMFLOAT3 TriangleNormal(const std::vector<Vertex>& vertices, const unsigned int* triangle)
+{
+	XMVECTOR p0 = XMLoadFloat3(&vertices[triangle[0]].Position);
+	XMVECTOR p1 = XMLoadFloat3(&vertices[triangle[1]].Position);
+	XMVECTOR p2 = XMLoadFloat3(&vertices[triangle[2]].Position);
+
+	XMFLOAT3 normal;
+	XMStoreFloat3(&normal, XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0)));
+	return normal;
+}
+
+TEST(MeshOptimizerBoxWindsOutward)
+{
+	// Make sure the test mesh really has the winding imported meshes do
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeBox(XMFLOAT3(1, 1, 5), vertices, indices);
+
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		XMFLOAT3 normal = TriangleNormal(vertices, &indices[t]);
+		const XMFLOAT3& expected = vertices[indices[t]].normal;
+		CHECK(normal.x * expected.x + normal.y * expected.y + normal.z * expected.z > 0.99f);
+	}
+}
+
+TEST(OptimizeOverdrawDrawsOutermostClustersFirst)
+{
+	// The ends of a long box stick out furthest from its middle,
+	// so they're the most likely to hide the rest
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeBox(XMFLOAT3(1, 1, 5), vertices, indices);
+
+	std::vector<unsigned int> optimized = indices;
+	OptimizeOverdraw(&optimized[0], (int)optimized.size(), &vertices[0], (int)vertices.size());
+
+	// The same triangles, just reordered
+	std::vector<unsigned int> before = indices, after = optimized;
+	std::sort(before.begin(), before.end());
+	std::sort(after.begin(), after.end());
+	CHECK(before == after);
+
+	// The four end triangles come first, facing away from the middle
+	for (int t = 0; t < 4; t++)
+	{
+		XMFLOAT3 normal = TriangleNormal(vertices, &optimized[t * 3]);
+		float z = vertices[optimized[t * 3]].Position.z;
+		CHECK(fabsf(normal.z) > 0.99f);
+		CHECK(normal.z * z > 0.0f);
+	}
+
+	// Then the sides, which are nearer the middle
+	for (int t = 4; t < 12; t++)
+		CHECK(fabsf(TriangleNormal(vertices, &optimized[t * 3]).z) < 0.01f);
+}
+
+// A flat grid of size x size quads, two triangles each, in a random order
+static std::vector<unsigned int> MakeShuffledGrid(int size, std::mt19937& random)
+{
+	std::vector<std::array<unsigned int, 3>> triangles;
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			unsigned int corner = (unsigned int)(y * (size + 1) + x);
+			triangles.push_back({ corner, corner + size + 1, corner + 1 });
+			triangles.push_back({ corner + 1, corner + size + 1, corner + size + 2 });
+		}
+	}
+	std::shuffle(triangles.begin(), triangles.end(), random);
+
+	std::vector<unsigned int> indices;
+	for (const std::array<unsigned int, 3>& triangle : triangles)
+		indices.insert(indices.end(), triangle.begin(), triangle.end());
+	return indices;
+}
+
+// Every triangle, each starting from its smallest index (which keeps its winding), sorted
+static std::vector<std::array<unsigned int, 3>> SortedTriangles(const std::vector<unsigned int>& indices)
+{
+	std::vector<std::array<unsigned int, 3>> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		std::array<unsigned int, 3> triangle = { indices[i], indices[i + 1], indices[i + 2] };
+		while (triangle[0] > triangle[1] || triangle[0] > triangle[2])
+			std::rotate(triangle.begin(), triangle.begin() + 1, triangle.end());
+		triangles.push_back(triangle);
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+TEST(OptimizeVertexCacheReordersTriangles)
+{
+	std::mt19937 random(61);
+
+	// A shuffled grid comes out with the same triangles, in an order the cache likes far more
+	std::vector<unsigned int> grid = MakeShuffledGrid(100, random);
+	int gridVertices = 101 * 101;
+	float before = MeasureVertexCache(grid.data(), (int)grid.size(), gridVertices).acmr;
+	std::vector<unsigned int> optimized = grid;
+	OptimizeVertexCache(optimized.data(), (int)optimized.size(), gridVertices);
+	float after = MeasureVertexCache(optimized.data(), (int)optimized.size(), gridVertices).acmr;
+	printf("  grid ACMR %.3f before, %.3f after\n", before, after);
+	CHECK(SortedTriangles(optimized) == SortedTriangles(grid));
+	CHECK(after < 0.8f);
+
+	// Triangles that share nothing are all dead ends, and still all come out
+	std::vector<unsigned int> soup(3000);
+	for (unsigned int i = 0; i < soup.size(); i++)
+		soup[i] = i;
+	std::shuffle(soup.begin(), soup.end(), random);
+	optimized = soup;
+	OptimizeVertexCache(optimized.data(), (int)optimized.size(), (int)soup.size());
+	CHECK(SortedTriangles(optimized) == SortedTriangles(soup));
+}
+
+// --------------------------------------------------------
+// Times OptimizeVertexCache on shuffled grids, and on
+// triangles that share no vertices (where every triangle is
+// a dead end, so the next one can't come from the cache)
+// --------------------------------------------------------
+BENCHMARK(OptimizeVertexCacheThroughput)
+{
+	std::mt19937 random(62);
+	for (int size : { 100, 300, 1000 })
+	{
+		std::vector<unsigned int> grid = MakeShuffledGrid(size, random);
+		int numVertices = (size + 1) * (size + 1);
+		auto start = std::chrono::high_resolution_clock::now();
+		OptimizeVertexCache(grid.data(), (int)grid.size(), numVertices);
+		auto end = std::chrono::high_resolution_clock::now();
+		printf("  %8d triangles, grid    %10.2f ms, ACMR %.3f\n", (int)grid.size() / 3,
+			std::chrono::duration<double, std::milli>(end - start).count(),
+			MeasureVertexCache(grid.data(), (int)grid.size(), numVertices).acmr);
+	}
+
+	for (int count : { 10000, 30000, 100000 })
+	{
+		std::vector<unsigned int> soup(count * 3);
+		for (unsigned int i = 0; i < soup.size(); i++)
+			soup[i] = i;
+		auto start = std::chrono::high_resolution_clock::now();
+		OptimizeVertexCache(soup.data(), (int)soup.size(), (int)soup.size());
+		auto end = std::chrono::high_resolution_clock::now();
+		printf("  %8d triangles, no sharing %7.2f ms\n", count, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+}
@@ -0,0 +1,307 @@
+#include "TestFramework.h"
+#include "../Mesh.h"
+#include "../MeshCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// The original scalar tangent calculation, one float at a
+// time, as the reference for Mesh::CalculateTangents()
+//
+// - Triangles with no UV area are skipped (they used to
+//   divide by zero), and vertices left with no tangent are
+//   skipped too, since any perpendicular will do for them
+// --------------------------------------------------------
+static void ReferenceTangents(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, std::vector<bool>& hasTangent)
+{
+	for (int i = 0; i < numVerts; i++)
+		verts[i].tangent = XMFLOAT3(0, 0, 0);
+
+	for (int i = 0; i + 2 < numIndices; i += 3)
+	{
+		Vertex* v1 = &verts[indices[i]];
+		Vertex* v2 = &verts[indices[i + 1]];
+		Vertex* v3 = &verts[indices[i + 2]];
+
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		float s1 = v2->uv.x - v1->uv.x;
+		float t1 = v2->uv.y - v1->uv.y;
+
+		float s2 = v3->uv.x - v1->uv.x;
+		float t2 = v3->uv.y - v1->uv.y;
+
+		float determinant = s1 * t2 - s2 * t1;
+		if (fabsf(determinant) < 1e-12f)
+			continue;
+
+		float r = 1.0f / determinant;
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+
+		for (Vertex* v : { v1, v2, v3 })
+		{
+			v->tangent.x += tx;
+			v->tangent.y += ty;
+			v->tangent.z += tz;
+		}
+	}
+
+	hasTangent.assign(numVerts, false);
+	for (int i = 0; i < numVerts; i++)
+	{
+		XMFLOAT3 n = verts[i].normal;
+		XMFLOAT3 t = verts[i].tangent;
+
+		// Gram-Schmidt orthonormalize
+		float dot = n.x * t.x + n.y * t.y + n.z * t.z;
+		t = XMFLOAT3(t.x - n.x * dot, t.y - n.y * dot, t.z - n.z * dot);
+		float length = sqrtf(t.x * t.x + t.y * t.y + t.z * t.z);
+		if (length > 0.0f)
+		{
+			verts[i].tangent = XMFLOAT3(t.x / length, t.y / length, t.z / length);
+			hasTangent[i] = true;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Makes a bumpy size x size grid, where the uvs of rows 5
+// and 6 are squashed together so the triangles between them
+// have no UV area, plus one lone triangle with no UV area
+// whose vertices touch nothing else
+// --------------------------------------------------------
+static void MakeTangentGrid(int size, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	for (int y = 0; y <= size; y++)
+	{
+		for (int x = 0; x <= size; x++)
+		{
+			Vertex vertex = {};
+			float height = sinf(x * 0.05f) * cosf(y * 0.03f);
+			vertex.Position = XMFLOAT3(x * 0.01f, height, y * 0.01f);
+			XMStoreFloat3(&vertex.normal, XMVector3Normalize(XMVectorSet(-cosf(x * 0.05f) * 0.05f, 0.01f, sinf(y * 0.03f) * 0.03f, 0)));
+			vertex.uv = XMFLOAT2(x * 4.0f / size, (y == 6 ? 5 : y) * 4.0f / size);
+			vertices.push_back(vertex);
+		}
+	}
+
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			unsigned int i = y * (size + 1) + x;
+			unsigned int quad[6] = { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	unsigned int first = (unsigned int)vertices.size();
+	for (int c = 0; c < 3; c++)
+	{
+		Vertex vertex = {};
+		vertex.Position = XMFLOAT3((float)c, 2.0f, (float)(c * c));
+		vertex.normal = XMFLOAT3(0, 1, 0);
+		vertex.uv = XMFLOAT2(0.5f, 0.5f);
+		vertices.push_back(vertex);
+		indices.push_back(first + c);
+	}
+}
+
+// CalculateTangents() doesn't touch the mesh itself, so an empty one is enough
+static void CalculateTangents(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, int threadCount)
+{
+	Mesh mesh(MeshVertexFormat::Full, nullptr);
+	mesh.CalculateTangents(&vertices[0], (int)vertices.size(), &indices[0], (int)indices.size(), threadCount);
+}
+
+TEST(TangentsMatchScalarReference)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeTangentGrid(200, vertices, indices);
+
+	std::vector<Vertex> reference = vertices;
+	std::vector<bool> hasTangent;
+	ReferenceTangents(&reference[0], (int)reference.size(), &indices[0], (int)indices.size(), hasTangent);
+
+	CalculateTangents(vertices, indices, 1);
+
+	float worst = 0.0f;
+	int fallbacks = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		XMVECTOR tangent = XMLoadFloat3(&vertices[i].tangent);
+		XMVECTOR normal = XMLoadFloat3(&vertices[i].normal);
+
+		// Every tangent is a unit vector at right angles to the normal
+		CHECK_NEAR(XMVectorGetX(XMVector3Length(tangent)), 1.0f, 1e-5f);
+		CHECK_NEAR(XMVectorGetX(XMVector3Dot(tangent, normal)), 0.0f, 1e-5f);
+
+		if (hasTangent[i])
+		{
+			XMVECTOR difference = tangent - XMLoadFloat3(&reference[i].tangent);
+			worst = std::max(worst, XMVectorGetX(XMVector3Length(difference)));
+		}
+		else
+			fallbacks++;
+	}
+
+	// Only the lone triangle's vertices have nothing to go on
+	printf("  worst difference %g\n", worst);
+	CHECK(worst < 1e-5f);
+	CHECK(fallbacks == 3);
+}
+
+TEST(TangentsAreSameOnEveryThreadCount)
+{
+	// Big enough to be split between threads
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeTangentGrid(300, vertices, indices);
+
+	std::vector<Vertex> threaded = vertices;
+	CalculateTangents(vertices, indices, 1);
+	CalculateTangents(threaded, indices, 4);
+	CHECK(memcmp(&vertices[0], &threaded[0], vertices.size() * sizeof(Vertex)) == 0);
+}
+
+// Writes a mesh out as an OBJ, every corner using the same position, uv and normal index
+static bool WriteObj(const std::wstring& fileName, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+	std::string text;
+	char line[128];
+	for (const Vertex& v : vertices)
+	{
+		snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+			v.Position.x, v.Position.y, v.Position.z, v.uv.x, v.uv.y, v.normal.x, v.normal.y, v.normal.z);
+		text += line;
+	}
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = indices[i] + 1, b = indices[i + 1] + 1, c = indices[i + 2] + 1;
+		snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+		text += line;
+	}
+
+	return WriteTestFile(fileName, text);
+}
+
+// A cooked cache's vertices, sorted by position and then uv so two cooks can be compared
+static std::vector<Vertex> GetSortedVertices(const std::wstring& cacheFileName, const std::wstring& sourceFileName, unsigned int& indexCount)
+{
+	MeshCacheFile cache(cacheFileName, sourceFileName);
+	if (!cache.IsValid())
+		return std::vector<Vertex>();
+
+	// Every index has to point at a vertex that's there
+	const MeshCacheHeader* header = cache.GetHeader();
+	indexCount = header->indexCount;
+	for (unsigned int i = 0; i < header->indexCount; i++)
+		if (cache.GetIndices()[i] >= header->vertexCount)
+			return std::vector<Vertex>();
+
+	std::vector<Vertex> vertices(cache.GetVertices(), cache.GetVertices() + header->vertexCount);
+	std::sort(vertices.begin(), vertices.end(), [](const Vertex& a, const Vertex& b)
+	{
+		float left[5] = { a.Position.x, a.Position.y, a.Position.z, a.uv.x, a.uv.y };
+		float right[5] = { b.Position.x, b.Position.y, b.Position.z, b.uv.x, b.uv.y };
+		return std::lexicographical_compare(left, left + 5, right, right + 5);
+	});
+	return vertices;
+}
+
+TEST(TangentsAreSameWhenCookedInWindows)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeTangentGrid(40, vertices, indices);
+
+	const wchar_t* sourceFileName = L"MeshTangentTests.obj";
+	const wchar_t* wholeFileName = L"MeshTangentTests.whole.meshbin";
+	const wchar_t* windowedFileName = L"MeshTangentTests.windowed.meshbin";
+	CHECK(WriteObj(sourceFileName, vertices, indices));
+
+	// All of the file in one window, then in dozens of them, where every
+	// window's faces use vertices from earlier ones
+	Mesh mesh(MeshVertexFormat::Full, nullptr);
+	CHECK(mesh.CookObjInWindows(sourceFileName, wholeFileName, false));
+	CHECK(mesh.CookObjInWindows(sourceFileName, windowedFileName, false, 4096));
+
+	unsigned int wholeIndices = 0, windowedIndices = 0;
+	std::vector<Vertex> whole = GetSortedVertices(wholeFileName, sourceFileName, wholeIndices);
+	std::vector<Vertex> windowed = GetSortedVertices(windowedFileName, sourceFileName, windowedIndices);
+
+	// Nothing was split along the windows' edges...
+	CHECK(whole.size() == vertices.size());
+	CHECK(windowed.size() == whole.size());
+	CHECK(windowedIndices == wholeIndices);
+
+	// ...so every vertex was given the tangents of all of its triangles
+	// (only the order they were added in differs)
+	float worst = 0.0f;
+	for (size_t i = 0; i < whole.size() && i < windowed.size(); i++)
+	{
+		CHECK(memcmp(&whole[i].Position, &windowed[i].Position, sizeof(XMFLOAT3)) == 0);
+		CHECK(memcmp(&whole[i].uv, &windowed[i].uv, sizeof(XMFLOAT2)) == 0);
+		XMVECTOR difference = XMLoadFloat3(&whole[i].tangent) - XMLoadFloat3(&windowed[i].tangent);
+		worst = std::max(worst, XMVectorGetX(XMVector3Length(difference)));
+	}
+
+	printf("  worst difference %g\n", worst);
+	CHECK(worst < 1e-4f);
+
+	DeleteFileW(windowedFileName);
+	DeleteFileW(wholeFileName);
+	DeleteFileW(sourceFileName);
+}
+
+// --------------------------------------------------------
+// Times the scalar reference against CalculateTangents(),
+// on one thread and on all of them, for a grid of 2 million
+// triangles
+// --------------------------------------------------------
+BENCHMARK(TangentThroughput)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeTangentGrid(1000, vertices, indices);
+
+	auto measure = [&](const char* name, const std::function<void(std::vector<Vertex>&)>& calculate)
+	{
+		// Best of a few runs
+		double best = 0;
+		for (int run = 0; run < 5; run++)
+		{
+			std::vector<Vertex> copy = vertices;
+			auto start = std::chrono::high_resolution_clock::now();
+			calculate(copy);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+			if (run == 0 || milliseconds < best) best = milliseconds;
+		}
+
+		printf("  %-28s %8.2f ms\n", name, best);
+	};
+
+	std::vector<bool> hasTangent;
+	measure("scalar reference", [&](std::vector<Vertex>& copy) { ReferenceTangents(&copy[0], (int)copy.size(), &indices[0], (int)indices.size(), hasTangent); });
+	measure("CalculateTangents, 1 thread", [&](std::vector<Vertex>& copy) { CalculateTangents(copy, indices, 1); });
+	measure("CalculateTangents, all", [&](std::vector<Vertex>& copy) { CalculateTangents(copy, indices, 0); });
+}
@@ -0,0 +1,440 @@
+#include "TestFramework.h"
+#include "../ObjParser.h"
+#include "../ParallelFor.h"
+
+#include <Windows.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+using namespace DirectX;
+
+// Scratch file for the tests that go through the file system (both names are the same file)
+static const wchar_t* testFileName = L"ObjParserTests.obj";
+static const char* testFileNameNarrow = "ObjParserTests.obj";
+
+// --------------------------------------------------------
+// The getline/sscanf_s loop the memory-mapped parser
+// replaced, minus the conversion to vertices, as the
+// reference for what the parser should produce
+//
+// - Only handles what it always did: lines shorter than 100
+//   characters, and triangles or quads with every index
+// --------------------------------------------------------
+static bool LegacyLoadObj(const char* fileName, ObjData& out)
+{
+	// File input object
+	std::ifstream obj(fileName);
+
+	// Check for successful open
+	if (!obj.is_open())
+		return false;
+
+	char chars[100];			// String for line reading
+
+	// Still have data left?
+	while (obj.good())
+	{
+		// Get the line (100 characters should be more than enough)
+		obj.getline(chars, 100);
+
+		// Check the type of line
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			out.normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			XMFLOAT2 uv;
+			sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+			out.uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			XMFLOAT3 pos;
+			sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			out.positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			int i[12];
+			int numbersRead = sscanf_s(
+				chars,
+				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2],
+				&i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8],
+				&i[9], &i[10], &i[11]);
+
+			// Same triangles as before, in the file's winding order
+			int triangles[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+			for (int t = 0; t < (numbersRead == 12 ? 2 : 1); t++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					int* corner = &i[triangles[t][c] * 3];
+					out.corners.push_back({ corner[0] - 1, corner[1] - 1, corner[2] - 1 });
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Makes an OBJ of a bumpy grid of size x size quads, with
+// every other quad split into two triangles
+//
+// - relative writes the faces with negative indices (all of
+//   the vertices come first, so they mean the same thing)
+// - Some numbers are written in scientific notation
+// --------------------------------------------------------
+static std::string MakeGridObj(int size, const char* newline, bool relative = false)
+{
+	std::string text = "# test grid";
+	text += newline;
+
+	char line[256];
+	int vertexCount = (size + 1) * (size + 1);
+	for (int y = 0; y <= size; y++)
+	{
+		for (int x = 0; x <= size; x++)
+		{
+			float height = sinf(x * 0.37f) * cosf(y * 0.21f);
+			snprintf(line, sizeof(line), "v %f %f %e%s", x * 0.25f, height, y * -0.25f, newline);
+			text += line;
+			snprintf(line, sizeof(line), "vt %f %f%s", x / (float)size, y / (float)size, newline);
+			text += line;
+			snprintf(line, sizeof(line), "vn %f %f %f%s", -height * 0.5f, 0.8f, height * 0.3f, newline);
+			text += line;
+		}
+	}
+
+	auto index = [&](int x, int y)
+	{
+		int absolute = y * (size + 1) + x + 1;
+		return relative ? absolute - vertexCount - 1 : absolute;
+	};
+
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			int a = index(x, y), b = index(x + 1, y), c = index(x + 1, y + 1), d = index(x, y + 1);
+			if ((x + y) % 2 == 0)
+				snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d%s", a, a, a, b, b, b, c, c, c, d, d, d, newline);
+			else
+				snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d%sf %d/%d/%d %d/%d/%d %d/%d/%d%s",
+					a, a, a, b, b, b, c, c, c, newline, a, a, a, c, c, c, d, d, d, newline);
+			text += line;
+		}
+	}
+
+	return text;
+}
+
+template<typename T>
+static bool SameArray(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(T)) == 0);
+}
+
+static bool SameElements(const ObjData& a, const ObjData& b)
+{
+	return SameArray(a.positions, b.positions) && SameArray(a.normals, b.normals) &&
+		SameArray(a.uvs, b.uvs) && SameArray(a.corners, b.corners);
+}
+
+static bool IsCorner(const ObjCorner& corner, int position, int uv, int normal)
+{
+	return corner.position == position && corner.uv == uv && corner.normal == normal;
+}
+
+static ObjData Parse(const std::string& text, int threadCount = 1)
+{
+	ObjData data = {};
+	ParseObj(text.data(), text.data() + text.size(), data, threadCount);
+	return data;
+}
+
+TEST(ObjParserMatchesLegacyLoader)
+{
+	CHECK(WriteTestFile(testFileName, MakeGridObj(64, "\n")));
+
+	ObjData parsed = {};
+	ObjData legacy = {};
+	CHECK(LoadObj(testFileName, parsed));
+	CHECK(LegacyLoadObj(testFileNameNarrow, legacy));
+	DeleteFileW(testFileName);
+
+	// Bit for bit, floats included
+	CHECK(parsed.positions.size() == 65 * 65);
+	CHECK(parsed.corners.size() == 64 * 64 * 6);
+	CHECK(SameElements(parsed, legacy));
+}
+
+TEST(ObjParserHandlesCrlf)
+{
+	ObjData lf = Parse(MakeGridObj(16, "\n"));
+	ObjData crlf = Parse(MakeGridObj(16, "\r\n"));
+	CHECK(SameElements(lf, crlf));
+
+	// No line break at all after the last line
+	ObjData unterminated = Parse("v 1 2 3\r\nv 4 5 6\r\nf 1 2 -1");
+	CHECK(unterminated.positions.size() == 2);
+	CHECK(unterminated.positions[1].z == 6.0f);
+	CHECK(unterminated.corners.size() == 3);
+	CHECK(IsCorner(unterminated.corners[2], 1, -1, -1));
+}
+
+TEST(ObjParserHandlesLongLines)
+{
+	// A comment much longer than the old 100 character buffer
+	std::string text = "# " + std::string(5000, 'x') + "\n";
+
+	// A polygon with 300 corners, which becomes a fan of 298 triangles
+	const int cornerCount = 300;
+	char number[64];
+	for (int i = 0; i < cornerCount; i++)
+	{
+		snprintf(number, sizeof(number), "v %d 0 0\nvt 0.5 0.5\n", i);
+		text += number;
+	}
+	text += "vn 0 1 0\nf";
+	for (int i = 1; i <= cornerCount; i++)
+	{
+		snprintf(number, sizeof(number), " %d/%d/1", i, i);
+		text += number;
+	}
+	text += "\n";
+
+	// More digits than a float (or the parser's mantissa) can hold
+	const char* longNumber = "0.1234567890123456789012345678901234567890";
+	text += std::string("v ") + longNumber + " -98765432109876543210.5 1e-3\n";
+
+	ObjData data = Parse(text);
+	CHECK(data.positions.size() == cornerCount + 1);
+	CHECK(data.uvs.size() == cornerCount);
+	CHECK(data.corners.size() == (cornerCount - 2) * 3);
+	for (int t = 0; t < cornerCount - 2; t++)
+	{
+		CHECK(IsCorner(data.corners[t * 3], 0, 0, 0));
+		CHECK(IsCorner(data.corners[t * 3 + 1], t + 1, t + 1, 0));
+		CHECK(IsCorner(data.corners[t * 3 + 2], t + 2, t + 2, 0));
+	}
+
+	const XMFLOAT3& last = data.positions[cornerCount];
+	CHECK(last.x == strtof(longNumber, 0));
+	CHECK(last.y == strtof("-98765432109876543210.5", 0));
+	CHECK(last.z == strtof("1e-3", 0));
+}
+
+TEST(ObjParserResolvesNegativeIndices)
+{
+	ObjData data = Parse(
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\n"
+		"vt 0 0\nvt 1 0\nvt 0 1\n"
+		"vn 0 0 1\nvn 0 1 0\n"
+		"f -4/-3/-2 -3/-2/-1 -2/-1/-1\n"
+		"v 2 2 2\n"
+		"f -1/-1/-1 -5/-3/-2 -2/-2/-2\n"
+		"f -6/1/1 1/1/1 2/1/1\n");
+
+	CHECK(data.corners.size() == 9);
+	CHECK(IsCorner(data.corners[0], 0, 0, 0));
+	CHECK(IsCorner(data.corners[1], 1, 1, 1));
+	CHECK(IsCorner(data.corners[2], 2, 2, 1));
+
+	// Relative indices count back from the latest element of their own kind
+	CHECK(IsCorner(data.corners[3], 4, 2, 1));
+	CHECK(IsCorner(data.corners[4], 0, 0, 0));
+	CHECK(IsCorner(data.corners[5], 3, 1, 0));
+
+	// Reaching back past the first element is invalid
+	CHECK(data.corners[6].position == -1);
+}
+
+TEST(ObjParserHandlesMissingIndices)
+{
+	ObjData data = Parse(
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n"
+		"f 1 2 3\n"
+		"f 1//1 2//1 3//1\n"
+		"f 1/1 2/1 3/1\n"
+		"f 0/1/1 2/0/1 3/1/0\n");
+
+	CHECK(data.corners.size() == 12);
+	CHECK(IsCorner(data.corners[0], 0, -1, -1));
+	CHECK(IsCorner(data.corners[2], 2, -1, -1));
+	CHECK(IsCorner(data.corners[3], 0, -1, 0));
+	CHECK(IsCorner(data.corners[5], 2, -1, 0));
+	CHECK(IsCorner(data.corners[6], 0, 0, -1));
+	CHECK(IsCorner(data.corners[8], 2, 0, -1));
+
+	// OBJ indices start at 1, so 0 means nothing
+	CHECK(IsCorner(data.corners[9], -1, 0, 0));
+	CHECK(IsCorner(data.corners[10], 1, -1, 0));
+	CHECK(IsCorner(data.corners[11], 2, 0, -1));
+}
+
+TEST(ObjParserRejectsIndicesTooBigForAnInt)
+{
+	// 2^32 + 1 and 2^32 + 2 would wrap around to the first two positions
+	ObjData data = Parse(
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n"
+		"f 4294967297 4294967298 3\n"
+		"f 1/2147483649/1 2/1/99999999999999 3/1/1\n"
+		"f 2147483648 2/1/1 3/1/1\n");
+
+	CHECK(data.corners.size() == 9);
+	CHECK(IsCorner(data.corners[0], -1, -1, -1));
+	CHECK(IsCorner(data.corners[1], -1, -1, -1));
+	CHECK(IsCorner(data.corners[2], 2, -1, -1));
+	CHECK(IsCorner(data.corners[3], 0, -1, 0));
+	CHECK(IsCorner(data.corners[4], 1, 0, -1));
+
+	// The largest index an int can hold is kept, even though it's out of range
+	CHECK(IsCorner(data.corners[6], INT32_MAX, -1, -1));
+}
+
+TEST(ObjParserIsSameOnEveryThreadCount)
+{
+	// Big enough to be split into chunks, whose faces refer back into earlier chunks
+	std::string absolute = MakeGridObj(300, "\n");
+	std::string relative = MakeGridObj(300, "\n", true);
+	CHECK(absolute.size() > 4 * OBJ_MIN_CHUNK_BYTES);
+
+	ObjData expected = Parse(absolute, 1);
+	CHECK(SameElements(expected, Parse(relative, 1)));
+
+	// Counts that don't divide the file evenly, and more threads than there are chunks
+	for (int threadCount : { 2, 3, 4, 7, 16, 64 })
+	{
+		CHECK(SameElements(expected, Parse(absolute, threadCount)));
+		CHECK(SameElements(expected, Parse(relative, threadCount)));
+	}
+
+	// Chunks split on the \n of a \r\n too
+	std::string crlf = MakeGridObj(300, "\r\n");
+	ObjData expectedCrlf = Parse(crlf, 1);
+	CHECK(SameElements(expected, expectedCrlf));
+	for (int threadCount : { 3, 8 })
+		CHECK(SameElements(expectedCrlf, Parse(crlf, threadCount)));
+}
+
+// Streams a file in windows of the given size, gathering every window's corners
+static ObjData Stream(size_t windowBytes)
+{
+	ObjData data = {};
+	std::vector<ObjCorner> corners;
+	CHECK(StreamObj(testFileName, windowBytes, data, [&](ObjData& window)
+	{
+		corners.insert(corners.end(), window.corners.begin(), window.corners.end());
+	}, 1));
+
+	data.corners = corners;
+	return data;
+}
+
+TEST(StreamObjResolvesRelativeIndicesAcrossWindows)
+{
+	// Six 8 byte lines fill the first 48 byte window exactly, so the
+	// face is all the second one has
+	CHECK(WriteTestFile(testFileName,
+		"v 0 0 0\nv 1 0 0\nv 2 0 0\nv 3 0 0\nv 4 0 0\nv 5 0 0\n"
+		"f -3 -2 -1\n"));
+
+	ObjData streamed = Stream(48);
+	CHECK(streamed.positions.size() == 6);
+	CHECK(streamed.corners.size() == 3);
+	for (int c = 0; c < 3 && c < (int)streamed.corners.size(); c++)
+		CHECK(IsCorner(streamed.corners[c], 3 + c, -1, -1));
+
+	// With smaller windows the face shares one with some of the positions
+	ObjData split = Stream(32);
+	CHECK(SameElements(streamed, split));
+
+	// A whole file of relative faces, many windows long
+	CHECK(WriteTestFile(testFileName, MakeGridObj(32, "\n", true)));
+	ObjData loaded = {};
+	CHECK(LoadObj(testFileName, loaded));
+	CHECK(SameElements(loaded, Stream(4096)));
+	DeleteFileW(testFileName);
+}
+
+// --------------------------------------------------------
+// Loads a ~50MB OBJ with the parser (on one thread and on
+// all of them) and with the old loop, reporting each one's
+// throughput
+// --------------------------------------------------------
+BENCHMARK(ObjParserThroughput)
+{
+	std::string text = MakeGridObj(700, "\n");
+	CHECK(WriteTestFile(testFileName, text));
+
+	auto measure = [&](const char* name, const std::function<bool(ObjData&)>& load)
+	{
+		// Best of a few runs, so the file is already cached
+		double best = 0;
+		for (int run = 0; run < 3; run++)
+		{
+			ObjData data = {};
+			auto start = std::chrono::high_resolution_clock::now();
+			CHECK(load(data));
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double seconds = std::chrono::duration<double>(end - start).count();
+			if (run == 0 || seconds < best) best = seconds;
+		}
+
+		printf("  %-22s %8.1f ms %8.1f MB/s\n", name, best * 1000, text.size() / (1024.0 * 1024.0) / best);
+	};
+
+	measure("getline/sscanf_s", [](ObjData& data) { return LegacyLoadObj(testFileNameNarrow, data); });
+	measure("LoadObj, 1 thread", [](ObjData& data) { return LoadObj(testFileName, data, 1); });
+	measure("LoadObj, all threads", [](ObjData& data) { return LoadObj(testFileName, data); });
+
+	DeleteFileW(testFileName);
+}
+
+// --------------------------------------------------------
+// Parses a ~50MB OBJ already in memory on 1, 2, 4, ... up
+// to every thread, reporting how much faster each count is
+// than one thread (no file access, so it's only the parser)
+// --------------------------------------------------------
+BENCHMARK(ObjParserThreadScaling)
+{
+	std::string text = MakeGridObj(700, "\n");
+	int maxThreads = GetDefaultThreadCount();
+
+	std::vector<int> threadCounts;
+	for (int threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+		threadCounts.push_back(threadCount);
+	threadCounts.push_back(maxThreads);
+
+	double single = 0;
+	for (int threadCount : threadCounts)
+	{
+		// Best of a few runs
+		double best = 0;
+		for (int run = 0; run < 3; run++)
+		{
+			ObjData data = {};
+			auto start = std::chrono::high_resolution_clock::now();
+			ParseObj(text.data(), text.data() + text.size(), data, threadCount);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double seconds = std::chrono::duration<double>(end - start).count();
+			if (run == 0 || seconds < best) best = seconds;
+		}
+
+		if (threadCount == 1) single = best;
+		printf("  %3d threads %8.1f ms %8.1f MB/s %6.2fx\n", threadCount, best * 1000,
+			text.size() / (1024.0 * 1024.0) / best, single / best);
+	}
+}
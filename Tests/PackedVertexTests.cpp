@@ -0,0 +1,151 @@
+#include "TestFramework.h"
+#include "../PackedVertex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+// Angle between two directions, in degrees (atan2 stays accurate for the
+// tiny angles being measured, where acos of the dot product doesn't)
+static float AngleBetween(XMFLOAT3 a, XMFLOAT3 b)
+{
+	XMVECTOR first = XMLoadFloat3(&a);
+	XMVECTOR second = XMLoadFloat3(&b);
+	float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(first, second)));
+	float cosine = XMVectorGetX(XMVector3Dot(first, second));
+	return atan2f(sine, cosine) * (180.0f / XM_PI);
+}
+
+// A few hundred thousand directions: random ones, plus the axes and
+// diagonals where the octahedron's folds are
+static std::vector<XMFLOAT3> MakeTestDirections()
+{
+	std::vector<XMFLOAT3> directions;
+	for (int x = -1; x <= 1; x++)
+		for (int y = -1; y <= 1; y++)
+			for (int z = -1; z <= 1; z++)
+				if (x || y || z)
+					directions.push_back(XMFLOAT3((float)x, (float)y, (float)z));
+
+	std::mt19937 random(7);
+	std::normal_distribution<float> normal;
+	while (directions.size() < 250000)
+		directions.push_back(XMFLOAT3(normal(random), normal(random), normal(random)));
+
+	for (XMFLOAT3& direction : directions)
+		XMStoreFloat3(&direction, XMVector3Normalize(XMLoadFloat3(&direction)));
+	return directions;
+}
+
+TEST(PackedVertexIs20Bytes)
+{
+	CHECK(sizeof(PackedVertex) == 20);
+}
+
+TEST(PackedPositionsRoundTrip)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> across(-50.0f, 150.0f);
+
+	// The z axis is flat, like a quad's
+	std::vector<Vertex> vertices(10000);
+	for (Vertex& vertex : vertices)
+		vertex.Position = XMFLOAT3(across(random), across(random) * 0.01f, 3.0f);
+
+	XMFLOAT3 offset, scale;
+	GetPackedPositionRange(&vertices[0], (int)vertices.size(), offset, scale);
+	CHECK(scale.z == 0.0f);
+
+	// Half a 16-bit step of each axis' range (plus a little for float rounding)
+	float worst[3] = {};
+	for (const Vertex& vertex : vertices)
+	{
+		Vertex unpacked = UnpackVertex(PackVertex(vertex, offset, scale), offset, scale);
+		worst[0] = std::max(worst[0], fabsf(unpacked.Position.x - vertex.Position.x));
+		worst[1] = std::max(worst[1], fabsf(unpacked.Position.y - vertex.Position.y));
+		worst[2] = std::max(worst[2], fabsf(unpacked.Position.z - vertex.Position.z));
+	}
+	printf("  worst error %g, %g, %g\n", worst[0], worst[1], worst[2]);
+	CHECK(worst[0] <= scale.x * (0.5f / 65535.0f) * 1.02f);
+	CHECK(worst[1] <= scale.y * (0.5f / 65535.0f) * 1.02f);
+	CHECK(worst[2] == 0.0f);
+}
+
+TEST(PackedNormalsRoundTrip)
+{
+	// 16 bits per axis of the octahedron is about a hundredth of a degree
+	float worst = 0.0f;
+	for (const XMFLOAT3& direction : MakeTestDirections())
+	{
+		Vertex vertex = {};
+		vertex.normal = direction;
+		Vertex unpacked = UnpackVertex(PackVertex(vertex, XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1)), XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
+		worst = std::max(worst, AngleBetween(direction, unpacked.normal));
+	}
+	printf("  worst error %.5f degrees\n", worst);
+	CHECK(worst < 0.01f);
+
+	// The encoding alone (before quantizing) should be exact
+	float worstUnquantized = 0.0f;
+	for (const XMFLOAT3& direction : MakeTestDirections())
+		worstUnquantized = std::max(worstUnquantized, AngleBetween(direction, DecodeOctahedral(EncodeOctahedral(direction))));
+	CHECK(worstUnquantized < 0.001f);
+}
+
+TEST(PackedTangentsRoundTrip)
+{
+	// 8 bits per axis is still about a degree, which is plenty for normal mapping
+	float worst = 0.0f;
+	int wrongSigns = 0;
+	int i = 0;
+	for (const XMFLOAT3& direction : MakeTestDirections())
+	{
+		float sign = i++ % 2 ? 1.0f : -1.0f;
+
+		Vertex vertex = {};
+		vertex.tangent = direction;
+		float unpackedSign = 0.0f;
+		Vertex unpacked = UnpackVertex(PackVertex(vertex, XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), sign),
+			XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), &unpackedSign);
+
+		worst = std::max(worst, AngleBetween(direction, unpacked.tangent));
+		if (unpackedSign != sign)
+			wrongSigns++;
+	}
+	printf("  worst error %.5f degrees\n", worst);
+	CHECK(worst < 1.2f);
+	CHECK(wrongSigns == 0);
+}
+
+TEST(PackedUvsRoundTrip)
+{
+	// Halves keep 11 significant bits, so the error is relative to the uv,
+	// and tiled uvs a long way from 0 lose the most
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> across(-16.0f, 16.0f);
+
+	float worstRelative = 0.0f;
+	for (int i = 0; i < 100000; i++)
+	{
+		Vertex vertex = {};
+		vertex.uv = XMFLOAT2(across(random), across(random) * 0.0625f);
+		if (i < 4)
+			vertex.uv = XMFLOAT2(i * 0.5f, 1.0f - i * 0.25f);
+
+		Vertex unpacked = UnpackVertex(PackVertex(vertex, XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1)), XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
+		if (i < 4)
+		{
+			// Simple fractions like these are exact
+			CHECK(unpacked.uv.x == vertex.uv.x);
+			CHECK(unpacked.uv.y == vertex.uv.y);
+		}
+
+		const float smallest = 1.0f / 16384.0f; // below this halves are denormal, and the error stops shrinking
+		worstRelative = std::max(worstRelative, fabsf(unpacked.uv.x - vertex.uv.x) / std::max(fabsf(vertex.uv.x), smallest));
+		worstRelative = std::max(worstRelative, fabsf(unpacked.uv.y - vertex.uv.y) / std::max(fabsf(vertex.uv.y), smallest));
+	}
+	printf("  worst relative error %g\n", worstRelative);
+	CHECK(worstRelative <= 1.0f / 2048.0f);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+
+// --------------------------------------------------------
+// A minimal test runner for the parts of the engine that
+// don't need a window or a D3D device (mostly the asset
+// pipeline)
+//
+// - TEST(Name) defines a test that runs every time, and
+//   BENCHMARK(Name) one that only runs when the program is
+//   started with --bench (time a Release build)
+// - A failed CHECK() is reported and the test carries on,
+//   so one run shows everything that's wrong
+// - The program's exit code is the number of failed checks
+// --------------------------------------------------------
+
+typedef void (*TestFunction)();
+
+// Adds a test to the list run by main() - use the macros below instead
+struct TestRegistration
+{
+	TestRegistration(const char* name, TestFunction function, bool benchmark);
+};
+
+// Counts and prints a failed check
+void ReportFailure(const char* file, int line, const char* expression);
+
+// Writes a whole file (in the working directory, unless the name has a path),
+// returning false on failure
+bool WriteTestFile(const std::wstring& fileName, const std::string& contents);
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, true); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) ReportFailure(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	CHECK(fabs((double)(a) - (double)(b)) <= (double)(tolerance))
@@ -0,0 +1,85 @@
+#include "TestFramework.h"
+
+#include <Windows.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// One test, as added by TEST() or BENCHMARK()
+struct RegisteredTest
+{
+	const char* name;
+	TestFunction function;
+	bool benchmark;
+};
+
+// A function-level static, so it exists before any other file's registrations run
+static std::vector<RegisteredTest>& GetTests()
+{
+	static std::vector<RegisteredTest> tests;
+	return tests;
+}
+
+static int failureCount = 0;
+
+TestRegistration::TestRegistration(const char* name, TestFunction function, bool benchmark)
+{
+	GetTests().push_back({ name, function, benchmark });
+}
+
+void ReportFailure(const char* file, int line, const char* expression)
+{
+	printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	failureCount++;
+}
+
+bool WriteTestFile(const std::wstring& fileName, const std::string& contents)
+{
+	HANDLE file = CreateFileW(fileName.c_str(), GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	bool success = WriteFile(file, contents.data(), (DWORD)contents.size(), &written, 0) && written == contents.size();
+	CloseHandle(file);
+	return success;
+}
+
+// --------------------------------------------------------
+// Runs every test, plus the benchmarks when given --bench,
+// or just the ones named on the command line
+// --------------------------------------------------------
+int main(int argc, char** argv)
+{
+	bool benchmarks = false;
+	std::vector<const char*> names;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+			benchmarks = true;
+		else
+			names.push_back(argv[i]);
+	}
+
+	int testCount = 0;
+	for (const RegisteredTest& test : GetTests())
+	{
+		bool named = false;
+		for (const char* name : names)
+			named |= strcmp(name, test.name) == 0;
+
+		bool run = names.empty() ? !test.benchmark || benchmarks : named;
+		if (!run)
+			continue;
+
+		printf("%s\n", test.name);
+		int failuresBefore = failureCount;
+		test.function();
+		if (failureCount != failuresBefore)
+			printf("  FAILED\n");
+		testCount++;
+	}
+
+	printf("%d tests run, %d failed checks\n", testCount, failureCount);
+	return failureCount;
+}
@@ -0,0 +1,583 @@
+#include "TestFramework.h"
+#include "../Transform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// Gives a transform a random position, rotation and (non-uniform) scale
+static void Randomize(Transform& transform, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scale(0.1f, 10.0f);
+
+	transform.SetPosition(position(random), position(random), position(random));
+	transform.SetRotation(angle(random), angle(random), angle(random));
+	transform.SetScale(scale(random), scale(random), scale(random));
+}
+
+// The largest difference between two matrices, relative to the largest element of the second
+static float MatrixError(const XMFLOAT4X4& matrix, const XMFLOAT4X4& reference)
+{
+	float largest = 0.0f;
+	float error = 0.0f;
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			largest = std::max(largest, fabsf(reference.m[row][column]));
+			error = std::max(error, fabsf(matrix.m[row][column] - reference.m[row][column]));
+		}
+	}
+
+	return error / largest;
+}
+
+// --------------------------------------------------------
+// How Transform built its world matrix before it moved into
+// the store: from pitch, yaw and roll, one object at a time,
+// with a general inverse for the inverse-transpose
+// --------------------------------------------------------
+struct LegacyTransform
+{
+	XMFLOAT3 position;
+	XMFLOAT3 pitchYawRoll;
+	XMFLOAT3 scale;
+	XMFLOAT4X4 worldMatrix;
+	XMFLOAT4X4 worldInverseTransposeMatrix;
+
+	void Rebuild()
+	{
+		XMMATRIX t = XMMatrixTranslationFromVector(XMLoadFloat3(&position));
+		XMMATRIX r = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+		XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
+
+		XMMATRIX wm = s * r * t;
+		XMStoreFloat4x4(&worldMatrix, wm);
+		XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(wm)));
+	}
+};
+
+TEST(TransformBatchMatchesPerObjectRebuild)
+{
+	// Not a whole number of batches or bitset words, so the last of each is partly empty
+	const int count = 301;
+	TransformStore batchStore;
+	TransformStore singleStore;
+	std::vector<std::unique_ptr<Transform>> batched;
+	std::vector<std::unique_ptr<Transform>> single;
+	std::vector<LegacyTransform> legacy(count);
+
+	std::mt19937 random(18);
+	for (int i = 0; i < count; i++)
+	{
+		batched.emplace_back(new Transform(batchStore));
+		single.emplace_back(new Transform(singleStore));
+		Randomize(*batched[i], random);
+		*single[i] = *batched[i];
+
+		legacy[i].position = batched[i]->GetPosition();
+		legacy[i].pitchYawRoll = batched[i]->GetPitchYawRoll();
+		legacy[i].scale = batched[i]->GetScale();
+		legacy[i].Rebuild();
+	}
+
+	CHECK(batchStore.UpdateWorldMatrices() == count);
+	CHECK(batchStore.GetDirtyCount() == 0);
+
+	float worstSingle = 0.0f;
+	float worstLegacy = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		// The other store never ran a batch, so each of these rebuilds just the one
+		XMFLOAT4X4 matrix = batched[i]->GetWorldMatrix();
+		worstSingle = std::max(worstSingle, MatrixError(matrix, single[i]->GetWorldMatrix()));
+		worstLegacy = std::max(worstLegacy, MatrixError(matrix, legacy[i].worldMatrix));
+	}
+
+	printf("  worst error against one at a time %g, against the old transform %g\n", worstSingle, worstLegacy);
+	CHECK(worstSingle < 1e-5f);
+	CHECK(worstLegacy < 1e-5f);
+	CHECK(singleStore.GetDirtyCount() == 0);
+}
+
+TEST(TransformBatchSkipsCleanSlots)
+{
+	TransformStore store;
+	std::vector<std::unique_ptr<Transform>> transforms;
+	std::mt19937 random(1);
+	for (int i = 0; i < 200; i++)
+	{
+		transforms.emplace_back(new Transform(store));
+		Randomize(*transforms.back(), random);
+	}
+
+	CHECK(store.GetDirtyCount() == 200);
+	CHECK(store.UpdateWorldMatrices() == 200);
+	CHECK(store.UpdateWorldMatrices() == 0);
+
+	std::vector<unsigned int> versions;
+	std::vector<XMFLOAT4X4> matrices;
+	for (auto& transform : transforms)
+	{
+		versions.push_back(transform->GetVersion());
+		matrices.push_back(transform->GetWorldMatrix());
+	}
+
+	// Setting what's already there (as the inspector does every frame) leaves them clean...
+	for (auto& transform : transforms)
+	{
+		transform->SetPosition(transform->GetPosition());
+		transform->SetRotation(transform->GetPitchYawRoll());
+		transform->SetScale(transform->GetScale());
+	}
+	CHECK(store.GetDirtyCount() == 0);
+
+	// ...while real changes, here in the first and third words, rebuild only those slots
+	transforms[5]->MoveAbsolute(1, 0, 0);
+	transforms[130]->Scale(2, 2, 2);
+	CHECK(store.GetDirtyCount() == 2);
+	CHECK(store.UpdateWorldMatrices() == 2);
+
+	for (size_t i = 0; i < transforms.size(); i++)
+	{
+		bool moved = i == 5 || i == 130;
+		CHECK((transforms[i]->GetVersion() != versions[i]) == moved);
+
+		XMFLOAT4X4 matrix = transforms[i]->GetWorldMatrix();
+		CHECK((memcmp(&matrix, &matrices[i], sizeof(matrix)) != 0) == moved);
+	}
+}
+
+TEST(TransformSlotsAreReusedAfterFree)
+{
+	TransformStore store;
+	std::vector<std::unique_ptr<Transform>> transforms;
+	std::mt19937 random(2);
+	for (int i = 0; i < 70; i++)
+	{
+		transforms.emplace_back(new Transform(store));
+		Randomize(*transforms.back(), random);
+	}
+	store.UpdateWorldMatrices();
+
+	unsigned int oldVersion = transforms[66]->GetVersion();
+	transforms[66].reset();
+	CHECK(store.GetCount() == 69);
+
+	// The new transform takes the freed slot, starting from identity with nothing of the old one left
+	transforms[66].reset(new Transform(store));
+	CHECK(store.GetCount() == 70);
+	CHECK(transforms[66]->GetVersion() != oldVersion);
+	CHECK(transforms[66]->GetParent() == nullptr);
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	XMFLOAT4X4 matrix = transforms[66]->GetWorldMatrix();
+	CHECK(memcmp(&matrix, &identity, sizeof(matrix)) == 0);
+	XMFLOAT3 scale = transforms[66]->GetScale();
+	CHECK(scale.x == 1.0f && scale.y == 1.0f && scale.z == 1.0f);
+
+	// ...and is rebuilt by the batch like any other
+	transforms[66]->SetPosition(3, 4, 5);
+	CHECK(store.UpdateWorldMatrices() == 1);
+	matrix = transforms[66]->GetWorldMatrix();
+	CHECK(matrix._41 == 3.0f && matrix._42 == 4.0f && matrix._43 == 5.0f);
+
+	// Freeing everything and starting again leaves every reused slot clean, as new ones are
+	transforms.clear();
+	CHECK(store.GetCount() == 0);
+	CHECK(store.GetDirtyCount() == 0);
+	for (int i = 0; i < 70; i++)
+		transforms.emplace_back(new Transform(store));
+
+	CHECK(store.GetCount() == 70);
+	CHECK(store.UpdateWorldMatrices() == 0);
+}
+
+// The inverse-transpose the old Transform kept, from a general 4x4 inverse of the world matrix
+static XMFLOAT4X4 GeneralInverseTranspose(Transform& transform)
+{
+	XMFLOAT4X4 world = transform.GetWorldMatrix();
+	XMFLOAT4X4 inverseTranspose;
+	XMStoreFloat4x4(&inverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(XMLoadFloat4x4(&world))));
+	return inverseTranspose;
+}
+
+TEST(InverseTransposeMatchesGeneralInverse)
+{
+	TransformStore store;
+	std::mt19937 random(20);
+	std::uniform_real_distribution<float> position(-1e4f, 1e4f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> logScale(-2.0f, 2.0f);
+
+	float worst = 0.0f;
+	for (int i = 0; i < 5000; i++)
+	{
+		// Positions far from the origin and scales from 0.01 to 100, different on every axis
+		Transform transform(store);
+		transform.SetPosition(position(random), position(random), position(random));
+		transform.SetRotation(angle(random), angle(random), angle(random));
+		transform.SetScale(powf(10.0f, logScale(random)), powf(10.0f, logScale(random)), powf(10.0f, logScale(random)));
+
+		// Half of them built before their world matrix is asked for, which used to give a stale one
+		if (i % 2)
+			store.UpdateWorldMatrices();
+
+		worst = std::max(worst, MatrixError(transform.GetWorldInverseTransposeMatrix(), GeneralInverseTranspose(transform)));
+	}
+
+	printf("  worst error %g\n", worst);
+	CHECK(worst < 1e-4f);
+}
+
+TEST(InverseTransposeMatchesGeneralInverseUnderShear)
+{
+	// A forest of rotated children under non-uniformly scaled parents, so most world matrices are sheared
+	TransformStore store;
+	std::vector<std::unique_ptr<Transform>> transforms;
+	std::mt19937 random(21);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scale(0.2f, 5.0f);
+	std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+	for (int i = 0; i < 400; i++)
+	{
+		transforms.emplace_back(new Transform(store));
+		Transform& transform = *transforms.back();
+		transform.SetPosition(position(random), position(random), position(random));
+		transform.SetRotation(angle(random), angle(random), angle(random));
+		transform.SetScale(scale(random), scale(random), scale(random));
+
+		// Parents always come from earlier in the list, at most a few levels up
+		if (i >= 20)
+			transform.SetParent(transforms[random() % (i / 4 + 1)].get());
+	}
+
+	auto check = [&]()
+	{
+		float worst = 0.0f;
+		int sheared = 0;
+		for (auto& transform : transforms)
+		{
+			// Rows of the world matrix that aren't at right angles mean it's sheared
+			XMFLOAT4X4 world = transform->GetWorldMatrix();
+			XMMATRIX matrix = XMLoadFloat4x4(&world);
+			float cosine = XMVectorGetX(XMVector3Dot(XMVector3Normalize(matrix.r[0]), XMVector3Normalize(matrix.r[1])));
+			if (fabsf(cosine) > 0.01f)
+				sheared++;
+
+			worst = std::max(worst, MatrixError(transform->GetWorldInverseTransposeMatrix(), GeneralInverseTranspose(*transform)));
+		}
+
+		printf("  worst error %g, %d sheared\n", worst, sheared);
+		CHECK(worst < 1e-4f);
+		CHECK(sheared > 100);
+	};
+
+	store.UpdateWorldMatrices();
+	check();
+
+	// Moving and rescaling some parents has to reach the inverse-transposes of everything below them
+	for (int i = 0; i < 20; i++)
+	{
+		transforms[i]->Rotate(0.3f, 0.2f, 0.1f);
+		transforms[i]->Scale(1.5f, 0.5f, 1.0f);
+	}
+	store.UpdateWorldMatrices();
+	check();
+}
+
+// S*R*T blended from one state to another, the way the store draws a slot between steps:
+// lerped position and scale, and a normalized lerp of the rotation the short way round
+static XMFLOAT4X4 BlendedMatrix(XMFLOAT3 previousPosition, XMFLOAT4 previousRotation, XMFLOAT3 previousScale,
+	XMFLOAT3 position, XMFLOAT4 rotation, XMFLOAT3 scale, float t)
+{
+	XMVECTOR from = XMLoadFloat4(&previousRotation);
+	XMVECTOR to = XMLoadFloat4(&rotation);
+	if (XMVectorGetX(XMVector4Dot(from, to)) < 0.0f)
+		from = XMVectorNegate(from);
+
+	XMFLOAT4X4 matrix;
+	XMStoreFloat4x4(&matrix,
+		XMMatrixScalingFromVector(XMVectorLerp(XMLoadFloat3(&previousScale), XMLoadFloat3(&scale), t)) *
+		XMMatrixRotationQuaternion(XMQuaternionNormalize(XMVectorLerp(from, to, t))) *
+		XMMatrixTranslationFromVector(XMVectorLerp(XMLoadFloat3(&previousPosition), XMLoadFloat3(&position), t)));
+	return matrix;
+}
+
+TEST(TransformsBlendBetweenSteps)
+{
+	// The same moves in two stores, one drawn by the batch and one a transform at a time
+	TransformStore batchStore;
+	TransformStore singleStore;
+	std::vector<std::unique_ptr<Transform>> batched;
+	std::vector<std::unique_ptr<Transform>> single;
+	std::mt19937 random(22);
+	for (int i = 0; i < 70; i++)
+	{
+		batched.emplace_back(new Transform(batchStore));
+		single.emplace_back(new Transform(singleStore));
+		Randomize(*batched[i], random);
+		*single[i] = *batched[i];
+	}
+	batchStore.UpdateWorldMatrices();
+
+	std::vector<XMFLOAT3> previousPositions, previousScales;
+	std::vector<XMFLOAT4> previousRotations;
+	std::vector<XMFLOAT4X4> unmoved;
+	for (auto& transform : batched)
+	{
+		previousPositions.push_back(transform->GetPosition());
+		previousRotations.push_back(transform->GetRotation());
+		previousScales.push_back(transform->GetScale());
+		unmoved.push_back(transform->GetWorldMatrix());
+	}
+
+	// Every other transform moves in the step, some of them more than once
+	for (TransformStore* store : { &batchStore, &singleStore })
+		store->BeginFixedStep();
+
+	std::mt19937 moves(5);
+	for (int i = 0; i < 70; i += 2)
+	{
+		std::mt19937 movesCopy = moves;
+		Randomize(*batched[i], moves);
+		Randomize(*single[i], movesCopy);
+		if (i % 3 == 0)
+		{
+			batched[i]->Rotate(0.5f, 1.0f, 0.0f);
+			single[i]->Rotate(0.5f, 1.0f, 0.0f);
+		}
+	}
+
+	// Flipping a quaternion's sign is the same rotation, and mustn't blend the long way round
+	XMFLOAT4 flipped = batched[0]->GetRotation();
+	flipped = XMFLOAT4(-flipped.x, -flipped.y, -flipped.z, -flipped.w);
+	batched[0]->SetRotation(flipped);
+	single[0]->SetRotation(flipped);
+
+	for (TransformStore* store : { &batchStore, &singleStore })
+		store->EndFixedStep();
+
+	for (float t : { 0.0f, 0.3f, 0.77f, 1.0f })
+	{
+		batchStore.SetInterpolation(t);
+		singleStore.SetInterpolation(t);
+		batchStore.UpdateWorldMatrices();
+
+		float worst = 0.0f;
+		for (int i = 0; i < 70; i++)
+		{
+			XMFLOAT4X4 matrix = batched[i]->GetWorldMatrix();
+			worst = std::max(worst, MatrixError(single[i]->GetWorldMatrix(), matrix));
+			if (i % 2)
+			{
+				CHECK(memcmp(&matrix, &unmoved[i], sizeof(matrix)) == 0);
+				continue;
+			}
+
+			XMFLOAT4X4 expected = BlendedMatrix(previousPositions[i], previousRotations[i], previousScales[i],
+				batched[i]->GetPosition(), batched[i]->GetRotation(), batched[i]->GetScale(), t);
+			worst = std::max(worst, MatrixError(matrix, expected));
+		}
+
+		printf("  at %g, worst error %g\n", t, worst);
+		CHECK(worst < 1e-5f);
+	}
+
+	// The next step draws everything where it is, unblended
+	batchStore.SetInterpolation(0.5f);
+	batchStore.BeginFixedStep();
+	batchStore.UpdateWorldMatrices();
+	for (int i = 0; i < 70; i += 2)
+	{
+		XMFLOAT4X4 expected = BlendedMatrix(previousPositions[i], previousRotations[i], previousScales[i],
+			batched[i]->GetPosition(), batched[i]->GetRotation(), batched[i]->GetScale(), 1.0f);
+		CHECK(MatrixError(batched[i]->GetWorldMatrix(), expected) < 1e-5f);
+	}
+	batchStore.EndFixedStep();
+}
+
+TEST(TransformsChangedBetweenStepsSnap)
+{
+	TransformStore store;
+	Transform moved(store);
+	Transform teleported(store);
+	Transform edited(store);
+
+	store.BeginFixedStep();
+	for (Transform* transform : { &moved, &teleported, &edited })
+	{
+		transform->SetPosition(10, 0, 0);
+		transform->SetScale(2, 2, 2);
+	}
+	store.EndFixedStep();
+	store.SetInterpolation(0.5f);
+
+	// A teleport between steps goes straight to where it's put, as does an inspector edit
+	teleported.SetPosition(0, 0, 50);
+	edited.SetScale(4, 4, 4);
+	store.UpdateWorldMatrices();
+
+	XMFLOAT4X4 matrix = moved.GetWorldMatrix();
+	CHECK(matrix._41 == 5.0f && matrix._11 == 1.5f);
+	matrix = teleported.GetWorldMatrix();
+	CHECK(matrix._41 == 0.0f && matrix._43 == 50.0f && matrix._11 == 2.0f);
+	matrix = edited.GetWorldMatrix();
+	CHECK(matrix._41 == 10.0f && matrix._11 == 4.0f);
+
+	// ...and stays there at every later fraction, while the one that moved in the step carries on blending
+	store.SetInterpolation(0.75f);
+	store.UpdateWorldMatrices();
+	matrix = moved.GetWorldMatrix();
+	CHECK(matrix._41 == 7.5f);
+	matrix = teleported.GetWorldMatrix();
+	CHECK(matrix._43 == 50.0f && matrix._11 == 2.0f);
+
+	// Writing back what's already there (as the inspector does) doesn't stop a slot blending
+	moved.SetPosition(moved.GetPosition());
+	store.SetInterpolation(0.25f);
+	store.UpdateWorldMatrices();
+	matrix = moved.GetWorldMatrix();
+	CHECK(matrix._41 == 2.5f);
+}
+
+// --------------------------------------------------------
+// Times rebuilding every matrix after everything moved, at
+// 10k, 100k and 1M transforms:
+//
+// - The old Transform, with pitch, yaw and roll and a
+//   general inverse for the inverse-transpose
+// - The store, asking each transform for its matrix
+// - The store's batch
+// - The batch again with only one transform in ten moved
+// --------------------------------------------------------
+BENCHMARK(TransformThroughput)
+{
+	for (int count : { 10000, 100000, 1000000 })
+	{
+		auto measure = [&](const char* name, const std::function<void()>& move, const std::function<void()>& rebuild)
+		{
+			// Best of a few runs, only timing the rebuild
+			double best = 0;
+			for (int run = 0; run < 5; run++)
+			{
+				move();
+				auto start = std::chrono::high_resolution_clock::now();
+				rebuild();
+				auto end = std::chrono::high_resolution_clock::now();
+
+				double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+				if (run == 0 || milliseconds < best) best = milliseconds;
+			}
+
+			printf("  %7d %-24s %8.2f ms\n", count, name, best);
+		};
+
+		std::mt19937 random(3);
+		{
+			std::vector<LegacyTransform> legacy(count);
+			for (LegacyTransform& transform : legacy)
+			{
+				transform.position = XMFLOAT3(0, 0, 0);
+				transform.pitchYawRoll = XMFLOAT3(0.1f, 0.2f, 0.3f);
+				transform.scale = XMFLOAT3(1, 2, 3);
+			}
+
+			measure("old transform", [&]() { for (LegacyTransform& transform : legacy) transform.position.x += 0.001f; },
+				[&]() { for (LegacyTransform& transform : legacy) transform.Rebuild(); });
+		}
+
+		TransformStore store;
+		std::vector<Transform> transforms;
+		transforms.reserve(count);
+		for (int i = 0; i < count; i++)
+		{
+			transforms.emplace_back(store);
+			Randomize(transforms.back(), random);
+		}
+
+		XMFLOAT4X4 sink;
+		measure("store, per object", [&]() { for (Transform& transform : transforms) transform.MoveAbsolute(0.001f, 0, 0); },
+			[&]() { for (Transform& transform : transforms) sink = transform.GetWorldMatrix(); });
+		measure("store, batch", [&]() { for (Transform& transform : transforms) transform.MoveAbsolute(0.001f, 0, 0); },
+			[&]() { store.UpdateWorldMatrices(); });
+		measure("store, batch, 10% moved", [&]() { for (int i = 0; i < count; i += 10) transforms[i].MoveAbsolute(0.001f, 0, 0); },
+			[&]() { store.UpdateWorldMatrices(); });
+		(void)sink;
+	}
+}
+
+// --------------------------------------------------------
+// Times the hierarchy pass at 10k, 100k and 1M transforms,
+// in two shapes: "deep" is chains of 1000, and "wide" is
+// 100 roots with everything else as their children
+//
+// - Every root moved, which recomposes everything, in the
+//   batch and (wide only, as deep chains are quadratic)
+//   one GetWorldMatrix() at a time
+// - One root moved, so one subtree is recomposed
+// - Nothing moved
+// --------------------------------------------------------
+BENCHMARK(TransformHierarchyThroughput)
+{
+	for (int count : { 10000, 100000, 1000000 })
+	{
+		for (bool deep : { true, false })
+		{
+			auto measure = [&](const char* name, const std::function<void()>& move, const std::function<void()>& rebuild)
+			{
+				// Best of a few runs, only timing the rebuild
+				double best = 0;
+				for (int run = 0; run < 5; run++)
+				{
+					move();
+					auto start = std::chrono::high_resolution_clock::now();
+					rebuild();
+					auto end = std::chrono::high_resolution_clock::now();
+
+					double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+					if (run == 0 || milliseconds < best) best = milliseconds;
+				}
+
+				printf("  %7d %-5s %-24s %8.2f ms\n", count, deep ? "deep" : "wide", name, best);
+			};
+
+			std::mt19937 random(4);
+			TransformStore store;
+			std::vector<Transform> transforms;
+			std::vector<Transform*> roots;
+			transforms.reserve(count);
+			for (int i = 0; i < count; i++)
+			{
+				transforms.emplace_back(store);
+				Randomize(transforms.back(), random);
+
+				int parent = deep ? (i % 1000 ? i - 1 : -1) : (i < 100 ? -1 : i % 100);
+				if (parent >= 0)
+					transforms.back().SetParent(&transforms[parent]);
+				else
+					roots.push_back(&transforms.back());
+			}
+			store.UpdateWorldMatrices();
+
+			auto moveRoots = [&]() { for (Transform* root : roots) root->MoveAbsolute(0.001f, 0, 0); };
+			XMFLOAT4X4 sink;
+			measure("roots moved, batch", moveRoots, [&]() { store.UpdateWorldMatrices(); });
+			if (!deep)
+				measure("roots moved, per object", moveRoots, [&]() { for (Transform& transform : transforms) sink = transform.GetWorldMatrix(); });
+			measure("one subtree moved", [&]() { roots[0]->MoveAbsolute(0.001f, 0, 0); }, [&]() { store.UpdateWorldMatrices(); });
+			measure("nothing moved", []() {}, [&]() { store.UpdateWorldMatrices(); });
+			(void)sink;
+		}
+	}
+}
@@ -0,0 +1,291 @@
+#include "TestFramework.h"
+#include "../Transform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// How Transform rotated and moved before it kept a
+// quaternion: angles added up, and turned into a quaternion
+// every time they were used
+// --------------------------------------------------------
+struct EulerTransform
+{
+	XMFLOAT3 position;
+	XMFLOAT3 pitchYawRoll;
+	XMFLOAT3 forward;
+	XMFLOAT4X4 worldMatrix;
+
+	void Rotate(float p, float y, float r)
+	{
+		pitchYawRoll.x += p;
+		pitchYawRoll.y += y;
+		pitchYawRoll.z += r;
+	}
+
+	void MoveRelative(float x, float y, float z)
+	{
+		XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+		XMStoreFloat3(&position, XMLoadFloat3(&position) + XMVector3Rotate(XMVectorSet(x, y, z, 0), rotQuat));
+	}
+
+	XMFLOAT3 GetForward()
+	{
+		XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+		XMStoreFloat3(&forward, XMVector3Rotate(XMVectorSet(0, 0, 1, 0), rotQuat));
+		return forward;
+	}
+
+	void Rebuild()
+	{
+		XMMATRIX r = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+		XMStoreFloat4x4(&worldMatrix, r * XMMatrixTranslationFromVector(XMLoadFloat3(&position)));
+	}
+};
+
+// The largest difference between the rotation matrices of two quaternions
+static float RotationError(FXMVECTOR rotation, FXMVECTOR reference)
+{
+	XMMATRIX a = XMMatrixRotationQuaternion(rotation);
+	XMMATRIX b = XMMatrixRotationQuaternion(reference);
+	float error = 0.0f;
+	for (int row = 0; row < 3; row++)
+		error = std::max(error, XMVectorGetX(XMVector3Length(a.r[row] - b.r[row])));
+
+	return error;
+}
+
+static XMVECTOR GetRotation(Transform& transform)
+{
+	XMFLOAT4 rotation = transform.GetRotation();
+	return XMLoadFloat4(&rotation);
+}
+
+TEST(PitchYawRollRoundTripsExactly)
+{
+	TransformStore store;
+	Transform transform(store);
+	std::mt19937 random(21);
+	std::uniform_real_distribution<float> angle(-10.0f, 10.0f);
+
+	for (int i = 0; i < 1000; i++)
+	{
+		// Angles that were set come back exactly, even outside the range they'd be worked out in...
+		XMFLOAT3 angles(angle(random), angle(random), angle(random));
+		transform.SetRotation(angles);
+		XMFLOAT3 read = transform.GetPitchYawRoll();
+		CHECK(read.x == angles.x && read.y == angles.y && read.z == angles.z);
+
+		// ...and setting them again changes nothing
+		store.UpdateWorldMatrices();
+		transform.SetRotation(read);
+		CHECK(store.GetDirtyCount() == 0);
+	}
+}
+
+TEST(PitchYawRollFromQuaternionsAreStable)
+{
+	TransformStore store;
+	Transform transform(store);
+	std::mt19937 random(22);
+	std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+
+	float worstRotation = 0.0f;
+	float worstDrift = 0.0f;
+	for (int i = 0; i < 2000; i++)
+	{
+		XMFLOAT4 quaternion(component(random), component(random), component(random), component(random));
+		transform.SetRotation(quaternion);
+		XMVECTOR rotation = GetRotation(transform);
+
+		// Angles worked out from a quaternion give back the same rotation...
+		XMFLOAT3 angles = transform.GetPitchYawRoll();
+		CHECK(angles.x >= -XM_PIDIV2 && angles.x <= XM_PIDIV2);
+		worstRotation = std::max(worstRotation, RotationError(XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z), rotation));
+
+		// ...and setting them, then going through a quaternion again, doesn't wander off
+		transform.SetRotation(angles);
+		for (int pass = 0; pass < 10; pass++)
+		{
+			XMFLOAT4 again;
+			XMStoreFloat4(&again, GetRotation(transform));
+			transform.SetRotation(again);
+			transform.SetRotation(transform.GetPitchYawRoll());
+		}
+
+		XMFLOAT3 after = transform.GetPitchYawRoll();
+		worstDrift = std::max(worstDrift, std::max(fabsf(after.x - angles.x), std::max(fabsf(after.y - angles.y), fabsf(after.z - angles.z))));
+	}
+
+	printf("  worst rotation error %g, worst drift %g\n", worstRotation, worstDrift);
+	CHECK(worstRotation < 1e-5f);
+	CHECK(worstDrift < 1e-4f);
+}
+
+TEST(PitchYawRollHandleGimbalLock)
+{
+	TransformStore store;
+	Transform transform(store);
+	std::mt19937 random(23);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+
+	float worstRotation = 0.0f;
+	float worstPitch = 0.0f;
+	for (float pitch : { XM_PIDIV2, -XM_PIDIV2, XM_PIDIV2 - 1e-4f, -XM_PIDIV2 + 1e-4f, XM_PIDIV2 - 1e-2f })
+	{
+		for (int i = 0; i < 200; i++)
+		{
+			// Straight up or down, yaw and roll turn about the same axis
+			XMFLOAT4 quaternion;
+			XMStoreFloat4(&quaternion, XMQuaternionRotationRollPitchYaw(pitch, angle(random), angle(random)));
+			transform.SetRotation(quaternion);
+			XMVECTOR rotation = GetRotation(transform);
+
+			XMFLOAT3 angles = transform.GetPitchYawRoll();
+			CHECK(angles.x == angles.x && angles.y == angles.y && angles.z == angles.z);
+			worstPitch = std::max(worstPitch, fabsf(angles.x - pitch));
+			worstRotation = std::max(worstRotation, RotationError(XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z), rotation));
+		}
+	}
+
+	printf("  worst pitch error %g, worst rotation error %g\n", worstPitch, worstRotation);
+	CHECK(worstPitch < 1e-3f);
+	CHECK(worstRotation < 1e-4f);
+}
+
+TEST(RotateMatchesAddingAnglesWithoutRoll)
+{
+	TransformStore store;
+	Transform transform(store);
+	EulerTransform euler = { XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0) };
+	std::mt19937 random(24);
+	std::uniform_real_distribution<float> turn(-0.02f, 0.02f);
+
+	// Mouse look: lots of small pitches and yaws, never any roll
+	float worst = 0.0f;
+	for (int i = 0; i < 20000; i++)
+	{
+		float pitch = turn(random);
+		float yaw = turn(random);
+		transform.Rotate(pitch, yaw, 0.0f);
+		euler.Rotate(pitch, yaw, 0.0f);
+
+		if (i % 100 == 0)
+		{
+			XMFLOAT3 forward = transform.GetForward();
+			XMFLOAT3 eulerForward = euler.GetForward();
+			worst = std::max(worst, XMVectorGetX(XMVector3Length(XMLoadFloat3(&forward) - XMLoadFloat3(&eulerForward))));
+		}
+	}
+
+	XMFLOAT3 angles = euler.pitchYawRoll;
+	float rotationError = RotationError(GetRotation(transform), XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z));
+	printf("  worst forward difference %g, final rotation difference %g\n", worst, rotationError);
+	CHECK(worst < 1e-4f);
+	CHECK(rotationError < 1e-4f);
+
+	// Moving along the rotated axes goes the same way too
+	transform.MoveRelative(1, 2, 3);
+	euler.MoveRelative(1, 2, 3);
+	XMFLOAT3 position = transform.GetPosition();
+	CHECK_NEAR(position.x, euler.position.x, 1e-3f);
+	CHECK_NEAR(position.y, euler.position.y, 1e-3f);
+	CHECK_NEAR(position.z, euler.position.z, 1e-3f);
+}
+
+// --------------------------------------------------------
+// Times a frame of camera-like work on 100k transforms, the
+// old way (angles) against the new (quaternions):
+//
+// - MoveRelative() six times
+// - Rotate(), MoveRelative() six times and GetForward()
+// - Rotate() alone, then the matrices rebuilt (one at a
+//   time for angles, in the batch for quaternions)
+// --------------------------------------------------------
+BENCHMARK(TransformRotationThroughput)
+{
+	const int count = 100000;
+	std::vector<EulerTransform> euler(count, { XMFLOAT3(0, 0, 0), XMFLOAT3(0.1f, 0.2f, 0.0f) });
+
+	TransformStore store;
+	std::vector<Transform> transforms;
+	transforms.reserve(count);
+	for (int i = 0; i < count; i++)
+	{
+		transforms.emplace_back(store);
+		transforms.back().SetRotation(0.1f, 0.2f, 0.0f);
+	}
+	store.UpdateWorldMatrices();
+
+	auto measure = [&](const char* name, const std::function<void()>& frame)
+	{
+		// Best of a few frames
+		double best = 0;
+		for (int run = 0; run < 5; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			frame();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+			if (run == 0 || milliseconds < best) best = milliseconds;
+		}
+
+		printf("  %-40s %8.2f ms\n", name, best);
+	};
+
+	float sink = 0.0f;
+	measure("MoveRelative x6, angles", [&]()
+	{
+		for (EulerTransform& transform : euler)
+			for (int move = 0; move < 6; move++)
+				transform.MoveRelative(0.01f, 0.0f, 0.01f);
+	});
+	measure("MoveRelative x6, quaternion", [&]()
+	{
+		for (Transform& transform : transforms)
+			for (int move = 0; move < 6; move++)
+				transform.MoveRelative(0.01f, 0.0f, 0.01f);
+	});
+	measure("Rotate, MoveRelative x6, forward, angles", [&]()
+	{
+		for (EulerTransform& transform : euler)
+		{
+			transform.Rotate(0.001f, 0.002f, 0.0f);
+			for (int move = 0; move < 6; move++)
+				transform.MoveRelative(0.01f, 0.0f, 0.01f);
+			sink += transform.GetForward().x;
+		}
+	});
+	measure("Rotate, MoveRelative x6, forward, quaternion", [&]()
+	{
+		for (Transform& transform : transforms)
+		{
+			transform.Rotate(0.001f, 0.002f, 0.0f);
+			for (int move = 0; move < 6; move++)
+				transform.MoveRelative(0.01f, 0.0f, 0.01f);
+			sink += transform.GetForward().x;
+		}
+	});
+	measure("Rotate and rebuild, angles", [&]()
+	{
+		for (EulerTransform& transform : euler)
+		{
+			transform.Rotate(0.001f, 0.002f, 0.0f);
+			transform.Rebuild();
+		}
+	});
+	measure("Rotate and rebuild, quaternion", [&]()
+	{
+		for (Transform& transform : transforms)
+			transform.Rotate(0.001f, 0.002f, 0.0f);
+		store.UpdateWorldMatrices();
+	});
+	printf("  (%g)\n", sink);
+}
@@ -5,27 +5,48 @@
 using namespace DirectX;
 
 //CONSTRUCTOR
-Transform::Transform() : 
-	position(0, 0, 0),
-	pitchYawRoll(0, 0, 0),
-	scale(1.0f, 1.0f, 1.0f),
-	matrixDirty(false),
-	forward(0,0,1),
-	right(1,0,0),
-	up(0,1,0),
-	vectorsDirty(false)
+Transform::Transform() : Transform(TransformStore::GetInstance())
 {
-	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
-	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixIdentity());
+}
+
+Transform::Transform(TransformStore& store) :
+	store(&store),
+	slot(store.Allocate(this))
+{
+}
+
+Transform::Transform(const Transform& other) :
+	store(other.store),
+	slot(other.store->Allocate(this))
+{
+	other.store->CopySlot(other.slot, *store, slot);
+}
+
+Transform& Transform::operator=(const Transform& other)
+{
+	if (this != &other)
+		other.store->CopySlot(other.slot, *store, slot);
+
+	return *this;
+}
+
+Transform::~Transform()
+{
+	store->Free(slot);
 }
 
 //SETTERS
 void Transform::SetPosition(float x, float y, float z)
 {
-	position.x = x;
-	position.y = y;
-	position.z = z;
-	matrixDirty = true;
+	//The inspector sets every position back every frame, mostly unchanged
+	if (store->positionX[slot] == x && store->positionY[slot] == y && store->positionZ[slot] == z)
+		return;
+
+	store->SavePrevious(slot);
+	store->positionX[slot] = x;
+	store->positionY[slot] = y;
+	store->positionZ[slot] = z;
+	store->MarkMatrixDirty(slot);
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 position)
@@ -35,11 +56,16 @@ void Transform::SetPosition(DirectX::XMFLOAT3 position)
 
 void Transform::SetRotation(float p, float y, float r)
 {
-	pitchYawRoll.x = p;
-	pitchYawRoll.y = y;
-	pitchYawRoll.z = r;
-	matrixDirty = true;
-	vectorsDirty = true;
+	//The inspector sets every rotation back every frame, mostly unchanged
+	XMFLOAT3& angles = store->eulerAngles[slot];
+	if (!store->AreEulerAnglesDirty(slot) && angles.x == p && angles.y == y && angles.z == r)
+		return;
+
+	store->SetRotation(slot, XMQuaternionRotationRollPitchYaw(p, y, r));
+
+	//Keep the angles as given, so reading them back (and setting them again) never drifts
+	angles = XMFLOAT3(p, y, r);
+	store->eulerDirtyBits[slot / 64] &= ~(1ull << (slot % 64));
 }
 
 void Transform::SetRotation(DirectX::XMFLOAT3 rotation)
@@ -47,12 +73,22 @@ void Transform::SetRotation(DirectX::XMFLOAT3 rotation)
 	SetRotation(rotation.x, rotation.y, rotation.z);
 }
 
+void Transform::SetRotation(DirectX::XMFLOAT4 quaternion)
+{
+	store->SetRotation(slot, XMQuaternionNormalize(XMLoadFloat4(&quaternion)));
+}
+
 void Transform::SetScale(float x, float y, float z)
 {
-	scale.x = x;
-	scale.y = y;
-	scale.z = z;
-	matrixDirty = true;
+	//As with positions, so unchanged transforms stay clean
+	if (store->scaleX[slot] == x && store->scaleY[slot] == y && store->scaleZ[slot] == z)
+		return;
+
+	store->SavePrevious(slot);
+	store->scaleX[slot] = x;
+	store->scaleY[slot] = y;
+	store->scaleZ[slot] = z;
+	store->MarkMatrixDirty(slot);
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 scale)
@@ -61,43 +97,54 @@ void Transform::SetScale(DirectX::XMFLOAT3 scale)
 }
 
 //GETTERS
-DirectX::XMFLOAT3 Transform::GetPosition() {return position;}
-DirectX::XMFLOAT3 Transform::GetPitchYawRoll() {return pitchYawRoll;}
-DirectX::XMFLOAT3 Transform::GetScale() {return scale;}
+DirectX::XMFLOAT3 Transform::GetPosition() {return XMFLOAT3(store->positionX[slot], store->positionY[slot], store->positionZ[slot]);}
+DirectX::XMFLOAT3 Transform::GetPitchYawRoll() { store->UpdateEulerAngles(slot); return store->eulerAngles[slot]; }
+DirectX::XMFLOAT4 Transform::GetRotation() {return XMFLOAT4(store->rotationX[slot], store->rotationY[slot], store->rotationZ[slot], store->rotationW[slot]);}
+DirectX::XMFLOAT3 Transform::GetScale() {return XMFLOAT3(store->scaleX[slot], store->scaleY[slot], store->scaleZ[slot]);}
 
-DirectX::XMFLOAT3 Transform::GetForward() { UpdateVectors(); return forward; }
-DirectX::XMFLOAT3 Transform::GetRight() { UpdateVectors(); return right; }
-DirectX::XMFLOAT3 Transform::GetUp() { UpdateVectors(); return up; }
+DirectX::XMFLOAT3 Transform::GetForward() { UpdateVectors(); return store->forwards[slot]; }
+DirectX::XMFLOAT3 Transform::GetRight() { UpdateVectors(); return store->rights[slot]; }
+DirectX::XMFLOAT3 Transform::GetUp() { UpdateVectors(); return store->ups[slot]; }
 
-DirectX::XMFLOAT4X4 Transform::GetWorldMatrix() 
+DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	if (matrixDirty)
-	{
-		//Build individual transformation matrices
-		XMMATRIX t = XMMatrixTranslationFromVector(XMLoadFloat3(&position));
-		XMMATRIX r = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-		XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
+	//Usually already rebuilt by the store's batch, otherwise done on its own now
+	store->UpdateWorldMatrix(slot);
+	return store->GetWorldMatrix(slot);
+}
+DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
+{
+	//Built only when asked for, so transforms that are never lit never pay for it
+	store->UpdateInverseTranspose(slot);
+	return store->GetWorldInverseTransposeMatrix(slot);
+}
+unsigned int Transform::GetVersion()
+{
+	store->UpdateWorldMatrix(slot);
+	return store->GetVersion(slot);
+}
 
-		//Combine into a single world matrix
-		XMMATRIX wm = s * r * t;
+bool Transform::SetParent(Transform* parent)
+{
+	if (parent && parent->store != store)
+		return false;
 
-		//Store it somewhere
-		XMStoreFloat4x4(&worldMatrix, wm);
-		XMStoreFloat4x4(&worldInverseTransposeMatrix,
-			XMMatrixInverse(0, XMMatrixTranspose(wm)));
-		matrixDirty = false;
-	}
+	return store->SetParent(slot, parent ? (int)parent->slot : -1);
+}
 
-	return worldMatrix;
+Transform* Transform::GetParent()
+{
+	int parent = store->parents[slot];
+	return parent >= 0 ? store->owners[parent] : nullptr;
 }
-DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix() {return worldInverseTransposeMatrix;}
 
 void Transform::MoveAbsolute(float x, float y, float z)
 {
-	position.x += x;
-	position.y += y;
-	position.z += z;
-	matrixDirty = true;
+	store->SavePrevious(slot);
+	store->positionX[slot] += x;
+	store->positionY[slot] += y;
+	store->positionZ[slot] += z;
+	store->MarkMatrixDirty(slot);
 }
 
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
@@ -107,17 +154,18 @@ void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	//Create a direction vector from the input and
-	//rotate to match our current orientation
-	XMVECTOR movement = XMVectorSet(x, y, z, 0);
-	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-
-	//The now-relative direction for our movement
-	XMVECTOR relativeDir = XMVector3Rotate(movement, rotQuat);
+	//Move along our own right, up and forward, which
+	//stay cached until the rotation changes
+	UpdateVectors();
+	XMVECTOR relativeDir =
+		XMLoadFloat3(&store->rights[slot]) * x +
+		XMLoadFloat3(&store->ups[slot]) * y +
+		XMLoadFloat3(&store->forwards[slot]) * z;
 
 	//Add and store the results
+	XMFLOAT3 position = GetPosition();
 	XMStoreFloat3(&position, XMLoadFloat3(&position) + relativeDir);
-	matrixDirty = true;
+	SetPosition(position);
 }
 
 void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
@@ -127,11 +175,21 @@ void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
 
 void Transform::Rotate(float p, float y, float r)
 {
-	pitchYawRoll.x += p;
-	pitchYawRoll.y += y;
-	pitchYawRoll.z += r;
-	matrixDirty = true;
-	vectorsDirty = true;
+	//Every half-angle's sine and cosine at once
+	XMVECTOR sines, cosines;
+	XMVectorSinCos(&sines, &cosines, XMVectorSet(p, y, r, 0) * 0.5f);
+	XMFLOAT3 s, c;
+	XMStoreFloat3(&s, sines);
+	XMStoreFloat3(&c, cosines);
+
+	//Pitch and roll go before the current rotation (so they're about our own axes)
+	//and yaw after it (so it's about the up axis), as adding them to the angles did
+	XMVECTOR pitchRoll = XMVectorSet(c.z * s.x, -s.z * s.x, s.z * c.x, c.z * c.x); //XMQuaternionRotationRollPitchYaw(p, 0, r)
+	XMVECTOR yaw = XMVectorSet(0, s.y, 0, c.y);
+	XMVECTOR rotation = XMQuaternionMultiply(XMQuaternionMultiply(pitchRoll, store->GetRotation(slot)), yaw);
+
+	//Renormalize so rounding can't build up over many small turns
+	store->SetRotation(slot, XMQuaternionNormalize(rotation));
 }
 
 void Transform::Rotate(DirectX::XMFLOAT3 rotation)
@@ -141,10 +199,11 @@ void Transform::Rotate(DirectX::XMFLOAT3 rotation)
 
 void Transform::Scale(float x, float y, float z)
 {
-	scale.x *= x;
-	scale.y *= y;
-	scale.z *= z;
-	matrixDirty = true;
+	store->SavePrevious(slot);
+	store->scaleX[slot] *= x;
+	store->scaleY[slot] *= y;
+	store->scaleZ[slot] *= z;
+	store->MarkMatrixDirty(slot);
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 scale)
@@ -154,16 +213,5 @@ void Transform::Scale(DirectX::XMFLOAT3 scale)
 
 void Transform::UpdateVectors()
 {
-	//Leave if there's no work
-	if (!vectorsDirty)
-		return;
-
-	//Update all three vectors
-	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-	XMStoreFloat3(&forward, XMVector3Rotate(XMVectorSet(0, 0, 1, 0), rotQuat));
-	XMStoreFloat3(&right, XMVector3Rotate(XMVectorSet(1, 0, 0, 0), rotQuat));
-	XMStoreFloat3(&up, XMVector3Rotate(XMVectorSet(0, 1, 0, 0), rotQuat));
-
-	//We're clean
-	vectorsDirty = false;
+	store->UpdateVectors(slot);
 }
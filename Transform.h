@@ -1,11 +1,33 @@
 #pragma once
 
 #include <DirectXMath.h>
-
+#include "TransformStore.h"
+
+// A position, rotation and scale, kept in a TransformStore
+// along with every other transform so their matrices can be
+// rebuilt in batches (see TransformStore::UpdateWorldMatrices)
+//
+// - With a parent, the position, rotation and scale are in
+//   the parent's space, as are forward, right and up; only
+//   the world matrices include the parent's
+// - The hierarchy isn't copied - copies start out as roots
+// - The rotation is a quaternion.  Pitch, yaw and roll can
+//   still be set and read, but Rotate() turns the current
+//   rotation rather than adding angles, and angles read
+//   back after it are any that give the same rotation
+// - Changes made during a fixed step (see DXCore) are drawn
+//   blended from before it, but read back as they are now
 class Transform
 {
 public:
-	Transform();
+	Transform(); //lives in TransformStore::GetInstance()
+	Transform(TransformStore& store);
+
+	//copies get a slot of their own, holding the same values (assigning keeps this transform's parent)
+	Transform(const Transform& other);
+	Transform& operator=(const Transform& other);
+
+	~Transform();
 
 	//Setters
 	void SetPosition(float x, float y, float z);
@@ -13,13 +35,15 @@ public:
 
 	void SetRotation(float p, float y, float r);
 	void SetRotation(DirectX::XMFLOAT3 rotation);
+	void SetRotation(DirectX::XMFLOAT4 quaternion); //normalized before it's stored
 
 	void SetScale(float x, float y, float z);
 	void SetScale(DirectX::XMFLOAT3 scale);
 
 	//Getters
 	DirectX::XMFLOAT3 GetPosition();
-	DirectX::XMFLOAT3 GetPitchYawRoll();
+	DirectX::XMFLOAT3 GetPitchYawRoll(); //exactly what was set, or worked out from the quaternion since
+	DirectX::XMFLOAT4 GetRotation();
 	DirectX::XMFLOAT3 GetScale();
 
 	DirectX::XMFLOAT3 GetForward();
@@ -29,6 +53,15 @@ public:
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
 
+	//Changes every time the world matrix does (including when a parent
+	//moves), so anything derived from it can tell when it needs to be rebuilt
+	unsigned int GetVersion();
+
+	//Hierarchy
+	//returns false, changing nothing, if parent is in another store or is this transform or one of its children
+	bool SetParent(Transform* parent);
+	Transform* GetParent(); //null for roots
+
 	//Transformers
 	void MoveAbsolute(float x, float y, float z);
 	void MoveAbsolute(DirectX::XMFLOAT3 offset);
@@ -36,6 +69,8 @@ public:
 	void MoveRelative(float x, float y, float z);
 	void MoveRelative(DirectX::XMFLOAT3 offset);
 
+	//pitches and rolls about this transform's own right and forward, then yaws about the up axis of
+	//the space it's in, which is the same as adding to pitch and yaw while there's no roll
 	void Rotate(float p, float y, float r);
 	void Rotate(DirectX::XMFLOAT3 rotation);
 
@@ -45,18 +80,6 @@ public:
 	void UpdateVectors();
 
 private:
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 pitchYawRoll;
-	DirectX::XMFLOAT3 scale;
-
-	//Local Vectors
-	DirectX::XMFLOAT3 forward;
-	DirectX::XMFLOAT3 right;
-	DirectX::XMFLOAT3 up;
-
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
-
-	bool matrixDirty;
-	bool vectorsDirty;
+	TransformStore* store; //where this transform's values live
+	unsigned int slot; //which of the store's slots is this transform's
 };
\ No newline at end of file
@@ -0,0 +1,780 @@
+#include "TransformStore.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+TransformStore& TransformStore::GetInstance()
+{
+	static TransformStore instance;
+	return instance;
+}
+
+TransformStore::TransformStore() :
+	slotCount(0),
+	liveCount(0),
+	stepping(false),
+	interpolation(1.0f),
+	hierarchyOrderDirty(false)
+{
+}
+
+TransformStore::~TransformStore()
+{
+}
+
+unsigned int TransformStore::Allocate(Transform* owner)
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = slotCount++;
+
+		// Grow by a whole bitset word, which also keeps every batch of four inside the arrays
+		if (slot == positionX.size())
+		{
+			size_t size = positionX.size() + 64;
+			XMFLOAT4X4 identity;
+			XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+			positionX.resize(size, 0.0f);
+			positionY.resize(size, 0.0f);
+			positionZ.resize(size, 0.0f);
+			rotationX.resize(size, 0.0f);
+			rotationY.resize(size, 0.0f);
+			rotationZ.resize(size, 0.0f);
+			rotationW.resize(size, 1.0f);
+			eulerAngles.resize(size, XMFLOAT3(0, 0, 0));
+			scaleX.resize(size, 1.0f);
+			scaleY.resize(size, 1.0f);
+			scaleZ.resize(size, 1.0f);
+			previousPositionX.resize(size, 0.0f);
+			previousPositionY.resize(size, 0.0f);
+			previousPositionZ.resize(size, 0.0f);
+			previousRotationX.resize(size, 0.0f);
+			previousRotationY.resize(size, 0.0f);
+			previousRotationZ.resize(size, 0.0f);
+			previousRotationW.resize(size, 1.0f);
+			previousScaleX.resize(size, 1.0f);
+			previousScaleY.resize(size, 1.0f);
+			previousScaleZ.resize(size, 1.0f);
+			worldMatrices.resize(size, identity);
+			worldInverseTransposeMatrices.resize(size, identity);
+			forwards.resize(size, XMFLOAT3(0, 0, 1));
+			rights.resize(size, XMFLOAT3(1, 0, 0));
+			ups.resize(size, XMFLOAT3(0, 1, 0));
+			versions.resize(size, 0);
+			parents.resize(size, -1);
+			firstChildren.resize(size, -1);
+			nextSiblings.resize(size, -1);
+			previousSiblings.resize(size, -1);
+			hierarchyIndices.resize(size, -1);
+			owners.resize(size, nullptr);
+			matrixDirtyBits.resize(size / 64, 0);
+			composeDirtyBits.resize(size / 64, 0);
+			inverseTransposeDirtyBits.resize(size / 64, 0);
+			vectorsDirtyBits.resize(size / 64, 0);
+			eulerDirtyBits.resize(size / 64, 0);
+			interpolateBits.resize(size / 64, 0);
+			liveBits.resize(size / 64, 0);
+		}
+	}
+
+	// Reused slots still hold whatever was freed, so reset them to identity
+	// (the version carries on counting, so nothing cached from the old one matches)
+	positionX[slot] = positionY[slot] = positionZ[slot] = 0.0f;
+	rotationX[slot] = rotationY[slot] = rotationZ[slot] = 0.0f;
+	rotationW[slot] = 1.0f;
+	eulerAngles[slot] = XMFLOAT3(0, 0, 0);
+	scaleX[slot] = scaleY[slot] = scaleZ[slot] = 1.0f;
+	XMStoreFloat4x4(&worldMatrices[slot], XMMatrixIdentity());
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[slot], XMMatrixIdentity());
+	forwards[slot] = XMFLOAT3(0, 0, 1);
+	rights[slot] = XMFLOAT3(1, 0, 0);
+	ups[slot] = XMFLOAT3(0, 1, 0);
+	parents[slot] = -1;
+	firstChildren[slot] = nextSiblings[slot] = previousSiblings[slot] = -1;
+	owners[slot] = owner;
+
+	liveBits[slot / 64] |= 1ull << (slot % 64);
+	liveCount++;
+	return slot;
+}
+
+void TransformStore::Free(unsigned int slot)
+{
+	// Its children become roots, keeping their own position, rotation and scale
+	while (firstChildren[slot] >= 0)
+		SetParent(firstChildren[slot], -1);
+
+	SetParent(slot, -1);
+
+	uint64_t bit = 1ull << (slot % 64);
+	liveBits[slot / 64] &= ~bit;
+	matrixDirtyBits[slot / 64] &= ~bit;
+	composeDirtyBits[slot / 64] &= ~bit;
+	inverseTransposeDirtyBits[slot / 64] &= ~bit;
+	vectorsDirtyBits[slot / 64] &= ~bit;
+	eulerDirtyBits[slot / 64] &= ~bit;
+	interpolateBits[slot / 64] &= ~bit;
+	owners[slot] = nullptr;
+	versions[slot]++;
+	freeSlots.push_back(slot);
+	liveCount--;
+}
+
+void TransformStore::CopySlot(unsigned int slot, TransformStore& destStore, unsigned int destSlot)
+{
+	destStore.SavePrevious(destSlot);
+	destStore.positionX[destSlot] = positionX[slot];
+	destStore.positionY[destSlot] = positionY[slot];
+	destStore.positionZ[destSlot] = positionZ[slot];
+	destStore.rotationX[destSlot] = rotationX[slot];
+	destStore.rotationY[destSlot] = rotationY[slot];
+	destStore.rotationZ[destSlot] = rotationZ[slot];
+	destStore.rotationW[destSlot] = rotationW[slot];
+	destStore.eulerAngles[destSlot] = eulerAngles[slot];
+	destStore.scaleX[destSlot] = scaleX[slot];
+	destStore.scaleY[destSlot] = scaleY[slot];
+	destStore.scaleZ[destSlot] = scaleZ[slot];
+	destStore.MarkMatrixDirty(destSlot);
+	destStore.MarkVectorsDirty(destSlot);
+
+	uint64_t bit = 1ull << (destSlot % 64);
+	destStore.eulerDirtyBits[destSlot / 64] = (destStore.eulerDirtyBits[destSlot / 64] & ~bit) | (AreEulerAnglesDirty(slot) ? bit : 0);
+}
+
+bool TransformStore::SetParent(unsigned int slot, int parent)
+{
+	if (parent == parents[slot])
+		return true;
+
+	for (int ancestor = parent; ancestor >= 0; ancestor = parents[ancestor])
+	{
+		if (ancestor == (int)slot)
+			return false;
+	}
+
+	// Unlink it from its old parent's children, then put it at the front of its new parent's
+	if (previousSiblings[slot] >= 0)
+		nextSiblings[previousSiblings[slot]] = nextSiblings[slot];
+	else if (parents[slot] >= 0)
+		firstChildren[parents[slot]] = nextSiblings[slot];
+
+	if (nextSiblings[slot] >= 0)
+		previousSiblings[nextSiblings[slot]] = previousSiblings[slot];
+
+	parents[slot] = parent;
+	previousSiblings[slot] = -1;
+	nextSiblings[slot] = -1;
+	if (parent >= 0)
+	{
+		nextSiblings[slot] = firstChildren[parent];
+		if (firstChildren[parent] >= 0)
+			previousSiblings[firstChildren[parent]] = slot;
+
+		firstChildren[parent] = slot;
+	}
+
+	// Its own matrix moves between the world and local arrays, so rebuild it
+	MarkMatrixDirty(slot);
+	composeDirtyBits[slot / 64] &= ~(1ull << (slot % 64));
+	hierarchyOrderDirty = true;
+	return true;
+}
+
+// --------------------------------------------------------
+// Lays the children out in order of depth
+//
+// - A slot's depth is found by walking up until reaching a
+//   root or a slot already given one, so each slot is only
+//   walked through once
+// - The entries are then bucketed by depth (a counting
+//   sort), which keeps every parent ahead of its children
+// - Local matrices move to their new entries; every world
+//   matrix is composed again, since parents may have moved
+// --------------------------------------------------------
+void TransformStore::SortHierarchy()
+{
+	// Children keep their versions in the hierarchy arrays, so hand them back first
+	for (size_t entry = 0; entry < hierarchyOrder.size(); entry++)
+	{
+		unsigned int slot = hierarchyOrder[entry].slot;
+		if (IsLive(slot))
+			versions[slot] = hierarchyVersions[entry];
+	}
+
+	std::vector<unsigned int> depths(slotCount, 0);
+	std::vector<unsigned int> path;
+	std::vector<unsigned int> depthStarts(1, 0);
+	unsigned int childCount = 0;
+
+	for (unsigned int slot = 0; slot < slotCount; slot++)
+	{
+		if (parents[slot] < 0 || depths[slot] > 0 || !IsLive(slot))
+			continue;
+
+		unsigned int current = slot;
+		while (parents[current] >= 0 && depths[current] == 0)
+		{
+			path.push_back(current);
+			current = parents[current];
+		}
+
+		unsigned int depth = depths[current];
+		while (!path.empty())
+		{
+			depths[path.back()] = ++depth;
+			if (depth >= depthStarts.size())
+				depthStarts.resize(depth + 1, 0);
+
+			depthStarts[depth]++;
+			childCount++;
+			path.pop_back();
+		}
+	}
+
+	// Turn the counts into where each depth starts
+	unsigned int start = 0;
+	for (unsigned int& depthStart : depthStarts)
+	{
+		unsigned int depthSize = depthStart;
+		depthStart = start;
+		start += depthSize;
+	}
+
+	std::vector<HierarchyEntry> order(childCount);
+	std::vector<XMFLOAT4X4> localMatrices(childCount);
+	for (unsigned int slot = 0; slot < slotCount; slot++)
+	{
+		int oldEntry = hierarchyIndices[slot];
+		hierarchyIndices[slot] = -1;
+		if (depths[slot] == 0)
+			continue;
+
+		// Anything newly parented is dirty, so only children that already had an entry have a local matrix worth keeping
+		unsigned int entry = depthStarts[depths[slot]]++;
+		order[entry] = { slot, (unsigned int)parents[slot], -1 };
+		if (oldEntry >= 0)
+			localMatrices[entry] = hierarchyLocalMatrices[oldEntry];
+
+		hierarchyIndices[slot] = entry;
+		composeDirtyBits[slot / 64] |= 1ull << (slot % 64);
+	}
+
+	for (HierarchyEntry& entry : order)
+		entry.parentEntry = hierarchyIndices[entry.parent];
+
+	hierarchyOrder.swap(order);
+	hierarchyLocalMatrices.swap(localMatrices);
+	hierarchyWorldMatrices.resize(childCount);
+	hierarchyWorldInverseTransposeMatrices.resize(childCount);
+	hierarchyVersions.resize(childCount);
+	hierarchyParentVersions.resize(childCount);
+	for (unsigned int entry = 0; entry < childCount; entry++)
+		hierarchyVersions[entry] = versions[hierarchyOrder[entry].slot];
+
+	hierarchyOrderDirty = false;
+}
+
+void TransformStore::Compose(unsigned int entry)
+{
+	const HierarchyEntry& child = hierarchyOrder[entry];
+	const XMFLOAT4X4& parentWorld = child.parentEntry < 0 ? worldMatrices[child.parent] : hierarchyWorldMatrices[child.parentEntry];
+	XMStoreFloat4x4(&hierarchyWorldMatrices[entry], XMMatrixMultiply(
+		XMLoadFloat4x4(&hierarchyLocalMatrices[entry]), XMLoadFloat4x4(&parentWorld)));
+
+	hierarchyParentVersions[entry] = GetParentVersion(child);
+	hierarchyVersions[entry]++;
+	composeDirtyBits[child.slot / 64] &= ~(1ull << (child.slot % 64));
+	inverseTransposeDirtyBits[child.slot / 64] |= 1ull << (child.slot % 64);
+}
+
+const XMFLOAT4X4& TransformStore::GetWorldMatrix(unsigned int slot)
+{
+	int entry = hierarchyIndices[slot];
+	return entry >= 0 ? hierarchyWorldMatrices[entry] : worldMatrices[slot];
+}
+
+const XMFLOAT4X4& TransformStore::GetWorldInverseTransposeMatrix(unsigned int slot)
+{
+	int entry = hierarchyIndices[slot];
+	return entry >= 0 ? hierarchyWorldInverseTransposeMatrices[entry] : worldInverseTransposeMatrices[slot];
+}
+
+unsigned int TransformStore::GetVersion(unsigned int slot)
+{
+	int entry = hierarchyIndices[slot];
+	return entry >= 0 ? hierarchyVersions[entry] : versions[slot];
+}
+
+unsigned int TransformStore::GetParentVersion(const HierarchyEntry& entry)
+{
+	return entry.parentEntry >= 0 ? hierarchyVersions[entry.parentEntry] : versions[entry.parent];
+}
+
+XMVECTOR TransformStore::GetRotation(unsigned int slot)
+{
+	return XMVectorSet(rotationX[slot], rotationY[slot], rotationZ[slot], rotationW[slot]);
+}
+
+void TransformStore::SetRotation(unsigned int slot, FXMVECTOR quaternion)
+{
+	SavePrevious(slot);
+
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, quaternion);
+	rotationX[slot] = rotation.x;
+	rotationY[slot] = rotation.y;
+	rotationZ[slot] = rotation.z;
+	rotationW[slot] = rotation.w;
+	MarkMatrixDirty(slot);
+	MarkVectorsDirty(slot);
+	eulerDirtyBits[slot / 64] |= 1ull << (slot % 64);
+}
+
+bool TransformStore::IsLive(unsigned int slot)
+{
+	return (liveBits[slot / 64] >> (slot % 64)) & 1;
+}
+
+bool TransformStore::IsMatrixDirty(unsigned int slot)
+{
+	return (matrixDirtyBits[slot / 64] >> (slot % 64)) & 1;
+}
+
+void TransformStore::MarkMatrixDirty(unsigned int slot)
+{
+	matrixDirtyBits[slot / 64] |= 1ull << (slot % 64);
+}
+
+bool TransformStore::AreVectorsDirty(unsigned int slot)
+{
+	return (vectorsDirtyBits[slot / 64] >> (slot % 64)) & 1;
+}
+
+void TransformStore::MarkVectorsDirty(unsigned int slot)
+{
+	vectorsDirtyBits[slot / 64] |= 1ull << (slot % 64);
+}
+
+bool TransformStore::AreEulerAnglesDirty(unsigned int slot)
+{
+	return (eulerDirtyBits[slot / 64] >> (slot % 64)) & 1;
+}
+
+bool TransformStore::IsInverseTransposeDirty(unsigned int slot)
+{
+	return (inverseTransposeDirtyBits[slot / 64] >> (slot % 64)) & 1;
+}
+
+bool TransformStore::IsInterpolating(unsigned int slot)
+{
+	return (interpolateBits[slot / 64] >> (slot % 64)) & 1;
+}
+
+bool TransformStore::IsComposeDirty(unsigned int slot)
+{
+	return (composeDirtyBits[slot / 64] >> (slot % 64)) & 1;
+}
+
+unsigned int TransformStore::GetCount() { return liveCount; }
+
+void TransformStore::BeginFixedStep()
+{
+	// Whatever moved in the last step and not since is drawn where it is now, unless it moves again
+	for (size_t word = 0; word < interpolateBits.size(); word++)
+	{
+		matrixDirtyBits[word] |= interpolateBits[word];
+		interpolateBits[word] = 0;
+	}
+
+	stepping = true;
+	interpolation = 1.0f;
+}
+
+void TransformStore::EndFixedStep()
+{
+	stepping = false;
+}
+
+void TransformStore::SetInterpolation(float t)
+{
+	interpolation = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+
+	// Every slot still blending needs its matrices again at the new fraction
+	for (size_t word = 0; word < interpolateBits.size(); word++)
+		matrixDirtyBits[word] |= interpolateBits[word];
+}
+
+void TransformStore::SavePrevious(unsigned int slot)
+{
+	// Changed between steps (an inspector edit, or a teleport), so it's put straight where
+	// it's going rather than blended there from where it was before the last step
+	if (!stepping)
+	{
+		interpolateBits[slot / 64] &= ~(1ull << (slot % 64));
+		return;
+	}
+
+	if (IsInterpolating(slot))
+		return;
+
+	previousPositionX[slot] = positionX[slot];
+	previousPositionY[slot] = positionY[slot];
+	previousPositionZ[slot] = positionZ[slot];
+	previousRotationX[slot] = rotationX[slot];
+	previousRotationY[slot] = rotationY[slot];
+	previousRotationZ[slot] = rotationZ[slot];
+	previousRotationW[slot] = rotationW[slot];
+	previousScaleX[slot] = scaleX[slot];
+	previousScaleY[slot] = scaleY[slot];
+	previousScaleZ[slot] = scaleZ[slot];
+	interpolateBits[slot / 64] |= 1ull << (slot % 64);
+}
+
+unsigned int TransformStore::GetDirtyCount()
+{
+	unsigned int count = 0;
+	for (uint64_t bits : matrixDirtyBits)
+	{
+		for (; bits; bits &= bits - 1)
+			count++;
+	}
+
+	return count;
+}
+
+void TransformStore::RebuildMatrix(unsigned int slot)
+{
+	if (!IsMatrixDirty(slot))
+		return;
+
+	XMVECTOR position = XMVectorSet(positionX[slot], positionY[slot], positionZ[slot], 0);
+	XMVECTOR rotation = GetRotation(slot);
+	XMVECTOR scale = XMVectorSet(scaleX[slot], scaleY[slot], scaleZ[slot], 0);
+
+	//Blend from before the last step if it moved in it, taking the shorter way round for the rotation
+	if (IsInterpolating(slot))
+	{
+		XMVECTOR previousRotation = XMVectorSet(previousRotationX[slot], previousRotationY[slot], previousRotationZ[slot], previousRotationW[slot]);
+		if (XMVectorGetX(XMVector4Dot(previousRotation, rotation)) < 0.0f)
+			previousRotation = XMVectorNegate(previousRotation);
+
+		position = XMVectorLerp(XMVectorSet(previousPositionX[slot], previousPositionY[slot], previousPositionZ[slot], 0), position, interpolation);
+		rotation = XMQuaternionNormalize(XMVectorLerp(previousRotation, rotation, interpolation));
+		scale = XMVectorLerp(XMVectorSet(previousScaleX[slot], previousScaleY[slot], previousScaleZ[slot], 0), scale, interpolation);
+	}
+
+	//Build individual transformation matrices
+	XMMATRIX t = XMMatrixTranslationFromVector(position);
+	XMMATRIX r = XMMatrixRotationQuaternion(rotation);
+	XMMATRIX s = XMMatrixScalingFromVector(scale);
+
+	//Combine into a single world matrix
+	XMMATRIX wm = s * r * t;
+
+	//Store it somewhere - children still need their parent's applied
+	if (hierarchyIndices[slot] < 0)
+	{
+		XMStoreFloat4x4(&worldMatrices[slot], wm);
+		inverseTransposeDirtyBits[slot / 64] |= 1ull << (slot % 64);
+		versions[slot]++;
+	}
+	else
+	{
+		XMStoreFloat4x4(&hierarchyLocalMatrices[hierarchyIndices[slot]], wm);
+		composeDirtyBits[slot / 64] |= 1ull << (slot % 64);
+	}
+
+	matrixDirtyBits[slot / 64] &= ~(1ull << (slot % 64));
+}
+
+void TransformStore::UpdateWorldMatrix(unsigned int slot)
+{
+	if (hierarchyOrderDirty)
+		SortHierarchy();
+
+	// Roots only depend on themselves
+	if (parents[slot] < 0)
+	{
+		RebuildMatrix(slot);
+		return;
+	}
+
+	// Anything else needs its ancestors current first, so work back down from the root
+	ancestors.clear();
+	for (int current = slot; current >= 0; current = parents[current])
+		ancestors.push_back(current);
+
+	for (size_t i = ancestors.size(); i-- > 0; )
+	{
+		unsigned int current = ancestors[i];
+		RebuildMatrix(current);
+
+		int entry = hierarchyIndices[current];
+		if (entry >= 0 && (IsComposeDirty(current) || hierarchyParentVersions[entry] != GetParentVersion(hierarchyOrder[entry])))
+			Compose(entry);
+	}
+}
+
+// --------------------------------------------------------
+// Builds the inverse-transpose of an S*R*T matrix without
+// inverting it
+//
+// - Its rows are the rotation's rows times each scale, so
+//   dividing a row by its squared length leaves R_i / s_i,
+//   which are the rows of (S*R)^-T
+// - The last column takes the translation into that space,
+//   -dot(t, R_i) / s_i, and the last row is (0, 0, 0, 1)
+// - Only valid without shear, so children's are built from
+//   their local matrices and then combined with their
+//   parent's, as (L*P)^-T is L^-T * P^-T
+// --------------------------------------------------------
+static XMMATRIX InverseTransposeFromTRS(const XMFLOAT4X4& trs)
+{
+	XMMATRIX m = XMLoadFloat4x4(&trs);
+	XMMATRIX inverseTranspose;
+	for (int i = 0; i < 3; i++)
+	{
+		XMVECTOR rowOverScale = m.r[i] * XMVectorReciprocal(XMVector3Dot(m.r[i], m.r[i]));
+		XMVECTOR translation = XMVectorNegate(XMVector3Dot(m.r[3], rowOverScale));
+		inverseTranspose.r[i] = XMVectorSetW(rowOverScale, XMVectorGetX(translation));
+	}
+
+	inverseTranspose.r[3] = XMVectorSet(0, 0, 0, 1);
+	return inverseTranspose;
+}
+
+void TransformStore::UpdateInverseTranspose(unsigned int slot)
+{
+	UpdateWorldMatrix(slot);
+
+	// Walk up to the first ancestor whose inverse-transpose is current, then back down building each one
+	ancestors.clear();
+	for (int current = slot; current >= 0 && IsInverseTransposeDirty(current); current = parents[current])
+		ancestors.push_back(current);
+
+	for (size_t i = ancestors.size(); i-- > 0; )
+	{
+		unsigned int current = ancestors[i];
+		int entry = hierarchyIndices[current];
+		if (entry < 0)
+		{
+			XMStoreFloat4x4(&worldInverseTransposeMatrices[current], InverseTransposeFromTRS(worldMatrices[current]));
+		}
+		else
+		{
+			const HierarchyEntry& child = hierarchyOrder[entry];
+			const XMFLOAT4X4& parentInverseTranspose = child.parentEntry < 0 ?
+				worldInverseTransposeMatrices[child.parent] : hierarchyWorldInverseTransposeMatrices[child.parentEntry];
+			XMStoreFloat4x4(&hierarchyWorldInverseTransposeMatrices[entry], XMMatrixMultiply(
+				InverseTransposeFromTRS(hierarchyLocalMatrices[entry]), XMLoadFloat4x4(&parentInverseTranspose)));
+		}
+
+		inverseTransposeDirtyBits[current / 64] &= ~(1ull << (current % 64));
+	}
+}
+
+void TransformStore::UpdateVectors(unsigned int slot)
+{
+	//Leave if there's no work
+	if (!AreVectorsDirty(slot))
+		return;
+
+	//Update all three vectors - they're just the rows of the rotation matrix
+	XMMATRIX r = XMMatrixRotationQuaternion(GetRotation(slot));
+	XMStoreFloat3(&rights[slot], r.r[0]);
+	XMStoreFloat3(&ups[slot], r.r[1]);
+	XMStoreFloat3(&forwards[slot], r.r[2]);
+
+	//We're clean
+	vectorsDirtyBits[slot / 64] &= ~(1ull << (slot % 64));
+}
+
+// --------------------------------------------------------
+// Works out pitch, yaw and roll from the quaternion, for
+// anything that still wants to show or edit angles
+//
+// - The rotation matrix is XMMatrixRotationRollPitchYaw's,
+//   Rz(roll) * Rx(pitch) * Ry(yaw), so its second column is
+//   (sr*cp, cr*cp, -sp) and its third row's length is cp,
+//   which give roll and pitch
+// - Yaw is then read from the first row of the matrix with
+//   that roll taken back off, which is (cy, 0, -sy), so it
+//   makes up for whatever error roll has
+// - Straight up or down (cp near 0) yaw and roll turn
+//   about the same axis, so roll is taken as 0 and yaw
+//   carries the whole turn
+// - Pitch comes out in [-pi/2, pi/2] and the others in
+//   [-pi, pi], so the angles may not be the ones that
+//   were put in, only the same rotation
+// --------------------------------------------------------
+void TransformStore::UpdateEulerAngles(unsigned int slot)
+{
+	if (!AreEulerAnglesDirty(slot))
+		return;
+
+	XMFLOAT3X3 r;
+	XMStoreFloat3x3(&r, XMMatrixRotationQuaternion(GetRotation(slot)));
+
+	float cosPitch = sqrtf(r._31 * r._31 + r._33 * r._33);
+	float roll = cosPitch > 1e-5f ? atan2f(r._12, r._22) : 0.0f;
+	float sinRoll = sinf(roll);
+	float cosRoll = cosf(roll);
+
+	XMFLOAT3& angles = eulerAngles[slot];
+	angles.x = atan2f(-r._32, cosPitch);
+	angles.y = atan2f(sinRoll * r._23 - cosRoll * r._13, cosRoll * r._11 - sinRoll * r._21);
+	angles.z = roll;
+
+	eulerDirtyBits[slot / 64] &= ~(1ull << (slot % 64));
+}
+
+int TransformStore::UpdateWorldMatrices()
+{
+	// Children's own matrices go straight into their entries, which have to be in place first
+	if (hierarchyOrderDirty)
+		SortHierarchy();
+
+	int rebuilt = 0;
+	for (size_t word = 0; word < matrixDirtyBits.size(); word++)
+	{
+		uint64_t dirty = matrixDirtyBits[word];
+		if (!dirty)
+			continue;
+
+		for (unsigned int lane = 0; lane < 64; lane += 4)
+		{
+			unsigned int laneMask = (unsigned int)(dirty >> lane) & 0xF;
+			if (laneMask)
+				UpdateBatch((unsigned int)word * 64 + lane, laneMask);
+		}
+
+		matrixDirtyBits[word] = 0;
+		for (; dirty; dirty &= dirty - 1)
+			rebuilt++;
+	}
+
+	// One pass down the hierarchy, parents always ahead of their children
+	for (unsigned int entry = 0; entry < hierarchyOrder.size(); entry++)
+	{
+		const HierarchyEntry& child = hierarchyOrder[entry];
+		if (IsComposeDirty(child.slot) || hierarchyParentVersions[entry] != GetParentVersion(child))
+			Compose(entry);
+	}
+
+	return rebuilt;
+}
+
+// --------------------------------------------------------
+// Rebuilds four slots' matrices at once
+//
+// - Every vector holds one value for each of the four
+//   slots, loaded straight out of the arrays, so the whole
+//   S*R*T product is worked out element by element
+// - The rotation is XMMatrixRotationQuaternion's, written
+//   out in terms of the quaternions' components, so it
+//   takes no sines or cosines at all
+// - Lanes still blending from the last step lerp every
+//   component, rotations included, and select the result
+//   so the others stay exact.  Dividing by the squared
+//   length in the rotation normalizes the blended ones
+// - Transposing each row's four component vectors turns
+//   them into that row for each of the four slots
+// --------------------------------------------------------
+void TransformStore::UpdateBatch(unsigned int firstSlot, unsigned int laneMask)
+{
+	XMVECTOR qx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&rotationX[firstSlot]));
+	XMVECTOR qy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&rotationY[firstSlot]));
+	XMVECTOR qz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&rotationZ[firstSlot]));
+	XMVECTOR qw = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&rotationW[firstSlot]));
+	XMVECTOR px = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionX[firstSlot]));
+	XMVECTOR py = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionY[firstSlot]));
+	XMVECTOR pz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionZ[firstSlot]));
+	XMVECTOR sx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&scaleX[firstSlot]));
+	XMVECTOR sy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&scaleY[firstSlot]));
+	XMVECTOR sz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&scaleZ[firstSlot]));
+	XMVECTOR one = XMVectorSplatOne();
+
+	// Twice the rotation over its squared length, which is just 2 for unit quaternions
+	XMVECTOR twice = XMVectorReplicate(2.0f);
+
+	// Lanes that moved in the last step blend from their previous values, the short way round
+	unsigned int interpolateMask = (unsigned int)(interpolateBits[firstSlot / 64] >> (firstSlot % 64)) & laneMask;
+	if (interpolateMask)
+	{
+		XMVECTOR blending = XMVectorSelectControl(
+			interpolateMask & 1, (interpolateMask >> 1) & 1, (interpolateMask >> 2) & 1, (interpolateMask >> 3) & 1);
+
+		XMVECTOR previousX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousRotationX[firstSlot]));
+		XMVECTOR previousY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousRotationY[firstSlot]));
+		XMVECTOR previousZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousRotationZ[firstSlot]));
+		XMVECTOR previousW = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousRotationW[firstSlot]));
+		XMVECTOR flip = XMVectorLess(previousX * qx + previousY * qy + previousZ * qz + previousW * qw, XMVectorZero());
+		qx = XMVectorSelect(qx, XMVectorLerp(XMVectorSelect(previousX, XMVectorNegate(previousX), flip), qx, interpolation), blending);
+		qy = XMVectorSelect(qy, XMVectorLerp(XMVectorSelect(previousY, XMVectorNegate(previousY), flip), qy, interpolation), blending);
+		qz = XMVectorSelect(qz, XMVectorLerp(XMVectorSelect(previousZ, XMVectorNegate(previousZ), flip), qz, interpolation), blending);
+		qw = XMVectorSelect(qw, XMVectorLerp(XMVectorSelect(previousW, XMVectorNegate(previousW), flip), qw, interpolation), blending);
+		twice = XMVectorSelect(twice, twice / (qx * qx + qy * qy + qz * qz + qw * qw), blending);
+
+		px = XMVectorSelect(px, XMVectorLerp(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousPositionX[firstSlot])), px, interpolation), blending);
+		py = XMVectorSelect(py, XMVectorLerp(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousPositionY[firstSlot])), py, interpolation), blending);
+		pz = XMVectorSelect(pz, XMVectorLerp(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousPositionZ[firstSlot])), pz, interpolation), blending);
+		sx = XMVectorSelect(sx, XMVectorLerp(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousScaleX[firstSlot])), sx, interpolation), blending);
+		sy = XMVectorSelect(sy, XMVectorLerp(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousScaleY[firstSlot])), sy, interpolation), blending);
+		sz = XMVectorSelect(sz, XMVectorLerp(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&previousScaleZ[firstSlot])), sz, interpolation), blending);
+	}
+
+	XMVECTOR x2 = qx * twice;
+	XMVECTOR y2 = qy * twice;
+	XMVECTOR z2 = qz * twice;
+	XMVECTOR xx = qx * x2, yy = qy * y2, zz = qz * z2;
+	XMVECTOR xy = qx * y2, xz = qx * z2, yz = qy * z2;
+	XMVECTOR wx = qw * x2, wy = qw * y2, wz = qw * z2;
+
+	XMVECTOR r00 = one - yy - zz;
+	XMVECTOR r01 = xy + wz;
+	XMVECTOR r02 = xz - wy;
+	XMVECTOR r10 = xy - wz;
+	XMVECTOR r11 = one - xx - zz;
+	XMVECTOR r12 = yz + wx;
+	XMVECTOR r20 = xz + wy;
+	XMVECTOR r21 = yz - wx;
+	XMVECTOR r22 = one - xx - yy;
+
+	XMVECTOR zero = XMVectorZero();
+
+	XMMATRIX world[3] = {
+		XMMatrixTranspose(XMMATRIX(r00 * sx, r01 * sx, r02 * sx, zero)),
+		XMMatrixTranspose(XMMATRIX(r10 * sy, r11 * sy, r12 * sy, zero)),
+		XMMatrixTranspose(XMMATRIX(r20 * sz, r21 * sz, r22 * sz, zero)) };
+	XMMATRIX translation = XMMatrixTranspose(XMMATRIX(px, py, pz, one));
+
+	for (unsigned int lane = 0; lane < 4; lane++)
+	{
+		if (!(laneMask & (1 << lane)))
+			continue;
+
+		// Children keep theirs as local matrices, for the hierarchy pass to combine with their parent's
+		unsigned int slot = firstSlot + lane;
+		int entry = hierarchyIndices[slot];
+		XMMATRIX matrix(world[0].r[lane], world[1].r[lane], world[2].r[lane], translation.r[lane]);
+		if (entry < 0)
+		{
+			XMStoreFloat4x4(&worldMatrices[slot], matrix);
+			inverseTransposeDirtyBits[slot / 64] |= 1ull << (slot % 64);
+			versions[slot]++;
+		}
+		else
+		{
+			XMStoreFloat4x4(&hierarchyLocalMatrices[entry], matrix);
+			composeDirtyBits[slot / 64] |= 1ull << (slot % 64);
+		}
+	}
+}
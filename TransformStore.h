@@ -0,0 +1,196 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+class Transform;
+
+// --------------------------------------------------------
+// Keeps the position, rotation and scale of every Transform
+// in one structure-of-arrays, so the world matrices of
+// everything that moved can be rebuilt together
+//
+// - Each Transform is a slot in here; the Transform object
+//   itself only remembers which one
+// - The arrays grow 64 slots at a time, one word of the
+//   bitsets, so a batch never runs off their end.  Freed
+//   slots are reused before they grow
+// - A set bit in the dirty bitset means the slot's matrices
+//   are out of date.  UpdateWorldMatrices() skips whole
+//   64-slot words that are clean and rebuilds the rest four
+//   slots at a time, straight from their quaternions
+// - Rotations are kept as unit quaternions.  Pitch, yaw and
+//   roll are only worked out (and cached) when something
+//   asks for them, unless they were what was set
+// - Inverse-transposes are only built when asked for, as
+//   most draws (shadows, for one) never use them, and come
+//   straight from the rotation and scale rather than a
+//   general 4x4 inverse.  They have a dirty bit of their own
+// - Children's matrices are their own S*R*T times their
+//   parent's world matrix.  They're kept apart from the
+//   roots', in arrays sorted by depth, so after the batch
+//   one front-to-back pass composes every child whose own
+//   matrix or parent's world matrix changed since it was
+//   last composed (parents always come first).  The order
+//   is only rebuilt when something is reparented or freed
+// - Between BeginFixedStep() and EndFixedStep(), the first
+//   change to a slot saves what it was before the step, and
+//   until the next step its matrices blend from that to its
+//   current values by SetInterpolation()'s fraction, unless
+//   it's changed again outside a step, which snaps it to
+//   its new values.  Only the matrices are blended -
+//   positions, rotations, scales and vectors read back are
+//   always the current ones
+// - A transform asked for its matrix while it's dirty still
+//   rebuilds just itself (and its dirty ancestors) the old
+//   way, so nothing depends on UpdateWorldMatrices() having
+//   been called
+// - Not thread safe
+// --------------------------------------------------------
+class TransformStore
+{
+public:
+	//the store every Transform lives in unless it's given another
+	static TransformStore& GetInstance();
+
+	TransformStore();
+	~TransformStore();
+
+	// Transforms point back into the store, so it can't be copied
+	TransformStore(TransformStore const&) = delete;
+	void operator=(TransformStore const&) = delete;
+
+	//rebuilds the matrices of every dirty slot in SIMD batches, then passes them down to every
+	//child that needs them, returning how many slots' own matrices were rebuilt
+	int UpdateWorldMatrices();
+
+	//call around each fixed simulation step, so anything moved in it is drawn in between its
+	//states before and after the step (matrices are unblended while a step runs)
+	void BeginFixedStep();
+	void EndFixedStep();
+
+	//how far from the last step's previous states (0) to the current ones (1) to draw
+	//whatever moved in it
+	void SetInterpolation(float t);
+
+	//returns how many transforms currently live in the store
+	unsigned int GetCount();
+
+	//returns how many of them have matrices waiting to be rebuilt
+	unsigned int GetDirtyCount();
+
+private:
+	friend class Transform;
+
+	//one entry per slot, the arrays always a whole number of 64-slot bitset words long
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW; //unit quaternions
+	std::vector<DirectX::XMFLOAT3> eulerAngles; //pitch, yaw and roll, only up to date while the slot's euler dirty bit is clear
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<float> previousPositionX, previousPositionY, previousPositionZ; //from before the last step, while interpolating
+	std::vector<float> previousRotationX, previousRotationY, previousRotationZ, previousRotationW;
+	std::vector<float> previousScaleX, previousScaleY, previousScaleZ;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices; //only up to date for roots (children's are below)
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices; //only up to date once asked for
+	std::vector<DirectX::XMFLOAT3> forwards, rights, ups;
+	std::vector<unsigned int> versions; //bumped whenever a root's world matrix is rebuilt
+	std::vector<int> parents; //-1 for roots
+	std::vector<int> firstChildren; //each slot's children are a linked list through the sibling arrays (-1 ends it)
+	std::vector<int> nextSiblings;
+	std::vector<int> previousSiblings;
+	std::vector<int> hierarchyIndices; //where a child is in the hierarchy arrays (-1 for roots)
+	std::vector<Transform*> owners;
+
+	std::vector<uint64_t> matrixDirtyBits; //one bit per slot
+	std::vector<uint64_t> composeDirtyBits; //local matrix rebuilt, not yet combined with the parent's
+	std::vector<uint64_t> inverseTransposeDirtyBits; //world matrix changed since the inverse-transpose was built
+	std::vector<uint64_t> vectorsDirtyBits;
+	std::vector<uint64_t> eulerDirtyBits; //rotation changed since eulerAngles was set or worked out
+	std::vector<uint64_t> interpolateBits; //changed during the last fixed step, so the previous arrays hold its state before it
+	std::vector<uint64_t> liveBits;
+	std::vector<unsigned int> freeSlots;
+	unsigned int slotCount; //slots ever handed out, live or not
+	unsigned int liveCount;
+	bool stepping; //between BeginFixedStep() and EndFixedStep()
+	float interpolation;
+
+	// One slot that has a parent
+	struct HierarchyEntry
+	{
+		unsigned int slot;
+		unsigned int parent;
+		int parentEntry; //the parent's own entry (-1 if it's a root)
+	};
+
+	//one entry per slot with a parent, shallowest first
+	std::vector<HierarchyEntry> hierarchyOrder;
+	std::vector<DirectX::XMFLOAT4X4> hierarchyLocalMatrices; //just the child's own S*R*T
+	std::vector<DirectX::XMFLOAT4X4> hierarchyWorldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> hierarchyWorldInverseTransposeMatrices;
+	std::vector<unsigned int> hierarchyVersions; //the child's version, bumped whenever it's composed
+	std::vector<unsigned int> hierarchyParentVersions; //the parent's version when the child was last composed
+	bool hierarchyOrderDirty;
+	std::vector<unsigned int> ancestors; //reused to walk back down from the root when updating one slot
+
+	//returns a slot holding an identity transform, with no parent
+	unsigned int Allocate(Transform* owner);
+
+	//frees a slot, turning its children into roots
+	void Free(unsigned int slot);
+
+	//copies one slot's position, rotation and scale into another (which may be in another store)
+	void CopySlot(unsigned int slot, TransformStore& destStore, unsigned int destSlot);
+
+	//returns false, changing nothing, if parent (-1 for none) would make a loop
+	bool SetParent(unsigned int slot, int parent);
+
+	//sorts every slot with a parent by its depth in the hierarchy, rebuilding the hierarchy arrays
+	void SortHierarchy();
+
+	//combines a child's local matrices with its parent's world matrices
+	void Compose(unsigned int entry);
+
+	//read a slot's world matrices and version from wherever it keeps them (once the hierarchy is sorted)
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int slot);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(unsigned int slot);
+	unsigned int GetVersion(unsigned int slot);
+	unsigned int GetParentVersion(const HierarchyEntry& entry);
+
+	//a slot's rotation as a quaternion; setting one marks everything built from it dirty
+	DirectX::XMVECTOR GetRotation(unsigned int slot);
+	void SetRotation(unsigned int slot, DirectX::FXMVECTOR quaternion);
+
+	bool IsLive(unsigned int slot);
+	bool IsMatrixDirty(unsigned int slot);
+	void MarkMatrixDirty(unsigned int slot);
+	bool AreVectorsDirty(unsigned int slot);
+	void MarkVectorsDirty(unsigned int slot);
+	bool AreEulerAnglesDirty(unsigned int slot);
+	bool IsInterpolating(unsigned int slot);
+	bool IsComposeDirty(unsigned int slot);
+	bool IsInverseTransposeDirty(unsigned int slot);
+
+	//saves a slot's position, rotation and scale as its previous ones, if a step is running
+	//and they haven't been already, or stops it blending if no step is - called before
+	//anything changes them
+	void SavePrevious(unsigned int slot);
+
+	//rebuilds one slot's own S*R*T the old way, if it's dirty
+	void RebuildMatrix(unsigned int slot);
+
+	//brings one slot's world matrix up to date on its own, along with its ancestors'
+	void UpdateWorldMatrix(unsigned int slot);
+
+	//brings one slot's world matrix and its inverse-transpose up to date, along with its ancestors'
+	void UpdateInverseTranspose(unsigned int slot);
+
+	//rebuilds forward, right and up for one slot, if they're dirty
+	void UpdateVectors(unsigned int slot);
+
+	//works out pitch, yaw and roll for one slot from its quaternion, if they're dirty
+	void UpdateEulerAngles(unsigned int slot);
+
+	//rebuilds the four slots starting at firstSlot, storing only the lanes set in laneMask
+	void UpdateBatch(unsigned int firstSlot, unsigned int laneMask);
+};